@@ -6,19 +6,65 @@
 #include <stdint.h>
 
 typedef struct Nin64State Nin64State;
+typedef struct Nin64Batch Nin64Batch;
 typedef enum
 {
     NIN64_OK                = 0,
     NIN64_ERROR_OUTOFMEMORY = 1,
     NIN64_ERROR_IO          = 2,
-    NIN64_ERROR_BADROM      = 3
+    NIN64_ERROR_BADROM      = 3,
+    NIN64_ERROR_UNSUPPORTED = 4,
+    NIN64_ERROR_BADSTATE    = 5,
+    NIN64_ERROR_EMPTY       = 6
 } Nin64Err;
+typedef enum
+{
+    NIN64_CPU_INTERPRETER = 0,
+    NIN64_CPU_RECOMPILER  = 1
+} Nin64CpuBackend;
+typedef struct
+{
+    uint64_t cycles;       /* Emulated CPU cycles */
+    uint64_t instructions; /* CPU instructions retired, idle loops skipped over excluded */
+    uint64_t cpuTime;      /* Wall time per component in nanoseconds, see nin64SetProfiling */
+    uint64_t rspTime;
+    uint64_t rdpTime;
+    uint64_t aiTime;
+    uint64_t viTime;
+} Nin64Stats;
 typedef void (*Nin64AudioCallback)(const uint16_t*, size_t, void*);
+typedef void (*Nin64FrameCallback)(Nin64State* state, size_t index, void* arg);
 
 NIN64_API Nin64Err nin64CreateState(Nin64State** dst, const char* romPath);
 NIN64_API Nin64Err nin64DestroyState(Nin64State* state);
 NIN64_API Nin64Err nin64RunCycles(Nin64State* state, size_t count);
 NIN64_API Nin64Err nin64RunFrame(Nin64State* state);
 NIN64_API Nin64Err nin64SetAudioCallback(Nin64State* state, Nin64AudioCallback callback, void* callbackArg);
+NIN64_API Nin64Err nin64SetCpuBackend(Nin64State* state, Nin64CpuBackend backend);
+NIN64_API Nin64Err nin64SetThreaded(Nin64State* state, int threaded);
+NIN64_API Nin64Err nin64SetCacheEmulation(Nin64State* state, int enabled);
+NIN64_API Nin64Err nin64SetAudioHLE(Nin64State* state, int enabled);
+NIN64_API Nin64Err nin64SetProfiling(Nin64State* state, int enabled);
+NIN64_API Nin64Err nin64GetStats(Nin64State* state, Nin64Stats* stats);
+NIN64_API Nin64Err nin64SaveStateSize(Nin64State* state, size_t* size);
+NIN64_API Nin64Err nin64SaveState(Nin64State* state, void* buffer, size_t size);
+NIN64_API Nin64Err nin64SaveStateDelta(Nin64State* state, void* buffer, size_t size, size_t* written);
+NIN64_API Nin64Err nin64LoadState(Nin64State* state, const void* buffer, size_t size);
+NIN64_API Nin64Err nin64SetRewindBudget(Nin64State* state, size_t budget);
+NIN64_API Nin64Err nin64RewindPush(Nin64State* state);
+NIN64_API Nin64Err nin64RewindStep(Nin64State* state);
+
+/* ROM fingerprints are an xxHash64 of the big endian image, the same for any byte order */
+NIN64_API Nin64Err nin64GetRomFingerprint(Nin64State* state, uint64_t* fingerprint);
+NIN64_API Nin64Err nin64RomFingerprint(const char* romPath, uint64_t* fingerprint);
+
+/*
+ * Batches step many states on a pool of threads, 0 meaning one per core.
+ * The callback runs on the pool after each frame of each state, for
+ * different states at once but never twice at once for the same state.
+ */
+NIN64_API Nin64Err nin64CreateBatch(Nin64Batch** dst, size_t threads);
+NIN64_API Nin64Err nin64DestroyBatch(Nin64Batch* batch);
+NIN64_API Nin64Err nin64BatchRunFrames(Nin64Batch* batch, Nin64State* const* states, size_t count, size_t frames, Nin64FrameCallback callback, void* callbackArg);
 
 #endif
@@ -0,0 +1,190 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <nin64/nin64.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/*
+ * Headless benchmark: runs a ROM for a number of frames with no audio or
+ * video output, and reports the speed and where the time went as JSON.
+ * With several instances, they run side by side on a batch and the stats
+ * are summed over all of them.
+ */
+
+static std::uint64_t peakRss()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage))
+        return 0;
+#if defined(__APPLE__)
+    return (std::uint64_t)usage.ru_maxrss;
+#else
+    return (std::uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+static void printString(std::FILE* out, const char* str)
+{
+    std::fputc('"', out);
+    for (; *str; ++str)
+    {
+        if (*str == '"' || *str == '\\')
+            std::fputc('\\', out);
+        if ((unsigned char)*str < 0x20)
+            std::fprintf(out, "\\u%04x", *str);
+        else
+            std::fputc(*str, out);
+    }
+    std::fputc('"', out);
+}
+
+static void usage()
+{
+    std::puts("usage: nin64-bench <rom> [--frames N] [--instances N] [--jobs N] [--recompiler] [--threaded] [--caches] [--audio-hle] [--output FILE]");
+    std::exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<Nin64State*> states;
+    Nin64Batch*              batch;
+    Nin64Stats               stats{};
+    Nin64Stats               instanceStats;
+    Nin64Err                 err;
+    const char*              output{};
+    std::FILE*               out;
+    unsigned long            frames{600};
+    unsigned long            instances{1};
+    unsigned long            jobs{};
+    bool                     recompiler{};
+    bool                     threaded{};
+    bool                     caches{};
+    bool                     audioHLE{};
+    double                   seconds;
+
+    if (argc < 2)
+        usage();
+    for (int i = 2; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+            instances = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            jobs = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else if (std::strcmp(argv[i], "--recompiler") == 0)
+            recompiler = true;
+        else if (std::strcmp(argv[i], "--threaded") == 0)
+            threaded = true;
+        else if (std::strcmp(argv[i], "--caches") == 0)
+            caches = true;
+        else if (std::strcmp(argv[i], "--audio-hle") == 0)
+            audioHLE = true;
+        else
+            usage();
+    }
+    if (!instances)
+        usage();
+
+    states.resize(instances);
+    for (auto& state : states)
+    {
+        if ((err = nin64CreateState(&state, argv[1])))
+        {
+            std::fprintf(stderr, "nin64-bench: cannot load %s (error %d)\n", argv[1], (int)err);
+            return 1;
+        }
+        if (recompiler && (err = nin64SetCpuBackend(state, NIN64_CPU_RECOMPILER)))
+        {
+            std::fprintf(stderr, "nin64-bench: the recompiler is not supported here\n");
+            return 1;
+        }
+        nin64SetThreaded(state, threaded);
+        nin64SetCacheEmulation(state, caches);
+        nin64SetAudioHLE(state, audioHLE);
+        nin64SetProfiling(state, 1);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (instances == 1)
+    {
+        for (unsigned long i = 0; i < frames; ++i)
+            nin64RunFrame(states[0]);
+    }
+    else
+    {
+        nin64CreateBatch(&batch, jobs);
+        nin64BatchRunFrames(batch, states.data(), states.size(), frames, nullptr, nullptr);
+        nin64DestroyBatch(batch);
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (auto state : states)
+    {
+        nin64GetStats(state, &instanceStats);
+        stats.cycles       += instanceStats.cycles;
+        stats.instructions += instanceStats.instructions;
+        stats.cpuTime      += instanceStats.cpuTime;
+        stats.rspTime      += instanceStats.rspTime;
+        stats.rdpTime      += instanceStats.rdpTime;
+        stats.aiTime       += instanceStats.aiTime;
+        stats.viTime       += instanceStats.viTime;
+    }
+
+    out = output ? std::fopen(output, "w") : stdout;
+    if (!out)
+    {
+        std::fprintf(stderr, "nin64-bench: cannot open %s\n", output);
+        return 1;
+    }
+    std::fprintf(out, "{\n");
+    std::fprintf(out, "  \"rom\": ");
+    printString(out, argv[1]);
+    std::fprintf(out, ",\n");
+    std::fprintf(out, "  \"backend\": \"%s\",\n", recompiler ? "recompiler" : "interpreter");
+    std::fprintf(out, "  \"threaded\": %s,\n", threaded ? "true" : "false");
+    std::fprintf(out, "  \"caches\": %s,\n", caches ? "true" : "false");
+    std::fprintf(out, "  \"audio_hle\": %s,\n", audioHLE ? "true" : "false");
+    std::fprintf(out, "  \"instances\": %lu,\n", instances);
+    std::fprintf(out, "  \"frames\": %lu,\n", frames);
+    std::fprintf(out, "  \"seconds\": %.6f,\n", seconds);
+    std::fprintf(out, "  \"fps\": %.3f,\n", frames * instances / seconds);
+    std::fprintf(out, "  \"cycles\": %llu,\n", (unsigned long long)stats.cycles);
+    std::fprintf(out, "  \"instructions\": %llu,\n", (unsigned long long)stats.instructions);
+    std::fprintf(out, "  \"mips\": %.3f,\n", stats.instructions / seconds / 1e6);
+    std::fprintf(out, "  \"time\": {\n");
+    std::fprintf(out, "    \"cpu\": %.6f,\n", stats.cpuTime / 1e9);
+    std::fprintf(out, "    \"rsp\": %.6f,\n", stats.rspTime / 1e9);
+    std::fprintf(out, "    \"rdp\": %.6f,\n", stats.rdpTime / 1e9);
+    std::fprintf(out, "    \"ai\": %.6f,\n", stats.aiTime / 1e9);
+    std::fprintf(out, "    \"vi\": %.6f\n", stats.viTime / 1e9);
+    std::fprintf(out, "  },\n");
+    std::fprintf(out, "  \"peak_rss\": %llu\n", (unsigned long long)peakRss());
+    std::fprintf(out, "}\n");
+    if (out != stdout)
+        std::fclose(out);
+
+    for (auto state : states)
+        nin64DestroyState(state);
+    return 0;
+}
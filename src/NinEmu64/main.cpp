@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <nin64/nin64.h>
 #include <vector>
 
@@ -26,6 +27,9 @@ static void displayError(Nin64Err err)
     case NIN64_ERROR_BADROM:
         std::puts("Bad Rom");
         break;
+    case NIN64_ERROR_UNSUPPORTED:
+        std::puts("Unsupported");
+        break;
     default:
         std::puts("Unknown Error");
         break;
@@ -92,6 +96,17 @@ int main(int argc, char** argv)
         displayError(err);
         std::exit(1);
     }
+    for (int i = 2; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--recompiler") == 0)
+            err = nin64SetCpuBackend(state, NIN64_CPU_RECOMPILER);
+        else if (std::strcmp(argv[i], "--threaded") == 0)
+            err = nin64SetThreaded(state, 1);
+        else
+            continue;
+        if (err)
+            displayError(err);
+    }
     for (;;)
     {
         // printf("=================\n");
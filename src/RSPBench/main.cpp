@@ -0,0 +1,175 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <libnin64/RSPVector.h>
+#include <vector>
+
+using namespace libnin64;
+
+struct Op
+{
+    const char*              name;
+    RSPVectorUnit::Multiply RSPVectorUnit::*multiply;
+    RSPVectorUnit::Clip RSPVectorUnit::*clip;
+};
+
+static const Op kOps[] = {
+    {"vmulf", &RSPVectorUnit::vmulf, nullptr},
+    {"vmulu", &RSPVectorUnit::vmulu, nullptr},
+    {"vmudl", &RSPVectorUnit::vmudl, nullptr},
+    {"vmudm", &RSPVectorUnit::vmudm, nullptr},
+    {"vmudn", &RSPVectorUnit::vmudn, nullptr},
+    {"vmudh", &RSPVectorUnit::vmudh, nullptr},
+    {"vmacf", &RSPVectorUnit::vmacf, nullptr},
+    {"vmacu", &RSPVectorUnit::vmacu, nullptr},
+    {"vmadl", &RSPVectorUnit::vmadl, nullptr},
+    {"vmadm", &RSPVectorUnit::vmadm, nullptr},
+    {"vmadn", &RSPVectorUnit::vmadn, nullptr},
+    {"vmadh", &RSPVectorUnit::vmadh, nullptr},
+    {"vcl", nullptr, &RSPVectorUnit::vcl},
+    {"vch", nullptr, &RSPVectorUnit::vch},
+};
+
+struct Result
+{
+    __m128i       value;
+    __m128i       acc[3];
+    std::uint16_t vcc;
+    std::uint16_t vco;
+    std::uint8_t  vce;
+};
+
+static std::uint32_t gSeed = 0x12345678;
+
+static std::uint16_t random16()
+{
+    gSeed = gSeed * 1664525 + 1013904223;
+    return (std::uint16_t)(gSeed >> 16);
+}
+
+static __m128i randomVector()
+{
+    std::uint16_t raw[8];
+
+    for (int i = 0; i < 8; ++i)
+    {
+        /* Bias towards the edge cases */
+        switch (random16() & 3)
+        {
+        case 0:
+            raw[i] = 0x8000 + (random16() & 3) - 1;
+            break;
+        case 1:
+            raw[i] = (random16() & 3) - 1;
+            break;
+        default:
+            raw[i] = random16();
+            break;
+        }
+    }
+    return _mm_loadu_si128((const __m128i*)raw);
+}
+
+static Result execute(const RSPVectorUnit& vu, const Op& op, __m128i vs, __m128i vt, std::uint8_t e, const __m128i* acc)
+{
+    Result r{};
+
+    std::memcpy(r.acc, acc, sizeof(r.acc));
+    if (op.multiply)
+        r.value = (vu.*op.multiply)(vs, vt, e, r.acc);
+    else
+        r.value = (vu.*op.clip)(vs, vt, e, r.acc, &r.vcc, &r.vco, &r.vce);
+    return r;
+}
+
+static bool same(const Result& a, const Result& b)
+{
+    return !std::memcmp(&a.value, &b.value, sizeof(a.value)) && !std::memcmp(a.acc, b.acc, sizeof(a.acc)) && a.vcc == b.vcc && a.vco == b.vco && a.vce == b.vce;
+}
+
+/* Every backend must match the SSE2 reference bit for bit */
+static int verify(const RSPVectorUnit& vu, std::size_t count)
+{
+    int errors{};
+
+    for (const Op& op : kOps)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            __m128i      vs  = randomVector();
+            __m128i      vt  = randomVector();
+            __m128i      acc[3] = {randomVector(), randomVector(), randomVector()};
+            std::uint8_t e      = (std::uint8_t)(random16() & 0xf);
+
+            if (!same(execute(kRSPVectorSSE2, op, vs, vt, e, acc), execute(vu, op, vs, vt, e, acc)))
+            {
+                std::printf("%s: %s mismatch (e=%d)\n", vu.name, op.name, e);
+                errors++;
+                break;
+            }
+        }
+    }
+    return errors;
+}
+
+static double bench(const RSPVectorUnit& vu, const Op& op, std::size_t count)
+{
+    __m128i       vregs[4] = {randomVector(), randomVector(), randomVector(), randomVector()};
+    __m128i       acc[3]   = {};
+    std::uint16_t vcc;
+    std::uint16_t vco;
+    std::uint8_t  vce;
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        __m128i* vd = &vregs[i & 3];
+        __m128i  vs = vregs[(i + 1) & 3];
+        __m128i  vt = vregs[(i + 2) & 3];
+
+        if (op.multiply)
+            *vd = (vu.*op.multiply)(vs, vt, (std::uint8_t)(i & 0xf), acc);
+        else
+            *vd = (vu.*op.clip)(vs, vt, (std::uint8_t)(i & 0xf), acc, &vcc, &vco, &vce);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    /* Keep the results alive */
+    if (_mm_movemask_epi8(_mm_or_si128(vregs[0], acc[0])) == 0x12345)
+        std::puts("");
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<const RSPVectorUnit*> units;
+    std::size_t                       count;
+    int                               errors{};
+
+    count = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+
+    units.push_back(&kRSPVectorSSE2);
+    if (RSPVectorUnit::detect() == RSPVectorBackend::AVX2)
+        units.push_back(&kRSPVectorAVX2);
+
+    for (std::size_t i = 1; i < units.size(); ++i)
+        errors += verify(*units[i], 100000);
+
+    std::printf("%-8s", "op");
+    for (const RSPVectorUnit* vu : units)
+        std::printf("%10s", vu->name);
+    std::printf("   (ns/op)\n");
+
+    for (const Op& op : kOps)
+    {
+        std::printf("%-8s", op.name);
+        for (const RSPVectorUnit* vu : units)
+            std::printf("%10.2f", bench(*vu, op, count));
+        std::printf("\n");
+    }
+
+    return errors ? 1 : 0;
+}
@@ -1,4 +1,6 @@
-#include <cstdio>
+#include <libnin64/Batch.h>
+#include <libnin64/Log.h>
+#include <libnin64/Rom.h>
 #include <libnin64/State.h>
 #include <nin64/nin64.h>
 
@@ -30,20 +32,14 @@ NIN64_API Nin64Err nin64DestroyState(Nin64State* state)
 
 NIN64_API Nin64Err nin64RunCycles(Nin64State* state, size_t count)
 {
-    state->cpu.tick(count);
+    state->run(count);
     return NIN64_OK;
 }
 
 NIN64_API Nin64Err nin64RunFrame(Nin64State* state)
 {
-    for (int i = 0; i < (93750000 / 60 / 32); ++i)
-    {
-        state->cpu.tick(32);
-        state->rsp.tick(24);
-        state->ai.tick(32);
-        state->vi.tick(32);
-    }
-    std::printf("PC:0x%016llx\n", state->cpu.pc());
+    state->run(State::kCyclesPerFrame);
+    NIN64_LOG(Core, Trace, "PC:0x%016llx\n", state->cpu.pc());
     //state->vi.setVBlank();
     return NIN64_OK;
 }
@@ -53,3 +49,111 @@ NIN64_API Nin64Err nin64SetAudioCallback(Nin64State* state, Nin64AudioCallback c
     state->ai.setCallback(callback, callbackArg);
     return NIN64_OK;
 }
+
+NIN64_API Nin64Err nin64SetCpuBackend(Nin64State* state, Nin64CpuBackend backend)
+{
+    if (!state->cpu.setBackend(backend == NIN64_CPU_RECOMPILER ? CPUBackend::Recompiler : CPUBackend::Interpreter))
+        return NIN64_ERROR_UNSUPPORTED;
+    return NIN64_OK;
+}
+
+NIN64_API Nin64Err nin64SetThreaded(Nin64State* state, int threaded)
+{
+    state->setThreaded(!!threaded);
+    return NIN64_OK;
+}
+
+NIN64_API Nin64Err nin64SetCacheEmulation(Nin64State* state, int enabled)
+{
+    return state->setCacheEmulation(!!enabled);
+}
+
+NIN64_API Nin64Err nin64SetAudioHLE(Nin64State* state, int enabled)
+{
+    state->rsp.setAudioHLE(!!enabled);
+    return NIN64_OK;
+}
+
+NIN64_API Nin64Err nin64SetProfiling(Nin64State* state, int enabled)
+{
+    state->profiler.setEnabled(!!enabled);
+    return NIN64_OK;
+}
+
+NIN64_API Nin64Err nin64GetStats(Nin64State* state, Nin64Stats* stats)
+{
+    state->stats(stats);
+    return NIN64_OK;
+}
+
+NIN64_API Nin64Err nin64SaveStateSize(Nin64State* state, size_t* size)
+{
+    *size = state->saveSize();
+    return NIN64_OK;
+}
+
+NIN64_API Nin64Err nin64SaveState(Nin64State* state, void* buffer, size_t size)
+{
+    return state->save(buffer, size);
+}
+
+NIN64_API Nin64Err nin64SaveStateDelta(Nin64State* state, void* buffer, size_t size, size_t* written)
+{
+    return state->saveDelta(buffer, size, written);
+}
+
+NIN64_API Nin64Err nin64LoadState(Nin64State* state, const void* buffer, size_t size)
+{
+    return state->load(buffer, size);
+}
+
+NIN64_API Nin64Err nin64SetRewindBudget(Nin64State* state, size_t budget)
+{
+    return state->setRewindBudget(budget);
+}
+
+NIN64_API Nin64Err nin64RewindPush(Nin64State* state)
+{
+    return state->rewindPush();
+}
+
+NIN64_API Nin64Err nin64RewindStep(Nin64State* state)
+{
+    return state->rewindStep();
+}
+
+NIN64_API Nin64Err nin64GetRomFingerprint(Nin64State* state, uint64_t* fingerprint)
+{
+    *fingerprint = state->cart.fingerprint();
+    return NIN64_OK;
+}
+
+NIN64_API Nin64Err nin64RomFingerprint(const char* romPath, uint64_t* fingerprint)
+{
+    std::shared_ptr<const Rom> rom;
+    Nin64Err                   err;
+
+    *fingerprint = 0;
+    if ((err = Rom::open(romPath, rom)))
+        return err;
+    *fingerprint = rom->fingerprint();
+    return NIN64_OK;
+}
+
+NIN64_API Nin64Err nin64CreateBatch(Nin64Batch** dst, size_t threads)
+{
+    *dst = new Nin64Batch(threads);
+    return NIN64_OK;
+}
+
+NIN64_API Nin64Err nin64DestroyBatch(Nin64Batch* batch)
+{
+    delete batch;
+    return NIN64_OK;
+}
+
+NIN64_API Nin64Err nin64BatchRunFrames(Nin64Batch* batch, Nin64State* const* states, size_t count, size_t frames, Nin64FrameCallback callback, void* callbackArg)
+{
+    batch->run(states, count, frames, callback, callbackArg);
+    return NIN64_OK;
+}
@@ -0,0 +1,679 @@
+#include <algorithm>
+#include <cstring>
+#include <libnin64/AudioHLE.h>
+#include <libnin64/Memory.h>
+#include <libnin64/Savestate.h>
+#include <libnin64/Util.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+/* OSTask, as loaded at the end of DMEM by osSpTaskLoad */
+#define TASK_TYPE       0xfc0
+#define TASK_UCODE_DATA 0xfd8
+#define TASK_DATA_PTR   0xff0
+#define TASK_DATA_SIZE  0xff4
+
+#define M_AUDTASK 2
+
+/* Buffer addresses in ABI 1 commands are relative to this */
+#define DMEM_BASE 0x5c0
+
+#define A_INIT 0x01
+#define A_LOOP 0x02
+#define A_LEFT 0x02
+#define A_VOL  0x04
+#define A_AUX  0x08
+
+using namespace libnin64;
+
+static std::int16_t clamp16(std::int32_t value)
+{
+    return (std::int16_t)std::min(std::max(value, -32768), 32767);
+}
+
+static std::uint16_t align(std::uint16_t value, std::uint16_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/* Loads sixteen bytes from DMEM, wrapping around its end */
+static __m128i loadDmem(const std::uint8_t* dmem, std::uint16_t addr)
+{
+    std::uint8_t wrapped[16];
+
+    if (addr <= 0x1000 - 16)
+        return _mm_loadu_si128((const __m128i*)(dmem + addr));
+    for (int i = 0; i < 16; ++i)
+        wrapped[i] = dmem[(addr + i) & 0xfff];
+    return _mm_loadu_si128((const __m128i*)wrapped);
+}
+
+static void storeDmem(std::uint8_t* dmem, std::uint16_t addr, __m128i v)
+{
+    std::uint8_t wrapped[16];
+
+    if (addr <= 0x1000 - 16)
+    {
+        _mm_storeu_si128((__m128i*)(dmem + addr), v);
+        return;
+    }
+    _mm_storeu_si128((__m128i*)wrapped, v);
+    for (int i = 0; i < 16; ++i)
+        dmem[(addr + i) & 0xfff] = wrapped[i];
+}
+
+static __m128i swap16(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+/* Loads eight big-endian samples from DMEM */
+static __m128i load8(const std::uint8_t* dmem, std::uint16_t addr)
+{
+    return swap16(loadDmem(dmem, addr));
+}
+
+static void store8(std::uint8_t* dmem, std::uint16_t addr, __m128i v)
+{
+    storeDmem(dmem, addr, swap16(v));
+}
+
+/*
+ * 4-tap interpolation filter for RESAMPLE, indexed by the top six bits of
+ * the pitch accumulator. This is a Catmull-Rom spline rather than the exact
+ * table from the microcode.
+ */
+struct ResampleTable
+{
+    ResampleTable()
+    {
+        for (int i = 0; i < 64; ++i)
+        {
+            double t  = i / 64.0;
+            double t2 = t * t;
+            double t3 = t2 * t;
+
+            taps[i][0] = (std::int32_t)(32768.0 * (-t3 + 2 * t2 - t) / 2);
+            taps[i][1] = (std::int32_t)(32768.0 * (3 * t3 - 5 * t2 + 2) / 2);
+            taps[i][2] = (std::int32_t)(32768.0 * (-3 * t3 + 4 * t2 + t) / 2);
+            taps[i][3] = (std::int32_t)(32768.0 * (t3 - t2) / 2);
+        }
+    }
+
+    std::int32_t taps[64][4];
+};
+
+static const ResampleTable kResample;
+
+AudioHLE::AudioHLE(Memory& memory)
+: _memory{memory}
+, _segments{}
+, _loop{}
+, _in{}
+, _out{}
+, _count{}
+, _dryRight{}
+, _wetLeft{}
+, _wetRight{}
+, _dry{}
+, _wet{}
+, _vol{}
+, _target{}
+, _rate{}
+, _table{}
+{
+}
+
+AudioHLE::~AudioHLE()
+{
+}
+
+bool AudioHLE::run()
+{
+    const std::uint8_t* task = _memory.spDmem;
+
+    if (swap32(*(const std::uint32_t*)(task + TASK_TYPE)) != M_AUDTASK)
+        return false;
+    if (identify(swap32(*(const std::uint32_t*)(task + TASK_UCODE_DATA)) & 0xffffff) == Abi::None)
+        return false;
+
+    process(swap32(*(const std::uint32_t*)(task + TASK_DATA_PTR)) & 0xffffff, swap32(*(const std::uint32_t*)(task + TASK_DATA_SIZE)));
+    _memory.markWritten(0x04000000, 0x1000);
+    return true;
+}
+
+/*
+ * IMEM still holds rspboot when the RSP is started, as it loads the task
+ * microcode itself, so the microcode is identified by a few words of its
+ * data segment in RDRAM instead: the first word, and the jump table entries
+ * that differ between the ABI variants.
+ */
+AudioHLE::Abi AudioHLE::identify(std::uint32_t ucodeData)
+{
+    if (ucodeData + 0x40 > Memory::kRamSize)
+        return Abi::None;
+
+    if ((std::uint32_t)ram32(ucodeData + 0x00) != 0x00000001)
+        return Abi::None;
+    if ((std::uint32_t)ram32(ucodeData + 0x30) != 0xf0000f00)
+        return Abi::None;
+
+    switch ((std::uint32_t)ram32(ucodeData + 0x28))
+    {
+    case 0x1e24138c:
+        return Abi::Audio;
+    default:
+        return Abi::None;
+    }
+}
+
+void AudioHLE::process(std::uint32_t list, std::uint32_t size)
+{
+    std::uint32_t w0;
+    std::uint32_t w1;
+
+    for (std::uint32_t i = 0; i + 8 <= size; i += 8)
+    {
+        w0 = (std::uint32_t)ram32(list + i);
+        w1 = (std::uint32_t)ram32(list + i + 4);
+
+        switch ((w0 >> 24) & 0x7f)
+        {
+        case 0x00: // SPNOOP
+            break;
+        case 0x01: // ADPCM
+            cmdAdpcm(w0, w1);
+            break;
+        case 0x02: // CLEARBUFF
+            cmdClearBuff(w0, w1);
+            break;
+        case 0x03: // ENVMIXER
+            cmdEnvMixer(w0, w1);
+            break;
+        case 0x04: // LOADBUFF
+            cmdLoadBuff(w0, w1);
+            break;
+        case 0x05: // RESAMPLE
+            cmdResample(w0, w1);
+            break;
+        case 0x06: // SAVEBUFF
+            cmdSaveBuff(w0, w1);
+            break;
+        case 0x07: // SEGMENT
+            cmdSegment(w0, w1);
+            break;
+        case 0x08: // SETBUFF
+            cmdSetBuff(w0, w1);
+            break;
+        case 0x09: // SETVOL
+            cmdSetVol(w0, w1);
+            break;
+        case 0x0a: // DMEMMOVE
+            cmdDmemMove(w0, w1);
+            break;
+        case 0x0b: // LOADADPCM
+            cmdLoadAdpcm(w0, w1);
+            break;
+        case 0x0c: // MIXER
+            cmdMixer(w0, w1);
+            break;
+        case 0x0d: // INTERLEAVE
+            cmdInterleave(w0, w1);
+            break;
+        case 0x0f: // SETLOOP
+            cmdSetLoop(w0, w1);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void AudioHLE::cmdAdpcm(std::uint32_t w0, std::uint32_t w1)
+{
+    std::uint8_t  flags = (w0 >> 16) & 0xff;
+    std::uint32_t state = address(w1);
+    std::uint16_t dmemi = _in;
+    std::uint16_t dmemo = _out;
+    std::uint16_t count = align(_count, 32);
+    std::int16_t  last[16];
+    std::int16_t  frame[16];
+
+    if (flags & A_INIT)
+        std::memset(last, 0, sizeof(last));
+    else
+    {
+        for (int i = 0; i < 16; ++i)
+            last[i] = ram16(((flags & A_LOOP) ? _loop : state) + i * 2);
+    }
+
+    for (int i = 0; i < 16; ++i, dmemo += 2)
+        setDmem16(dmemo, last[i]);
+
+    while (count != 0)
+    {
+        std::uint8_t        code   = _memory.spDmem[dmemi++ & 0xfff];
+        unsigned            scale  = code >> 4;
+        unsigned            rshift = (scale < 12) ? 12 - scale : 0;
+        const std::int16_t* book   = _table + ((code & 0xf) << 4);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            std::uint8_t byte = _memory.spDmem[dmemi++ & 0xfff];
+
+            frame[i * 2 + 0] = (std::int16_t)((byte & 0xf0) << 8) >> rshift;
+            frame[i * 2 + 1] = (std::int16_t)((byte & 0x0f) << 12) >> rshift;
+        }
+
+        /* Each half is predicted from the two samples before it */
+        for (int half = 0; half < 2; ++half)
+        {
+            const std::int16_t* src = frame + half * 8;
+            std::int16_t*       dst = last + half * 8;
+            std::int16_t        l1  = half ? last[6] : last[14];
+            std::int16_t        l2  = half ? last[7] : last[15];
+
+            for (int i = 0; i < 8; ++i)
+            {
+                std::int32_t accu = (std::int32_t)src[i] << 11;
+
+                accu += book[i] * l1 + book[8 + i] * l2;
+                for (int j = 0; j < i; ++j)
+                    accu += book[8 + j] * src[i - 1 - j];
+                dst[i] = clamp16(accu >> 11);
+            }
+        }
+
+        for (int i = 0; i < 16; ++i, dmemo += 2)
+            setDmem16(dmemo, last[i]);
+
+        count -= 32;
+    }
+
+    for (int i = 0; i < 16; ++i)
+        setRam16(state + i * 2, last[i]);
+}
+
+void AudioHLE::cmdClearBuff(std::uint32_t w0, std::uint32_t w1)
+{
+    std::uint16_t dmem  = (w0 + DMEM_BASE) & 0xfff;
+    std::uint16_t count = align(w1 & 0xfff, 16);
+
+    std::memset(_memory.spDmem + dmem, 0, std::min<std::uint32_t>(count, 0x1000 - dmem));
+}
+
+/*
+ * The volume ramps are stepped every sample, then the eight samples of a
+ * step are mixed into the dry and wet outputs together.
+ */
+void AudioHLE::cmdEnvMixer(std::uint32_t w0, std::uint32_t w1)
+{
+    std::uint8_t  flags = (w0 >> 16) & 0xff;
+    std::uint32_t state = address(w1);
+    std::uint16_t outs[4];
+    std::int16_t  dry;
+    std::int16_t  wet;
+    std::int32_t  seq[2];
+    std::int32_t  rates[2];
+    Ramp          ramps[2];
+    int           n;
+
+    n       = (flags & A_AUX) ? 4 : 2;
+    outs[0] = _out;
+    outs[1] = _dryRight;
+    outs[2] = _wetLeft;
+    outs[3] = _wetRight;
+
+    if (flags & A_INIT)
+    {
+        dry = _dry;
+        wet = _wet;
+        for (int i = 0; i < 2; ++i)
+        {
+            ramps[i].value  = _vol[i] << 16;
+            ramps[i].target = _target[i] << 16;
+            rates[i]        = _rate[i];
+            seq[i]          = _vol[i] * _rate[i];
+        }
+    }
+    else
+    {
+        wet = ram16(state + 0);
+        dry = ram16(state + 2);
+        for (int i = 0; i < 2; ++i)
+        {
+            ramps[i].target = ram32(state + 4 + i * 4);
+            rates[i]        = ram32(state + 12 + i * 4);
+            seq[i]          = ram32(state + 20 + i * 4);
+            ramps[i].value  = ram32(state + 28 + i * 4);
+        }
+    }
+
+    for (int i = 0; i < 2; ++i)
+        ramps[i].step = ramps[i].target - ramps[i].value;
+
+    for (std::uint16_t y = 0; y < _count; y += 16)
+    {
+        alignas(16) std::int16_t gains[4][8];
+        __m128i                  in;
+
+        for (int i = 0; i < 2; ++i)
+        {
+            if (ramps[i].step != 0)
+            {
+                seq[i]        = (std::int32_t)(((std::int64_t)seq[i] * rates[i]) >> 16);
+                ramps[i].step = (seq[i] - ramps[i].value) >> 3;
+            }
+        }
+
+        for (int x = 0; x < 8; ++x)
+        {
+            std::int16_t vol[2];
+
+            for (int i = 0; i < 2; ++i)
+            {
+                Ramp& ramp = ramps[i];
+                bool  reached;
+
+                ramp.value += ramp.step;
+                reached = (ramp.step <= 0) ? (ramp.value <= ramp.target) : (ramp.value >= ramp.target);
+                if (reached)
+                {
+                    ramp.value = ramp.target;
+                    ramp.step  = 0;
+                }
+                vol[i] = (std::int16_t)(ramp.value >> 16);
+            }
+
+            gains[0][x] = clamp16((vol[0] * dry + 0x4000) >> 15);
+            gains[1][x] = clamp16((vol[1] * dry + 0x4000) >> 15);
+            gains[2][x] = clamp16((vol[0] * wet + 0x4000) >> 15);
+            gains[3][x] = clamp16((vol[1] * wet + 0x4000) >> 15);
+        }
+
+        in = load8(_memory.spDmem, (_in + y) & 0xfff);
+        for (int i = 0; i < n; ++i)
+        {
+            std::uint16_t out  = (outs[i] + y) & 0xfff;
+            __m128i       gain = _mm_load_si128((const __m128i*)gains[i]);
+            __m128i       hi   = _mm_mulhi_epi16(in, gain);
+            __m128i       lo   = _mm_mullo_epi16(in, gain);
+            __m128i       prod = _mm_or_si128(_mm_slli_epi16(hi, 1), _mm_srli_epi16(lo, 15));
+            __m128i       min  = _mm_set1_epi16((short)0x8000);
+            __m128i       over;
+
+            /* -1.0 * -1.0 is the only product that does not fit */
+            over = _mm_and_si128(_mm_cmpeq_epi16(in, min), _mm_cmpeq_epi16(gain, min));
+            prod = _mm_or_si128(_mm_andnot_si128(over, prod), _mm_and_si128(over, _mm_set1_epi16(0x7fff)));
+            prod = _mm_adds_epi16(load8(_memory.spDmem, out), prod);
+            prod = _mm_adds_epi16(prod, _mm_and_si128(over, _mm_set1_epi16(1)));
+            store8(_memory.spDmem, out, prod);
+        }
+    }
+
+    setRam16(state + 0, wet);
+    setRam16(state + 2, dry);
+    for (int i = 0; i < 2; ++i)
+    {
+        setRam32(state + 4 + i * 4, ramps[i].target);
+        setRam32(state + 12 + i * 4, rates[i]);
+        setRam32(state + 20 + i * 4, seq[i]);
+        setRam32(state + 28 + i * 4, ramps[i].value);
+    }
+}
+
+void AudioHLE::cmdLoadBuff(std::uint32_t, std::uint32_t w1)
+{
+    std::uint32_t addr  = address(w1) & ~7u;
+    std::uint16_t count = align(_count, 8);
+
+    for (std::uint16_t i = 0; i < count; ++i)
+        _memory.spDmem[(_in + i) & 0xfff] = _memory.ram[(addr + i) & (Memory::kRamSize - 1)];
+}
+
+void AudioHLE::cmdResample(std::uint32_t w0, std::uint32_t w1)
+{
+    std::uint8_t  flags = (w0 >> 16) & 0xff;
+    std::uint32_t pitch = (w0 & 0xffff) << 1;
+    std::uint32_t state = address(w1);
+    std::uint16_t ipos  = (_in >> 1) - 4;
+    std::uint16_t opos  = _out >> 1;
+    std::uint16_t count = align(_count, 16) >> 1;
+    std::uint32_t accu;
+
+    if (flags & A_INIT)
+    {
+        for (int k = 0; k < 4; ++k)
+            setDmem16((ipos + k) << 1, 0);
+        accu = 0;
+    }
+    else
+    {
+        for (int k = 0; k < 4; ++k)
+            setDmem16((ipos + k) << 1, ram16(state + k * 2));
+        accu = (std::uint16_t)ram16(state + 8);
+    }
+
+    while (count != 0)
+    {
+        const std::int32_t* taps = kResample.taps[(accu >> 10) & 0x3f];
+        std::int32_t        sum{};
+
+        for (int k = 0; k < 4; ++k)
+            sum += (dmem16((ipos + k) << 1) * taps[k]) >> 15;
+        setDmem16(opos++ << 1, clamp16(sum));
+
+        accu += pitch;
+        ipos += accu >> 16;
+        accu &= 0xffff;
+        --count;
+    }
+
+    for (int k = 0; k < 4; ++k)
+        setRam16(state + k * 2, dmem16((ipos + k) << 1));
+    setRam16(state + 8, (std::int16_t)accu);
+}
+
+void AudioHLE::cmdSaveBuff(std::uint32_t, std::uint32_t w1)
+{
+    std::uint32_t addr  = address(w1) & ~7u;
+    std::uint16_t count = align(_count, 8);
+
+    for (std::uint16_t i = 0; i < count; ++i)
+        _memory.ram[(addr + i) & (Memory::kRamSize - 1)] = _memory.spDmem[(_out + i) & 0xfff];
+    _memory.markWritten(addr & (Memory::kRamSize - 1), count);
+}
+
+void AudioHLE::cmdSegment(std::uint32_t, std::uint32_t w1)
+{
+    _segments[(w1 >> 24) & 0xf] = w1 & 0xffffff;
+}
+
+void AudioHLE::cmdSetBuff(std::uint32_t w0, std::uint32_t w1)
+{
+    std::uint8_t flags = (w0 >> 16) & 0xff;
+
+    if (flags & A_AUX)
+    {
+        _dryRight = (w0 + DMEM_BASE) & 0xfff;
+        _wetLeft  = ((w1 >> 16) + DMEM_BASE) & 0xfff;
+        _wetRight = (w1 + DMEM_BASE) & 0xfff;
+    }
+    else
+    {
+        _in    = (w0 + DMEM_BASE) & 0xfff;
+        _out   = ((w1 >> 16) + DMEM_BASE) & 0xfff;
+        _count = w1 & 0xffff;
+    }
+}
+
+void AudioHLE::cmdSetVol(std::uint32_t w0, std::uint32_t w1)
+{
+    std::uint8_t flags = (w0 >> 16) & 0xff;
+    int          lr    = (flags & A_LEFT) ? 0 : 1;
+
+    if (flags & A_AUX)
+    {
+        _dry = (std::int16_t)w0;
+        _wet = (std::int16_t)w1;
+    }
+    else if (flags & A_VOL)
+    {
+        _vol[lr] = (std::int16_t)w0;
+    }
+    else
+    {
+        _target[lr] = (std::int16_t)w0;
+        _rate[lr]   = (std::int32_t)w1;
+    }
+}
+
+void AudioHLE::cmdDmemMove(std::uint32_t w0, std::uint32_t w1)
+{
+    std::uint16_t dmemi = (w0 + DMEM_BASE) & 0xfff;
+    std::uint16_t dmemo = ((w1 >> 16) + DMEM_BASE) & 0xfff;
+    std::uint16_t count = align(w1 & 0xffff, 16);
+
+    for (std::uint16_t i = 0; i < count; ++i)
+        _memory.spDmem[(dmemo + i) & 0xfff] = _memory.spDmem[(dmemi + i) & 0xfff];
+}
+
+void AudioHLE::cmdLoadAdpcm(std::uint32_t w0, std::uint32_t w1)
+{
+    std::uint32_t addr  = address(w1);
+    std::uint16_t count = std::min<std::uint16_t>(align(w0 & 0xffff, 8) >> 1, 16 * 8);
+
+    for (std::uint16_t i = 0; i < count; ++i)
+        _table[i] = ram16(addr + i * 2);
+}
+
+void AudioHLE::cmdMixer(std::uint32_t w0, std::uint32_t w1)
+{
+    __m128i       gain  = _mm_set1_epi16((std::int16_t)w0);
+    std::uint16_t dmemi = ((w1 >> 16) + DMEM_BASE) & 0xfff;
+    std::uint16_t dmemo = (w1 + DMEM_BASE) & 0xfff;
+
+    /* dst += (src * gain + 0x4000) >> 15, saturated */
+    for (std::uint16_t i = 0; i < _count; i += 16)
+    {
+        std::uint16_t dst = (dmemo + i) & 0xfff;
+        __m128i       src = load8(_memory.spDmem, (dmemi + i) & 0xfff);
+        __m128i       hi  = _mm_mulhi_epi16(src, gain);
+        __m128i       lo  = _mm_mullo_epi16(src, gain);
+        __m128i       round;
+
+        round = _mm_srli_epi16(_mm_add_epi16(_mm_srli_epi16(lo, 14), _mm_set1_epi16(1)), 1);
+        store8(_memory.spDmem, dst, _mm_adds_epi16(load8(_memory.spDmem, dst), _mm_add_epi16(_mm_slli_epi16(hi, 1), round)));
+    }
+}
+
+void AudioHLE::cmdInterleave(std::uint32_t, std::uint32_t w1)
+{
+    std::uint16_t left  = ((w1 >> 16) + DMEM_BASE) & 0xfff;
+    std::uint16_t right = (w1 + DMEM_BASE) & 0xfff;
+    std::uint16_t count = std::min<std::uint16_t>(_count, 0x800);
+    std::uint8_t  tmp[0x1000];
+
+    /* The output may overlap the inputs, and is at most all of DMEM */
+    for (std::uint16_t i = 0; i < count; i += 16)
+    {
+        __m128i l = loadDmem(_memory.spDmem, (left + i) & 0xfff);
+        __m128i r = loadDmem(_memory.spDmem, (right + i) & 0xfff);
+
+        _mm_storeu_si128((__m128i*)(tmp + i * 2), _mm_unpacklo_epi16(l, r));
+        _mm_storeu_si128((__m128i*)(tmp + i * 2 + 16), _mm_unpackhi_epi16(l, r));
+    }
+
+    for (std::uint32_t i = 0; i < count * 2u; ++i)
+        _memory.spDmem[(_out + i) & 0xfff] = tmp[i];
+}
+
+void AudioHLE::cmdSetLoop(std::uint32_t, std::uint32_t w1)
+{
+    _loop = address(w1);
+}
+
+std::uint32_t AudioHLE::address(std::uint32_t segmented) const
+{
+    return (_segments[(segmented >> 24) & 0xf] + (segmented & 0xffffff)) & 0xffffff;
+}
+
+std::int16_t AudioHLE::dmem16(std::uint16_t addr) const
+{
+    addr &= 0xffe;
+    return (std::int16_t)((_memory.spDmem[addr] << 8) | _memory.spDmem[addr + 1]);
+}
+
+void AudioHLE::setDmem16(std::uint16_t addr, std::int16_t value)
+{
+    addr &= 0xffe;
+    _memory.spDmem[addr + 0] = (std::uint8_t)(value >> 8);
+    _memory.spDmem[addr + 1] = (std::uint8_t)value;
+}
+
+std::int16_t AudioHLE::ram16(std::uint32_t addr) const
+{
+    addr &= (Memory::kRamSize - 2);
+    return (std::int16_t)((_memory.ram[addr] << 8) | _memory.ram[addr + 1]);
+}
+
+void AudioHLE::setRam16(std::uint32_t addr, std::int16_t value)
+{
+    addr &= (Memory::kRamSize - 2);
+    _memory.ram[addr + 0] = (std::uint8_t)(value >> 8);
+    _memory.ram[addr + 1] = (std::uint8_t)value;
+    _memory.markWritten(addr);
+}
+
+std::int32_t AudioHLE::ram32(std::uint32_t addr) const
+{
+    addr &= (Memory::kRamSize - 4);
+    return (std::int32_t)swap32(*(const std::uint32_t*)(_memory.ram + addr));
+}
+
+void AudioHLE::setRam32(std::uint32_t addr, std::int32_t value)
+{
+    addr &= (Memory::kRamSize - 4);
+    *(std::uint32_t*)(_memory.ram + addr) = swap32((std::uint32_t)value);
+    _memory.markWritten(addr);
+}
+
+void AudioHLE::save(SavestateWriter& writer) const
+{
+    writer.write(_segments);
+    writer.write(_loop);
+    writer.write(_in);
+    writer.write(_out);
+    writer.write(_count);
+    writer.write(_dryRight);
+    writer.write(_wetLeft);
+    writer.write(_wetRight);
+    writer.write(_dry);
+    writer.write(_wet);
+    writer.write(_vol);
+    writer.write(_target);
+    writer.write(_rate);
+    writer.write(_table);
+}
+
+void AudioHLE::load(SavestateReader& reader)
+{
+    reader.read(_segments);
+    reader.read(_loop);
+    reader.read(_in);
+    reader.read(_out);
+    reader.read(_count);
+    reader.read(_dryRight);
+    reader.read(_wetLeft);
+    reader.read(_wetRight);
+    reader.read(_dry);
+    reader.read(_wet);
+    reader.read(_vol);
+    reader.read(_target);
+    reader.read(_rate);
+    reader.read(_table);
+}
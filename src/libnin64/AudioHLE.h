@@ -0,0 +1,95 @@
+#ifndef INCLUDED_AUDIO_HLE_H
+#define INCLUDED_AUDIO_HLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <libnin64/NonCopyable.h>
+
+namespace libnin64
+{
+
+class Memory;
+class SavestateReader;
+class SavestateWriter;
+
+/*
+ * High level emulation of the standard libultra audio microcode (ABI 1).
+ *
+ * When the RSP is started, the task header left in DMEM by the OS tells the
+ * kind of task and where its microcode lives. Audio tasks whose microcode is
+ * known have their command list run natively; everything else is left to
+ * the RSP interpreter. This is opt-in, see RSP::setAudioHLE.
+ */
+class AudioHLE : private NonCopyable
+{
+public:
+    AudioHLE(Memory& memory);
+    ~AudioHLE();
+
+    bool run();
+
+    void save(SavestateWriter& writer) const;
+    void load(SavestateReader& reader);
+
+private:
+    enum class Abi : std::uint8_t
+    {
+        None,
+        Audio,
+    };
+
+    struct Ramp
+    {
+        std::int32_t value;
+        std::int32_t target;
+        std::int32_t step;
+    };
+
+    Abi  identify(std::uint32_t ucodeData);
+    void process(std::uint32_t list, std::uint32_t size);
+
+    void cmdAdpcm(std::uint32_t w0, std::uint32_t w1);
+    void cmdClearBuff(std::uint32_t w0, std::uint32_t w1);
+    void cmdEnvMixer(std::uint32_t w0, std::uint32_t w1);
+    void cmdLoadBuff(std::uint32_t w0, std::uint32_t w1);
+    void cmdResample(std::uint32_t w0, std::uint32_t w1);
+    void cmdSaveBuff(std::uint32_t w0, std::uint32_t w1);
+    void cmdSegment(std::uint32_t w0, std::uint32_t w1);
+    void cmdSetBuff(std::uint32_t w0, std::uint32_t w1);
+    void cmdSetVol(std::uint32_t w0, std::uint32_t w1);
+    void cmdDmemMove(std::uint32_t w0, std::uint32_t w1);
+    void cmdLoadAdpcm(std::uint32_t w0, std::uint32_t w1);
+    void cmdMixer(std::uint32_t w0, std::uint32_t w1);
+    void cmdInterleave(std::uint32_t w0, std::uint32_t w1);
+    void cmdSetLoop(std::uint32_t w0, std::uint32_t w1);
+
+    std::uint32_t address(std::uint32_t segmented) const;
+
+    std::int16_t dmem16(std::uint16_t addr) const;
+    void         setDmem16(std::uint16_t addr, std::int16_t value);
+    std::int16_t ram16(std::uint32_t addr) const;
+    void         setRam16(std::uint32_t addr, std::int16_t value);
+    std::int32_t ram32(std::uint32_t addr) const;
+    void         setRam32(std::uint32_t addr, std::int32_t value);
+
+    Memory& _memory;
+
+    std::uint32_t _segments[16];
+    std::uint32_t _loop;
+    std::uint16_t _in;
+    std::uint16_t _out;
+    std::uint16_t _count;
+    std::uint16_t _dryRight;
+    std::uint16_t _wetLeft;
+    std::uint16_t _wetRight;
+    std::int16_t  _dry;
+    std::int16_t  _wet;
+    std::int16_t  _vol[2];
+    std::int16_t  _target[2];
+    std::int32_t  _rate[2];
+    std::int16_t  _table[16 * 8];
+};
+
+} // namespace libnin64
+
+#endif
@@ -1,8 +1,12 @@
-#include <cstdio>
 #include <cstdlib>
 #include <libnin64/AudioInterface.h>
+#include <libnin64/HostFpu.h>
+#include <libnin64/Log.h>
 #include <libnin64/MIPSInterface.h>
 #include <libnin64/Memory.h>
+#include <libnin64/Profiler.h>
+#include <libnin64/Savestate.h>
+#include <libnin64/Scheduler.h>
 #include <libnin64/Util.h>
 
 #define AI_DRAM_ADDR_REG 0x04500000
@@ -23,12 +27,13 @@ static void dummyAudioCallback(const std::uint16_t* samples, std::size_t sampleC
     (void)arg;
 }
 
-AudioInterface::AudioInterface(MIPSInterface& mi, Memory& memory)
+AudioInterface::AudioInterface(MIPSInterface& mi, Scheduler& scheduler, Memory& memory, Profiler& profiler)
 : _mi{mi}
+, _scheduler{scheduler}
 , _memory{memory}
+, _profiler{profiler}
 , _callback{&dummyAudioCallback}
 , _callbackArg{}
-, _acc{}
 , _addr{}
 , _len{}
 , _bufCount{}
@@ -46,30 +51,20 @@ void AudioInterface::setCallback(Nin64AudioCallback callback, void* callbackArg)
     _callbackArg = callbackArg;
 }
 
-void AudioInterface::tick(std::uint32_t count)
+void AudioInterface::drain()
 {
-    if (_bufCount == 0)
-        return;
+    Profiler::Scope scope{_profiler, Component::AI};
 
-    _acc += count;
-    while (_acc >= TICKS_PER_SAMPLE)
+    _bufCount--;
+    if (_bufCount)
+    {
+        _mi.setInterrupt(MI_INTR_AI);
+        _len[0] = _len[1];
+        _scheduler.scheduleAt(Event::AudioDrain, _scheduler.when(Event::AudioDrain) + std::uint64_t(_len[0]) * TICKS_PER_SAMPLE);
+    }
+    else
     {
-        _acc -= TICKS_PER_SAMPLE;
-        _len[0]--;
-        if (_len[0] == 0)
-        {
-            _bufCount--;
-            if (_bufCount)
-            {
-                _mi.setInterrupt(MI_INTR_AI);
-                _len[0] = _len[1];
-            }
-            else
-            {
-                _acc = 0;
-                break;
-            }
-        }
+        _len[0] = 0;
     }
 }
 
@@ -80,25 +75,26 @@ std::uint32_t AudioInterface::read(std::uint32_t reg)
     switch (reg)
     {
     case AI_DRAM_ADDR_REG:
-        std::printf("AI Read: AI_DRAM_ADDR_REG\n");
+        NIN64_LOG(AI, Trace, "AI Read: AI_DRAM_ADDR_REG\n");
         break;
     case AI_LEN_REG:
-        std::printf("AI Read: AI_LEN_REG\n");
-        value = _len[0];
+        NIN64_LOG(AI, Trace, "AI Read: AI_LEN_REG\n");
+        if (_bufCount)
+            value = (std::uint32_t)((_scheduler.when(Event::AudioDrain) - _scheduler.now() + TICKS_PER_SAMPLE - 1) / TICKS_PER_SAMPLE);
         break;
     case AI_CONTROL_REG:
-        std::printf("AI Read: AI_CONTROL_REG\n");
+        NIN64_LOG(AI, Trace, "AI Read: AI_CONTROL_REG\n");
         break;
     case AI_STATUS_REG:
-        std::printf("AI Read: AI_STATUS_REG\n");
+        NIN64_LOG(AI, Trace, "AI Read: AI_STATUS_REG\n");
         if (_bufCount == 2) value |= 0x80000001;
         if (_bufCount) value |= 0x40000000;
         break;
     case AI_DACRATE_REG:
-        std::printf("AI Read: AI_DACRATE_REG\n");
+        NIN64_LOG(AI, Trace, "AI Read: AI_DACRATE_REG\n");
         break;
     case AI_BITRATE_REG:
-        std::printf("AI Read: AI_BITRATE_REG\n");
+        NIN64_LOG(AI, Trace, "AI Read: AI_BITRATE_REG\n");
         break;
     }
 
@@ -107,36 +103,33 @@ std::uint32_t AudioInterface::read(std::uint32_t reg)
 
 void AudioInterface::write(std::uint32_t reg, std::uint32_t value)
 {
+    Profiler::Scope scope{_profiler, Component::AI};
+
     switch (reg)
     {
     case AI_DRAM_ADDR_REG:
-        std::printf("AI Write: AI_DRAM_ADDR_REG 0x%08x\n", value);
-        //std::printf("Audio DMA ADDR: 0x%08x\n", value);
+        NIN64_LOG(AI, Trace, "AI Write: AI_DRAM_ADDR_REG 0x%08x\n", value);
         _addr = value & 0x00fffff8;
         break;
     case AI_LEN_REG:
-        std::printf("AI Write: AI_LEN_REG 0x%08x\n", value);
-        //std::printf("Audio DMA: 0x%08x\n", value);
-        //std::printf("AI Write: AI_LEN_REG\n");
+        NIN64_LOG(AI, Trace, "AI Write: AI_LEN_REG 0x%08x\n", value);
         dma(value & 0x3fff8);
         break;
     case AI_CONTROL_REG:
-        std::printf("AI Write: AI_CONTROL_REG 0x%08x\n", value);
+        NIN64_LOG(AI, Trace, "AI Write: AI_CONTROL_REG 0x%08x\n", value);
         // TODO: Implement this
         break;
     case AI_STATUS_REG:
-        std::printf("AI Write: AI_STATUS_REG 0x%08x\n", value);
+        NIN64_LOG(AI, Trace, "AI Write: AI_STATUS_REG 0x%08x\n", value);
         _mi.clearInterrupt(MI_INTR_AI);
         break;
     case AI_DACRATE_REG:
-        std::printf("AI Write: AI_DACRATE_REG 0x%08x\n", value);
+        NIN64_LOG(AI, Trace, "AI Write: AI_DACRATE_REG 0x%08x\n", value);
+        NIN64_LOG(AI, Trace, "AI DAC rate: %u Hz\n", 48681812 / (value + 1));
         // TODO: Implement this
-        //std::printf("DAC Rate: 0x%08x\n", (48681812 / (value + 1)));
-        //std::printf("AI Write: AI_DACRATE_REG\n");
-        //std::exit(1);
         break;
     case AI_BITRATE_REG:
-        std::printf("AI Write: AI_BITRATE_REG 0x%08x\n", value);
+        NIN64_LOG(AI, Trace, "AI Write: AI_BITRATE_REG 0x%08x\n", value);
         // TODO: Implement this
         break;
     }
@@ -148,6 +141,8 @@ void AudioInterface::dma(std::uint32_t size)
 
     if (_bufCount == 2)
         return;
+    if (_bufCount == 0)
+        _scheduler.schedule(Event::AudioDrain, std::uint64_t(size) * TICKS_PER_SAMPLE);
     _len[_bufCount++] = size;
     dstSize           = (size * 3) / 2;
     /* Swap and convert from 32kHz to 48kHz */
@@ -161,5 +156,28 @@ void AudioInterface::dma(std::uint32_t size)
         _buffer[i * 6 + 5] = _buffer[i * 6 + 3];
     }
 
-    (*_callback)(_buffer, dstSize, _callbackArg);
+    /* The frontend may be called from inside the CPU, give it the host floating point state */
+    {
+        HostFpu host;
+
+        (*_callback)(_buffer, dstSize, _callbackArg);
+    }
+}
+
+/* The sample buffer only lives during a callback, it is not part of the state */
+void AudioInterface::save(SavestateWriter& writer) const
+{
+    writer.begin("AI  ");
+    writer.write(_addr);
+    writer.write(_len);
+    writer.write(_bufCount);
+    writer.end();
+}
+
+void AudioInterface::load(SavestateReader& reader)
+{
+    reader.open("AI  ");
+    reader.read(_addr);
+    reader.read(_len);
+    reader.read(_bufCount);
 }
@@ -11,28 +11,36 @@ namespace libnin64
 
 class Memory;
 class MIPSInterface;
+class Profiler;
+class SavestateReader;
+class SavestateWriter;
+class Scheduler;
 class AudioInterface : private NonCopyable
 {
 public:
-    AudioInterface(MIPSInterface& mi, Memory& memory);
+    AudioInterface(MIPSInterface& mi, Scheduler& scheduler, Memory& memory, Profiler& profiler);
     ~AudioInterface();
 
     void setCallback(Nin64AudioCallback callback, void* callbackArg);
 
-    void          tick(std::uint32_t count);
+    void          drain();
     std::uint32_t read(std::uint32_t reg);
     void          write(std::uint32_t reg, std::uint32_t value);
 
+    void save(SavestateWriter& writer) const;
+    void load(SavestateReader& reader);
+
 private:
     void dma(std::uint32_t size);
 
     MIPSInterface& _mi;
+    Scheduler&     _scheduler;
     Memory&        _memory;
+    Profiler&      _profiler;
 
     Nin64AudioCallback _callback;
     void*              _callbackArg;
 
-    std::uint32_t _acc;
     std::uint32_t _addr;
     std::uint32_t _len[2];
     std::uint8_t  _bufCount;
@@ -0,0 +1,143 @@
+#include <libnin64/Batch.h>
+#include <libnin64/State.h>
+
+using namespace libnin64;
+
+Batch::Batch(std::size_t threads)
+: _queueCount{}
+, _job{}
+, _quit{}
+, _states{}
+, _frames{}
+, _remaining{}
+, _queued{}
+, _callback{}
+, _callbackArg{}
+{
+    if (!threads)
+        threads = std::thread::hardware_concurrency();
+    if (!threads)
+        threads = 1;
+
+    _queueCount = threads;
+    _queues     = std::make_unique<Queue[]>(threads);
+    for (std::size_t i = 0; i < threads; ++i)
+        _threads.emplace_back(&Batch::loop, this, i);
+}
+
+Batch::~Batch()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _wake.notify_all();
+    for (auto& thread : _threads)
+        thread.join();
+}
+
+void Batch::run(Nin64State* const* states, std::size_t count, std::size_t frames, Nin64FrameCallback callback, void* callbackArg)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (!count || !frames)
+        return;
+
+    _states      = states;
+    _frames      = frames;
+    _callback    = callback;
+    _callbackArg = callbackArg;
+    _progress.assign(count, 0);
+    _remaining   = count;
+    for (std::size_t i = 0; i < count; ++i)
+        enqueue(i % _queueCount, i);
+    _job++;
+    _wake.notify_all();
+
+    _done.wait(lock, [this] { return _remaining == 0; });
+}
+
+void Batch::loop(std::size_t index)
+{
+    std::uint64_t job{};
+    std::size_t   task;
+    State*        state;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [&] { return _job != job || _quit; });
+            if (_quit)
+                return;
+            job = _job;
+        }
+
+        while (_remaining)
+        {
+            /* The states left are all being run elsewhere */
+            if (!take(index, task))
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _work.wait(lock, [this] { return _queued != 0 || _remaining == 0; });
+                continue;
+            }
+
+            state = _states[task];
+            state->run(State::kCyclesPerFrame);
+            if (_callback)
+                _callback(_states[task], task, _callbackArg);
+
+            if (++_progress[task] < _frames)
+                push(index, task);
+            else if (--_remaining == 0)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _done.notify_all();
+                _work.notify_all();
+            }
+        }
+    }
+}
+
+bool Batch::take(std::size_t index, std::size_t& task)
+{
+    for (std::size_t i = 0; i < _queueCount; ++i)
+    {
+        Queue& queue = _queues[(index + i) % _queueCount];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+        _queued--;
+        if (i == 0)
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+/* Queues a task and wakes a thread that may be waiting for one */
+void Batch::push(std::size_t index, std::size_t task)
+{
+    enqueue(index, task);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+    }
+    _work.notify_one();
+}
+
+void Batch::enqueue(std::size_t index, std::size_t task)
+{
+    std::lock_guard<std::mutex> lock(_queues[index].mutex);
+    _queues[index].tasks.push_back(task);
+    _queued++;
+}
@@ -0,0 +1,76 @@
+#ifndef INCLUDED_BATCH_H
+#define INCLUDED_BATCH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <libnin64/NonCopyable.h>
+#include <nin64/nin64.h>
+
+namespace libnin64
+{
+
+/*
+ * A pool of threads stepping many states at once, one frame per task.
+ *
+ * Each thread has its own queue of states due for a frame. It runs the
+ * newest one from the back, and steals the oldest from the front of the
+ * other queues when its own is empty. A state that has frames left goes
+ * back to the thread that just ran it, so it stays warm in its cache,
+ * while a state is only ever run by one thread at a time. Threads with
+ * nothing to take sleep until a state is queued or the batch is done.
+ */
+class Batch : private NonCopyable
+{
+public:
+    explicit Batch(std::size_t threads);
+    ~Batch();
+
+    void run(Nin64State* const* states, std::size_t count, std::size_t frames, Nin64FrameCallback callback, void* callbackArg);
+
+private:
+    struct Queue
+    {
+        std::mutex              mutex;
+        std::deque<std::size_t> tasks;
+    };
+
+    void loop(std::size_t index);
+    bool take(std::size_t index, std::size_t& task);
+    void push(std::size_t index, std::size_t task);
+    void enqueue(std::size_t index, std::size_t task);
+
+    std::size_t              _queueCount;
+    std::unique_ptr<Queue[]> _queues;
+    std::vector<std::thread> _threads;
+
+    std::mutex              _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _work;
+    std::condition_variable _done;
+    std::uint64_t           _job;
+    bool                    _quit;
+
+    Nin64State* const*       _states;
+    std::size_t              _frames;
+    std::vector<std::size_t> _progress;
+    std::atomic<std::size_t> _remaining;
+    std::atomic<std::size_t> _queued;
+    Nin64FrameCallback       _callback;
+    void*                    _callbackArg;
+};
+
+} // namespace libnin64
+
+struct Nin64Batch : public libnin64::Batch
+{
+    using libnin64::Batch::Batch;
+};
+
+#endif
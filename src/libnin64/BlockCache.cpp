@@ -0,0 +1,59 @@
+#include <libnin64/BlockCache.h>
+
+using namespace libnin64;
+
+BlockCache::BlockCache(Memory& memory)
+: _memory{memory}
+{
+}
+
+BlockCache::~BlockCache()
+{
+}
+
+Block* BlockCache::find(std::uint32_t addr)
+{
+    Page*  page;
+    Block* block;
+
+    page = _pages[Memory::offset(addr) >> 12].get();
+    if (!page)
+        return nullptr;
+
+    block = page->blocks[(addr >> 2) & 0x3ff].get();
+    if (!block)
+        return nullptr;
+
+    if (_memory.generation[block->lines[0]] != block->generation[0] || _memory.generation[block->lines[1]] != block->generation[1])
+        return nullptr;
+
+    return block;
+}
+
+Block* BlockCache::insert(std::uint32_t addr, const Instr* instrs, std::size_t size)
+{
+    std::unique_ptr<Page>& page = _pages[Memory::offset(addr) >> 12];
+    Block*                 block;
+
+    if (!page)
+        page = std::make_unique<Page>();
+
+    block                = new Block;
+    block->addr          = addr;
+    block->size          = (std::uint32_t)size;
+    block->lines[0]      = Memory::line(addr);
+    block->lines[1]      = Memory::line(addr + (std::uint32_t)size * 4 - 1);
+    block->generation[0] = _memory.generation[block->lines[0]];
+    block->generation[1] = _memory.generation[block->lines[1]];
+    block->instrs        = std::make_unique<Instr[]>(size);
+    block->idle          = false;
+    block->code          = nullptr;
+    block->codePc        = 0;
+    block->codeEpoch     = 0;
+    for (std::size_t i = 0; i < size; ++i)
+        block->instrs[i] = instrs[i];
+
+    /* Replacing a stale block frees it, which is safe as blocks are only looked up between executions */
+    page->blocks[(addr >> 2) & 0x3ff].reset(block);
+    return block;
+}
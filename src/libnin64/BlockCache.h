@@ -0,0 +1,80 @@
+#ifndef INCLUDED_BLOCK_CACHE_H
+#define INCLUDED_BLOCK_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <libnin64/Memory.h>
+#include <libnin64/NonCopyable.h>
+
+namespace libnin64
+{
+
+class CPU;
+
+struct Instr;
+using InstrHandler = void (*)(CPU& cpu, const Instr& instr);
+
+/* A predecoded VR4300 instruction */
+struct Instr
+{
+    InstrHandler  handler;
+    std::uint32_t op;
+    std::uint8_t  rs;
+    std::uint8_t  rt;
+    std::uint8_t  rd;
+    std::uint8_t  sa;
+    std::uint16_t imm;
+    std::uint8_t  cycles;
+};
+
+struct Block
+{
+    std::uint32_t            addr;
+    std::uint32_t            size;
+    std::uint32_t            lines[2];
+    std::uint32_t            generation[2];
+    std::unique_ptr<Instr[]> instrs;
+    bool                     idle;
+
+    /* Recompiled code, for the virtual address and code buffer epoch it was made for */
+    const void*   code;
+    std::uint64_t codePc;
+    std::uint32_t codeEpoch;
+};
+
+/*
+ * Predecoded blocks, indexed by physical address.
+ *
+ * Only RDRAM and SP memory are cached. A block never crosses a 4KiB page, so
+ * it spans at most two memory lines; it remembers their write generations and
+ * is thrown away on lookup as soon as either of them changed.
+ */
+class BlockCache : private NonCopyable
+{
+public:
+    static constexpr const std::size_t kMaxBlockSize = 64;
+
+    BlockCache(Memory& memory);
+    ~BlockCache();
+
+    static bool cacheable(std::uint32_t addr) { return addr < Memory::kRamSize || (addr >= 0x04000000 && addr < 0x04002000); }
+
+    Block* find(std::uint32_t addr);
+    Block* insert(std::uint32_t addr, const Instr* instrs, std::size_t size);
+
+private:
+    static constexpr const std::size_t kPageCount = (Memory::kRamSize + 0x2000) >> 12;
+
+    struct Page
+    {
+        std::unique_ptr<Block> blocks[0x400];
+    };
+
+    Memory&               _memory;
+    std::unique_ptr<Page> _pages[kPageCount];
+};
+
+} // namespace libnin64
+
+#endif
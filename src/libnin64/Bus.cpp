@@ -1,8 +1,9 @@
-#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <libnin64/AudioInterface.h>
 #include <libnin64/Bus.h>
 #include <libnin64/Cart.h>
+#include <libnin64/Log.h>
 #include <libnin64/MIPSInterface.h>
 #include <libnin64/Memory.h>
 #include <libnin64/PeripheralInterface.h>
@@ -13,6 +14,9 @@
 #include <libnin64/Util.h>
 #include <libnin64/VideoInterface.h>
 
+#define CART_BASE 0x10000000
+#define CART_END  0x1fc00000
+
 using namespace libnin64;
 
 // https://raw.githubusercontent.com/mikeryan/n64dev/master/docs/n64ops/n64ops%23h.txt
@@ -27,103 +31,184 @@ Bus::Bus(Memory& memory, Cart& cart, MIPSInterface& mi, PeripheralInterface& pi,
 , _ri{ri}
 , _rsp{rsp}
 , _rdp{rdp}
+, _readPages{std::make_unique<std::uint8_t*[]>(kPageCount)}
+, _writePages{std::make_unique<std::uint8_t*[]>(kPageCount)}
+, _devices{std::make_unique<BusDevice[]>(kPageCount)}
 {
+    map(0x00000000, 0x03f00000, BusDevice::Open);
+    map(0x03f00000, 0x00100000, BusDevice::Open); // RDRAM Registers
+    map(0x04040000, 0x00050000, BusDevice::RSP);
+    map(0x04100000, 0x00200000, BusDevice::RDP); // DP Registers
+    map(0x04300000, 0x00100000, BusDevice::MI);  // MIPS Interface (MI) Registers
+    map(0x04400000, 0x00100000, BusDevice::VI);  // Video Interface (VI) Registers
+    map(0x04500000, 0x00100000, BusDevice::AI);  // Audio Interface (AI) Registers
+    map(0x04600000, 0x00100000, BusDevice::PI);  // Peripheral Interface (PI) Registers
+    map(0x04700000, 0x00100000, BusDevice::RI);  // RDRAM Interface (RI) Registers
+    map(0x04800000, 0x00100000, BusDevice::SI);  // Serial Interface (SI) Registers
+    map(CART_BASE, CART_END - CART_BASE, BusDevice::Cart); // Cart Domain 1 Address 2
+    map(0x1fc00000, 0x00001000, BusDevice::PIF);
+
+    mapMemory(0x00000000, Memory::kRamSize, _memory.ram, true);
+    mapMemory(0x04000000, 0x1000, _memory.spDmem, true);
+    mapMemory(0x04001000, 0x1000, _memory.spImem, true);
 }
 
-template <typename T> T Bus::read(std::uint32_t addr)
+Bus::~Bus()
 {
-    T value;
+}
 
-    addr &= 0x1fffffff;
+/* Map the ROM pages directly, the partial last page stays with the cart */
+void Bus::mapCart()
+{
+    std::uint32_t size;
+    std::uint8_t* rom;
+
+    for (std::uint32_t addr = CART_BASE; addr < CART_END; addr += (1 << kPageShift))
+        _readPages[addr >> kPageShift] = nullptr;
 
-    if (addr < 0x03f00000)
+    size = _cart.size();
+    if (size > CART_END - CART_BASE)
+        size = CART_END - CART_BASE;
+    mapMemory(CART_BASE, size & ~((1u << kPageShift) - 1), (std::uint8_t*)_cart.data(), false);
+
+    /* Read-only mapping in the fastmem region, or a copy padded with zeroes to a page */
+    if (_memory.fastmem.valid())
+    {
+        _memory.fastmem.release(CART_BASE, CART_END - CART_BASE);
+        size = (size + (1u << kPageShift) - 1) & ~((1u << kPageShift) - 1);
+        if (size && _cart.map(_memory.fastmem.base() + CART_BASE, size))
+            return;
+        if (size && (rom = _memory.fastmem.commit(CART_BASE, size)))
+        {
+            std::memcpy(rom, _cart.data(), _cart.size() < size ? _cart.size() : size);
+            _memory.fastmem.protect(CART_BASE, size);
+        }
+    }
+}
+
+void Bus::map(std::uint32_t addr, std::uint32_t size, BusDevice device)
+{
+    for (std::uint32_t i = 0; i < (size >> kPageShift); ++i)
+        _devices[(addr >> kPageShift) + i] = device;
+}
+
+void Bus::mapMemory(std::uint32_t addr, std::uint32_t size, std::uint8_t* base, bool writable)
+{
+    for (std::uint32_t i = 0; i < (size >> kPageShift); ++i)
     {
-        value = swap(*(T*)(_memory.ram + addr));
+        _readPages[(addr >> kPageShift) + i] = base + (i << kPageShift);
+        if (writable)
+            _writePages[(addr >> kPageShift) + i] = base + (i << kPageShift);
     }
-    else if (addr < 0x03ffffff)
+}
+
+template <typename T> T Bus::readDevice(std::uint32_t addr)
+{
+    T value;
+
+    switch (_devices[addr >> kPageShift])
+    {
+    case BusDevice::Open:
         value = 0;
-    else if (addr < 0x04001000)
-        value = swap(*(T*)(_memory.spDmem + (addr & 0xfff)));
-    else if (addr < 0x04002000)
-        value = swap(*(T*)(_memory.spImem + (addr & 0xfff)));
-    else if (addr >= 0x04040000 && addr <= 0x0408ffff)
+        break;
+    case BusDevice::RSP:
         value = T(_rsp.read(addr));
-    else if (addr >= 0x04100000 && addr <= 0x042fffff) // DP Registers
+        break;
+    case BusDevice::RDP:
         value = T(_rdp.read(addr));
-    else if (addr >= 0x04300000 && addr <= 0x043fffff) // MIPS Interface (MI) Registers
+        break;
+    case BusDevice::MI:
         value = T(_mi.read(addr));
-    else if (addr >= 0x04400000 && addr <= 0x044fffff) // Video Interface (VI) Registers
+        break;
+    case BusDevice::VI:
         value = T(_vi.read(addr));
-    else if (addr >= 0x04500000 && addr <= 0x045fffff) // Audio Interface (AI) Registers
+        break;
+    case BusDevice::AI:
         value = T(_ai.read(addr));
-    else if (addr >= 0x04600000 && addr <= 0x046fffff) // Peripheral Interface (PI) Registers
+        break;
+    case BusDevice::PI:
         value = T(_pi.read(addr));
-    else if (addr >= 0x04700000 && addr <= 0x047fffff) // RDRAM Interface (RI) Registers
+        break;
+    case BusDevice::RI:
         value = T(_ri.read(addr));
-    else if (addr >= 0x04800000 && addr <= 0x048fffff) // Serial Interface (SI) Registers
+        break;
+    case BusDevice::SI:
         value = T(_si.read(addr));
-    else if (addr >= 0x10000000 && addr <= 0x1fbfffff) // Cart Domain 1 Address 2
-    {
-        _cart.read((std::uint8_t*)&value, addr - 0x10000000, sizeof(T));
-        value = swap(value);
-    }
-    else if (addr >= 0x1fc007c0 && addr <= 0x1fc007ff) // PIF RAM
-        value = swap(*(T*)(_memory.pif + (addr & 0x3f)));
-    else
-    {
+        break;
+    case BusDevice::Cart:
         value = 0;
-        std::printf("WARN: Read: Accessing not mapped memory zone: 0x%08x.\n", addr);
+        if (addr - CART_BASE + sizeof(T) <= _cart.size())
+        {
+            _cart.read((std::uint8_t*)&value, addr - CART_BASE, sizeof(T));
+            value = swap(value);
+        }
+        break;
+    case BusDevice::PIF:
+        if (addr >= 0x1fc007c0 && addr <= 0x1fc007ff) // PIF RAM
+        {
+            value = swap(*(T*)(_memory.pif + (addr & 0x3f)));
+            break;
+        }
+        /* fallthrough */
+    default:
+        value = 0;
+        NIN64_LOG(Bus, Warn, "WARN: Read: Accessing not mapped memory zone: 0x%08x.\n", addr);
+        break;
     }
 
     return value;
 }
 
-template <typename T> void Bus::write(std::uint32_t addr, T value)
+template <typename T> void Bus::writeDevice(std::uint32_t addr, T value)
 {
-    addr &= 0x1fffffff;
-
-    if (addr < 0x03f00000)
-        *(T*)(_memory.ram + addr) = swap(value);
-    else if (addr < 0x03ffffff)
-        return;
-    else if (addr < 0x04001000)
-        *(T*)(_memory.spDmem + (addr & 0xfff)) = swap(value);
-    else if (addr < 0x04002000)
-        *(T*)(_memory.spImem + (addr & 0xfff)) = swap(value);
-    else if (addr >= 0x04040000 && addr <= 0x0408ffff)
+    switch (_devices[addr >> kPageShift])
+    {
+    case BusDevice::Open:
+        break;
+    case BusDevice::RSP:
         _rsp.write(addr, (std::uint32_t)value);
-    else if (addr >= 0x04100000 && addr <= 0x042fffff) // DP Registers
+        break;
+    case BusDevice::RDP:
         _rdp.write(addr, (std::uint32_t)value);
-    else if (addr >= 0x04300000 && addr <= 0x043fffff) // MIPS Interface (MI) Registers
+        break;
+    case BusDevice::MI:
         _mi.write(addr, (std::uint32_t)value);
-    else if (addr >= 0x04400000 && addr <= 0x044fffff) // Video Interface (VI) Registers
+        break;
+    case BusDevice::VI:
         _vi.write(addr, (std::uint32_t)value);
-    else if (addr >= 0x04500000 && addr <= 0x045fffff) // Audio Interface (AI) Registers
+        break;
+    case BusDevice::AI:
         _ai.write(addr, (std::uint32_t)value);
-    else if (addr >= 0x04600000 && addr <= 0x046fffff) // Peripheral Interface (PI) Registers
+        break;
+    case BusDevice::PI:
         _pi.write(addr, (std::uint32_t)value);
-    else if (addr >= 0x04700000 && addr <= 0x047fffff) // RDRAM Interface (RI) Registers
+        break;
+    case BusDevice::RI:
         _ri.write(addr, (std::uint32_t)value);
-    else if (addr >= 0x04800000 && addr <= 0x048fffff) // Serial Interface (SI) Registers
+        break;
+    case BusDevice::SI:
         _si.write(addr, (std::uint32_t)value);
-    else if (addr >= 0x1fc007c0 && addr <= 0x1fc007ff) // PIF RAM
-    {
-        *(T*)(_memory.pif + (addr & 0x3f)) = swap(value);
-        _si.pifUpdate();
-    }
-    else
-    {
-        std::printf("WARN: Write: Accessing not mapped memory zone: 0x%08x.\n", addr);
-        return;
+        break;
+    case BusDevice::PIF:
+        if (addr >= 0x1fc007c0 && addr <= 0x1fc007ff) // PIF RAM
+        {
+            *(T*)(_memory.pif + (addr & 0x3f)) = swap(value);
+            _si.pifUpdate();
+            break;
+        }
+        /* fallthrough */
+    default:
+        NIN64_LOG(Bus, Warn, "WARN: Write: Accessing not mapped memory zone: 0x%08x.\n", addr);
+        break;
     }
 }
 
-template std::uint8_t  Bus::read<std::uint8_t>(std::uint32_t);
-template std::uint16_t Bus::read<std::uint16_t>(std::uint32_t);
-template std::uint32_t Bus::read<std::uint32_t>(std::uint32_t);
-template std::uint64_t Bus::read<std::uint64_t>(std::uint32_t);
+template std::uint8_t  Bus::readDevice<std::uint8_t>(std::uint32_t);
+template std::uint16_t Bus::readDevice<std::uint16_t>(std::uint32_t);
+template std::uint32_t Bus::readDevice<std::uint32_t>(std::uint32_t);
+template std::uint64_t Bus::readDevice<std::uint64_t>(std::uint32_t);
 
-template void Bus::write<std::uint8_t>(std::uint32_t, std::uint8_t);
-template void Bus::write<std::uint16_t>(std::uint32_t, std::uint16_t);
-template void Bus::write<std::uint32_t>(std::uint32_t, std::uint32_t);
-template void Bus::write<std::uint64_t>(std::uint32_t, std::uint64_t);
+template void Bus::writeDevice<std::uint8_t>(std::uint32_t, std::uint8_t);
+template void Bus::writeDevice<std::uint16_t>(std::uint32_t, std::uint16_t);
+template void Bus::writeDevice<std::uint32_t>(std::uint32_t, std::uint32_t);
+template void Bus::writeDevice<std::uint64_t>(std::uint32_t, std::uint64_t);
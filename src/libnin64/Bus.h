@@ -1,13 +1,16 @@
 #ifndef INCLUDED_BUS_H
 #define INCLUDED_BUS_H
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <libnin64/Memory.h>
 #include <libnin64/NonCopyable.h>
+#include <libnin64/Util.h>
 
 namespace libnin64
 {
 
-class Memory;
 class Cart;
 class MIPSInterface;
 class PeripheralInterface;
@@ -18,10 +21,39 @@ class RDRAMInterface;
 class RSP;
 class RDP;
 
+enum class BusDevice : std::uint8_t
+{
+    Unmapped = 0,
+    Open,
+    RSP,
+    RDP,
+    MI,
+    VI,
+    AI,
+    PI,
+    RI,
+    SI,
+    Cart,
+    PIF
+};
+
+/*
+ * Physical address space, split in 4KiB pages.
+ *
+ * Pages backed by plain memory (RDRAM, SP memory, cart ROM) have a host
+ * pointer and are accessed directly; everything else goes through the
+ * device the page belongs to.
+ */
 class Bus : private NonCopyable
 {
 public:
+    static constexpr const unsigned    kPageShift = 12;
+    static constexpr const std::size_t kPageCount = 0x20000000 >> kPageShift;
+
     Bus(Memory& memory, Cart& cart, MIPSInterface& mi, PeripheralInterface& pi, SerialInterface& si, VideoInterface& vi, AudioInterface& ai, RDRAMInterface& ri, RSP& rsp, RDP& rdp);
+    ~Bus();
+
+    void mapCart();
 
     template <typename T> T    read(std::uint32_t addr);
     template <typename T> void write(std::uint32_t addr, T value);
@@ -37,6 +69,12 @@ public:
     void write64(std::uint32_t addr, std::uint64_t value) { write<std::uint64_t>(addr, value); }
 
 private:
+    void map(std::uint32_t addr, std::uint32_t size, BusDevice device);
+    void mapMemory(std::uint32_t addr, std::uint32_t size, std::uint8_t* base, bool writable);
+
+    template <typename T> T    readDevice(std::uint32_t addr);
+    template <typename T> void writeDevice(std::uint32_t addr, T value);
+
     Memory&              _memory;
     Cart&                _cart;
     MIPSInterface&       _mi;
@@ -47,8 +85,38 @@ private:
     RDRAMInterface&      _ri;
     RSP&                 _rsp;
     RDP&                 _rdp;
+
+    std::unique_ptr<std::uint8_t*[]> _readPages;
+    std::unique_ptr<std::uint8_t*[]> _writePages;
+    std::unique_ptr<BusDevice[]>     _devices;
 };
 
+template <typename T> inline T Bus::read(std::uint32_t addr)
+{
+    std::uint8_t* page;
+
+    addr &= 0x1fffffff;
+    page = _readPages[addr >> kPageShift];
+    if (page)
+        return swap(*(T*)(page + (addr & 0xfff)));
+    return readDevice<T>(addr);
+}
+
+template <typename T> inline void Bus::write(std::uint32_t addr, T value)
+{
+    std::uint8_t* page;
+
+    addr &= 0x1fffffff;
+    page = _writePages[addr >> kPageShift];
+    if (page)
+    {
+        *(T*)(page + (addr & 0xfff)) = swap(value);
+        _memory.markWritten(addr);
+        return;
+    }
+    writeDevice<T>(addr, value);
+}
+
 } // namespace libnin64
 
 #endif
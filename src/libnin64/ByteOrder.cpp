@@ -0,0 +1,87 @@
+#include <cstring>
+#include <libnin64/ByteOrder.h>
+#include <libnin64/CPUFeatures.h>
+#include <libnin64/Util.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+using namespace libnin64;
+
+template <ByteOrder order>
+static std::uint32_t swapWord(std::uint32_t v)
+{
+    switch (order)
+    {
+    case ByteOrder::Swap16:
+        return ((v & 0x00ff00ff) << 8) | ((v >> 8) & 0x00ff00ff);
+    case ByteOrder::Swap32:
+        return swap32(v);
+    case ByteOrder::SwapHalves:
+        return (v << 16) | (v >> 16);
+    default:
+        return v;
+    }
+}
+
+template <ByteOrder order>
+static __m128i swapVector(__m128i v)
+{
+    if (order == ByteOrder::Swap16 || order == ByteOrder::Swap32)
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    if (order == ByteOrder::Swap32 || order == ByteOrder::SwapHalves)
+    {
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    }
+    return v;
+}
+
+/* SSE2 is the baseline, and has enough shifts and shuffles for all orders */
+template <ByteOrder order>
+static void swapAll(std::uint8_t* dst, const std::uint8_t* src, std::size_t size, std::size_t done)
+{
+    std::uint32_t word;
+
+    for (; done + 16 <= size; done += 16)
+        _mm_storeu_si128((__m128i*)(dst + done), swapVector<order>(_mm_loadu_si128((const __m128i*)(src + done))));
+    for (; done + 4 <= size; done += 4)
+    {
+        std::memcpy(&word, src + done, 4);
+        word = swapWord<order>(word);
+        std::memcpy(dst + done, &word, 4);
+    }
+    if (dst != src)
+        std::memcpy(dst + done, src + done, size - done);
+}
+
+void libnin64::swapByteOrder(void* dst, const void* src, std::size_t size, ByteOrder order)
+{
+    std::size_t done{};
+
+    if (order == ByteOrder::Big)
+    {
+        if (dst != src)
+            std::memcpy(dst, src, size);
+        return;
+    }
+
+    if (CPUFeatures::host().avx2)
+        done = swapByteOrderAVX2(dst, src, size, order);
+
+    switch (order)
+    {
+    case ByteOrder::Swap16:
+        swapAll<ByteOrder::Swap16>((std::uint8_t*)dst, (const std::uint8_t*)src, size, done);
+        break;
+    case ByteOrder::Swap32:
+        swapAll<ByteOrder::Swap32>((std::uint8_t*)dst, (const std::uint8_t*)src, size, done);
+        break;
+    default:
+        swapAll<ByteOrder::SwapHalves>((std::uint8_t*)dst, (const std::uint8_t*)src, size, done);
+        break;
+    }
+}
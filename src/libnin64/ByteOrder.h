@@ -0,0 +1,34 @@
+#ifndef INCLUDED_BYTE_ORDER_H
+#define INCLUDED_BYTE_ORDER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace libnin64
+{
+
+/*
+ * Byte orders of the 32-bit big endian words found in ROM and save dumps,
+ * named after the swap that turns them back into big endian.
+ */
+enum class ByteOrder : std::uint8_t
+{
+    Big,        /* .z64 */
+    Swap16,     /* .v64, bytes swapped in each halfword */
+    Swap32,     /* .n64, little endian words */
+    SwapHalves, /* halfwords swapped in each word */
+};
+
+/*
+ * Swaps size bytes in a single pass. The swaps are their own inverse, so
+ * this converts to and from big endian alike. dst may be src, but the two
+ * must not overlap otherwise. A partial last word is copied as is.
+ */
+void swapByteOrder(void* dst, const void* src, std::size_t size, ByteOrder order);
+
+/* Kernels for the hosts with AVX2, returning the count of bytes done */
+std::size_t swapByteOrderAVX2(void* dst, const void* src, std::size_t size, ByteOrder order);
+
+} // namespace libnin64
+
+#endif
@@ -0,0 +1,47 @@
+#include <libnin64/ByteOrder.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+/*
+ * AVX2 kernels: a single pshufb per 32 bytes, from a table indexed by the
+ * byte order. Shuffles stay within 128-bit lanes, which words never cross.
+ */
+
+using namespace libnin64;
+
+alignas(32) static const std::uint8_t kShuffle[4][32] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14},
+    {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12},
+    {2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13, 2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13},
+};
+
+std::size_t libnin64::swapByteOrderAVX2(void* dst, const void* src, std::size_t size, ByteOrder order)
+{
+    std::uint8_t*       out = (std::uint8_t*)dst;
+    const std::uint8_t* in  = (const std::uint8_t*)src;
+    __m256i             shuffle;
+    __m256i             a;
+    __m256i             b;
+    std::size_t         done{};
+
+    shuffle = _mm256_load_si256((const __m256i*)kShuffle[(int)order]);
+    for (; done + 64 <= size; done += 64)
+    {
+        a = _mm256_loadu_si256((const __m256i*)(in + done));
+        b = _mm256_loadu_si256((const __m256i*)(in + done + 32));
+        _mm256_storeu_si256((__m256i*)(out + done), _mm256_shuffle_epi8(a, shuffle));
+        _mm256_storeu_si256((__m256i*)(out + done + 32), _mm256_shuffle_epi8(b, shuffle));
+    }
+    for (; done + 32 <= size; done += 32)
+    {
+        a = _mm256_loadu_si256((const __m256i*)(in + done));
+        _mm256_storeu_si256((__m256i*)(out + done), _mm256_shuffle_epi8(a, shuffle));
+    }
+    _mm256_zeroupper();
+    return done;
+}
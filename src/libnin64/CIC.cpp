@@ -0,0 +1,39 @@
+#include <libnin64/CIC.h>
+
+using namespace libnin64;
+
+#define REGS_6102 0x0000000000000001, 0x000000000ebda536, 0x000000000ebda536, 0x000000000000a536, 0xffffffffed10d0b3, 0x000000001402a4cc, 0x000000003103e121
+#define NTSC_6102 {0xffffffffc95973d5, 0x000000002449a366, 3}
+#define PAL_6102  {0xffffffffc0f1d859, 0x000000002de108ea, 0}
+
+/* The first entry is the fallback for unknown boot code */
+static const CICInfo kCICs[] = {
+    /* cic, name, boot code CRC32, r1, r2, r3, r4, r12, r13, r15, r22, r25, NTSC r5, r14, r24, PAL r5, r14, r24 */
+    {CIC::Unknown, "Unknown", 0x00000000, REGS_6102, 0x3f, 0xffffffff9debb54f, NTSC_6102, PAL_6102},
+    {CIC::NUS_6101, "6101", 0x6170a4a1, REGS_6102, 0x3f, 0xffffffff9debb54f, NTSC_6102, PAL_6102},
+    {CIC::NUS_6102, "6102", 0x90bb6cb5, REGS_6102, 0x3f, 0xffffffff9debb54f, NTSC_6102, PAL_6102},
+    {CIC::NUS_6103, "6103", 0x0b050ee0,
+     0x0000000000000001, 0x0000000049a5ee96, 0x0000000049a5ee96, 0x000000000000ee96, 0xffffffffce9dfbf7, 0xffffffffce9dfbf7, 0x0000000018b63d28, 0x78, 0xffffffff825b21c9,
+     {0xffffffff95315a28, 0x000000005baca1df, 3},
+     {0xffffffffd4646273, 0x000000001af99984, 0}},
+    {CIC::NUS_6105, "6105", 0x98bc2c86,
+     0x0000000000000000, 0xfffffffff58b0fbf, 0xfffffffff58b0fbf, 0x0000000000000fbf, 0xffffffff9651f81e, 0x000000002d42aac5, 0x0000000056584d60, 0x91, 0xffffffffcdce565f,
+     {0x000000005493fb9a, 0xffffffffc2c20384, 3},
+     {0xffffffffdecaaad1, 0x000000000cf85c13, 2}},
+    {CIC::NUS_6106, "6106", 0xacc8580a,
+     0x0000000000000000, 0xffffffffa95930a4, 0xffffffffa95930a4, 0x00000000000030a4, 0xffffffffbcb59510, 0xffffffffbcb59510, 0x000000007a3c07f4, 0x85, 0x00000000465e3f72,
+     {0xffffffffe067221f, 0x000000005cd2b70f, 3},
+     {0xffffffffb04dc903, 0x000000001af99984, 2}},
+    {CIC::NUS_7102, "7102", 0x009e9ea3, REGS_6102, 0x3f, 0xffffffff9debb54f, NTSC_6102, PAL_6102},
+    {CIC::NUS_8303, "8303", 0x0e018159, REGS_6102, 0xdd, 0xffffffff9debb54f, NTSC_6102, PAL_6102},
+};
+
+const CICInfo& CICInfo::find(std::uint32_t crc)
+{
+    for (const auto& info : kCICs)
+    {
+        if (info.crc == crc && info.cic != CIC::Unknown)
+            return info;
+    }
+    return kCICs[0];
+}
@@ -1,6 +1,8 @@
 #ifndef INCLUDED_CIC_H
 #define INCLUDED_CIC_H
 
+#include <cstdint>
+
 namespace libnin64
 {
 
@@ -12,8 +14,51 @@ enum class CIC
     NUS_6103,
     NUS_6105,
     NUS_6106,
+    NUS_7102,
+    NUS_8303,
+};
+
+enum class TvType
+{
+    PAL  = 0,
+    NTSC = 1,
+};
+
+/*
+ * What the PIF leaves behind for each CIC, found by the CRC32 of the IPL3
+ * boot code in the ROM header. IPL3 checks the ROM against the seed in r22,
+ * the other registers are left over from IPL2. The PAL 7101, 7103, 7105 and
+ * 7106 run the same IPL3 as their NTSC counterparts and only differ by
+ * region, which comes from the ROM header.
+ */
+struct CICInfo
+{
+    struct Region
+    {
+        std::uint64_t r5;
+        std::uint64_t r14;
+        std::uint64_t r24;
+    };
+
+    /* Unknown boot code gets the 6102 values */
+    static const CICInfo& find(std::uint32_t crc);
+
+    CIC           cic;
+    const char*   name;
+    std::uint32_t crc;
+    std::uint64_t r1;
+    std::uint64_t r2;
+    std::uint64_t r3;
+    std::uint64_t r4;
+    std::uint64_t r12;
+    std::uint64_t r13;
+    std::uint64_t r15;
+    std::uint64_t r22;
+    std::uint64_t r25;
+    Region        ntsc;
+    Region        pal;
 };
 
-}
+} // namespace libnin64
 
 #endif
@@ -1,10 +1,19 @@
+#include <algorithm>
 #include <cmath>
-#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <type_traits>
+#include <x86intrin.h>
 #include <libnin64/Bus.h>
 #include <libnin64/CPU.h>
+#include <libnin64/Cache.h>
+#include <libnin64/HostFpu.h>
+#include <libnin64/Log.h>
 #include <libnin64/MIPSInterface.h>
+#include <libnin64/Recompiler.h>
+#include <libnin64/Savestate.h>
+#include <libnin64/Scheduler.h>
+#include <libnin64/Timing.h>
 #include <libnin64/Util.h>
 
 #define COP0_REG_INDEX    0
@@ -36,88 +45,104 @@
 #define FCR_REVISION 0
 #define FCR_CONTROL  31
 
-#define NOT_IMPLEMENTED()                                                                                \
-    {                                                                                                    \
-        std::printf("%s:%d: PC: 0x%016llx Not implemented: OP:%02o RS:%02o RT:%02o RD:%02o %02o %02o\n", \
-                    __FILE__,                                                                            \
-                    __LINE__,                                                                            \
-                    _pc,                                                                                 \
-                    (op >> 26),                                                                          \
-                    ((op >> 21) & 0x1f),                                                                 \
-                    ((op >> 16) & 0x1f),                                                                 \
-                    ((op >> 11) & 0x1f),                                                                 \
-                    ((op >> 06) & 0x1f),                                                                 \
-                    ((op >> 00) & 0x3f));                                                                \
-        exit(1);                                                                                         \
+#define FCR31_RM    0x00000003
+#define FCR31_CAUSE 0x0003f000
+#define FCR31_C     0x00800000
+#define FCR31_FS    0x01000000
+#define FCR31_MASK  0x0183ffff
+
+#define FPU_EXC_INEXACT   0x01
+#define FPU_EXC_UNDERFLOW 0x02
+#define FPU_EXC_OVERFLOW  0x04
+#define FPU_EXC_DIVZERO   0x08
+#define FPU_EXC_INVALID   0x10
+#define FPU_EXC_UNIMPL    0x20
+
+#define NOT_IMPLEMENTED()                                                                                          \
+    {                                                                                                              \
+        NIN64_LOG(CPU, Error, "%s:%d: PC: 0x%016llx Not implemented: OP:%02o RS:%02o RT:%02o RD:%02o %02o %02o\n", \
+                  __FILE__,                                                                                        \
+                  __LINE__,                                                                                        \
+                  _pc,                                                                                             \
+                  (instr.op >> 26),                                                                                \
+                  instr.rs,                                                                                        \
+                  instr.rt,                                                                                        \
+                  instr.rd,                                                                                        \
+                  instr.sa,                                                                                        \
+                  (instr.op & 0x3f));                                                                              \
+        exit(1);                                                                                                   \
     }
 
-#define RS          ((std::uint8_t)((op >> 21) & 0x1f))
+#define RS          (instr.rs)
 #define BASE        RS
 #define FMT         RS
-#define RT          ((std::uint8_t)((op >> 16) & 0x1f))
+#define RT          (instr.rt)
 #define FT          RT
-#define RD          ((std::uint8_t)((op >> 11) & 0x1f))
+#define RD          (instr.rd)
 #define FS          RD
-#define SA          ((std::uint8_t)((op >> 6) & 0x1f))
+#define SA          (instr.sa)
 #define FD          SA
-#define IMM         ((std::uint16_t)op)
-#define SIMM        ((std::int16_t)op)
-#define JUMP_TARGET ((std::uint32_t)op & 0x3ffffff)
-
-#define FMT_S (16 << 6)
-#define FMT_D (17 << 6)
-#define FMT_W (20 << 6)
-#define FMT_L (21 << 6)
+#define IMM         (instr.imm)
+#define SIMM        ((std::int16_t)instr.imm)
+#define JUMP_TARGET (instr.op & 0x3ffffff)
 
 #define INT_TIMER 0x80
 
-using namespace libnin64;
-
-static std::uint32_t StoW(float v)
-{
-    return (((std::uint32_t)std::fabs(v)) & 0x7fffffff) | (v < 0.f ? 0x80000000 : 0x00000000);
-}
-
-static std::uint64_t StoL(float v)
-{
-    return (((std::uint64_t)std::fabs(v)) & 0x7fffffffffffffffull) | (v < 0.f ? 0x8000000000000000ull : 0x0000000000000000ull);
-}
-
-static std::uint32_t DtoW(double v)
-{
-    return (((std::uint32_t)std::abs(v)) & 0x7fffffff) | (v < 0.0 ? 0x80000000 : 0x00000000);
-}
+#define EXC_INT  0
+#define EXC_MOD  1
+#define EXC_TLBL 2
+#define EXC_TLBS 3
+#define EXC_FPE  15
 
-static std::uint64_t DtoL(double v)
-{
-    return (((std::uint64_t)std::abs(v)) & 0x7fffffffffffffffull) | (v < 0.0 ? 0x8000000000000000ull : 0x0000000000000000ull);
-}
+using namespace libnin64;
 
-static float WtoS(std::uint32_t v)
-{
-    return (float)(v & 0x7fffffff) * ((v & 0x80000000) ? -1.f : 1.f);
-}
+/* MXCSR rounding control for each FCR31 rounding mode: nearest, zero, up and down */
+static constexpr const std::uint32_t kRoundingModes[4] = {0x0000, 0x6000, 0x4000, 0x2000};
 
-static float LtoS(std::uint64_t v)
+/* Host MXCSR for an FCR31 value: exceptions masked, flags clear, the same rounding, and flush to zero for FS */
+static std::uint32_t hostCsr(std::uint32_t fcr31)
 {
-    return (float)(v & 0x7fffffffffffffffull) * ((v & 0x8000000000000000ull) ? -1.f : 1.f);
+    return 0x1f80 | kRoundingModes[fcr31 & FCR31_RM] | ((fcr31 & FCR31_FS) ? 0x8000 : 0);
 }
 
-static double WtoD(std::uint32_t v)
+/* MXCSR exception flags as FCR31 cause bits, the denormal operand flag has no equivalent */
+static std::uint32_t hostExceptions(std::uint32_t csr)
 {
-    return (double)(v & 0x7fffffff) * ((v & 0x80000000) ? -1.0 : 1.0);
+    return ((csr & 0x20) ? FPU_EXC_INEXACT : 0)
+           | ((csr & 0x10) ? FPU_EXC_UNDERFLOW : 0)
+           | ((csr & 0x08) ? FPU_EXC_OVERFLOW : 0)
+           | ((csr & 0x04) ? FPU_EXC_DIVZERO : 0)
+           | ((csr & 0x01) ? FPU_EXC_INVALID : 0);
 }
 
-static double LtoD(std::uint64_t v)
+/* CVTSS2SI and friends, in the current rounding mode or truncating */
+template <typename I, bool kTruncate, typename T> static I toInt(T value)
 {
-    return (double)(v & 0x7fffffffffffffffull) * ((v & 0x8000000000000000ull) ? -1.0 : 1.0);
+    if constexpr (std::is_same_v<T, float> && sizeof(I) == 4)
+        return kTruncate ? _mm_cvttss_si32(_mm_set_ss(value)) : _mm_cvtss_si32(_mm_set_ss(value));
+    else if constexpr (std::is_same_v<T, float>)
+        return kTruncate ? _mm_cvttss_si64(_mm_set_ss(value)) : _mm_cvtss_si64(_mm_set_ss(value));
+    else if constexpr (sizeof(I) == 4)
+        return kTruncate ? _mm_cvttsd_si32(_mm_set_sd(value)) : _mm_cvtsd_si32(_mm_set_sd(value));
+    else
+        return kTruncate ? _mm_cvttsd_si64(_mm_set_sd(value)) : _mm_cvtsd_si64(_mm_set_sd(value));
 }
 
-CPU::CPU(Bus& bus, MIPSInterface& mi)
+CPU::CPU(Bus& bus, Memory& memory, MIPSInterface& mi, Scheduler& scheduler)
 : _bus{bus}
 , _mi{mi}
+, _scheduler{scheduler}
+, _memory{memory}
+, _blocks{memory}
+, _tlb{}
+, _recompiler{}
+, _cache{}
+, _lastBlock{}
+, _lastBlockTime{}
 , _pc{0xffffffffa4000040ull}
 , _pcNext{_pc + 4}
+, _instrPc{}
+, _instrDelay{}
 , _regs{}
 , _fpuRegs{}
 , _llAddr{}
@@ -125,16 +150,31 @@ CPU::CPU(Bus& bus, MIPSInterface& mi)
 , _errorEpc{}
 , _ip{}
 , _im{}
+, _branchDelay{}
 , _erl{true}
 , _exl{}
 , _ie{}
 , _llBit{}
 , _fpCompare{}
-, _branchDelay{}
 , _bd{}
 , _fr{}
-, _count{}
+, _fcr31{}
+, _mxcsr{hostCsr(0)}
+, _countOffset{}
 , _compare{}
+, _index{}
+, _random{31}
+, _entryLo0{}
+, _entryLo1{}
+, _context{}
+, _pageMask{}
+, _wired{}
+, _badVAddr{}
+, _entryHi{}
+, _tagLo{}
+, _tagHi{}
+, _excCode{}
+, _instructions{}
 {
     _regs[0].u64  = 0;
     _regs[1].u64  = 0x1;
@@ -168,1193 +208,1760 @@ CPU::CPU(Bus& bus, MIPSInterface& mi)
     _regs[29].u64 = 0xa4001ff0;
     _regs[30].u64 = 0x0;
     _regs[31].u64 = 0xffffffffa4001550;
+
+    scheduleTimer();
 }
 
 CPU::~CPU()
 {
 }
 
-void CPU::init(CIC cic)
+void CPU::init(const CICInfo& cic, TvType tvType)
 {
-    switch (cic)
+    const CICInfo::Region& region = (tvType == TvType::PAL) ? cic.pal : cic.ntsc;
+
+    _regs[1].u64  = cic.r1;
+    _regs[2].u64  = cic.r2;
+    _regs[3].u64  = cic.r3;
+    _regs[4].u64  = cic.r4;
+    _regs[5].u64  = region.r5;
+    _regs[12].u64 = cic.r12;
+    _regs[13].u64 = cic.r13;
+    _regs[14].u64 = region.r14;
+    _regs[15].u64 = cic.r15;
+    _regs[20].u64 = (std::uint64_t)tvType;
+    _regs[22].u64 = cic.r22;
+    _regs[23].u64 = (tvType == TvType::PAL) ? 6 : 0;
+    _regs[24].u64 = region.r24;
+    _regs[25].u64 = cic.r25;
+    _regs[31].u64 = (tvType == TvType::PAL) ? 0xffffffffa4001554 : 0xffffffffa4001550;
+}
+
+bool CPU::setBackend(CPUBackend backend)
+{
+    if (backend == CPUBackend::Interpreter)
     {
-    case CIC::Unknown:
-    case CIC::NUS_6102:
-        _regs[1].u64  = 0x0000000000000001;
-        _regs[2].u64  = 0x000000000ebda536;
-        _regs[3].u64  = 0x000000000ebda536;
-        _regs[4].u64  = 0x000000000000a536;
-        _regs[5].u64  = 0xffffffffc95973d5;
-        _regs[12].u64 = 0xffffffffed10d0b3;
-        _regs[13].u64 = 0x000000001402a4cc;
-        _regs[14].u64 = 0x000000002449a366;
-        _regs[15].u64 = 0x000000003103e121;
-        _regs[22].u64 = 0x000000000000003f;
-        _regs[25].u64 = 0xffffffff9debb54f;
-        break;
-    case CIC::NUS_6103:
-        _regs[1].u64  = 0x0000000000000001;
-        _regs[2].u64  = 0x0000000049a5ee96;
-        _regs[3].u64  = 0x0000000049a5ee96;
-        _regs[4].u64  = 0x000000000000ee96;
-        _regs[5].u64  = 0xffffffff95315a28;
-        _regs[12].u64 = 0xffffffffce9dfbf7;
-        _regs[13].u64 = 0xffffffffce9dfbf7;
-        _regs[14].u64 = 0x000000005baca1df;
-        _regs[15].u64 = 0x0000000018b63d28;
-        _regs[22].u64 = 0x0000000000000078;
-        _regs[25].u64 = 0xffffffff825b21c9;
-        break;
-    case CIC::NUS_6105:
-        _regs[1].u64  = 0x0000000000000000;
-        _regs[2].u64  = 0xfffffffff58b0fbf;
-        _regs[3].u64  = 0xfffffffff58b0fbf;
-        _regs[4].u64  = 0x0000000000000fbf;
-        _regs[5].u64  = 0x000000005493fb9a;
-        _regs[12].u64 = 0xffffffff9651f81e;
-        _regs[13].u64 = 0x000000002d42aac5;
-        _regs[14].u64 = 0xffffffffc2c20384;
-        _regs[15].u64 = 0x0000000056584d60;
-        _regs[22].u64 = 0x0000000000000091;
-        _regs[25].u64 = 0xffffffffcdce565f;
-        break;
+        _recompiler.reset();
+        return true;
+    }
+
+    if (!Recompiler::supported())
+        return false;
+    if (!_recompiler)
+        _recompiler = std::make_unique<Recompiler>(*this, _scheduler, _memory);
+    if (!_recompiler->valid())
+    {
+        _recompiler.reset();
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Routes CPU accesses to cached pages through the primary caches. Dirty data
+ * is written back when turning it off, so memory is left as the program sees
+ * it.
+ */
+void CPU::setCacheEmulation(bool enabled)
+{
+    if (enabled && !_cache)
+    {
+        _cache = std::make_unique<Cache>(_bus);
+    }
+    else if (!enabled && _cache)
+    {
+        _cache->writeBack();
+        _cache.reset();
     }
 }
 
-void CPU::tick(std::size_t count)
+void CPU::run(std::uint64_t until)
 {
-    while (count--)
+    Instr         instr;
+    Block*        block;
+    std::uint32_t addr;
+
+    /* Guest floating point runs in its own MXCSR, the caller gets its own back */
+    HostFpu::enter(_mxcsr);
+
+    /* Blocks bypass the caches, so emulating them means interpreting everything */
+    if (_cache)
     {
-        tick();
+        while (_scheduler.now() < until && _scheduler.now() < _scheduler.deadline())
+            interpret<true>();
+        HostFpu::leave();
+        return;
+    }
+
+    while (_scheduler.now() < until && _scheduler.now() < _scheduler.deadline())
+    {
+        interrupt();
+
+        /* A fetch that misses the TLB faults as if the instruction had started */
+        _instrPc    = _pc;
+        _instrDelay = _branchDelay;
+        if (!translate((std::uint32_t)_pc, false, addr))
+            continue;
+
+        block = _blocks.find(addr);
+        if (!block && BlockCache::cacheable(addr))
+            block = compile(addr);
+
+        /* Back at the start of an idle loop that just ran once, skip ahead */
+        if (block && block->idle && block == _lastBlock && _pcNext == _pc + 4 && !idleReadsClock(*block))
+            skipIdle(_scheduler.now() - _lastBlockTime, until);
+        _lastBlock     = block;
+        _lastBlockTime = _scheduler.now();
+
+        if (block && _recompiler)
+        {
+            _recompiler->run(block, until);
+        }
+        else if (block)
+        {
+            execute(*block);
+        }
+        else
+        {
+            predecode<false>(instr, _bus.read32(addr));
+            step(instr);
+        }
     }
-    //std::printf("PC: %016llx\n", _pc);
+    HostFpu::leave();
 }
 
 void CPU::tick()
 {
-    std::uint32_t op;
-    std::uint64_t tmp;
-    std::uint64_t tmp2;
+    HostFpu::enter(_mxcsr);
+    if (_cache)
+        interpret<true>();
+    else
+        interpret<false>();
+    HostFpu::leave();
+}
+
+template <bool kCached> void CPU::interpret()
+{
+    Instr         instr;
+    std::uint32_t page;
+    std::uint32_t addr;
+
+    interrupt();
+
+    _instrPc    = _pc;
+    _instrDelay = _branchDelay;
+    if (!(page = mapping((std::uint32_t)_pc, false)))
+        return;
+    addr = (page & 0xfffff000) | ((std::uint32_t)_pc & 0xfff);
+
+    if (kCached && (page & TLB::kCached))
+        predecode<kCached>(instr, _cache->fetch(addr));
+    else
+        predecode<kCached>(instr, _bus.read32(addr));
+    step(instr);
+    if (kCached)
+        stall(_cache->stall());
+}
+
+void CPU::timer()
+{
+    _ip |= INT_TIMER;
+    scheduleTimer();
+}
 
+/*
+ * Count runs at half the CPU clock and is never stored: it is the clock plus
+ * _countOffset, halved. The timer fires when Count next turns into Compare,
+ * a whole 2^32 counts away when that is right now.
+ */
+std::uint32_t CPU::count() const
+{
+    return (std::uint32_t)((_scheduler.now() + _countOffset) >> 1);
+}
+
+void CPU::scheduleTimer()
+{
+    std::uint64_t delay;
+
+    delay = ((std::uint64_t(_compare) << 1) - (_scheduler.now() + _countOffset)) & ((std::uint64_t(1) << 33) - 1);
+    _scheduler.schedule(Event::Timer, delay ? delay : (std::uint64_t(1) << 33));
+}
+
+/* Cycles the pipeline waits on top of those of the instruction */
+inline void CPU::stall(std::uint32_t cycles)
+{
+    _scheduler.advance(cycles);
+}
+
+/* Page array entry of an access, 0 once the TLB exception it caused was taken */
+inline std::uint32_t CPU::mapping(std::uint32_t addr, bool write)
+{
+    std::uint32_t page;
+
+    page = _tlb.lookup(addr);
+    if (!(page & (write ? TLB::kWritable : TLB::kReadable)))
+        page = tlbMiss(addr, write);
+    return page;
+}
+
+/* Physical address of an access, false once the TLB exception it caused was taken */
+inline bool CPU::translate(std::uint32_t addr, bool write, std::uint32_t& paddr)
+{
+    std::uint32_t page;
+
+    if (!(page = mapping(addr, write)))
+        return false;
+    paddr = (page & 0xfffff000) | (addr & 0xfff);
+    return true;
+}
+
+/* Cached pages only go through the data cache when it is emulated, uncached ones wait for the bus */
+template <bool kCached, typename T> inline bool CPU::load(std::uint32_t addr, T& value)
+{
+    std::uint32_t page;
+    std::uint32_t paddr;
+
+    if (!(page = mapping(addr, false)))
+        return false;
+    paddr = (page & 0xfffff000) | (addr & 0xfff);
+    if (kCached && (page & TLB::kCached))
+    {
+        value = _cache->read<T>(paddr);
+        return true;
+    }
+    if (Timing::kUncachedLoad && !(page & TLB::kCached))
+        stall(Timing::kUncachedLoad);
+    value = _bus.read<T>(paddr);
+    return true;
+}
+
+template <bool kCached, typename T> inline bool CPU::store(std::uint32_t addr, T value)
+{
+    std::uint32_t page;
+    std::uint32_t paddr;
+
+    if (!(page = mapping(addr, true)))
+        return false;
+    paddr = (page & 0xfffff000) | (addr & 0xfff);
+    if (kCached && (page & TLB::kCached))
+    {
+        _cache->write<T>(paddr, value);
+        return true;
+    }
+    if (Timing::kUncachedStore && !(page & TLB::kCached))
+        stall(Timing::kUncachedStore);
+    _bus.write<T>(paddr, value);
+    return true;
+}
+
+/*
+ * Slow path of translate(). KUSEG is an unmapped window while ERL is set,
+ * anything else that missed the page array raises a TLB refill, invalid or
+ * modification exception for the instruction at _instrPc.
+ */
+std::uint32_t CPU::tlbMiss(std::uint32_t addr, bool write)
+{
+    std::uint32_t lo;
+    std::uint8_t  code;
+    int           index;
+
+    if (_erl && addr < 0x80000000)
+        return (addr & 0x1ffff000) | TLB::kReadable | TLB::kWritable;
+
+    code  = write ? EXC_TLBS : EXC_TLBL;
+    index = _tlb.probe((addr & 0xffffe000) | (_entryHi & 0xff));
+    if (index >= 0)
+    {
+        const TLB::Entry& entry = _tlb.entry(index);
+
+        lo = (addr & (((entry.pageMask | 0x1fff) + 1) >> 1)) ? entry.entryLo1 : entry.entryLo0;
+        if (write && (lo & 0x2))
+            code = EXC_MOD;
+    }
+    NIN64_LOG(COP0, Trace, "TLB exception %d at 0x%08x (0x%016llx)\n", code, addr, (unsigned long long)_instrPc);
+
+    _badVAddr    = addr;
+    _context     = (_context & 0xff800000) | ((addr >> 9) & 0x007ffff0);
+    _entryHi     = (addr & 0xffffe000) | (_entryHi & 0xff);
+    _pc          = _instrPc;
+    _branchDelay = _instrDelay;
+    exception(code, (index < 0 && !_exl) ? 0xffffffff80000000ull : 0xffffffff80000180ull);
+    return 0;
+}
+
+void CPU::interrupt()
+{
     if (_ie && !_erl && !_exl && (_im & (_ip | _mi.ip())))
+        exception(EXC_INT, 0xffffffff80000180ull);
+}
+
+/* Taken before the instruction at _pc runs. EPC and BD only change when EXL was clear */
+void CPU::exception(std::uint8_t code, std::uint64_t vector)
+{
+    if (!_exl)
     {
-        _bd          = _branchDelay;
-        _branchDelay = false;
-        _exl         = true;
-        _epc         = (std::uint32_t)_pc - (_bd ? 4 : 0);
-        _pc          = 0xffffffff80000180ull;
-        _pcNext      = _pc + 4;
+        _bd  = _branchDelay;
+        _epc = (std::uint32_t)_pc - (_bd ? 4 : 0);
     }
+    _branchDelay = false;
+    _exl         = true;
+    _excCode     = code;
+    _pc          = vector;
+    _pcNext      = _pc + 4;
+}
 
-    // For current tick
-    op = _bus.read32((std::uint32_t)_pc);
-    //std::printf("PC: 0x%016llx OP: 0x%08x Details:%02o %02o %02o %02o %02o %02o\n", _pc, op, (op >> 26), ((op >> 21) & 0x1f), ((op >> 16) & 0x1f), ((op >> 11) & 0x1f), ((op >> 06) & 0x1f), ((op >> 00) & 0x3f));
-    //for (int i = 0; i < 32; ++i) { std::printf("  REG %02d: 0x%016llx\n", i, _regs[i].u64); }
+inline void CPU::step(const Instr& instr)
+{
+    /* Where a fault raised by the handler returns to */
+    _instrPc    = _pc;
+    _instrDelay = _branchDelay;
 
     // For next tick
     _pc = _pcNext;
     _pcNext += 4;
     _branchDelay = false;
 
+    instr.handler(*this, instr);
+
+    _regs[0].u64 = 0;
+    _instructions++;
+    _scheduler.advance(instr.cycles);
+}
+
+/*
+ * Blocks end after a jump or branch and its delay slot, and right after
+ * instructions that can change the interrupt state, so that interrupts are
+ * still taken at the same point as with single stepping.
+ */
+int CPU::blockEnd(std::uint32_t op)
+{
     switch (op >> 26)
     {
     case 000: // SPECIAL
         switch (op & 0x3f)
         {
-        case 000: // SLL (Shift Left Logical)
-            _regs[RD].i64 = (std::int32_t)((_regs[RT].u32 << SA) & 0xffffffff);
-            break;
-        case 002: // SRL (Shift Right Logical)
-            _regs[RD].i64 = (std::int32_t)((_regs[RT].u32 >> SA) & 0xffffffff);
-            break;
-        case 003: // SRA (Shift Right Arithmetic)
-            _regs[RD].i64 = (std::int32_t)((_regs[RT].i32 >> SA) & 0xffffffff);
-            break;
-        case 004: // SLLV (Shift Left Logical Variable)
-            _regs[RD].i64 = (std::int32_t)((_regs[RT].u32 << (_regs[RS].u8 & 0x1f)) & 0xffffffff);
-            break;
-        case 006: // SRLV (Shift Right Logical Variable)
-            _regs[RD].i64 = (std::int32_t)((_regs[RT].u32 >> (_regs[RS].u8 & 0x1f)) & 0xffffffff);
-            break;
-        case 007: // SRAV (Shift Right Arithmetic Variable)
-            _regs[RD].i64 = (std::int32_t)((_regs[RT].i32 >> (_regs[RS].u8 & 0x1f)) & 0xffffffff);
-            break;
-        case 010: // JR (Jump Register)
-            _pcNext = _regs[RS].u64;
-            break;
-        case 011: // JALR (Jump And Link Register)
-            _pcNext       = _regs[RS].u64;
-            _regs[RD].u64 = _pc + 4;
-            break;
-        case 014: // SYSCALL (System Call)
-            NOT_IMPLEMENTED();
-            break;
-        case 015: // BREAK (Breakpoint)
-            NOT_IMPLEMENTED();
-            break;
-        case 017: // SYNC (Synchronize)
-            NOT_IMPLEMENTED();
-            break;
-        case 020: // MFHI (Move From HI)
-            _regs[RD].u64 = _hi.u64;
-            break;
-        case 021: // MTHI (Move To HI)
-            _hi.u64 = _regs[RS].u64;
-            break;
-        case 022: // MFLO (Move From LO)
-            _regs[RD].u64 = _lo.u64;
-            break;
-        case 023: // MTLO (Move To LO)
-            _lo.u64 = _regs[RS].u64;
-            break;
-        case 024: // DSLLV (Doubleword Shift Left Logical Variable)
-            NOT_IMPLEMENTED();
-            break;
-        case 026: // DSRLV (Doubleword Shift Right Logical Variable)
-            NOT_IMPLEMENTED();
-            break;
-        case 027: // DSRAV
-            NOT_IMPLEMENTED();
-            break;
-        case 030: // MULT (Multiply)
-            tmp     = (std::int64_t)_regs[RS].i32 * _regs[RT].i32;
-            _lo.i64 = (std::int32_t)(tmp & 0xffffffff);
-            _hi.i64 = (std::int32_t)((tmp >> 32) & 0xffffffff);
-            break;
-        case 031: // MULTU (Multiply Unsigned)
-            tmp     = (std::uint64_t)_regs[RS].u32 * _regs[RT].u32;
-            _lo.i64 = (std::int32_t)(tmp & 0xffffffff);
-            _hi.i64 = (std::int32_t)((tmp >> 32) & 0xffffffff);
-            break;
-        case 032: // DIV
-            _lo.i64 = _regs[RS].i32 / _regs[RT].i32;
-            _hi.i64 = _regs[RS].i32 % _regs[RT].i32;
-            break;
-        case 033: // DIVU
-            _lo.u64 = _regs[RS].u32 / _regs[RT].u32;
-            _hi.u64 = _regs[RS].u32 % _regs[RT].u32;
-            break;
-        case 034: // DMULT (Doubleword Multiply)
-            mul128(_regs[RS].i64, _regs[RT].i64, &_lo.i64, &_hi.i64);
-            break;
-        case 035: // DMULTU (Doubleword Multiply Unsigned)
-            umul128(_regs[RS].u64, _regs[RT].u64, &_lo.u64, &_hi.u64);
-            break;
-        case 036: // DDIV (Doubleword Divide)
-            _lo.i64 = _regs[RS].i64 / _regs[RT].i64;
-            _hi.i64 = _regs[RS].i64 % _regs[RT].i64;
-            break;
-        case 037: // DDIVU (Doubleword Divide Unsigned)
-            _lo.u64 = _regs[RS].u64 / _regs[RT].u64;
-            _hi.u64 = _regs[RS].u64 % _regs[RT].u64;
-            break;
-        case 040: // ADD (Add)
-            _regs[RD].i64 = (std::int32_t)(_regs[RS].i64 + _regs[RT].i64);
-            break;
-        case 041: // ADDU (Add Unsigned)
-            _regs[RD].i64 = (std::int32_t)(_regs[RS].i64 + _regs[RT].i64);
-            break;
-        case 042: // SUB (Subtract)
-            _regs[RD].i64 = (std::int32_t)(_regs[RS].i64 - _regs[RT].i64);
+        case 010: // JR
+        case 011: // JALR
+            return 1;
+        case 014: // SYSCALL
+        case 015: // BREAK
+            return 2;
+        }
+        return 0;
+    case 001: // REGIMM
+    case 002: // J
+    case 003: // JAL
+    case 004: // BEQ
+    case 005: // BNE
+    case 006: // BLEZ
+    case 007: // BGTZ
+    case 024: // BEQL
+    case 025: // BNEL
+    case 026: // BLEZL
+    case 027: // BGTZL
+        return 1;
+    case 020: // COP0
+        return (((op >> 21) & 0x1e) == 004 || (op & (1 << 25))) ? 2 : 0;
+    case 021: // COP1
+        return (((op >> 21) & 0x1f) == 010) ? 1 : 0;
+    }
+    return 0;
+}
+
+Block* CPU::compile(std::uint32_t addr)
+{
+    Instr       instrs[BlockCache::kMaxBlockSize];
+    Block*      block;
+    std::size_t size;
+    int         end;
+
+    size = 0;
+    for (;;)
+    {
+        predecode<false>(instrs[size], _bus.read32(addr + size * 4));
+        end = blockEnd(instrs[size].op);
+        size++;
+
+        if (end == 2 || size == BlockCache::kMaxBlockSize || ((addr + size * 4) & 0xfff) == 0)
             break;
-        case 043: // SUBU (Subtract Unsigned)
-            _regs[RD].i64 = (std::int32_t)(_regs[RS].i64 - _regs[RT].i64);
+        if (end == 1)
+        {
+            /* Delay slot */
+            if (size < BlockCache::kMaxBlockSize && ((addr + size * 4) & 0xfff) != 0)
+            {
+                predecode<false>(instrs[size], _bus.read32(addr + size * 4));
+                size++;
+            }
             break;
+        }
+    }
+
+    block       = _blocks.insert(addr, instrs, size);
+    block->idle = idleLoop(addr, instrs, size);
+    return block;
+}
+
+/* Registers an instruction reads and writes, if it can appear in an idle loop */
+static bool idleInstr(const Instr& instr, std::uint32_t& reads, std::uint32_t& writes)
+{
+    reads  = 0;
+    writes = 0;
+    switch (instr.op >> 26)
+    {
+    case 000: // SPECIAL
+        switch (instr.op & 0x3f)
+        {
+        case 000: // SLL
+        case 002: // SRL
+        case 003: // SRA
+        case 070: // DSLL
+        case 072: // DSRL
+        case 073: // DSRA
+        case 074: // DSLL32
+        case 076: // DSRL32
+        case 077: // DSRA32
+            reads  = (1u << RT);
+            writes = (1u << RD);
+            return true;
+        case 004: // SLLV
+        case 006: // SRLV
+        case 007: // SRAV
+        case 040: // ADD
+        case 041: // ADDU
+        case 042: // SUB
+        case 043: // SUBU
         case 044: // AND
-            _regs[RD].u64 = _regs[RS].u64 & _regs[RT].u64;
-            break;
         case 045: // OR
-            _regs[RD].u64 = _regs[RS].u64 | _regs[RT].u64;
-            break;
         case 046: // XOR
-            _regs[RD].u64 = _regs[RS].u64 ^ _regs[RT].u64;
-            break;
         case 047: // NOR
-            _regs[RD].u64 = ~(_regs[RS].u64 | _regs[RT].u64);
-            break;
-        case 052: // SLT (Set On Less Than)
-            _regs[RD].u64 = !!(_regs[RS].i64 < _regs[RT].i64);
-            break;
-        case 053: // SLTU (Set On Less Than Unsigned)
-            _regs[RD].u64 = !!(_regs[RS].u64 < _regs[RT].u64);
-            break;
+        case 052: // SLT
+        case 053: // SLTU
         case 054: // DADD
-            _regs[RD].i64 = _regs[RS].i64 + _regs[RT].i64;
-            break;
         case 055: // DADDU
-            _regs[RD].i64 = _regs[RS].i64 + _regs[RT].i64;
-            break;
         case 056: // DSUB
-            _regs[RD].i64 = _regs[RS].i64 - _regs[RT].i64;
-            break;
         case 057: // DSUBU
-            _regs[RD].i64 = _regs[RS].i64 - _regs[RT].i64;
-            break;
-        case 060: // TGE
-            NOT_IMPLEMENTED();
-            break;
-        case 061: // TGEU
-            NOT_IMPLEMENTED();
-            break;
-        case 062: // TLT
-            NOT_IMPLEMENTED();
-            break;
-        case 063: // TLTU
-            NOT_IMPLEMENTED();
-            break;
-        case 064: // TEQ
-            NOT_IMPLEMENTED();
-            break;
-        case 066: // TNE
-            NOT_IMPLEMENTED();
-            break;
-        case 070: // DSLL (Doubleword Shift Left Logical)
-            _regs[RD].u64 = _regs[RT].u64 << SA;
-            break;
-        case 072: // DSRL (Doubleword Shift Right Logical)
-            _regs[RD].u64 = _regs[RT].u64 >> SA;
-            break;
-        case 073: // DSRA (Doubleword Shift Right Arithmetic)
-            _regs[RD].i64 = _regs[RT].i64 >> SA;
-            break;
-        case 074: // DSLL32 (Doubleword Shift Left Logical + 32)
-            _regs[RD].u64 = _regs[RT].u64 << (32 + SA);
-            break;
-        case 076: // DSRL32 (Doubleword Shift Right Logical + 32)
-            _regs[RD].u64 = _regs[RT].u64 >> (32 + SA);
+            reads  = (1u << RS) | (1u << RT);
+            writes = (1u << RD);
+            return true;
+        }
+        return false;
+    case 001: // REGIMM
+        if (RT > 003)
+            return false;
+        reads = (1u << RS);
+        return true;
+    case 002: // J
+        return true;
+    case 004: // BEQ
+    case 005: // BNE
+    case 024: // BEQL
+    case 025: // BNEL
+        reads = (1u << RS) | (1u << RT);
+        return true;
+    case 006: // BLEZ
+    case 007: // BGTZ
+    case 026: // BLEZL
+    case 027: // BGTZL
+        reads = (1u << RS);
+        return true;
+    case 017: // LUI
+        writes = (1u << RT);
+        return true;
+    case 010: // ADDI
+    case 011: // ADDIU
+    case 012: // SLTI
+    case 013: // SLTIU
+    case 014: // ANDI
+    case 015: // ORI
+    case 016: // XORI
+    case 030: // DADDI
+    case 031: // DADDIU
+    case 040: // LB
+    case 041: // LH
+    case 043: // LW
+    case 044: // LBU
+    case 045: // LHU
+    case 047: // LWU
+    case 067: // LD
+        reads  = (1u << RS);
+        writes = (1u << RT);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * A loop is idle when it branches back to its own start, does not store,
+ * and carries no register from one iteration to the next: every iteration
+ * then computes the same thing until an event changes memory or MMIO state.
+ */
+bool CPU::idleLoop(std::uint32_t addr, const Instr* instrs, std::size_t size)
+{
+    std::uint32_t branchAddr;
+    std::uint32_t reads;
+    std::uint32_t writes;
+    std::uint32_t written;
+    std::uint32_t carried;
+
+    if (size < 2 || blockEnd(instrs[size - 2].op) != 1)
+        return false;
+
+    const Instr& instr = instrs[size - 2];
+    branchAddr         = addr + (std::uint32_t)(size - 2) * 4;
+    switch (instr.op >> 26)
+    {
+    case 002: // J
+        if ((JUMP_TARGET << 2) != (addr & 0x0fffffff))
+            return false;
+        break;
+    case 003: // JAL
+    case 021: // COP1
+        return false;
+    default:
+        if (branchAddr + 4 + ((std::int32_t)SIMM << 2) != addr)
+            return false;
+        break;
+    }
+
+    written = 0;
+    carried = 0;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        if (!idleInstr(instrs[i], reads, writes))
+            return false;
+        carried |= reads & ~written;
+        written |= writes;
+    }
+    return !(carried & written & ~1u);
+}
+
+void CPU::execute(const Block& block)
+{
+    std::uint64_t pc;
+
+    /* Leave as soon as control flow goes anywhere but the next instruction */
+    pc = _pc;
+    for (std::uint32_t i = 0; i < block.size; ++i)
+    {
+        pc += 4;
+        step(block.instrs[i]);
+        if (_pc != pc)
             break;
-        case 077: // DSRA32 (Doubleword Shift Right Arithmetic + 32)
-            _regs[RD].i64 = _regs[RT].i64 >> (32 + SA);
+    }
+}
+
+/*
+ * AI_LEN counts down with the clock, so a loop polling it sees a new value
+ * every iteration and must not be skipped. Registers the loop reads before
+ * writing never change in it, so its load addresses follow from their values
+ * now and the constants the loop builds; any other base is assumed to hit it.
+ */
+bool CPU::idleReadsClock(const Block& block) const
+{
+    std::uint64_t values[32];
+    std::uint32_t known;
+    std::uint32_t reads;
+    std::uint32_t writes;
+    std::uint32_t addr;
+
+    for (std::size_t i = 0; i < 32; ++i)
+        values[i] = _regs[i].u64;
+    known = ~0u;
+
+    for (std::uint32_t i = 0; i < block.size; ++i)
+    {
+        const Instr& instr    = block.instrs[i];
+        bool         constant = true;
+
+        idleInstr(instr, reads, writes);
+        switch (instr.op >> 26)
+        {
+        case 017: // LUI
+            values[RT] = (std::uint64_t)((std::int64_t)SIMM << 16);
+            break;
+        case 011: // ADDIU
+            constant   = known & (1u << RS);
+            values[RT] = (std::uint64_t)(std::int32_t)((std::uint32_t)values[RS] + SIMM);
+            break;
+        case 031: // DADDIU
+            constant   = known & (1u << RS);
+            values[RT] = values[RS] + SIMM;
+            break;
+        case 015: // ORI
+            constant   = known & (1u << RS);
+            values[RT] = values[RS] | IMM;
+            break;
+        case 040: // LB
+        case 041: // LH
+        case 043: // LW
+        case 044: // LBU
+        case 045: // LHU
+        case 047: // LWU
+        case 067: // LD
+            if (!(known & (1u << RS)))
+                return true;
+            addr = (std::uint32_t)(values[RS] + SIMM);
+            if ((addr & 0xc0000000) == 0x80000000 && (addr & 0x1ff00000) == 0x04500000)
+                return true;
+            constant = false;
             break;
         default:
-            NOT_IMPLEMENTED();
+            constant = false;
             break;
         }
+
+        values[0] = 0;
+        known     = constant ? (known | writes) : (known & ~(writes & ~1u));
+    }
+    return false;
+}
+
+/* Whole iterations only, of the length the last one took, so the loop ends up exactly where it would have */
+void CPU::skipIdle(std::uint64_t iteration, std::uint64_t until)
+{
+    std::uint64_t target;
+    std::uint64_t skip;
+
+    target = std::min(until, _scheduler.deadline());
+    if (target <= _scheduler.now())
+        return;
+    skip = ((target - _scheduler.now()) / iteration) * iteration;
+    _scheduler.advance(skip);
+}
+
+template <bool kCached> void CPU::predecode(Instr& instr, std::uint32_t op)
+{
+    instr.handler = decode<kCached>(op);
+    instr.op      = op;
+    instr.rs      = (std::uint8_t)((op >> 21) & 0x1f);
+    instr.rt      = (std::uint8_t)((op >> 16) & 0x1f);
+    instr.rd      = (std::uint8_t)((op >> 11) & 0x1f);
+    instr.sa      = (std::uint8_t)((op >> 6) & 0x1f);
+    instr.imm     = (std::uint16_t)op;
+    instr.cycles  = Timing::instrCycles(op);
+}
+
+#define HANDLER(...) (&CPU::handler<&CPU::__VA_ARGS__>)
+#define UNIMPL       HANDLER(opUnimplemented)
+
+/* COP1 arithmetic, by format (S, D, W and L) and function */
+const InstrHandler CPU::kCop1Handlers[4][64] = {
+    {
+        HANDLER(opFADD<float>), HANDLER(opFSUB<float>), HANDLER(opFMUL<float>), HANDLER(opFDIV<float>), HANDLER(opFSQRT<float>), HANDLER(opFABS<float>), HANDLER(opFMOV<float>), HANDLER(opFNEG<float>),
+        HANDLER(opFTOI<float, std::int64_t, 0>), HANDLER(opFTOI<float, std::int64_t, 1>), HANDLER(opFTOI<float, std::int64_t, 2>), HANDLER(opFTOI<float, std::int64_t, 3>),
+        HANDLER(opFTOI<float, std::int32_t, 0>), HANDLER(opFTOI<float, std::int32_t, 1>), HANDLER(opFTOI<float, std::int32_t, 2>), HANDLER(opFTOI<float, std::int32_t, 3>),
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, HANDLER(opFCVT<double, float>), UNIMPL, UNIMPL, HANDLER(opFTOI<float, std::int32_t, -1>), HANDLER(opFTOI<float, std::int64_t, -1>), UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        HANDLER(opFC<float>), HANDLER(opFC<float>), HANDLER(opFC<float>), HANDLER(opFC<float>), HANDLER(opFC<float>), HANDLER(opFC<float>), HANDLER(opFC<float>), HANDLER(opFC<float>),
+        HANDLER(opFC<float>), HANDLER(opFC<float>), HANDLER(opFC<float>), HANDLER(opFC<float>), HANDLER(opFC<float>), HANDLER(opFC<float>), HANDLER(opFC<float>), HANDLER(opFC<float>),
+    },
+    {
+        HANDLER(opFADD<double>), HANDLER(opFSUB<double>), HANDLER(opFMUL<double>), HANDLER(opFDIV<double>), HANDLER(opFSQRT<double>), HANDLER(opFABS<double>), HANDLER(opFMOV<double>), HANDLER(opFNEG<double>),
+        HANDLER(opFTOI<double, std::int64_t, 0>), HANDLER(opFTOI<double, std::int64_t, 1>), HANDLER(opFTOI<double, std::int64_t, 2>), HANDLER(opFTOI<double, std::int64_t, 3>),
+        HANDLER(opFTOI<double, std::int32_t, 0>), HANDLER(opFTOI<double, std::int32_t, 1>), HANDLER(opFTOI<double, std::int32_t, 2>), HANDLER(opFTOI<double, std::int32_t, 3>),
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        HANDLER(opFCVT<float, double>), UNIMPL, UNIMPL, UNIMPL, HANDLER(opFTOI<double, std::int32_t, -1>), HANDLER(opFTOI<double, std::int64_t, -1>), UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        HANDLER(opFC<double>), HANDLER(opFC<double>), HANDLER(opFC<double>), HANDLER(opFC<double>), HANDLER(opFC<double>), HANDLER(opFC<double>), HANDLER(opFC<double>), HANDLER(opFC<double>),
+        HANDLER(opFC<double>), HANDLER(opFC<double>), HANDLER(opFC<double>), HANDLER(opFC<double>), HANDLER(opFC<double>), HANDLER(opFC<double>), HANDLER(opFC<double>), HANDLER(opFC<double>),
+    },
+    {
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        HANDLER(opFCVT<float, std::int32_t>), HANDLER(opFCVT<double, std::int32_t>), UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+    },
+    {
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        HANDLER(opFCVT<float, std::int64_t>), HANDLER(opFCVT<double, std::int64_t>), UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+        UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL, UNIMPL,
+    },
+};
+
+template <bool kCached> InstrHandler CPU::decode(std::uint32_t op)
+{
+    switch (op >> 26)
+    {
+    case 000: // SPECIAL
+        switch (op & 0x3f)
+        {
+        case 000: return HANDLER(opSLL);
+        case 002: return HANDLER(opSRL);
+        case 003: return HANDLER(opSRA);
+        case 004: return HANDLER(opSLLV);
+        case 006: return HANDLER(opSRLV);
+        case 007: return HANDLER(opSRAV);
+        case 010: return HANDLER(opJR);
+        case 011: return HANDLER(opJALR);
+        case 020: return HANDLER(opMFHI);
+        case 021: return HANDLER(opMTHI);
+        case 022: return HANDLER(opMFLO);
+        case 023: return HANDLER(opMTLO);
+        case 030: return HANDLER(opMULT);
+        case 031: return HANDLER(opMULTU);
+        case 032: return HANDLER(opDIV);
+        case 033: return HANDLER(opDIVU);
+        case 034: return HANDLER(opDMULT);
+        case 035: return HANDLER(opDMULTU);
+        case 036: return HANDLER(opDDIV);
+        case 037: return HANDLER(opDDIVU);
+        case 040: return HANDLER(opADDU); // ADD
+        case 041: return HANDLER(opADDU);
+        case 042: return HANDLER(opSUBU); // SUB
+        case 043: return HANDLER(opSUBU);
+        case 044: return HANDLER(opAND);
+        case 045: return HANDLER(opOR);
+        case 046: return HANDLER(opXOR);
+        case 047: return HANDLER(opNOR);
+        case 052: return HANDLER(opSLT);
+        case 053: return HANDLER(opSLTU);
+        case 054: return HANDLER(opDADDU); // DADD
+        case 055: return HANDLER(opDADDU);
+        case 056: return HANDLER(opDSUBU); // DSUB
+        case 057: return HANDLER(opDSUBU);
+        case 070: return HANDLER(opDSLL);
+        case 072: return HANDLER(opDSRL);
+        case 073: return HANDLER(opDSRA);
+        case 074: return HANDLER(opDSLL32);
+        case 076: return HANDLER(opDSRL32);
+        case 077: return HANDLER(opDSRA32);
+        }
         break;
     case 001: // REGIMM
-        switch (RT)
+        switch ((op >> 16) & 0x1f)
         {
-        case 000: // BLTZ
-            if (_regs[RS].i64 < 0)
-            {
-                _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-                _branchDelay = true;
-            }
-            break;
-        case 001: // BGEZ
-            if (_regs[RS].i64 >= 0)
-            {
-                _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-                _branchDelay = true;
-            }
-            break;
-        case 002: // BLTZL
-            if (_regs[RS].i64 < 0)
-            {
-                _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-                _branchDelay = true;
-            }
-            else
-            {
-                _pc = _pcNext;
-                _pcNext += 4;
-            }
-            break;
-        case 003: // BGEZL (Branch On Greater Than Or Equal To Zero Likely)
-            if (_regs[RS].i64 >= 0)
-            {
-                _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-                _branchDelay = true;
-            }
-            else
-            {
-                _pc = _pcNext;
-                _pcNext += 4;
-            }
-            break;
-        case 010: // TGEI
-            NOT_IMPLEMENTED();
-            break;
-        case 011: // TGEIU
-            NOT_IMPLEMENTED();
-            break;
-        case 012: // TLTI
-            NOT_IMPLEMENTED();
-            break;
-        case 013: // TLTIU
-            NOT_IMPLEMENTED();
-            break;
-        case 014: // TEQI
-            NOT_IMPLEMENTED();
-            break;
-        case 016: // TNEI
-            NOT_IMPLEMENTED();
-            break;
-        case 020: // BLTZAL (Branch On Less Than Zero And Link Likely)
-            _regs[31].u64 = _pc + 4;
-            if (_regs[RS].i64 < 0)
-            {
-                _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-                _branchDelay = true;
-            }
-            break;
-        case 021: // BGEZAL (Branch On Greater Than Or Equal To Zero And Link Likely)
-            _regs[31].u64 = _pc + 4;
-            if (_regs[RS].i64 >= 0)
-            {
-                _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-                _branchDelay = true;
-            }
-            break;
-        case 022: // BLTZALL
-            _regs[31].u64 = _pc + 4;
-            if (_regs[RS].i64 < 0)
-            {
-                _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-                _branchDelay = true;
-            }
-            else
-            {
-                _pc = _pcNext;
-                _pcNext += 4;
-            }
-            break;
-        case 023: // BGEZALL
-            _regs[31].u64 = _pc + 4;
-            if (_regs[RS].i64 >= 0)
-            {
-                _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-                _branchDelay = true;
-            }
-            else
-            {
-                _pc = _pcNext;
-                _pcNext += 4;
-            }
+        case 000: return HANDLER(opBLTZ);
+        case 001: return HANDLER(opBGEZ);
+        case 002: return HANDLER(opBLTZL);
+        case 003: return HANDLER(opBGEZL);
+        case 020: return HANDLER(opBLTZAL);
+        case 021: return HANDLER(opBGEZAL);
+        case 022: return HANDLER(opBLTZALL);
+        case 023: return HANDLER(opBGEZALL);
+        }
+        break;
+    case 002: return HANDLER(opJ);
+    case 003: return HANDLER(opJAL);
+    case 004: return HANDLER(opBEQ);
+    case 005: return HANDLER(opBNE);
+    case 006: return HANDLER(opBLEZ);
+    case 007: return HANDLER(opBGTZ);
+    case 010: return HANDLER(opADDIU); // ADDI
+    case 011: return HANDLER(opADDIU);
+    case 012: return HANDLER(opSLTI);
+    case 013: return HANDLER(opSLTIU);
+    case 014: return HANDLER(opANDI);
+    case 015: return HANDLER(opORI);
+    case 016: return HANDLER(opXORI);
+    case 017: return HANDLER(opLUI);
+    case 020: // COP0
+        switch ((op >> 21) & 0x1f)
+        {
+        case 000: return HANDLER(opMFC0);
+        case 001: return HANDLER(opDMFC0);
+        case 004: return HANDLER(opMTC0);
+        case 005: return HANDLER(opMTC0); // DMT
+        case 002: // CF
+        case 006: // CT
+        case 010: // BC
             break;
         default:
-            NOT_IMPLEMENTED();
-            break;
-        }
-        break;
-    case 002: // J (Jump)
-        _pcNext      = ((std::uint64_t)JUMP_TARGET << 2) | (_pc & 0xfffffffff0000000ULL);
-        _branchDelay = true;
-        break;
-    case 003: // JAL (Jump And Link)
-        _pcNext       = ((std::uint64_t)JUMP_TARGET << 2) | (_pc & 0xfffffffff0000000ULL);
-        _branchDelay  = true;
-        _regs[31].u64 = _pc + 4;
-        break;
-    case 004: // BEQ
-        if (_regs[RS].u64 == _regs[RT].u64)
-        {
-            _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-            _branchDelay = true;
-        }
-        break;
-    case 005: // BNE
-        if (_regs[RS].u64 != _regs[RT].u64)
-        {
-            _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-            _branchDelay = true;
-        }
-        break;
-    case 006: // BLEZ
-        if (_regs[RS].i64 <= 0)
-        {
-            _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-            _branchDelay = true;
-        }
-        break;
-    case 007: // BGTZ
-        if (_regs[RS].i64 > 0)
-        {
-            _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-            _branchDelay = true;
-        }
-        break;
-    case 010: // ADDI (Add Immediate)
-        _regs[RT].i64 = (_regs[RS].i32 + SIMM);
-        break;
-    case 011: // ADDIU (Add Immediate Unsigned)
-        _regs[RT].i64 = (_regs[RS].i32 + SIMM);
-        break;
-    case 012: // SLTI (Set On Less Than Immediate)
-        _regs[RT].u64 = (_regs[RS].i64 < SIMM) ? 1 : 0;
-        break;
-    case 013: // SLTIU (Set On Less Than Immediate Unsigned)
-        _regs[RT].u64 = (_regs[RS].u64 < (std::uint64_t)((std::int64_t)SIMM)) ? 1 : 0;
-        break;
-    case 014: // ANDI (And Immediate)
-        _regs[RT].u64 = _regs[RS].u64 & IMM;
-        break;
-    case 015: // ORI (Or Immediate)
-        _regs[RT].u64 = _regs[RS].u64 | IMM;
-        break;
-    case 016: // XORI (Exclusive Or Immediate)
-        _regs[RT].u64 = _regs[RS].u64 ^ IMM;
-        break;
-    case 017: // LUI (Load Upper Immediate)
-        _regs[RT].i64 = ((std::int64_t)SIMM << 16);
-        break;
-    case 020: // COP0 (Coprocessor 0)
-        switch (RS)
-        {
-        case 000: // MF
-            _regs[RT].i64 = (std::int32_t)cop0Read(RD);
-            break;
-        case 001: // DMF
-            _regs[RT].u64 = cop0Read(RD);
-            break;
-        case 002: // CF
-            NOT_IMPLEMENTED();
-            break;
-        case 004: // MT
-            cop0Write(RD, _regs[RT].u32);
-            break;
-        case 005: // DMT
-            cop0Write(RD, _regs[RT].u32);
-            break;
-        case 006: // CT
-            NOT_IMPLEMENTED();
-            break;
-        case 010: // BC
-            NOT_IMPLEMENTED();
-            break;
-        case 020:
-        case 021:
-        case 022:
-        case 023:
-        case 024:
-        case 025:
-        case 026:
-        case 027:
-        case 030:
-        case 031:
-        case 032:
-        case 033:
-        case 034:
-        case 035:
-        case 036:
-        case 037:
+            if (!(op & (1 << 25)))
+                break;
             switch (op & 077)
             {
-            case 001: // TLBR
-                // To implement when doing TLB
-                break;
-            case 002: // TLBWI
-                // To implement when doing TLB
-                break;
-            case 006: // TLBWR
-                // To implement when doing TLB
-                break;
-            case 010: // TLBP
-                // To implement when doing TLB
-                break;
-            case 030: // ERET
-                if (_erl)
-                {
-                    _pc  = (std::int64_t)((std::int32_t)_errorEpc);
-                    _erl = false;
-                    std::printf("ERET: ErrorEPC\n");
-                }
-                else
-                {
-                    _pc  = (std::int64_t)((std::int32_t)_epc);
-                    _exl = false;
-                    std::printf("ERET: EPC\n");
-                }
-                _llBit  = false;
-                _pcNext = _pc + 4;
-                break;
+            case 001: return HANDLER(opTLBR);
+            case 002: return HANDLER(opTLBWI);
+            case 006: return HANDLER(opTLBWR);
+            case 010: return HANDLER(opTLBP);
+            case 030: return HANDLER(opERET);
             }
-            break;
+            return HANDLER(opNop);
         }
         break;
-    case 021: // COP1 (Coprocessor 1)
-        switch (RS)
+    case 021: // COP1
+        switch ((op >> 21) & 0x1f)
         {
-        case 000: // MFC1 (Move Word From FPU)
-            _regs[RT].u32 = fpuReadU32(FS);
-            break;
-        case 001: // DMFC1 (Doubleword Move From FPU)
-            _regs[RT].u64 = fpuReadU64(FS);
-            break;
-        case 002: // CFC1 (Move Control From FPU)
-            _regs[RT].i64 = (std::int32_t)fcrRead(FS);
-            break;
-        case 004: // MTC1 (Move To FPU)
-            fpuWriteU32(FS, _regs[RT].u32);
-            break;
-        case 005: // DMTC1 (Doubleword Move To FPU)
-            fpuWriteU64(FS, _regs[RT].u64);
-            break;
-        case 006: // CTC1 (Move Control Word To FPU)
-            fcrWrite(FS, _regs[RT].u32);
-            break;
+        case 000: return HANDLER(opMFC1);
+        case 001: return HANDLER(opDMFC1);
+        case 002: return HANDLER(opCFC1);
+        case 004: return HANDLER(opMTC1);
+        case 005: return HANDLER(opDMTC1);
+        case 006: return HANDLER(opCTC1);
         case 010: // BC
-            switch (RT)
+            switch ((op >> 16) & 0x1f)
             {
-            case 000: // BCF
-                if (!_fpCompare)
-                {
-                    _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-                    _branchDelay = true;
-                }
-                break;
-            case 001: // BCT
-                if (_fpCompare)
-                {
-                    _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-                    _branchDelay = true;
-                }
-                break;
-            case 002: // BCFL
-                if (!_fpCompare)
-                {
-                    _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-                    _branchDelay = true;
-                }
-                else
-                {
-                    _pc = _pcNext;
-                    _pcNext += 4;
-                }
-                break;
-            case 003: // BCTL
-                if (_fpCompare)
-                {
-                    _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-                    _branchDelay = true;
-                }
-                else
-                {
-                    _pc = _pcNext;
-                    _pcNext += 4;
-                }
-                break;
-            default:
-                NOT_IMPLEMENTED();
-                break;
+            case 000: return HANDLER(opBC1F);
+            case 001: return HANDLER(opBC1T);
+            case 002: return HANDLER(opBC1FL);
+            case 003: return HANDLER(opBC1TL);
             }
             break;
-        case 020:
-        case 021:
-        case 022:
-        case 023:
-        case 024:
-        case 025:
-        case 026:
-        case 027:
-        case 030:
-        case 031:
-        case 032:
-        case 033:
-        case 034:
-        case 035:
-        case 036:
-        case 037: // CO
-            /*
-             * FMT values:
-             * 0x10
-             */
-            switch (((std::uint16_t)FMT << 6) | (op & 0x77))
-            {
-            // 00: ADD.fmt
-            case FMT_S | 000: // ADD.S
-                fpuWriteF32(FD, fpuReadF32(FS) + fpuReadF32(FT));
-                break;
-            case FMT_D | 000: // ADD.D
-                fpuWriteF64(FD, fpuReadF64(FS) + fpuReadF64(FT));
-                break;
+        case 020: return kCop1Handlers[0][op & 077]; // S
+        case 021: return kCop1Handlers[1][op & 077]; // D
+        case 024: return kCop1Handlers[2][op & 077]; // W
+        case 025: return kCop1Handlers[3][op & 077]; // L
+        }
+        break;
+    case 024: return HANDLER(opBEQL);
+    case 025: return HANDLER(opBNEL);
+    case 026: return HANDLER(opBLEZL);
+    case 027: return HANDLER(opBGTZL);
+    case 030: return HANDLER(opDADDIU); // DADDI
+    case 031: return HANDLER(opDADDIU);
+    case 033: return HANDLER(opLDR<kCached>);
+    case 040: return HANDLER(opLB<kCached>);
+    case 041: return HANDLER(opLH<kCached>);
+    case 042: return HANDLER(opLWL<kCached>);
+    case 043: return HANDLER(opLW<kCached>);
+    case 044: return HANDLER(opLBU<kCached>);
+    case 045: return HANDLER(opLHU<kCached>);
+    case 046: return HANDLER(opLWR<kCached>);
+    case 047: return HANDLER(opLWU<kCached>);
+    case 050: return HANDLER(opSB<kCached>);
+    case 051: return HANDLER(opSH<kCached>);
+    case 052: return HANDLER(opSWL<kCached>);
+    case 053: return HANDLER(opSW<kCached>);
+    case 056: return HANDLER(opSWR<kCached>);
+    case 057: return kCached ? HANDLER(opCACHE) : HANDLER(opNop);
+    case 060: return HANDLER(opLL<kCached>);
+    case 061: return HANDLER(opLWC1<kCached>);
+    case 065: return HANDLER(opLDC1<kCached>);
+    case 067: return HANDLER(opLD<kCached>);
+    case 071: return HANDLER(opSWC1<kCached>);
+    case 075: return HANDLER(opSDC1<kCached>);
+    case 077: return HANDLER(opSD<kCached>);
+    }
 
-            // 01: SUB.fmt
-            case FMT_S | 001: // SUB.S
-                fpuWriteF32(FD, fpuReadF32(FS) - fpuReadF32(FT));
-                break;
-            case FMT_D | 001: // SUB.D
-                fpuWriteF64(FD, fpuReadF64(FS) - fpuReadF64(FT));
-                break;
+    return HANDLER(opUnimplemented);
+}
 
-            // 02: MUL.fmt
-            case FMT_S | 002: // MUL.S
-                fpuWriteF32(FD, fpuReadF32(FS) * fpuReadF32(FT));
-                break;
-            case FMT_D | 002: // MUL.D
-                fpuWriteF64(FD, fpuReadF64(FS) * fpuReadF64(FT));
-                break;
+#undef UNIMPL
+#undef HANDLER
 
-            // 03: DIV.fmt
-            case FMT_S | 003: // DIV.S
-                fpuWriteF32(FD, fpuReadF32(FS) / fpuReadF32(FT));
-                break;
-            case FMT_D | 003: // DIV.D
-                fpuWriteF64(FD, fpuReadF64(FS) / fpuReadF64(FT));
-                break;
+void CPU::branch(const Instr& instr, bool taken)
+{
+    if (taken)
+    {
+        _pcNext      = _pc + ((std::int64_t)SIMM << 2);
+        _branchDelay = true;
+    }
+}
 
-            // 04: SQRT.fmt
-            case FMT_S | 004: // SQRT.S
-                fpuWriteF32(FD, std::sqrtf(fpuReadF32(FS)));
-                break;
-            case FMT_D | 004: // SQRT.D
-                fpuWriteF64(FD, std::sqrt(fpuReadF64(FS)));
-                break;
+void CPU::branchLikely(const Instr& instr, bool taken)
+{
+    if (taken)
+    {
+        _pcNext      = _pc + ((std::int64_t)SIMM << 2);
+        _branchDelay = true;
+    }
+    else
+    {
+        _pc = _pcNext;
+        _pcNext += 4;
+    }
+}
 
-            // 05: ABS.fmt
-            case FMT_S | 005: // ABS.S
-                fpuWriteF32(FD, std::fabs(fpuReadF32(FS)));
-                break;
-            case FMT_D | 005: // ABS.D
-                fpuWriteF64(FD, std::abs(fpuReadF64(FS)));
-                break;
+void CPU::opUnimplemented(const Instr& instr)
+{
+    NOT_IMPLEMENTED();
+}
 
-            // 06: MOV.fmt
-            case FMT_S | 006:
-                fpuWriteF32(FD, fpuReadF32(FS));
-                break;
-            case FMT_D | 006:
-                fpuWriteF64(FD, fpuReadF64(FS));
-                break;
+void CPU::opNop(const Instr&)
+{
+}
 
-            // 07: NEG
-            case FMT_S | 007:
-                fpuWriteF32(FD, -fpuReadF32(FS));
-                break;
-            case FMT_D | 007:
-                fpuWriteF64(FD, -fpuReadF64(FS));
-                break;
+/*
+ * SPECIAL
+ */
 
-            // 10: ROUND.L
-            case FMT_S | 010:
-                fpuWriteU64(FD, StoL(std::roundf(fpuReadF32(FS))));
-                break;
-            case FMT_D | 010:
-                fpuWriteU64(FD, DtoL(std::round(fpuReadF64(FS))));
-                break;
+void CPU::opSLL(const Instr& instr)
+{
+    _regs[RD].i64 = (std::int32_t)((_regs[RT].u32 << SA) & 0xffffffff);
+}
 
-            // 11: TRUNC.L
-            case FMT_S | 011:
-                fpuWriteU64(FD, StoL(std::truncf(fpuReadF32(FS))));
-                break;
-            case FMT_D | 011:
-                fpuWriteU64(FD, DtoL(std::trunc(fpuReadF64(FS))));
-                break;
+void CPU::opSRL(const Instr& instr)
+{
+    _regs[RD].i64 = (std::int32_t)((_regs[RT].u32 >> SA) & 0xffffffff);
+}
 
-            // 12: CEIL.L
-            case FMT_S | 012:
-                fpuWriteU64(FD, StoL(std::ceilf(fpuReadF32(FS))));
-                break;
-            case FMT_D | 012:
-                fpuWriteU64(FD, DtoL(std::ceil(fpuReadF64(FS))));
-                break;
+void CPU::opSRA(const Instr& instr)
+{
+    _regs[RD].i64 = (std::int32_t)((_regs[RT].i32 >> SA) & 0xffffffff);
+}
 
-            // 13: FLOOR.L
-            case FMT_S | 013:
-                fpuWriteU64(FD, StoL(std::floorf(fpuReadF32(FS))));
-                break;
-            case FMT_D | 013:
-                fpuWriteU64(FD, DtoL(std::floor(fpuReadF64(FS))));
-                break;
+void CPU::opSLLV(const Instr& instr)
+{
+    _regs[RD].i64 = (std::int32_t)((_regs[RT].u32 << (_regs[RS].u8 & 0x1f)) & 0xffffffff);
+}
 
-            // 14: ROUND.W
-            case FMT_S | 014:
-                fpuWriteU32(FD, StoW(std::roundf(fpuReadF32(FS))));
-                break;
-            case FMT_D | 014:
-                fpuWriteU32(FD, DtoW(std::round(fpuReadF64(FS))));
-                break;
+void CPU::opSRLV(const Instr& instr)
+{
+    _regs[RD].i64 = (std::int32_t)((_regs[RT].u32 >> (_regs[RS].u8 & 0x1f)) & 0xffffffff);
+}
 
-            // 15: TRUNC.W
-            case FMT_S | 015:
-                fpuWriteU32(FD, StoW(std::truncf(fpuReadF32(FS))));
-                break;
-            case FMT_D | 015:
-                fpuWriteU32(FD, DtoW(std::trunc(fpuReadF64(FS))));
-                break;
+void CPU::opSRAV(const Instr& instr)
+{
+    _regs[RD].i64 = (std::int32_t)((_regs[RT].i32 >> (_regs[RS].u8 & 0x1f)) & 0xffffffff);
+}
 
-            // 16: CEIL.W
-            case FMT_S | 016:
-                fpuWriteU32(FD, StoW(std::ceilf(fpuReadF32(FS))));
-                break;
-            case FMT_D | 016:
-                fpuWriteU32(FD, DtoW(std::ceil(fpuReadF64(FS))));
-                break;
+void CPU::opJR(const Instr& instr)
+{
+    _pcNext      = _regs[RS].u64;
+    _branchDelay = true;
+}
 
-            // 17: FLOOR.W
-            case FMT_S | 017:
-                fpuWriteU32(FD, StoW(std::floorf(fpuReadF32(FS))));
-                break;
-            case FMT_D | 017:
-                fpuWriteU32(FD, DtoW(std::floor(fpuReadF64(FS))));
-                break;
+void CPU::opJALR(const Instr& instr)
+{
+    _pcNext       = _regs[RS].u64;
+    _branchDelay  = true;
+    _regs[RD].u64 = _pc + 4;
+}
 
-            // 40: CVT.S
-            case FMT_D | 040:
-                fpuWriteF32(FD, (float)fpuReadF64(FS));
-                break;
-            case FMT_W | 040:
-                fpuWriteF32(FD, WtoS(fpuReadU32(FS)));
-                break;
-            case FMT_L | 040:
-                fpuWriteF32(FD, LtoS(fpuReadU64(FS)));
-                break;
+void CPU::opMFHI(const Instr& instr)
+{
+    _regs[RD].u64 = _hi.u64;
+}
 
-            // 41: CVT.D
-            case FMT_S | 041:
-                fpuWriteF64(FD, (double)fpuReadF32(FS));
-                break;
-            case FMT_W | 041:
-                fpuWriteF64(FD, WtoD(fpuReadU32(FS)));
-                break;
-            case FMT_L | 041:
-                fpuWriteF64(FD, LtoD(fpuReadU64(FS)));
-                break;
+void CPU::opMTHI(const Instr& instr)
+{
+    _hi.u64 = _regs[RS].u64;
+}
 
-            // 44: CVT.W
-            case FMT_S | 044:
-                fpuWriteU32(FD, StoW(fpuReadF32(FS)));
-                break;
-            case FMT_D | 044:
-                fpuWriteU32(FD, DtoW(fpuReadF64(FS)));
-                break;
+void CPU::opMFLO(const Instr& instr)
+{
+    _regs[RD].u64 = _lo.u64;
+}
 
-            // 45: CVT.L
-            case FMT_S | 045:
-                fpuWriteU64(FD, StoL(fpuReadF32(FS)));
-                break;
-            case FMT_D | 045:
-                fpuWriteU64(FD, DtoL(fpuReadF64(FS)));
-                break;
+void CPU::opMTLO(const Instr& instr)
+{
+    _lo.u64 = _regs[RS].u64;
+}
 
-            // C.cond.fmt (Floating-point Compare)
+void CPU::opMULT(const Instr& instr)
+{
+    std::uint64_t tmp;
 
-            // 60: C.F
-            case FMT_S | 060:
-                _fpCompare = false;
-                break;
-            case FMT_D | 060:
-                _fpCompare = false;
-                break;
+    tmp     = (std::int64_t)_regs[RS].i32 * _regs[RT].i32;
+    _lo.i64 = (std::int32_t)(tmp & 0xffffffff);
+    _hi.i64 = (std::int32_t)((tmp >> 32) & 0xffffffff);
+}
 
-            // 61: C.UN
-            case FMT_S | 061:
-                _fpCompare = (std::isnan(fpuReadF32(FS)) || std::isnan(fpuReadF32(FT)));
-                break;
-            case FMT_D | 061:
-                _fpCompare = (std::isnan(fpuReadF64(FS)) || std::isnan(fpuReadF64(FT)));
-                break;
+void CPU::opMULTU(const Instr& instr)
+{
+    std::uint64_t tmp;
 
-            // 62: C.EQ
-            case FMT_S | 062:
-                _fpCompare = (fpuReadF32(FS) == fpuReadF32(FT));
-                break;
-            case FMT_D | 062:
-                _fpCompare = (fpuReadF64(FS) == fpuReadF64(FT));
-                break;
+    tmp     = (std::uint64_t)_regs[RS].u32 * _regs[RT].u32;
+    _lo.i64 = (std::int32_t)(tmp & 0xffffffff);
+    _hi.i64 = (std::int32_t)((tmp >> 32) & 0xffffffff);
+}
 
-            // 63: C.UEQ
-            case FMT_S | 063:
-                _fpCompare = (std::isnan(fpuReadF32(FS)) || std::isnan(fpuReadF32(FT)) || (fpuReadF32(FS) == fpuReadF32(FT)));
-                break;
-            case FMT_D | 063:
-                _fpCompare = (std::isnan(fpuReadF64(FS)) || std::isnan(fpuReadF64(FT)) || (fpuReadF64(FS) == fpuReadF64(FT)));
-                break;
+void CPU::opDIV(const Instr& instr)
+{
+    _lo.i64 = _regs[RS].i32 / _regs[RT].i32;
+    _hi.i64 = _regs[RS].i32 % _regs[RT].i32;
+}
 
-            // 64: C.OLT
-            case FMT_S | 064:
-                _fpCompare = (fpuReadF32(FS) < fpuReadF32(FT));
-                break;
-            case FMT_D | 064:
-                _fpCompare = (fpuReadF64(FS) < fpuReadF64(FT));
-                break;
+void CPU::opDIVU(const Instr& instr)
+{
+    _lo.u64 = _regs[RS].u32 / _regs[RT].u32;
+    _hi.u64 = _regs[RS].u32 % _regs[RT].u32;
+}
 
-            // 65: C.ULT
-            case FMT_S | 065:
-                _fpCompare = (std::isnan(fpuReadF32(FS)) || std::isnan(fpuReadF32(FT)) || (fpuReadF32(FS) < fpuReadF32(FT)));
-                break;
-            case FMT_D | 065:
-                _fpCompare = (std::isnan(fpuReadF64(FS)) || std::isnan(fpuReadF64(FT)) || (fpuReadF64(FS) < fpuReadF64(FT)));
-                break;
+void CPU::opDMULT(const Instr& instr)
+{
+    mul128(_regs[RS].i64, _regs[RT].i64, &_lo.i64, &_hi.i64);
+}
 
-            // 66: C.OLE
-            case FMT_S | 066:
-                _fpCompare = (fpuReadF32(FS) <= fpuReadF32(FT));
-                break;
-            case FMT_D | 066:
-                _fpCompare = (fpuReadF64(FS) <= fpuReadF64(FT));
-                break;
+void CPU::opDMULTU(const Instr& instr)
+{
+    umul128(_regs[RS].u64, _regs[RT].u64, &_lo.u64, &_hi.u64);
+}
 
-            // 67: C.ULE
-            case FMT_S | 067:
-                _fpCompare = (std::isnan(fpuReadF32(FS)) || std::isnan(fpuReadF32(FT)) || (fpuReadF32(FS) <= fpuReadF32(FT)));
-                break;
-            case FMT_D | 067:
-                _fpCompare = (std::isnan(fpuReadF64(FS)) || std::isnan(fpuReadF64(FT)) || (fpuReadF64(FS) <= fpuReadF64(FT)));
-                break;
+void CPU::opDDIV(const Instr& instr)
+{
+    _lo.i64 = _regs[RS].i64 / _regs[RT].i64;
+    _hi.i64 = _regs[RS].i64 % _regs[RT].i64;
+}
 
-            // 70: C.SF
-            case FMT_S | 070:
-                // TODO: Signals
-                _fpCompare = false;
-                break;
-            case FMT_D | 070:
-                // TODO: Signals
-                _fpCompare = false;
-                break;
+void CPU::opDDIVU(const Instr& instr)
+{
+    _lo.u64 = _regs[RS].u64 / _regs[RT].u64;
+    _hi.u64 = _regs[RS].u64 % _regs[RT].u64;
+}
+
+void CPU::opADDU(const Instr& instr)
+{
+    _regs[RD].i64 = (std::int32_t)(_regs[RS].i64 + _regs[RT].i64);
+}
+
+void CPU::opSUBU(const Instr& instr)
+{
+    _regs[RD].i64 = (std::int32_t)(_regs[RS].i64 - _regs[RT].i64);
+}
+
+void CPU::opAND(const Instr& instr)
+{
+    _regs[RD].u64 = _regs[RS].u64 & _regs[RT].u64;
+}
+
+void CPU::opOR(const Instr& instr)
+{
+    _regs[RD].u64 = _regs[RS].u64 | _regs[RT].u64;
+}
+
+void CPU::opXOR(const Instr& instr)
+{
+    _regs[RD].u64 = _regs[RS].u64 ^ _regs[RT].u64;
+}
+
+void CPU::opNOR(const Instr& instr)
+{
+    _regs[RD].u64 = ~(_regs[RS].u64 | _regs[RT].u64);
+}
+
+void CPU::opSLT(const Instr& instr)
+{
+    _regs[RD].u64 = !!(_regs[RS].i64 < _regs[RT].i64);
+}
+
+void CPU::opSLTU(const Instr& instr)
+{
+    _regs[RD].u64 = !!(_regs[RS].u64 < _regs[RT].u64);
+}
+
+void CPU::opDADDU(const Instr& instr)
+{
+    _regs[RD].i64 = _regs[RS].i64 + _regs[RT].i64;
+}
+
+void CPU::opDSUBU(const Instr& instr)
+{
+    _regs[RD].i64 = _regs[RS].i64 - _regs[RT].i64;
+}
+
+void CPU::opDSLL(const Instr& instr)
+{
+    _regs[RD].u64 = _regs[RT].u64 << SA;
+}
+
+void CPU::opDSRL(const Instr& instr)
+{
+    _regs[RD].u64 = _regs[RT].u64 >> SA;
+}
+
+void CPU::opDSRA(const Instr& instr)
+{
+    _regs[RD].i64 = _regs[RT].i64 >> SA;
+}
+
+void CPU::opDSLL32(const Instr& instr)
+{
+    _regs[RD].u64 = _regs[RT].u64 << (32 + SA);
+}
+
+void CPU::opDSRL32(const Instr& instr)
+{
+    _regs[RD].u64 = _regs[RT].u64 >> (32 + SA);
+}
+
+void CPU::opDSRA32(const Instr& instr)
+{
+    _regs[RD].i64 = _regs[RT].i64 >> (32 + SA);
+}
+
+/*
+ * REGIMM
+ */
+
+void CPU::opBLTZ(const Instr& instr)
+{
+    branch(instr, _regs[RS].i64 < 0);
+}
+
+void CPU::opBGEZ(const Instr& instr)
+{
+    branch(instr, _regs[RS].i64 >= 0);
+}
+
+void CPU::opBLTZL(const Instr& instr)
+{
+    branchLikely(instr, _regs[RS].i64 < 0);
+}
+
+void CPU::opBGEZL(const Instr& instr)
+{
+    branchLikely(instr, _regs[RS].i64 >= 0);
+}
+
+void CPU::opBLTZAL(const Instr& instr)
+{
+    _regs[31].u64 = _pc + 4;
+    branch(instr, _regs[RS].i64 < 0);
+}
+
+void CPU::opBGEZAL(const Instr& instr)
+{
+    _regs[31].u64 = _pc + 4;
+    branch(instr, _regs[RS].i64 >= 0);
+}
+
+void CPU::opBLTZALL(const Instr& instr)
+{
+    _regs[31].u64 = _pc + 4;
+    branchLikely(instr, _regs[RS].i64 < 0);
+}
+
+void CPU::opBGEZALL(const Instr& instr)
+{
+    _regs[31].u64 = _pc + 4;
+    branchLikely(instr, _regs[RS].i64 >= 0);
+}
+
+/*
+ * Main opcodes
+ */
+
+void CPU::opJ(const Instr& instr)
+{
+    _pcNext      = ((std::uint64_t)JUMP_TARGET << 2) | (_pc & 0xfffffffff0000000ULL);
+    _branchDelay = true;
+}
+
+void CPU::opJAL(const Instr& instr)
+{
+    _pcNext       = ((std::uint64_t)JUMP_TARGET << 2) | (_pc & 0xfffffffff0000000ULL);
+    _branchDelay  = true;
+    _regs[31].u64 = _pc + 4;
+}
+
+void CPU::opBEQ(const Instr& instr)
+{
+    branch(instr, _regs[RS].u64 == _regs[RT].u64);
+}
+
+void CPU::opBNE(const Instr& instr)
+{
+    branch(instr, _regs[RS].u64 != _regs[RT].u64);
+}
+
+void CPU::opBLEZ(const Instr& instr)
+{
+    branch(instr, _regs[RS].i64 <= 0);
+}
+
+void CPU::opBGTZ(const Instr& instr)
+{
+    branch(instr, _regs[RS].i64 > 0);
+}
+
+void CPU::opADDIU(const Instr& instr)
+{
+    _regs[RT].i64 = (_regs[RS].i32 + SIMM);
+}
+
+void CPU::opSLTI(const Instr& instr)
+{
+    _regs[RT].u64 = (_regs[RS].i64 < SIMM) ? 1 : 0;
+}
+
+void CPU::opSLTIU(const Instr& instr)
+{
+    _regs[RT].u64 = (_regs[RS].u64 < (std::uint64_t)((std::int64_t)SIMM)) ? 1 : 0;
+}
+
+void CPU::opANDI(const Instr& instr)
+{
+    _regs[RT].u64 = _regs[RS].u64 & IMM;
+}
+
+void CPU::opORI(const Instr& instr)
+{
+    _regs[RT].u64 = _regs[RS].u64 | IMM;
+}
+
+void CPU::opXORI(const Instr& instr)
+{
+    _regs[RT].u64 = _regs[RS].u64 ^ IMM;
+}
+
+void CPU::opLUI(const Instr& instr)
+{
+    _regs[RT].i64 = ((std::int64_t)SIMM << 16);
+}
+
+void CPU::opBEQL(const Instr& instr)
+{
+    branchLikely(instr, _regs[RS].u64 == _regs[RT].u64);
+}
+
+void CPU::opBNEL(const Instr& instr)
+{
+    branchLikely(instr, _regs[RS].u64 != _regs[RT].u64);
+}
+
+void CPU::opBLEZL(const Instr& instr)
+{
+    branchLikely(instr, _regs[RS].i64 <= 0);
+}
+
+void CPU::opBGTZL(const Instr& instr)
+{
+    branchLikely(instr, _regs[RS].i64 > 0);
+}
+
+void CPU::opDADDIU(const Instr& instr)
+{
+    _regs[RT].i64 = _regs[RS].i64 + SIMM;
+}
+
+/*
+ * COP0
+ */
+
+void CPU::opMFC0(const Instr& instr)
+{
+    _regs[RT].i64 = (std::int32_t)cop0Read(RD);
+}
+
+void CPU::opDMFC0(const Instr& instr)
+{
+    _regs[RT].u64 = cop0Read(RD);
+}
+
+void CPU::opMTC0(const Instr& instr)
+{
+    cop0Write(RD, _regs[RT].u32);
+}
+
+void CPU::opERET(const Instr&)
+{
+    if (_erl)
+    {
+        _pc  = (std::int64_t)((std::int32_t)_errorEpc);
+        _erl = false;
+        NIN64_LOG(COP0, Trace, "ERET: ErrorEPC\n");
+    }
+    else
+    {
+        _pc  = (std::int64_t)((std::int32_t)_epc);
+        _exl = false;
+        NIN64_LOG(COP0, Trace, "ERET: EPC\n");
+    }
+    _llBit  = false;
+    _pcNext = _pc + 4;
+}
+
+void CPU::opTLBR(const Instr&)
+{
+    const TLB::Entry& entry = _tlb.entry(_index & 0x1f);
+
+    _pageMask = entry.pageMask;
+    _entryHi  = entry.entryHi;
+    _entryLo0 = entry.entryLo0;
+    _entryLo1 = entry.entryLo1;
+    _tlb.setAsid(_entryHi & 0xff);
+}
+
+void CPU::opTLBWI(const Instr&)
+{
+    TLB::Entry    entry;
+    std::uint32_t global;
+
+    global         = _entryLo0 & _entryLo1 & 1;
+    entry.pageMask = _pageMask;
+    entry.entryHi  = _entryHi & ~_pageMask;
+    entry.entryLo0 = (_entryLo0 & ~1u) | global;
+    entry.entryLo1 = (_entryLo1 & ~1u) | global;
+    NIN64_LOG(COP0, Trace, "TLB write %d: %08x %08x %08x %08x\n", _index & 0x1f, entry.pageMask, entry.entryHi, entry.entryLo0, entry.entryLo1);
+    _tlb.write(_index & 0x1f, entry);
+}
+
+/* Random counts down from 31 to Wired on every random write */
+void CPU::opTLBWR(const Instr& instr)
+{
+    std::uint32_t index;
+
+    index   = _index;
+    _index  = _random;
+    opTLBWI(instr);
+    _index  = index;
+    _random = (_random > _wired && _random > 0) ? _random - 1 : 31;
+}
+
+void CPU::opTLBP(const Instr&)
+{
+    int index;
+
+    index  = _tlb.probe(_entryHi);
+    _index = (index < 0) ? 0x80000000 : (std::uint32_t)index;
+}
+
+/*
+ * COP1
+ */
+
+void CPU::opMFC1(const Instr& instr)
+{
+    _regs[RT].u32 = fpuReadU32(FS);
+}
+
+void CPU::opDMFC1(const Instr& instr)
+{
+    _regs[RT].u64 = fpuReadU64(FS);
+}
+
+void CPU::opCFC1(const Instr& instr)
+{
+    _regs[RT].i64 = (std::int32_t)fcrRead(FS);
+}
+
+void CPU::opMTC1(const Instr& instr)
+{
+    fpuWriteU32(FS, _regs[RT].u32);
+}
+
+void CPU::opDMTC1(const Instr& instr)
+{
+    fpuWriteU64(FS, _regs[RT].u64);
+}
+
+void CPU::opCTC1(const Instr& instr)
+{
+    fcrWrite(FS, _regs[RT].u32);
+}
+
+void CPU::opBC1F(const Instr& instr)
+{
+    branch(instr, !_fpCompare);
+}
+
+void CPU::opBC1T(const Instr& instr)
+{
+    branch(instr, _fpCompare);
+}
+
+void CPU::opBC1FL(const Instr& instr)
+{
+    branchLikely(instr, !_fpCompare);
+}
+
+void CPU::opBC1TL(const Instr& instr)
+{
+    branchLikely(instr, _fpCompare);
+}
+
+/*
+ * COP1 arithmetic, one handler per operation and format. Results are
+ * computed by the host in the guest rounding mode, starting from clear
+ * flags, then kept only if the exceptions they raised do not trap. They go
+ * through a volatile so that the compiler cannot move the operation past
+ * the read of the host flags.
+ */
+
+template <typename T> void CPU::opFADD(const Instr& instr)
+{
+    volatile T value;
+
+    fpuBegin();
+    value = fpuRead<T>(FS) + fpuRead<T>(FT);
+    if (fpuCommit(0))
+        fpuWrite<T>(FD, value);
+}
+
+template <typename T> void CPU::opFSUB(const Instr& instr)
+{
+    volatile T value;
+
+    fpuBegin();
+    value = fpuRead<T>(FS) - fpuRead<T>(FT);
+    if (fpuCommit(0))
+        fpuWrite<T>(FD, value);
+}
+
+template <typename T> void CPU::opFMUL(const Instr& instr)
+{
+    volatile T value;
+
+    fpuBegin();
+    value = fpuRead<T>(FS) * fpuRead<T>(FT);
+    if (fpuCommit(0))
+        fpuWrite<T>(FD, value);
+}
+
+template <typename T> void CPU::opFDIV(const Instr& instr)
+{
+    volatile T value;
+
+    fpuBegin();
+    value = fpuRead<T>(FS) / fpuRead<T>(FT);
+    if (fpuCommit(0))
+        fpuWrite<T>(FD, value);
+}
+
+template <typename T> void CPU::opFSQRT(const Instr& instr)
+{
+    volatile T value;
+
+    fpuBegin();
+    value = std::sqrt(fpuRead<T>(FS));
+    if (fpuCommit(0))
+        fpuWrite<T>(FD, value);
+}
+
+template <typename T> void CPU::opFABS(const Instr& instr)
+{
+    volatile T value;
+
+    fpuBegin();
+    value = std::fabs(fpuRead<T>(FS));
+    if (fpuCommit(0))
+        fpuWrite<T>(FD, value);
+}
+
+template <typename T> void CPU::opFMOV(const Instr& instr)
+{
+    fpuWrite<T>(FD, fpuRead<T>(FS));
+}
+
+template <typename T> void CPU::opFNEG(const Instr& instr)
+{
+    volatile T value;
 
-            // 71: C.NGLE
-            case FMT_S | 071:
-                // TODO: Signals
-                _fpCompare = (std::isnan(fpuReadF32(FS)) || std::isnan(fpuReadF32(FT)));
-                break;
-            case FMT_D | 071:
-                // TODO: Signals
-                _fpCompare = (std::isnan(fpuReadF64(FS)) || std::isnan(fpuReadF64(FT)));
-                break;
+    fpuBegin();
+    value = -fpuRead<T>(FS);
+    if (fpuCommit(0))
+        fpuWrite<T>(FD, value);
+}
 
-            // 72: C.SEQ
-            case FMT_S | 072:
-                // TODO: Signals
-                _fpCompare = (fpuReadF32(FS) == fpuReadF32(FT));
-                break;
-            case FMT_D | 072:
-                // TODO: Signals
-                _fpCompare = (fpuReadF64(FS) == fpuReadF64(FT));
-                break;
+/* ROUND, TRUNC, CEIL and FLOOR pass their rounding mode, CVT.W and CVT.L use the one in FCR31 */
+template <typename T, typename I, int kMode> void CPU::opFTOI(const Instr& instr)
+{
+    volatile I value;
 
-            // 73: C.NGL
-            case FMT_S | 073:
-                // TODO: Signals
-                _fpCompare = (std::isnan(fpuReadF32(FS)) || std::isnan(fpuReadF32(FT)) || (fpuReadF32(FS) == fpuReadF32(FT)));
-                break;
-            case FMT_D | 073:
-                // TODO: Signals
-                _fpCompare = (std::isnan(fpuReadF64(FS)) || std::isnan(fpuReadF64(FT)) || (fpuReadF64(FS) == fpuReadF64(FT)));
-                break;
+    fpuBegin();
+    value = fpuConvert<I>(fpuRead<T>(FS), kMode);
+    if (fpuCommit(0))
+        fpuWrite<I>(FD, value);
+}
 
-            // 74: C.LT
-            case FMT_S | 074:
-                // TODO: Signals
-                _fpCompare = (fpuReadF32(FS) < fpuReadF32(FT));
-                break;
-            case FMT_D | 074:
-                // TODO: Signals
-                _fpCompare = (fpuReadF64(FS) <= fpuReadF64(FT));
-                break;
+/* CVT.S and CVT.D */
+template <typename T, typename U> void CPU::opFCVT(const Instr& instr)
+{
+    volatile T value;
 
-            // 75: C.NGE
-            case FMT_S | 075:
-                // TODO: Signals
-                _fpCompare = (std::isnan(fpuReadF32(FS)) || std::isnan(fpuReadF32(FT)) || (fpuReadF32(FS) < fpuReadF32(FT)));
-                break;
-            case FMT_D | 075:
-                // TODO: Signals
-                _fpCompare = (std::isnan(fpuReadF64(FS)) || std::isnan(fpuReadF64(FT)) || (fpuReadF64(FS) < fpuReadF64(FT)));
-                break;
+    fpuBegin();
+    value = (T)fpuRead<U>(FS);
+    if (fpuCommit(0))
+        fpuWrite<T>(FD, value);
+}
 
-            // 76: C.LE
-            case FMT_S | 076:
-                // TODO: Signals
-                _fpCompare = (fpuReadF32(FS) <= fpuReadF32(FT));
-                break;
-            case FMT_D | 076:
-                // TODO: Signals
-                _fpCompare = (fpuReadF64(FS) <= fpuReadF64(FT));
-                break;
+/* C.cond: the low three bits of the function pick unordered, equal and less than, the fourth signals on NaN */
+template <typename T> void CPU::opFC(const Instr& instr)
+{
+    T             fs;
+    T             ft;
+    bool          unordered;
+    volatile bool cond;
+
+    fpuBegin();
+    fs        = fpuRead<T>(FS);
+    ft        = fpuRead<T>(FT);
+    unordered = std::isunordered(fs, ft);
+    cond      = ((instr.op & 1) && unordered) || ((instr.op & 2) && fs == ft) || ((instr.op & 4) && std::isless(fs, ft));
+    if (fpuCommit(((instr.op & 8) && unordered) ? FPU_EXC_INVALID : 0))
+        _fpCompare = cond;
+}
 
-            // 77: C.NGT
-            case FMT_S | 077:
-                // TODO: Signals
-                _fpCompare = (std::isnan(fpuReadF32(FS)) || std::isnan(fpuReadF32(FT)) || (fpuReadF32(FS) <= fpuReadF32(FT)));
-                break;
-            case FMT_D | 077:
-                // TODO: Signals
-                _fpCompare = (std::isnan(fpuReadF64(FS)) || std::isnan(fpuReadF64(FT)) || (fpuReadF64(FS) <= fpuReadF64(FT)));
-                break;
+/*
+ * Loads and stores
+ */
 
-            default:
-                NOT_IMPLEMENTED();
-                break;
-            }
-            break;
-        default:
-            NOT_IMPLEMENTED();
-            break;
-        }
-        break;
-    case 022: // COP2 (Coprocessor 2)
-        NOT_IMPLEMENTED();
-        break;
-    case 024: // BEQL
-        if (_regs[RS].u64 == _regs[RT].u64)
-        {
-            _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-            _branchDelay = true;
-        }
-        else
-        {
-            _pc = _pcNext;
-            _pcNext += 4;
-        }
-        break;
-    case 025: // BNEL
-        if (_regs[RS].u64 != _regs[RT].u64)
-        {
-            _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-            _branchDelay = true;
-        }
-        else
-        {
-            _pc = _pcNext;
-            _pcNext += 4;
-        }
-        break;
-    case 026: // BLEZL
-        if (_regs[RS].i64 <= 0)
-        {
-            _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-            _branchDelay = true;
-        }
-        else
-        {
-            _pc = _pcNext;
-            _pcNext += 4;
-        }
+template <bool kCached> void CPU::opLDR(const Instr& instr)
+{
+    std::uint64_t tmp;
+    std::uint64_t tmp2;
+
+    NIN64_LOG(CPU, Trace, "LDR\n");
+    tmp = _regs[RS].u64 + SIMM;
+    if (!load<kCached>((std::uint32_t)tmp & 0xfffffff8, tmp2)) // Mask the offset
+        return;
+    switch (tmp & 0x7)
+    {
+    case 0x0:
+        tmp = (tmp2 >> 56) | (_regs[RT].u64 & 0xffffffffffffff00ull);
         break;
-    case 027: // BGTZL (Branch On Greater Than Zero Likely)
-        if (_regs[RS].i64 > 0)
-        {
-            _pcNext      = _pc + ((std::int64_t)SIMM << 2);
-            _branchDelay = true;
-        }
-        else
-        {
-            _pc = _pcNext;
-            _pcNext += 4;
-        }
+    case 0x1:
+        tmp = (tmp2 >> 48) | (_regs[RT].u64 & 0xffffffffffff0000ull);
         break;
-    case 030: // DADDI (Doubleword Add Immediate)
-        _regs[RT].i64 = _regs[RS].i64 + SIMM;
+    case 0x2:
+        tmp = (tmp2 >> 40) | (_regs[RT].u64 & 0xffffffffff000000ull);
         break;
-    case 031: // DADDIU (Doubleword Add Immediate Unsigned)
-        _regs[RT].i64 = _regs[RS].i64 + SIMM;
+    case 0x3:
+        tmp = (tmp2 >> 32) | (_regs[RT].u64 & 0xffffffff00000000ull);
         break;
-    case 032: // LDL (Load Doubleword Left)
-        NOT_IMPLEMENTED();
+    case 0x4:
+        tmp = (tmp2 >> 24) | (_regs[RT].u64 & 0xffffff0000000000ull);
         break;
-    case 033: // LDR (Load Doubleword Right)
-        std::printf("LDR\n");
-        tmp  = _regs[RS].u64 + SIMM;
-        tmp2 = _bus.read64(tmp & 0xfffffff8); // Mask the offset
-        switch (tmp & 0x7)
-        {
-        case 0x0:
-            tmp = (tmp2 >> 56) | (_regs[RT].u64 & 0xffffffffffffff00ull);
-            break;
-        case 0x1:
-            tmp = (tmp2 >> 48) | (_regs[RT].u64 & 0xffffffffffff0000ull);
-            break;
-        case 0x2:
-            tmp = (tmp2 >> 40) | (_regs[RT].u64 & 0xffffffffff000000ull);
-            break;
-        case 0x3:
-            tmp = (tmp2 >> 32) | (_regs[RT].u64 & 0xffffffff00000000ull);
-            break;
-        case 0x4:
-            tmp = (tmp2 >> 24) | (_regs[RT].u64 & 0xffffff0000000000ull);
-            break;
-        case 0x5:
-            tmp = (tmp2 >> 16) | (_regs[RT].u64 & 0xffff000000000000ull);
-            break;
-        case 0x6:
-            tmp = (tmp2 >> 8) | (_regs[RT].u64 & 0xff00000000000000ull);
-            break;
-        case 0x7:
-            tmp = tmp2;
-            break;
-        }
-        _regs[RT].u64 = tmp;
+    case 0x5:
+        tmp = (tmp2 >> 16) | (_regs[RT].u64 & 0xffff000000000000ull);
         break;
-    case 040: // LB (Load Byte)
-        _regs[RT].u64 = sext(_bus.read8(_regs[RS].u32 + SIMM));
+    case 0x6:
+        tmp = (tmp2 >> 8) | (_regs[RT].u64 & 0xff00000000000000ull);
         break;
-    case 041: // LH (Load Halfword)
-        _regs[RT].u64 = sext(_bus.read16(_regs[RS].u32 + SIMM));
+    case 0x7:
+        tmp = tmp2;
         break;
-    case 042: // LWL (Load Word Left)
-        tmp = _regs[RS].u32 + SIMM;
-        std::printf("LWL 0x%08x (0x%016llx)\n", (uint32_t)tmp, _pc);
-        tmp2 = _bus.read32(tmp & ~0x3);
+    }
+    _regs[RT].u64 = tmp;
+}
 
-        switch (tmp & 0x3)
-        {
-        case 0x00:
-            _regs[RT].u64 = sext(tmp2);
-            break;
-        case 0x01:
-            _regs[RT].u64 = sext((_regs[RT].u32 & 0x000000ff) | ((tmp2 & 0x00ffffff) << 8));
-            break;
-        case 0x02:
-            _regs[RT].u64 = sext((_regs[RT].u32 & 0x0000ffff) | ((tmp2 & 0x0000ffff) << 16));
-            break;
-        case 0x03:
-            _regs[RT].u64 = sext((_regs[RT].u32 & 0x00ffffff) | ((tmp2 & 0x000000ff) << 24));
-            break;
-        }
-        break;
-    case 043: // LW (Load Word)
-        _regs[RT].u64 = sext(_bus.read32(_regs[RS].u32 + SIMM));
-        break;
-    case 044: // LBU (Load Byte Unsigned)
-        _regs[RT].u64 = _bus.read8(_regs[RS].u32 + SIMM);
-        break;
-    case 045: // LHU (Load Halfword Unsigned)
-        _regs[RT].u64 = _bus.read16(_regs[RS].u32 + SIMM);
-        break;
-    case 046: // LWR
-        tmp = _regs[RS].u32 + SIMM;
-        std::printf("LWR 0x%08x (0x%016llx)\n", (uint32_t)tmp, _pc);
-        tmp2 = _bus.read32(tmp & ~0x3);
+template <bool kCached> void CPU::opLB(const Instr& instr)
+{
+    std::uint8_t value;
 
-        switch (tmp & 0x3)
-        {
-        case 0x00:
-            _regs[RT].u64 = sext((tmp2 >> 24) | (_regs[RT].u32 & 0xffffff00));
-            break;
-        case 0x01:
-            _regs[RT].u64 = sext((tmp2 >> 16) | (_regs[RT].u32 & 0xffff0000));
-            break;
-        case 0x02:
-            _regs[RT].u64 = sext((tmp2 >> 8) | (_regs[RT].u32 & 0xff000000));
-            break;
-        case 0x03:
-            _regs[RT].u64 = sext(tmp2);
-            break;
-        }
-        break;
-    case 047: // LWU
-        _regs[RT].u64 = _bus.read32(_regs[RS].u32 + SIMM);
-        break;
-    case 050: // SB (Store Byte)
-        _bus.write8(_regs[RS].u32 + SIMM, _regs[RT].u8);
-        break;
-    case 051: // SH (Store Halfword)
-        _bus.write16(_regs[RS].u32 + SIMM, _regs[RT].u16);
-        break;
-    case 052: // SWL (Store Word Left)
-        tmp = _regs[RS].u32 + SIMM;
-        std::printf("SWL 0x%08x (0x%016llx)\n", (uint32_t)tmp, _pc);
-        tmp2 = _bus.read32(tmp & ~0x3);
-        switch (tmp & 0x3)
-        {
-        case 0x00:
-            _bus.write32(tmp & ~0x3, _regs[RT].u32);
-            break;
-        case 0x01:
-            _bus.write32(tmp & ~0x3, (_regs[RT].u32 >> 8) | (tmp2 & 0xff000000));
-            break;
-        case 0x02:
-            _bus.write32(tmp & ~0x3, (_regs[RT].u32 >> 16) | (tmp2 & 0xffff0000));
-            break;
-        case 0x03:
-            _bus.write32(tmp & ~0x3, (_regs[RT].u32 >> 24) | (tmp2 & 0xffffff00));
-            break;
-        }
-        break;
-    case 053: // SW (Store Word)
-        _bus.write32(_regs[RS].u32 + SIMM, _regs[RT].u32);
-        break;
-    case 054: // SDL (Store Doubleword Left)
-        NOT_IMPLEMENTED();
-        break;
-    case 055: // SDR (Store Doubleword Right)
-        NOT_IMPLEMENTED();
-        break;
-    case 056: // SWR (Store Word Right)
-        tmp = _regs[RS].u32 + SIMM;
-        std::printf("SWR 0x%08x (0x%016llx)\n", (uint32_t)tmp, _pc);
-        tmp2 = _bus.read32(tmp & ~0x3);
-        switch (tmp & 0x3)
-        {
-        case 0x00:
-            _bus.write32(tmp & ~0x3, ((_regs[RT].u32 & 0xff) << 24) | (tmp2 & 0x00ffffff));
-            break;
-        case 0x01:
-            _bus.write32(tmp & ~0x3, ((_regs[RT].u32 & 0xffff) << 16) | (tmp2 & 0x0000ffff));
-            break;
-        case 0x02:
-            _bus.write32(tmp & ~0x3, ((_regs[RT].u32 & 0xffffff) << 8) | (tmp2 & 0x000000ff));
-            break;
-        case 0x03:
-            _bus.write32(tmp & ~0x3, _regs[RT].u32);
-            break;
-        }
-        break;
-    case 057: // CACHE
+    if (load<kCached>(_regs[RS].u32 + SIMM, value))
+        _regs[RT].u64 = sext(value);
+}
+
+template <bool kCached> void CPU::opLH(const Instr& instr)
+{
+    std::uint16_t value;
+
+    if (load<kCached>(_regs[RS].u32 + SIMM, value))
+        _regs[RT].u64 = sext(value);
+}
+
+template <bool kCached> void CPU::opLWL(const Instr& instr)
+{
+    std::uint64_t tmp;
+    std::uint64_t tmp2;
+    std::uint32_t word;
+
+    tmp = _regs[RS].u32 + SIMM;
+    NIN64_LOG(CPU, Trace, "LWL 0x%08x (0x%016llx)\n", (uint32_t)tmp, _pc);
+    if (!load<kCached>(tmp & ~0x3, word))
+        return;
+    tmp2 = word;
+
+    switch (tmp & 0x3)
+    {
+    case 0x00:
+        _regs[RT].u64 = sext(tmp2);
         break;
-    case 060: // LL (Load Linked)
-        tmp           = (_regs[RS].u32 + SIMM);
-        _regs[RT].i64 = (std::int32_t)_bus.read32((std::uint32_t)tmp);
-        _llAddr       = (std::uint32_t)tmp;
-        _llBit        = true;
+    case 0x01:
+        _regs[RT].u64 = sext((_regs[RT].u32 & 0x000000ff) | ((tmp2 & 0x00ffffff) << 8));
         break;
-    case 061: // LWC1 (Load Word to FPU)
-        _fpuRegs[FT].u32 = _bus.read32(_regs[BASE].u32 + SIMM);
+    case 0x02:
+        _regs[RT].u64 = sext((_regs[RT].u32 & 0x0000ffff) | ((tmp2 & 0x0000ffff) << 16));
         break;
-    case 062: // LWC2
-        NOT_IMPLEMENTED();
+    case 0x03:
+        _regs[RT].u64 = sext((_regs[RT].u32 & 0x00ffffff) | ((tmp2 & 0x000000ff) << 24));
         break;
-    case 064: // LLD
-        NOT_IMPLEMENTED();
+    }
+}
+
+template <bool kCached> void CPU::opLW(const Instr& instr)
+{
+    std::uint32_t value;
+
+    if (load<kCached>(_regs[RS].u32 + SIMM, value))
+        _regs[RT].u64 = sext(value);
+}
+
+template <bool kCached> void CPU::opLBU(const Instr& instr)
+{
+    std::uint8_t value;
+
+    if (load<kCached>(_regs[RS].u32 + SIMM, value))
+        _regs[RT].u64 = value;
+}
+
+template <bool kCached> void CPU::opLHU(const Instr& instr)
+{
+    std::uint16_t value;
+
+    if (load<kCached>(_regs[RS].u32 + SIMM, value))
+        _regs[RT].u64 = value;
+}
+
+template <bool kCached> void CPU::opLWR(const Instr& instr)
+{
+    std::uint64_t tmp;
+    std::uint64_t tmp2;
+    std::uint32_t word;
+
+    tmp = _regs[RS].u32 + SIMM;
+    NIN64_LOG(CPU, Trace, "LWR 0x%08x (0x%016llx)\n", (uint32_t)tmp, _pc);
+    if (!load<kCached>(tmp & ~0x3, word))
+        return;
+    tmp2 = word;
+
+    switch (tmp & 0x3)
+    {
+    case 0x00:
+        _regs[RT].u64 = sext((tmp2 >> 24) | (_regs[RT].u32 & 0xffffff00));
         break;
-    case 065: // LDC1 (Load Doubleword to FPU)
-        _fpuRegs[FT].u64 = _bus.read64(_regs[BASE].u32 + SIMM);
+    case 0x01:
+        _regs[RT].u64 = sext((tmp2 >> 16) | (_regs[RT].u32 & 0xffff0000));
         break;
-    case 066: // LDC2
-        NOT_IMPLEMENTED();
+    case 0x02:
+        _regs[RT].u64 = sext((tmp2 >> 8) | (_regs[RT].u32 & 0xff000000));
         break;
-    case 067: // LD (Load Doubleword)
-        _regs[RT].u64 = _bus.read64(_regs[RS].u32 + SIMM);
+    case 0x03:
+        _regs[RT].u64 = sext(tmp2);
         break;
-    case 070: // SC (Store Conditional)
-        NOT_IMPLEMENTED();
+    }
+}
+
+template <bool kCached> void CPU::opLWU(const Instr& instr)
+{
+    std::uint32_t value;
+
+    if (load<kCached>(_regs[RS].u32 + SIMM, value))
+        _regs[RT].u64 = value;
+}
+
+template <bool kCached> void CPU::opSB(const Instr& instr)
+{
+    store<kCached>(_regs[RS].u32 + SIMM, _regs[RT].u8);
+}
+
+template <bool kCached> void CPU::opSH(const Instr& instr)
+{
+    store<kCached>(_regs[RS].u32 + SIMM, _regs[RT].u16);
+}
+
+template <bool kCached> void CPU::opSWL(const Instr& instr)
+{
+    std::uint32_t tmp;
+    std::uint32_t tmp2;
+
+    tmp = _regs[RS].u32 + SIMM;
+    NIN64_LOG(CPU, Trace, "SWL 0x%08x (0x%016llx)\n", tmp, _pc);
+
+    /* A read only page faults as a store, not as the load below */
+    if (!mapping(tmp & ~0x3, true) || !load<kCached>(tmp & ~0x3, tmp2))
+        return;
+    switch (tmp & 0x3)
+    {
+    case 0x00:
+        store<kCached>(tmp & ~0x3, _regs[RT].u32);
         break;
-    case 071: // SWC1 (Store Word From FPU)
-        _bus.write32(_regs[BASE].u32 + SIMM, _fpuRegs[FT].u32);
+    case 0x01:
+        store<kCached>(tmp & ~0x3, (_regs[RT].u32 >> 8) | (tmp2 & 0xff000000));
         break;
-    case 072: // SWC2
-        NOT_IMPLEMENTED();
+    case 0x02:
+        store<kCached>(tmp & ~0x3, (_regs[RT].u32 >> 16) | (tmp2 & 0xffff0000));
         break;
-    case 074: // SCD (Store Conditional Doubleword)
-        NOT_IMPLEMENTED();
+    case 0x03:
+        store<kCached>(tmp & ~0x3, (_regs[RT].u32 >> 24) | (tmp2 & 0xffffff00));
         break;
-    case 075: // SDC1 (Store Doubleword From FPU)
-        _bus.write64(_regs[BASE].u32 + SIMM, _fpuRegs[FT].u64);
+    }
+}
+
+template <bool kCached> void CPU::opSW(const Instr& instr)
+{
+    store<kCached>(_regs[RS].u32 + SIMM, _regs[RT].u32);
+}
+
+template <bool kCached> void CPU::opSWR(const Instr& instr)
+{
+    std::uint32_t tmp;
+    std::uint32_t tmp2;
+
+    tmp = _regs[RS].u32 + SIMM;
+    NIN64_LOG(CPU, Trace, "SWR 0x%08x (0x%016llx)\n", tmp, _pc);
+    if (!mapping(tmp & ~0x3, true) || !load<kCached>(tmp & ~0x3, tmp2))
+        return;
+    switch (tmp & 0x3)
+    {
+    case 0x00:
+        store<kCached>(tmp & ~0x3, ((_regs[RT].u32 & 0xff) << 24) | (tmp2 & 0x00ffffff));
         break;
-    case 076: // SDC2 (Store Doubleword From Coprocessor 2)
-        NOT_IMPLEMENTED();
+    case 0x01:
+        store<kCached>(tmp & ~0x3, ((_regs[RT].u32 & 0xffff) << 16) | (tmp2 & 0x0000ffff));
         break;
-    case 077: // SD (Store Doubleword)
-        _bus.write64(_regs[RS].u32 + SIMM, _regs[RT].u64);
+    case 0x02:
+        store<kCached>(tmp & ~0x3, ((_regs[RT].u32 & 0xffffff) << 8) | (tmp2 & 0x000000ff));
         break;
-    default:
-        NOT_IMPLEMENTED();
+    case 0x03:
+        store<kCached>(tmp & ~0x3, _regs[RT].u32);
         break;
     }
+}
 
-    _regs[0].u64 = 0;
-    _count++;
-    if ((_count >> 1) == _compare)
-    {
-        _ip |= INT_TIMER;
-    }
+template <bool kCached> void CPU::opLL(const Instr& instr)
+{
+    std::uint32_t tmp;
+    std::uint32_t value;
+
+    tmp = (_regs[RS].u32 + SIMM);
+    if (!load<kCached>(tmp, value))
+        return;
+    _regs[RT].i64 = (std::int32_t)value;
+    _llAddr       = tmp;
+    _llBit        = true;
+}
+
+template <bool kCached> void CPU::opLWC1(const Instr& instr)
+{
+    load<kCached>(_regs[BASE].u32 + SIMM, _fpuRegs[FT].u32);
+}
+
+template <bool kCached> void CPU::opLDC1(const Instr& instr)
+{
+    load<kCached>(_regs[BASE].u32 + SIMM, _fpuRegs[FT].u64);
+}
+
+template <bool kCached> void CPU::opLD(const Instr& instr)
+{
+    load<kCached>(_regs[RS].u32 + SIMM, _regs[RT].u64);
+}
+
+template <bool kCached> void CPU::opSWC1(const Instr& instr)
+{
+    store<kCached>(_regs[BASE].u32 + SIMM, _fpuRegs[FT].u32);
+}
+
+template <bool kCached> void CPU::opSDC1(const Instr& instr)
+{
+    store<kCached>(_regs[BASE].u32 + SIMM, _fpuRegs[FT].u64);
+}
+
+template <bool kCached> void CPU::opSD(const Instr& instr)
+{
+    store<kCached>(_regs[RS].u32 + SIMM, _regs[RT].u64);
 }
 
-#define COP0_NOT_IMPLEMENTED(w)                                                        \
-    {                                                                                  \
-        std::printf("COP0 reg not implemented (%s): %d\n", w ? "write" : "read", reg); \
-        std::exit(2);                                                                  \
+void CPU::opCACHE(const Instr& instr)
+{
+    std::uint32_t vaddr;
+    std::uint32_t paddr;
+
+    vaddr = _regs[BASE].u32 + SIMM;
+    paddr = vaddr;
+    if ((RT & 0x10) && !translate(vaddr, false, paddr))
+        return;
+    _cache->op(RT, vaddr, paddr, _tagLo);
+}
+
+#define COP0_NOT_IMPLEMENTED(w)                                                                   \
+    {                                                                                             \
+        NIN64_LOG(COP0, Error, "COP0 reg not implemented (%s): %d\n", w ? "write" : "read", reg); \
+        std::exit(2);                                                                             \
     }
 
 std::uint32_t CPU::cop0Read(std::uint8_t reg)
@@ -1364,51 +1971,51 @@ std::uint32_t CPU::cop0Read(std::uint8_t reg)
     switch (reg)
     {
     case COP0_REG_INDEX:
-        std::printf("COP0 Read: COP0_REG_INDEX\n");
-        // COP0_NOT_IMPLEMENTED(false);
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_INDEX\n");
+        value = _index;
         break;
     case COP0_REG_RANDOM:
-        std::printf("COP0 Read: COP0_REG_RANDOM\n");
-        // COP0_NOT_IMPLEMENTED(false);
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_RANDOM\n");
+        value = _random;
         break;
     case COP0_REG_ENTRYLO0:
-        std::printf("COP0 Read: COP0_REG_ENTRYLO0\n");
-        // COP0_NOT_IMPLEMENTED(false);
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_ENTRYLO0\n");
+        value = _entryLo0;
         break;
     case COP0_REG_ENTRYLO1:
-        std::printf("COP0 Read: COP0_REG_ENTRYLO1\n");
-        // COP0_NOT_IMPLEMENTED(false);
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_ENTRYLO1\n");
+        value = _entryLo1;
         break;
     case COP0_REG_CONTEXT:
-        std::printf("COP0 Read: COP0_REG_CONTEXT\n");
-        // COP0_NOT_IMPLEMENTED(false);
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_CONTEXT\n");
+        value = _context;
         break;
     case COP0_REG_PAGEMASK:
-        std::printf("COP0 Read: COP0_REG_PAGEMASK\n");
-        // COP0_NOT_IMPLEMENTED(false);
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_PAGEMASK\n");
+        value = _pageMask;
         break;
     case COP0_REG_WIRED:
-        std::printf("COP0 Read: COP0_REG_WIRED\n");
-        // COP0_NOT_IMPLEMENTED(false);
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_WIRED\n");
+        value = _wired;
         break;
     case COP0_REG_BADVADDR:
-        std::printf("COP0 Read: COP0_REG_BADVADDR\n");
-        // COP0_NOT_IMPLEMENTED(false);
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_BADVADDR\n");
+        value = _badVAddr;
         break;
     case COP0_REG_COUNT:
-        std::printf("COP0 Read: COP0_REG_COUNT\n");
-        value = (_count >> 1);
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_COUNT\n");
+        value = count();
         break;
     case COP0_REG_ENTRYHI:
-        std::printf("COP0 Read: COP0_REG_ENTRYHI\n");
-        // COP0_NOT_IMPLEMENTED(false);
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_ENTRYHI\n");
+        value = _entryHi;
         break;
     case COP0_REG_COMPARE:
-        std::printf("COP0 Read: COP0_REG_COMPARE\n");
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_COMPARE\n");
         value = _compare;
         break;
     case COP0_REG_SR:
-        std::printf("COP0 Read: COP0_REG_SR\n");
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_SR\n");
         if (_ie) value |= 0x00000001;
         if (_exl) value |= 0x00000002;
         if (_erl) value |= 0x00000004;
@@ -1418,56 +2025,57 @@ std::uint32_t CPU::cop0Read(std::uint8_t reg)
         // COP0_NOT_IMPLEMENTED(false);
         break;
     case COP0_REG_CAUSE:
-        std::printf("COP0 Read: COP0_REG_CAUSE\n");
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_CAUSE\n");
         value |= (std::uint32_t)(_ip | _mi.ip()) << 8;
+        value |= (std::uint32_t)_excCode << 2;
         if (_bd) value |= 0x80000000;
         break;
     case COP0_REG_EPC:
-        std::printf("COP0 Read: COP0_REG_EPC\n");
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_EPC\n");
         value = _epc;
         break;
     case COP0_REG_PRID:
-        std::printf("COP0 Read: COP0_REG_PRID\n");
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_PRID\n");
         // COP0_NOT_IMPLEMENTED(false);
         break;
     case COP0_REG_CONFIG:
-        std::printf("COP0 Read: COP0_REG_CONFIG\n");
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_CONFIG\n");
         // COP0_NOT_IMPLEMENTED(false);
         break;
     case COP0_REG_LLADDR:
-        std::printf("COP0 Read: COP0_REG_LLADDR\n");
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_LLADDR\n");
         value = _llAddr;
         break;
     case COP0_REG_WATCHLO:
-        std::printf("COP0 Read: COP0_REG_WATCHLO\n");
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_WATCHLO\n");
         // COP0_NOT_IMPLEMENTED(false);
         break;
     case COP0_REG_WATCHHI:
-        std::printf("COP0 Read: COP0_REG_WATCHHI\n");
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_WATCHHI\n");
         // COP0_NOT_IMPLEMENTED(false);
         break;
     case COP0_REG_XCONTEXT:
-        std::printf("COP0 Read: COP0_REG_XCONTEXT\n");
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_XCONTEXT\n");
         // COP0_NOT_IMPLEMENTED(false);
         break;
     case COP0_REG_PERR:
-        std::printf("COP0 Read: COP0_REG_PERR\n");
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_PERR\n");
         // COP0_NOT_IMPLEMENTED(false);
         break;
     case COP0_REG_CACHEERR:
-        std::printf("COP0 Read: COP0_REG_CACHEERR\n");
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_CACHEERR\n");
         // COP0_NOT_IMPLEMENTED(false);
         break;
     case COP0_REG_TAGLO:
-        std::printf("COP0 Read: COP0_REG_TAGLO\n");
-        // COP0_NOT_IMPLEMENTED(false);
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_TAGLO\n");
+        value = _tagLo;
         break;
     case COP0_REG_TAGHI:
-        std::printf("COP0 Read: COP0_REG_TAGHI\n");
-        // COP0_NOT_IMPLEMENTED(false);
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_TAGHI\n");
+        value = _tagHi;
         break;
     case COP0_REG_ERROREPC:
-        std::printf("COP0 Read: COP0_REG_ERROREPC\n");
+        NIN64_LOG(COP0, Trace, "COP0 Read: COP0_REG_ERROREPC\n");
         value = _errorEpc;
         break;
     default:
@@ -1483,55 +2091,59 @@ void CPU::cop0Write(std::uint8_t reg, std::uint32_t value)
     switch (reg)
     {
     case COP0_REG_INDEX:
-        std::printf("COP0 Write: COP0_REG_INDEX 0x%08x\n", value);
-        // COP0_NOT_IMPLEMENTED(true);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_INDEX 0x%08x\n", value);
+        _index = (_index & 0x80000000) | (value & 0x3f);
         break;
     case COP0_REG_RANDOM:
-        std::printf("COP0 Write: COP0_REG_RANDOM 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_RANDOM 0x%08x\n", value);
         // COP0_NOT_IMPLEMENTED(true);
         break;
     case COP0_REG_ENTRYLO0:
-        std::printf("COP0 Write: COP0_REG_ENTRYLO0 0x%08x\n", value);
-        // COP0_NOT_IMPLEMENTED(true);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_ENTRYLO0 0x%08x\n", value);
+        _entryLo0 = value & 0x3fffffff;
         break;
     case COP0_REG_ENTRYLO1:
-        std::printf("COP0 Write: COP0_REG_ENTRYLO1 0x%08x\n", value);
-        // COP0_NOT_IMPLEMENTED(true);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_ENTRYLO1 0x%08x\n", value);
+        _entryLo1 = value & 0x3fffffff;
         break;
     case COP0_REG_CONTEXT:
-        std::printf("COP0 Write: COP0_REG_CONTEXT 0x%08x\n", value);
-        // COP0_NOT_IMPLEMENTED(true);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_CONTEXT 0x%08x\n", value);
+        _context = (_context & 0x007ffff0) | (value & 0xff800000);
         break;
     case COP0_REG_PAGEMASK:
-        std::printf("COP0 Write: COP0_REG_PAGEMASK 0x%08x\n", value);
-        // COP0_NOT_IMPLEMENTED(true);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_PAGEMASK 0x%08x\n", value);
+        _pageMask = value & 0x01ffe000;
         break;
     case COP0_REG_WIRED:
-        std::printf("COP0 Write: COP0_REG_WIRED 0x%08x\n", value);
-        // COP0_NOT_IMPLEMENTED(true);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_WIRED 0x%08x\n", value);
+        _wired  = value & 0x3f;
+        _random = 31;
         break;
     case COP0_REG_BADVADDR:
-        std::printf("COP0 Write: COP0_REG_BADVADDR 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_BADVADDR 0x%08x\n", value);
         // COP0_NOT_IMPLEMENTED(true);
         break;
     case COP0_REG_COUNT:
-        std::printf("COP0 Write: COP0_REG_COUNT 0x%08x\n", value);
-        _count = (value << 1);
-        std::printf("COUNT WRITE: 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_COUNT 0x%08x\n", value);
+        _countOffset = (std::uint64_t(value) << 1) - _scheduler.now();
+        scheduleTimer();
+        NIN64_LOG(COP0, Trace, "COUNT WRITE: 0x%08x\n", value);
 
         break;
     case COP0_REG_ENTRYHI:
-        std::printf("COP0 Write: COP0_REG_ENTRYHI 0x%08x\n", value);
-        // COP0_NOT_IMPLEMENTED(true);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_ENTRYHI 0x%08x\n", value);
+        _entryHi = value & 0xffffe0ff;
+        _tlb.setAsid(value & 0xff);
         break;
     case COP0_REG_COMPARE:
-        std::printf("COP0 Write: COP0_REG_COMPARE 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_COMPARE 0x%08x\n", value);
         _compare = value;
         _ip &= ~INT_TIMER;
-        std::printf("COMPARE WRITE: 0x%08x\n", value);
+        scheduleTimer();
+        NIN64_LOG(COP0, Trace, "COMPARE WRITE: 0x%08x\n", value);
         break;
     case COP0_REG_SR:
-        std::printf("COP0 Write: COP0_REG_SR 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_SR 0x%08x\n", value);
         _ie  = !!(value & 0x00000001);
         _exl = !!(value & 0x00000002);
         _erl = !!(value & 0x00000004);
@@ -1539,55 +2151,55 @@ void CPU::cop0Write(std::uint8_t reg, std::uint32_t value)
         _im  = (value >> 8) & 0xff;
         break;
     case COP0_REG_CAUSE:
-        std::printf("COP0 Write: COP0_REG_CAUSE 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_CAUSE 0x%08x\n", value);
         _ip = (_ip & 0xfc) | ((value >> 8) & 0x03);
         break;
     case COP0_REG_EPC:
-        std::printf("COP0 Write: COP0_REG_EPC 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_EPC 0x%08x\n", value);
         _epc = value;
         break;
     case COP0_REG_PRID:
-        std::printf("COP0 Write: COP0_REG_PRID 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_PRID 0x%08x\n", value);
         // COP0_NOT_IMPLEMENTED(true);
         break;
     case COP0_REG_CONFIG:
-        std::printf("COP0 Write: COP0_REG_CONFIG 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_CONFIG 0x%08x\n", value);
         // COP0_NOT_IMPLEMENTED(true);
         break;
     case COP0_REG_LLADDR:
-        std::printf("COP0 Write: COP0_REG_LLADDR 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_LLADDR 0x%08x\n", value);
         _llAddr = value;
         break;
     case COP0_REG_WATCHLO:
-        std::printf("COP0 Write: COP0_REG_WATCHLO 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_WATCHLO 0x%08x\n", value);
         // COP0_NOT_IMPLEMENTED(true);
         break;
     case COP0_REG_WATCHHI:
-        std::printf("COP0 Write: COP0_REG_WATCHHI 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_WATCHHI 0x%08x\n", value);
         // COP0_NOT_IMPLEMENTED(true);
         break;
     case COP0_REG_XCONTEXT:
-        std::printf("COP0 Write: COP0_REG_XCONTEXT 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_XCONTEXT 0x%08x\n", value);
         // COP0_NOT_IMPLEMENTED(true);
         break;
     case COP0_REG_PERR:
-        std::printf("COP0 Write: COP0_REG_PERR 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_PERR 0x%08x\n", value);
         // COP0_NOT_IMPLEMENTED(true);
         break;
     case COP0_REG_CACHEERR:
-        std::printf("COP0 Write: COP0_REG_CACHEERR 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_CACHEERR 0x%08x\n", value);
         // COP0_NOT_IMPLEMENTED(true);
         break;
     case COP0_REG_TAGLO:
-        std::printf("COP0 Write: COP0_REG_TAGLO 0x%08x\n", value);
-        // COP0_NOT_IMPLEMENTED(true);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_TAGLO 0x%08x\n", value);
+        _tagLo = value & 0x0fffffc0;
         break;
     case COP0_REG_TAGHI:
-        std::printf("COP0 Write: COP0_REG_TAGHI 0x%08x\n", value);
-        // COP0_NOT_IMPLEMENTED(true);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_TAGHI 0x%08x\n", value);
+        _tagHi = value;
         break;
     case COP0_REG_ERROREPC:
-        std::printf("COP0 Write: COP0_REG_ERROREPC 0x%08x\n", value);
+        NIN64_LOG(COP0, Trace, "COP0 Write: COP0_REG_ERROREPC 0x%08x\n", value);
         _errorEpc = value;
         break;
     }
@@ -1615,22 +2227,6 @@ std::uint64_t CPU::fpuReadU64(std::uint8_t reg)
     return tmp;
 }
 
-float CPU::fpuReadF32(std::uint8_t reg)
-{
-    std::uint32_t tmp;
-
-    tmp = fpuReadU32(reg);
-    return *(float*)(&tmp);
-}
-
-double CPU::fpuReadF64(std::uint8_t reg)
-{
-    std::uint64_t tmp;
-
-    tmp = fpuReadU64(reg);
-    return *(double*)(&tmp);
-}
-
 void CPU::fpuWriteU32(std::uint8_t reg, std::uint32_t value)
 {
     reg = reg & (_fr ? 0x1f : 0x1e);
@@ -1646,18 +2242,86 @@ void CPU::fpuWriteU64(std::uint8_t reg, std::uint64_t value)
     else
     {
         _fpuRegs[(reg & 0x1e) + 0].u32 = ((value >> 0) & 0xffffffff);
-        _fpuRegs[(reg & 0x1e) + 1].u32 = ((value >> 8) & 0xffffffff);
+        _fpuRegs[(reg & 0x1e) + 1].u32 = ((value >> 32) & 0xffffffff);
     }
 }
 
-void CPU::fpuWriteF32(std::uint8_t reg, float value)
+template <typename T> T CPU::fpuRead(std::uint8_t reg)
+{
+    std::uint64_t tmp;
+    T             value;
+
+    tmp = (sizeof(T) == 4) ? fpuReadU32(reg) : fpuReadU64(reg);
+    std::memcpy(&value, &tmp, sizeof(T));
+    return value;
+}
+
+template <typename T> void CPU::fpuWrite(std::uint8_t reg, T value)
+{
+    std::uint64_t tmp{};
+
+    std::memcpy(&tmp, &value, sizeof(T));
+    if (sizeof(T) == 4)
+        fpuWriteU32(reg, (std::uint32_t)tmp);
+    else
+        fpuWriteU64(reg, tmp);
+}
+
+/* Conversions rounding another way than FCR31 switch the host mode for just that instruction */
+template <typename I, typename T> I CPU::fpuConvert(T value, int mode)
 {
-    fpuWriteU32(reg, *(std::uint32_t*)(&value));
+    std::uint32_t csr;
+    volatile T    input;
+    volatile I    result;
+
+    if (mode == 1)
+        return toInt<I, true>(value);
+    if (mode < 0 || mode == (int)(_fcr31 & FCR31_RM))
+        return toInt<I, false>(value);
+
+    input = value;
+    csr   = _mm_getcsr();
+    _mm_setcsr((csr & ~0x6000u) | kRoundingModes[mode]);
+    result = toInt<I, false>((T)input);
+    _mm_setcsr((_mm_getcsr() & ~0x6000u) | (csr & 0x6000u));
+    return result;
 }
 
-void CPU::fpuWriteF64(std::uint8_t reg, double value)
+/*
+ * Reloads the guest MXCSR before an operation, so the flags it raises are
+ * its own and not left over from host code that ran in between, like an
+ * MMIO handler.
+ */
+void CPU::fpuBegin()
 {
-    fpuWriteU64(reg, *(std::uint64_t*)(&value));
+    _mm_setcsr(_mxcsr);
+}
+
+/*
+ * Takes the exceptions the host raised since fpuBegin, and any the
+ * operation raises itself, as the new cause. Enabled ones trap and the
+ * result must be dropped, the others accumulate in the flags.
+ */
+bool CPU::fpuCommit(std::uint32_t cause)
+{
+    cause |= hostExceptions(_mm_getcsr());
+
+    _fcr31 = (_fcr31 & ~FCR31_CAUSE) | (cause << 12);
+    if (cause & (((_fcr31 >> 7) & 0x1f) | FPU_EXC_UNIMPL))
+    {
+        fpuTrap();
+        return false;
+    }
+    _fcr31 |= cause << 2;
+    return true;
+}
+
+void CPU::fpuTrap()
+{
+    NIN64_LOG(CPU, Trace, "FPU exception 0x%08x at 0x%016llx\n", _fcr31, (unsigned long long)_instrPc);
+    _pc          = _instrPc;
+    _branchDelay = _instrDelay;
+    exception(EXC_FPE, 0xffffffff80000180ull);
 }
 
 std::uint32_t CPU::fcrRead(std::uint8_t reg)
@@ -1667,6 +2331,7 @@ std::uint32_t CPU::fcrRead(std::uint8_t reg)
     switch (reg)
     {
     case FCR_CONTROL:
+        value = _fcr31 | (_fpCompare ? FCR31_C : 0);
         break;
     case FCR_REVISION:
         value = 0x000B0100;
@@ -1683,6 +2348,13 @@ void CPU::fcrWrite(std::uint8_t reg, std::uint32_t value)
     switch (reg)
     {
     case FCR_CONTROL:
+        _fcr31     = value & FCR31_MASK & ~FCR31_C;
+        _fpCompare = !!(value & FCR31_C);
+        _mxcsr     = hostCsr(_fcr31);
+
+        /* Writing a cause bit that is enabled traps, unimplemented operation always does */
+        if ((_fcr31 >> 12) & (((_fcr31 >> 7) & 0x1f) | FPU_EXC_UNIMPL))
+            fpuTrap();
         break;
     case FCR_REVISION:
         break;
@@ -1690,3 +2362,98 @@ void CPU::fcrWrite(std::uint8_t reg, std::uint32_t value)
         break;
     }
 }
+
+void CPU::save(SavestateWriter& writer) const
+{
+    writer.begin("CPU ");
+    writer.write(_pc);
+    writer.write(_pcNext);
+    writer.write(_regs);
+    writer.write(_fpuRegs);
+    writer.write(_lo);
+    writer.write(_hi);
+    writer.write(_llAddr);
+    writer.write(_epc);
+    writer.write(_errorEpc);
+    writer.write(_ip);
+    writer.write(_im);
+    writer.write(_branchDelay);
+    writer.write<bool>(_erl);
+    writer.write<bool>(_exl);
+    writer.write<bool>(_ie);
+    writer.write<bool>(_llBit);
+    writer.write<bool>(_fpCompare);
+    writer.write<bool>(_bd);
+    writer.write<bool>(_fr);
+    writer.write(_fcr31);
+    writer.write(_countOffset);
+    writer.write(_compare);
+    writer.write(_index);
+    writer.write(_random);
+    writer.write(_entryLo0);
+    writer.write(_entryLo1);
+    writer.write(_context);
+    writer.write(_pageMask);
+    writer.write(_wired);
+    writer.write(_badVAddr);
+    writer.write(_entryHi);
+    writer.write(_tagLo);
+    writer.write(_tagHi);
+    writer.write(_excCode);
+    for (std::size_t i = 0; i < TLB::kEntryCount; ++i)
+        writer.write(_tlb.entry(i));
+    writer.write(_instructions);
+    writer.end();
+
+    if (_cache)
+        _cache->save(writer);
+}
+
+void CPU::load(SavestateReader& reader)
+{
+    TLB::Entry entries[TLB::kEntryCount];
+
+    reader.open("CPU ");
+    reader.read(_pc);
+    reader.read(_pcNext);
+    reader.read(_regs);
+    reader.read(_fpuRegs);
+    reader.read(_lo);
+    reader.read(_hi);
+    reader.read(_llAddr);
+    reader.read(_epc);
+    reader.read(_errorEpc);
+    reader.read(_ip);
+    reader.read(_im);
+    reader.read(_branchDelay);
+    _erl       = reader.read<bool>();
+    _exl       = reader.read<bool>();
+    _ie        = reader.read<bool>();
+    _llBit     = reader.read<bool>();
+    _fpCompare = reader.read<bool>();
+    _bd        = reader.read<bool>();
+    _fr        = reader.read<bool>();
+    reader.read(_fcr31);
+    _mxcsr = hostCsr(_fcr31);
+    reader.read(_countOffset);
+    reader.read(_compare);
+    reader.read(_index);
+    reader.read(_random);
+    reader.read(_entryLo0);
+    reader.read(_entryLo1);
+    reader.read(_context);
+    reader.read(_pageMask);
+    reader.read(_wired);
+    reader.read(_badVAddr);
+    reader.read(_entryHi);
+    reader.read(_tagLo);
+    reader.read(_tagHi);
+    reader.read(_excCode);
+    reader.read(entries);
+    reader.read(_instructions);
+    _tlb.load(entries, _entryHi & 0xff);
+    _lastBlock = nullptr;
+
+    if (_cache)
+        _cache->load(reader);
+}
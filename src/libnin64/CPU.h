@@ -3,38 +3,221 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <libnin64/BlockCache.h>
 #include <libnin64/CIC.h>
 #include <libnin64/MIPSInterface.h>
 #include <libnin64/NonCopyable.h>
+#include <libnin64/TLB.h>
 
 namespace libnin64
 {
 
+enum class CPUBackend
+{
+    Interpreter,
+    Recompiler
+};
+
 class Bus;
+class Cache;
+class Memory;
+class Recompiler;
+class SavestateReader;
+class SavestateWriter;
+class Scheduler;
 class CPU : private NonCopyable
 {
 public:
-    CPU(Bus& bus, MIPSInterface& mi);
+    CPU(Bus& bus, Memory& memory, MIPSInterface& mi, Scheduler& scheduler);
     ~CPU();
 
     std::uint64_t pc() const { return _pc; }
+    std::uint64_t instructions() const { return _instructions; }
 
-    void init(CIC cic);
-    void tick(std::size_t count);
+    void init(const CICInfo& cic, TvType tvType);
+    bool setBackend(CPUBackend backend);
+    void setCacheEmulation(bool enabled);
+    bool cacheEmulation() const { return _cache != nullptr; }
+    void run(std::uint64_t until);
     void tick();
+    void timer();
+
+    void save(SavestateWriter& writer) const;
+    void load(SavestateReader& reader);
 
 private:
+    friend class Recompiler;
+
+    template <void (CPU::*F)(const Instr&)> static void handler(CPU& cpu, const Instr& instr) { (cpu.*F)(instr); }
+
+    static const InstrHandler kCop1Handlers[4][64];
+
+    template <bool kCached> static InstrHandler decode(std::uint32_t op);
+    template <bool kCached> static void         predecode(Instr& instr, std::uint32_t op);
+    static int          blockEnd(std::uint32_t op);
+    static bool         idleLoop(std::uint32_t addr, const Instr* instrs, std::size_t size);
+
+    void   interrupt();
+    void   exception(std::uint8_t code, std::uint64_t vector);
+    void   step(const Instr& instr);
+    template <bool kCached> void interpret();
+    Block* compile(std::uint32_t addr);
+    void   execute(const Block& block);
+    bool   idleReadsClock(const Block& block) const;
+    void   skipIdle(std::uint64_t iteration, std::uint64_t until);
+
+    std::uint32_t count() const;
+    void          scheduleTimer();
+
+    void          stall(std::uint32_t cycles);
+    std::uint32_t mapping(std::uint32_t addr, bool write);
+    bool          translate(std::uint32_t addr, bool write, std::uint32_t& paddr);
+    std::uint32_t tlbMiss(std::uint32_t addr, bool write);
+
+    template <bool kCached, typename T> bool load(std::uint32_t addr, T& value);
+    template <bool kCached, typename T> bool store(std::uint32_t addr, T value);
+
+    void branch(const Instr& instr, bool taken);
+    void branchLikely(const Instr& instr, bool taken);
+
+    void opUnimplemented(const Instr& instr);
+    void opNop(const Instr& instr);
+
+    void opSLL(const Instr& instr);
+    void opSRL(const Instr& instr);
+    void opSRA(const Instr& instr);
+    void opSLLV(const Instr& instr);
+    void opSRLV(const Instr& instr);
+    void opSRAV(const Instr& instr);
+    void opJR(const Instr& instr);
+    void opJALR(const Instr& instr);
+    void opMFHI(const Instr& instr);
+    void opMTHI(const Instr& instr);
+    void opMFLO(const Instr& instr);
+    void opMTLO(const Instr& instr);
+    void opMULT(const Instr& instr);
+    void opMULTU(const Instr& instr);
+    void opDIV(const Instr& instr);
+    void opDIVU(const Instr& instr);
+    void opDMULT(const Instr& instr);
+    void opDMULTU(const Instr& instr);
+    void opDDIV(const Instr& instr);
+    void opDDIVU(const Instr& instr);
+    void opADDU(const Instr& instr);
+    void opSUBU(const Instr& instr);
+    void opAND(const Instr& instr);
+    void opOR(const Instr& instr);
+    void opXOR(const Instr& instr);
+    void opNOR(const Instr& instr);
+    void opSLT(const Instr& instr);
+    void opSLTU(const Instr& instr);
+    void opDADDU(const Instr& instr);
+    void opDSUBU(const Instr& instr);
+    void opDSLL(const Instr& instr);
+    void opDSRL(const Instr& instr);
+    void opDSRA(const Instr& instr);
+    void opDSLL32(const Instr& instr);
+    void opDSRL32(const Instr& instr);
+    void opDSRA32(const Instr& instr);
+
+    void opBLTZ(const Instr& instr);
+    void opBGEZ(const Instr& instr);
+    void opBLTZL(const Instr& instr);
+    void opBGEZL(const Instr& instr);
+    void opBLTZAL(const Instr& instr);
+    void opBGEZAL(const Instr& instr);
+    void opBLTZALL(const Instr& instr);
+    void opBGEZALL(const Instr& instr);
+
+    void opJ(const Instr& instr);
+    void opJAL(const Instr& instr);
+    void opBEQ(const Instr& instr);
+    void opBNE(const Instr& instr);
+    void opBLEZ(const Instr& instr);
+    void opBGTZ(const Instr& instr);
+    void opADDIU(const Instr& instr);
+    void opSLTI(const Instr& instr);
+    void opSLTIU(const Instr& instr);
+    void opANDI(const Instr& instr);
+    void opORI(const Instr& instr);
+    void opXORI(const Instr& instr);
+    void opLUI(const Instr& instr);
+    void opBEQL(const Instr& instr);
+    void opBNEL(const Instr& instr);
+    void opBLEZL(const Instr& instr);
+    void opBGTZL(const Instr& instr);
+    void opDADDIU(const Instr& instr);
+
+    void opMFC0(const Instr& instr);
+    void opDMFC0(const Instr& instr);
+    void opMTC0(const Instr& instr);
+    void opERET(const Instr& instr);
+    void opTLBR(const Instr& instr);
+    void opTLBWI(const Instr& instr);
+    void opTLBWR(const Instr& instr);
+    void opTLBP(const Instr& instr);
+
+    void opMFC1(const Instr& instr);
+    void opDMFC1(const Instr& instr);
+    void opCFC1(const Instr& instr);
+    void opMTC1(const Instr& instr);
+    void opDMTC1(const Instr& instr);
+    void opCTC1(const Instr& instr);
+    void opBC1F(const Instr& instr);
+    void opBC1T(const Instr& instr);
+    void opBC1FL(const Instr& instr);
+    void opBC1TL(const Instr& instr);
+
+    template <typename T> void                        opFADD(const Instr& instr);
+    template <typename T> void                        opFSUB(const Instr& instr);
+    template <typename T> void                        opFMUL(const Instr& instr);
+    template <typename T> void                        opFDIV(const Instr& instr);
+    template <typename T> void                        opFSQRT(const Instr& instr);
+    template <typename T> void                        opFABS(const Instr& instr);
+    template <typename T> void                        opFMOV(const Instr& instr);
+    template <typename T> void                        opFNEG(const Instr& instr);
+    template <typename T, typename I, int kMode> void opFTOI(const Instr& instr);
+    template <typename T, typename U> void            opFCVT(const Instr& instr);
+    template <typename T> void                        opFC(const Instr& instr);
+
+    template <bool kCached> void opLDR(const Instr& instr);
+    template <bool kCached> void opLB(const Instr& instr);
+    template <bool kCached> void opLH(const Instr& instr);
+    template <bool kCached> void opLWL(const Instr& instr);
+    template <bool kCached> void opLW(const Instr& instr);
+    template <bool kCached> void opLBU(const Instr& instr);
+    template <bool kCached> void opLHU(const Instr& instr);
+    template <bool kCached> void opLWR(const Instr& instr);
+    template <bool kCached> void opLWU(const Instr& instr);
+    template <bool kCached> void opSB(const Instr& instr);
+    template <bool kCached> void opSH(const Instr& instr);
+    template <bool kCached> void opSWL(const Instr& instr);
+    template <bool kCached> void opSW(const Instr& instr);
+    template <bool kCached> void opSWR(const Instr& instr);
+    template <bool kCached> void opLL(const Instr& instr);
+    template <bool kCached> void opLWC1(const Instr& instr);
+    template <bool kCached> void opLDC1(const Instr& instr);
+    template <bool kCached> void opLD(const Instr& instr);
+    template <bool kCached> void opSWC1(const Instr& instr);
+    template <bool kCached> void opSDC1(const Instr& instr);
+    template <bool kCached> void opSD(const Instr& instr);
+    void opCACHE(const Instr& instr);
+
     std::uint32_t cop0Read(std::uint8_t reg);
     void          cop0Write(std::uint8_t reg, std::uint32_t value);
 
     std::uint32_t fpuReadU32(std::uint8_t reg);
     std::uint64_t fpuReadU64(std::uint8_t reg);
-    float         fpuReadF32(std::uint8_t reg);
-    double        fpuReadF64(std::uint8_t reg);
     void          fpuWriteU32(std::uint8_t reg, std::uint32_t value);
     void          fpuWriteU64(std::uint8_t reg, std::uint64_t value);
-    void          fpuWriteF32(std::uint8_t reg, float value);
-    void          fpuWriteF64(std::uint8_t reg, double value);
+
+    template <typename T> T             fpuRead(std::uint8_t reg);
+    template <typename T> void          fpuWrite(std::uint8_t reg, T value);
+    template <typename I, typename T> I fpuConvert(T value, int mode);
+    void                                fpuBegin();
+    bool                                fpuCommit(std::uint32_t cause);
+    void                                fpuTrap();
 
     std::uint32_t fcrRead(std::uint8_t reg);
     void          fcrWrite(std::uint8_t reg, std::uint32_t value);
@@ -54,9 +237,20 @@ private:
 
     Bus&           _bus;
     MIPSInterface& _mi;
+    Scheduler&     _scheduler;
+    Memory&        _memory;
+    BlockCache     _blocks;
+    TLB            _tlb;
+
+    std::unique_ptr<Recompiler> _recompiler;
+    std::unique_ptr<Cache>      _cache;
+    const Block*                _lastBlock;
+    std::uint64_t               _lastBlockTime;
 
     std::uint64_t _pc;
     std::uint64_t _pcNext;
+    std::uint64_t _instrPc;
+    bool          _instrDelay;
     Reg           _regs[32];
     Reg           _fpuRegs[32];
     Reg           _lo;
@@ -66,16 +260,31 @@ private:
     std::uint32_t _errorEpc;
     std::uint8_t  _ip;
     std::uint8_t  _im;
+    bool          _branchDelay;
     bool          _erl : 1;
     bool          _exl : 1;
     bool          _ie : 1;
     bool          _llBit : 1;
     bool          _fpCompare : 1;
-    bool          _branchDelay : 1;
     bool          _bd : 1;
     bool          _fr : 1;
-    std::uint32_t _count;
+    std::uint32_t _fcr31;
+    std::uint32_t _mxcsr;
+    std::uint64_t _countOffset;
     std::uint32_t _compare;
+    std::uint32_t _index;
+    std::uint32_t _random;
+    std::uint32_t _entryLo0;
+    std::uint32_t _entryLo1;
+    std::uint32_t _context;
+    std::uint32_t _pageMask;
+    std::uint32_t _wired;
+    std::uint32_t _badVAddr;
+    std::uint32_t _entryHi;
+    std::uint32_t _tagLo;
+    std::uint32_t _tagHi;
+    std::uint8_t  _excCode;
+    std::uint64_t _instructions;
 };
 
 } // namespace libnin64
@@ -0,0 +1,67 @@
+#include <cstdint>
+#include <libnin64/CPUFeatures.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+using namespace libnin64;
+
+static void cpuid(std::uint32_t leaf, std::uint32_t subleaf, std::uint32_t* regs)
+{
+#if defined(_MSC_VER)
+    int tmp[4];
+
+    __cpuidex(tmp, (int)leaf, (int)subleaf);
+    for (int i = 0; i < 4; ++i)
+        regs[i] = (std::uint32_t)tmp[i];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static std::uint64_t xgetbv()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    std::uint32_t lo;
+    std::uint32_t hi;
+
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((std::uint64_t)hi << 32) | lo;
+#endif
+}
+
+static CPUFeatures detect()
+{
+    CPUFeatures   features{};
+    std::uint32_t regs[4];
+    std::uint32_t maxLeaf;
+
+    cpuid(0, 0, regs);
+    maxLeaf = regs[0];
+    if (maxLeaf < 1)
+        return features;
+
+    cpuid(1, 0, regs);
+    features.ssse3  = !!(regs[2] & (1 << 9));
+    features.sse42  = !!(regs[2] & (1 << 20));
+    features.pclmul = !!(regs[2] & (1 << 1));
+
+    /* The OS must save the YMM registers */
+    if (maxLeaf < 7 || !(regs[2] & (1 << 27)) || (xgetbv() & 0x6) != 0x6)
+        return features;
+
+    cpuid(7, 0, regs);
+    features.avx2 = !!(regs[1] & (1 << 5));
+    return features;
+}
+
+const CPUFeatures& CPUFeatures::host()
+{
+    static const CPUFeatures features = detect();
+    return features;
+}
@@ -0,0 +1,24 @@
+#ifndef INCLUDED_CPU_FEATURES_H
+#define INCLUDED_CPU_FEATURES_H
+
+namespace libnin64
+{
+
+/*
+ * Instruction set extensions of the host, for the kernels built for more
+ * than the baseline. Each of them lives in its own translation unit,
+ * compiled for its instruction set, and is only called when present.
+ */
+struct CPUFeatures
+{
+    static const CPUFeatures& host();
+
+    bool ssse3;
+    bool sse42;
+    bool pclmul;
+    bool avx2;
+};
+
+} // namespace libnin64
+
+#endif
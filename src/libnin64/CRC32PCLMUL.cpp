@@ -0,0 +1,77 @@
+#include <libnin64/Util.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+/*
+ * CRC32 by folding with carry-less multiplies, after Intel's "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction". Four
+ * 128-bit accumulators fold 64 bytes per iteration, then get folded into
+ * one, which a Barrett reduction brings down to 32 bits. The constants are
+ * those of the paper, in the bit-reflected domain.
+ */
+
+using namespace libnin64;
+
+alignas(16) static const std::uint64_t kFold4[2]   = {0x0154442bd4, 0x01c6e41596};
+alignas(16) static const std::uint64_t kFold1[2]   = {0x01751997d0, 0x00ccaa009e};
+alignas(16) static const std::uint64_t kFold64[2]  = {0x0163cd6124, 0x0000000000};
+alignas(16) static const std::uint64_t kBarrett[2] = {0x01db710641, 0x01f7011641};
+
+static __m128i fold(__m128i acc, __m128i k, __m128i data)
+{
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(acc, k, 0x11), _mm_clmulepi64_si128(acc, k, 0x00)), data);
+}
+
+/* Takes and returns the CRC before its final inversion; length is at least 64, and a multiple of 16 */
+std::uint32_t libnin64::crc32PCLMUL(std::uint32_t crc, const void* data, std::size_t length)
+{
+    const std::uint8_t* in = (const std::uint8_t*)data;
+    __m128i             x0;
+    __m128i             x1;
+    __m128i             x2;
+    __m128i             x3;
+    __m128i             x4;
+    __m128i             mask;
+
+    x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + 0x00)), _mm_cvtsi32_si128((int)crc));
+    x2 = _mm_loadu_si128((const __m128i*)(in + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(in + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(in + 0x30));
+    in     += 64;
+    length -= 64;
+
+    x0 = _mm_load_si128((const __m128i*)kFold4);
+    for (; length >= 64; length -= 64, in += 64)
+    {
+        x1 = fold(x1, x0, _mm_loadu_si128((const __m128i*)(in + 0x00)));
+        x2 = fold(x2, x0, _mm_loadu_si128((const __m128i*)(in + 0x10)));
+        x3 = fold(x3, x0, _mm_loadu_si128((const __m128i*)(in + 0x20)));
+        x4 = fold(x4, x0, _mm_loadu_si128((const __m128i*)(in + 0x30)));
+    }
+
+    x0 = _mm_load_si128((const __m128i*)kFold1);
+    x1 = fold(x1, x0, x2);
+    x1 = fold(x1, x0, x3);
+    x1 = fold(x1, x0, x4);
+    for (; length >= 16; length -= 16, in += 16)
+        x1 = fold(x1, x0, _mm_loadu_si128((const __m128i*)in));
+
+    /* 128 to 64 bits */
+    mask = _mm_setr_epi32(-1, 0, -1, 0);
+    x2   = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x1   = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x0   = _mm_loadl_epi64((const __m128i*)kFold64);
+    x2   = _mm_srli_si128(x1, 4);
+    x1   = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask), x0, 0x00), x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_load_si128((const __m128i*)kBarrett);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), x0, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (std::uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
@@ -0,0 +1,183 @@
+#include <libnin64/Cache.h>
+#include <libnin64/Log.h>
+#include <libnin64/Savestate.h>
+#include <libnin64/Timing.h>
+
+using namespace libnin64;
+
+Cache::Cache(Bus& bus)
+: _bus{bus}
+, _icache{}
+, _dcache{}
+, _stall{}
+{
+}
+
+Cache::~Cache()
+{
+}
+
+std::uint32_t Cache::fetch(std::uint32_t addr)
+{
+    ILine& line = _icache[iIndex(addr)];
+
+    if (!line.valid || line.tag != (addr >> 12))
+    {
+        fill(line.data, addr & ~0x1fu, sizeof(line.data));
+        line.tag   = addr >> 12;
+        line.valid = true;
+        _stall += Timing::kICacheMiss;
+    }
+    return swap(*(std::uint32_t*)(line.data + (addr & 0x1c)));
+}
+
+/*
+ * Index and hit operations, from the low two bits of op (0 for the
+ * instruction cache, 1 for the data cache) and the three above them.
+ * TagLo holds the physical tag in bits 27:8, and the valid and dirty bits
+ * in 7 and 6.
+ */
+void Cache::op(std::uint8_t op, std::uint32_t vaddr, std::uint32_t paddr, std::uint32_t& tagLo)
+{
+    std::size_t index;
+    bool        hit;
+
+    if ((op & 3) == 0)
+    {
+        index       = (op & 0x10) ? iIndex(paddr) : iIndex(vaddr);
+        ILine& line = _icache[index];
+
+        hit = line.valid && line.tag == (paddr >> 12);
+        switch (op >> 2)
+        {
+        case 0: // Index Invalidate
+            line.valid = false;
+            break;
+        case 1: // Index Load Tag
+            tagLo = (line.tag << 8) | (line.valid ? 0x80 : 0);
+            break;
+        case 2: // Index Store Tag
+            line.tag   = (tagLo >> 8) & 0xfffff;
+            line.valid = !!(tagLo & 0x80);
+            break;
+        case 4: // Hit Invalidate
+            if (hit)
+                line.valid = false;
+            break;
+        case 5: // Fill
+            fill(line.data, paddr & ~0x1fu, sizeof(line.data));
+            line.tag   = paddr >> 12;
+            line.valid = true;
+            _stall += Timing::kICacheMiss;
+            break;
+        case 6: // Hit Write Back
+            if (hit)
+                flush(line.data, paddr & ~0x1fu, sizeof(line.data));
+            break;
+        default:
+            NIN64_LOG(CPU, Warn, "Unknown instruction cache op %d\n", op >> 2);
+            break;
+        }
+    }
+    else if ((op & 3) == 1)
+    {
+        index       = (op & 0x10) ? dIndex(paddr) : dIndex(vaddr);
+        DLine& line = _dcache[index];
+
+        hit = line.valid && line.tag == (paddr >> 12);
+        switch (op >> 2)
+        {
+        case 0: // Index Write Back Invalidate
+            writeBack(line, index);
+            line.valid = false;
+            break;
+        case 1: // Index Load Tag
+            tagLo = (line.tag << 8) | (line.valid ? 0x80 : 0) | (line.dirty ? 0x40 : 0);
+            break;
+        case 2: // Index Store Tag
+            line.tag   = (tagLo >> 8) & 0xfffff;
+            line.valid = !!(tagLo & 0x80);
+            line.dirty = !!(tagLo & 0x40);
+            break;
+        case 3: // Create Dirty Exclusive
+            if (!hit)
+                writeBack(line, index);
+            line.tag   = paddr >> 12;
+            line.valid = true;
+            line.dirty = true;
+            break;
+        case 4: // Hit Invalidate
+            if (hit)
+                line.valid = false;
+            break;
+        case 5: // Hit Write Back Invalidate
+            if (hit)
+            {
+                writeBack(line, index);
+                line.valid = false;
+            }
+            break;
+        case 6: // Hit Write Back
+            if (hit)
+                writeBack(line, index);
+            break;
+        default:
+            NIN64_LOG(CPU, Warn, "Unknown data cache op %d\n", op >> 2);
+            break;
+        }
+    }
+}
+
+void Cache::writeBack()
+{
+    for (std::size_t i = 0; i < kDCacheLines; ++i)
+        writeBack(_dcache[i], i);
+}
+
+void Cache::save(SavestateWriter& writer) const
+{
+    writer.begin("CACH");
+    writer.write(_icache);
+    writer.write(_dcache);
+    writer.end();
+}
+
+void Cache::load(SavestateReader& reader)
+{
+    reader.open("CACH");
+    reader.read(_icache);
+    reader.read(_dcache);
+}
+
+/* Write back first, then allocate: the line now holds addr, clean */
+void Cache::miss(DLine& line, std::uint32_t addr)
+{
+    writeBack(line, dIndex(addr));
+    fill(line.data, addr & ~0xfu, sizeof(line.data));
+    line.tag   = addr >> 12;
+    line.valid = true;
+    line.dirty = false;
+    _stall += Timing::kDCacheMiss;
+}
+
+/* Lines keep the big endian layout of memory */
+void Cache::fill(std::uint8_t* data, std::uint32_t addr, std::size_t size)
+{
+    for (std::size_t i = 0; i < size; i += 4)
+        *(std::uint32_t*)(data + i) = swap(_bus.read32(addr + (std::uint32_t)i));
+}
+
+void Cache::flush(const std::uint8_t* data, std::uint32_t addr, std::size_t size)
+{
+    for (std::size_t i = 0; i < size; i += 4)
+        _bus.write32(addr + (std::uint32_t)i, swap(*(const std::uint32_t*)(data + i)));
+}
+
+void Cache::writeBack(DLine& line, std::size_t index)
+{
+    if (!line.valid || !line.dirty)
+        return;
+    flush(line.data, (line.tag << 12) | (std::uint32_t)(index << 4), sizeof(line.data));
+    line.dirty = false;
+    _stall += Timing::kWriteBack;
+}
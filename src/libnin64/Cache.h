@@ -0,0 +1,118 @@
+#ifndef INCLUDED_CACHE_H
+#define INCLUDED_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <libnin64/Bus.h>
+#include <libnin64/NonCopyable.h>
+#include <libnin64/Util.h>
+
+namespace libnin64
+{
+
+class SavestateReader;
+class SavestateWriter;
+
+/*
+ * VR4300 primary caches, for accuracy test suites.
+ *
+ * Both are direct mapped with physical tags: 16KiB of instruction cache in
+ * 32-byte lines, and 8KiB of write back, write allocate data cache in
+ * 16-byte lines. Lines hold their own copy of the data, so code that forgets
+ * to write back or invalidate around DMA fails the way it does on hardware.
+ * The CPU only goes through them, and only allocates them, when cache
+ * emulation is on.
+ */
+class Cache : private NonCopyable
+{
+public:
+    Cache(Bus& bus);
+    ~Cache();
+
+    std::uint32_t fetch(std::uint32_t addr);
+
+    template <typename T> T    read(std::uint32_t addr);
+    template <typename T> void write(std::uint32_t addr, T value);
+
+    /* CACHE instruction. Index operations pick the line from vaddr, hit operations match paddr */
+    void op(std::uint8_t op, std::uint32_t vaddr, std::uint32_t paddr, std::uint32_t& tagLo);
+
+    /* Writes every dirty line back to memory */
+    void writeBack();
+
+    /* Cycles spent on misses and write backs since the last call */
+    std::uint32_t stall();
+
+    void save(SavestateWriter& writer) const;
+    void load(SavestateReader& reader);
+
+private:
+    static constexpr const std::size_t kICacheLines = 0x4000 / 32;
+    static constexpr const std::size_t kDCacheLines = 0x2000 / 16;
+
+    struct ILine
+    {
+        std::uint8_t  data[32];
+        std::uint32_t tag;
+        bool          valid;
+    };
+
+    struct DLine
+    {
+        std::uint8_t  data[16];
+        std::uint32_t tag;
+        bool          valid;
+        bool          dirty;
+    };
+
+    static std::size_t iIndex(std::uint32_t addr) { return (addr >> 5) & (kICacheLines - 1); }
+    static std::size_t dIndex(std::uint32_t addr) { return (addr >> 4) & (kDCacheLines - 1); }
+
+    DLine& dLine(std::uint32_t addr);
+    void   miss(DLine& line, std::uint32_t addr);
+    void   fill(std::uint8_t* data, std::uint32_t addr, std::size_t size);
+    void   flush(const std::uint8_t* data, std::uint32_t addr, std::size_t size);
+    void   writeBack(DLine& line, std::size_t index);
+
+    Bus&          _bus;
+    ILine         _icache[kICacheLines];
+    DLine         _dcache[kDCacheLines];
+    std::uint32_t _stall;
+};
+
+inline Cache::DLine& Cache::dLine(std::uint32_t addr)
+{
+    DLine& line = _dcache[dIndex(addr)];
+
+    if (!line.valid || line.tag != (addr >> 12))
+        miss(line, addr);
+    return line;
+}
+
+inline std::uint32_t Cache::stall()
+{
+    std::uint32_t cycles;
+
+    cycles = _stall;
+    _stall = 0;
+    return cycles;
+}
+
+template <typename T> inline T Cache::read(std::uint32_t addr)
+{
+    DLine& line = dLine(addr);
+
+    return swap(*(T*)(line.data + (addr & 0xf & ~(sizeof(T) - 1))));
+}
+
+template <typename T> inline void Cache::write(std::uint32_t addr, T value)
+{
+    DLine& line = dLine(addr);
+
+    *(T*)(line.data + (addr & 0xf & ~(sizeof(T) - 1))) = swap(value);
+    line.dirty = true;
+}
+
+} // namespace libnin64
+
+#endif
@@ -1,140 +1,80 @@
 #include <algorithm>
-#include <cstdio>
 #include <libnin64/Cart.h>
+#include <libnin64/Rom.h>
 #include <libnin64/Util.h>
 
 using namespace libnin64;
 
-inline static constexpr std::uint32_t swapWords(std::uint32_t v)
-{
-    return swap16(v & 0xffff) | (swap16(v >> 16) << 16);
-}
-
 Cart::Cart()
-: _data{}
+: _rom{}
+, _data{}
 , _size{}
+, _cic{&CICInfo::find(0)}
 {
 }
 
 Cart::~Cart()
 {
-    delete[] _data;
 }
 
-CIC Cart::cic() const
+/* From the country code in the ROM header */
+TvType Cart::tvType() const
 {
-    std::uint32_t cicChecksum;
-
-    cicChecksum = crc32(_data + 0x40, 0x1000 - 0x40);
-    switch (cicChecksum)
+    switch (_data ? _data[0x3e] : 0)
     {
-    case 0x90bb6cb5:
-        return CIC::NUS_6102;
-    case 0x0b050ee0:
-        return CIC::NUS_6103;
-    case 0x98bc2c86:
-        return CIC::NUS_6105;
+    case 'D': /* Germany */
+    case 'F': /* France */
+    case 'I': /* Italy */
+    case 'P': /* Europe */
+    case 'S': /* Spain */
+    case 'U': /* Australia */
+    case 'X': /* Europe */
+    case 'Y': /* Europe */
+        return TvType::PAL;
     default:
-        return CIC::Unknown;
+        return TvType::NTSC;
     }
 }
 
+std::uint64_t Cart::fingerprint() const
+{
+    return _rom ? _rom->fingerprint() : 0;
+}
+
+/* Reads past the end of the ROM return zeroes */
 void Cart::read(std::uint8_t *dst, std::uint32_t offset, std::uint32_t size)
 {
-    std::copy(_data + offset, _data + offset + size, dst);
+    std::uint32_t count{};
+
+    if (offset < _size)
+        count = std::min(size, _size - offset);
+    std::copy(_data + offset, _data + offset + count, dst);
+    std::fill(dst + count, dst + size, 0);
 }
 
 Nin64Err Cart::load(const char *path)
 {
-    std::FILE *file;
-    std::uint32_t magic{};
-    bool byteSwap;
-    bool wordSwap;
+    Nin64Err err;
 
     /* If there was already a cart loaded, unload it properly */
-    delete[] _data;
+    _rom.reset();
     _data = nullptr;
     _size = 0;
+    _cic  = &CICInfo::find(0);
 
-    file = std::fopen(path, "rb");
-    if (!file)
+    if ((err = Rom::open(path, _rom)))
     {
-        return NIN64_ERROR_IO;
-    }
-
-    /* Detect the correct endianess */
-    std::fread(&magic, 4, 1, file);
-    switch (magic & 0xff)
-    {
-    case 0x80:
-        /* Big-Endian ROM */
-        byteSwap = false;
-        wordSwap = false;
-        break;
-    case 0x37:
-        /* Little-Endian ROM */
-        byteSwap = false;
-        wordSwap = true;
-        break;
-    case 0x40:
-        /* Middle-Endian ROM */
-        byteSwap = true;
-        wordSwap = false;
-        break;
-    case 0x12:
-        /* Alternative Middle-Endian ROM - very rare */
-        byteSwap = true;
-        wordSwap = true;
-        break;
-    default:
-        std::fclose(file);
-        return NIN64_ERROR_BADROM;
-    }
-
-    /* Fix up the magic */
-    if (byteSwap)
-    {
-        magic = swap32(magic);
-    }
-    if (wordSwap)
-    {
-        magic = swapWords(magic);
-    }
-
-    /* Check the fixed up magic */
-    if (magic != 0x40123780)
-    {
-        std::fclose(file);
-        return NIN64_ERROR_BADROM;
-    }
-
-    /* Get the ROM size */
-    std::fseek(file, 0, SEEK_END);
-    _size = std::ftell(file);
-
-    /* Read the ROM */
-    std::fseek(file, 0, SEEK_SET);
-    _data = new std::uint8_t[_size];
-    std::fread(_data, _size, 1, file);
-    std::fclose(file);
-
-    /* Byte swap */
-    if (byteSwap)
-    {
-        for (std::uint32_t i = 0; i < _size / 4; ++i)
-        {
-            ((std::uint32_t *)_data)[i] = swap32(((std::uint32_t *)_data)[i]);
-        }
-    }
-
-    /* Word swap */
-    if (wordSwap)
-    {
-        for (std::uint32_t i = 0; i < _size / 4; ++i)
-        {
-            ((std::uint32_t *)_data)[i] = swapWords(((std::uint32_t *)_data)[i]);
-        }
+        return err;
     }
+    _data = _rom->data();
+    _size = _rom->size();
+    _cic  = &CICInfo::find(crc32(_data + 0x40, 0x1000 - 0x40));
 
     return NIN64_OK;
 }
+
+/* Maps the ROM without copying it, if the host allows it */
+bool Cart::map(std::uint8_t *addr, std::size_t size) const
+{
+    return _rom && _rom->map(addr, size);
+}
@@ -1,7 +1,9 @@
 #ifndef INCLUDED_CART_H
 #define INCLUDED_CART_H
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <nin64/nin64.h>
 #include <libnin64/CIC.h>
 #include <libnin64/NonCopyable.h>
@@ -9,19 +11,34 @@
 namespace libnin64
 {
 
+class Rom;
+
+/*
+ * Cartridge ROM, stored big endian. The image is shared with every other
+ * cart of the process holding the same ROM, see Rom.
+ */
 class Cart : private NonCopyable
 {
 public:
     Cart();
     ~Cart();
 
-    CIC         cic() const;
+    const std::uint8_t* data() const { return _data; }
+    std::uint32_t       size() const { return _size; }
+    std::uint64_t       fingerprint() const;
+
+    const CICInfo& cic() const { return *_cic; }
+    TvType         tvType() const;
+
     void        read(std::uint8_t* dst, std::uint32_t offset, std::uint32_t size);
     Nin64Err    load(const char* path);
+    bool        map(std::uint8_t* addr, std::size_t size) const;
 
 private:
-    std::uint8_t* _data;
-    std::uint32_t   _size;
+    std::shared_ptr<const Rom> _rom;
+    const std::uint8_t*        _data;
+    std::uint32_t              _size;
+    const CICInfo*             _cic;
 };
 
 }
@@ -0,0 +1,84 @@
+#include <libnin64/Fastmem.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+using namespace libnin64;
+
+Fastmem::Fastmem()
+: _base{}
+{
+    void* base;
+
+    if (!supported())
+        return;
+
+#if defined(_WIN32)
+    base = VirtualAlloc(nullptr, kSize, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    base = mmap(nullptr, kSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+        base = nullptr;
+#endif
+    _base = (std::uint8_t*)base;
+}
+
+Fastmem::~Fastmem()
+{
+    if (!_base)
+        return;
+#if defined(_WIN32)
+    VirtualFree(_base, 0, MEM_RELEASE);
+#else
+    munmap(_base, kSize);
+#endif
+}
+
+bool Fastmem::supported()
+{
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(_WIN32) || defined(__linux__) || defined(__APPLE__))
+    return true;
+#else
+    return false;
+#endif
+}
+
+/* Make a range readable and writable, zero filled */
+std::uint8_t* Fastmem::commit(std::uint32_t addr, std::size_t size)
+{
+    if (!_base)
+        return nullptr;
+#if defined(_WIN32)
+    if (!VirtualAlloc(_base + addr, size, MEM_COMMIT, PAGE_READWRITE))
+        return nullptr;
+#else
+    if (mprotect(_base + addr, size, PROT_READ | PROT_WRITE))
+        return nullptr;
+#endif
+    return _base + addr;
+}
+
+/* Make a committed range read-only */
+void Fastmem::protect(std::uint32_t addr, std::size_t size)
+{
+#if defined(_WIN32)
+    DWORD old;
+
+    VirtualProtect(_base + addr, size, PAGE_READONLY, &old);
+#else
+    mprotect(_base + addr, size, PROT_READ);
+#endif
+}
+
+/* Drop the backing of a range, accessing it faults again */
+void Fastmem::release(std::uint32_t addr, std::size_t size)
+{
+#if defined(_WIN32)
+    VirtualFree(_base + addr, size, MEM_DECOMMIT);
+#else
+    mmap(_base + addr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+#endif
+}
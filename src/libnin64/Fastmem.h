@@ -0,0 +1,42 @@
+#ifndef INCLUDED_FASTMEM_H
+#define INCLUDED_FASTMEM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <libnin64/NonCopyable.h>
+
+namespace libnin64
+{
+
+/*
+ * Host mirror of the N64 physical address space.
+ *
+ * A 4GiB region is reserved with no access, and the memories that can be
+ * addressed directly are committed at their physical offsets. Any other
+ * access faults, so that generated code can use a single host load for
+ * every guest load and take the slow path only on a fault.
+ */
+class Fastmem : private NonCopyable
+{
+public:
+    static constexpr const std::uint64_t kSize = 0x100000000ull;
+
+    Fastmem();
+    ~Fastmem();
+
+    static bool supported();
+
+    bool          valid() const { return _base != nullptr; }
+    std::uint8_t* base() const { return _base; }
+
+    std::uint8_t* commit(std::uint32_t addr, std::size_t size);
+    void          protect(std::uint32_t addr, std::size_t size);
+    void          release(std::uint32_t addr, std::size_t size);
+
+private:
+    std::uint8_t* _base;
+};
+
+} // namespace libnin64
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef INCLUDED_HOST_FPU_H
+#define INCLUDED_HOST_FPU_H
+
+#include <cstdint>
+#include <x86intrin.h>
+#include <libnin64/NonCopyable.h>
+
+namespace libnin64
+{
+
+/*
+ * The CPU runs guest floating point with its own MXCSR loaded, for the
+ * guest rounding mode and flush to zero. Code reached from inside the CPU
+ * that calls back into the host, like the frontend audio callback, holds a
+ * HostFpu for the duration of the call to get the caller's MXCSR back.
+ */
+class HostFpu : private NonCopyable
+{
+public:
+    HostFpu()
+    : _saved{}
+    , _active{tGuest}
+    {
+        if (!_active)
+            return;
+        _saved = _mm_getcsr();
+        _mm_setcsr(tHost);
+    }
+
+    ~HostFpu()
+    {
+        if (_active)
+            _mm_setcsr(_saved);
+    }
+
+    /* Loads the guest MXCSR on this thread, until leave puts the host one back */
+    static void enter(std::uint32_t guest)
+    {
+        tHost  = _mm_getcsr();
+        tGuest = true;
+        _mm_setcsr(guest);
+    }
+
+    static void leave()
+    {
+        _mm_setcsr(tHost);
+        tGuest = false;
+    }
+
+private:
+    std::uint32_t _saved;
+    bool          _active;
+
+    inline static thread_local std::uint32_t tHost{};
+    inline static thread_local bool          tGuest{};
+};
+
+} // namespace libnin64
+
+#endif
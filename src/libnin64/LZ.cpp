@@ -0,0 +1,159 @@
+#include <cstring>
+#include <libnin64/LZ.h>
+
+using namespace libnin64;
+
+/*
+ * A stream of sequences: a token byte holding the literal count in its high
+ * nibble and the match length minus 4 in its low nibble, the literals, then
+ * a 16-bit little endian match offset. A nibble of 15 is extended by the
+ * bytes that follow, up to and including the first that is not 255. The
+ * last sequence only holds literals and ends the stream.
+ */
+
+static constexpr const std::size_t kMinMatch     = 4;
+static constexpr const std::size_t kMaxOffset    = 0xffff;
+static constexpr const unsigned    kHashBits     = 12;
+static constexpr const std::size_t kTail         = 12;
+static constexpr const std::size_t kLastLiterals = 5;
+
+static std::uint32_t read32(const std::uint8_t* p)
+{
+    std::uint32_t value;
+
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+static std::uint32_t hash(std::uint32_t seq)
+{
+    return (seq * 2654435761u) >> (32 - kHashBits);
+}
+
+static std::uint8_t* writeLength(std::uint8_t* out, std::size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *out++ = 255;
+    *out++ = (std::uint8_t)length;
+    return out;
+}
+
+static std::uint8_t* writeLiterals(std::uint8_t* out, const std::uint8_t* literals, std::size_t count, std::uint8_t matchNibble)
+{
+    *out++ = (std::uint8_t)(((count < 15) ? count : 15) << 4) | matchNibble;
+    if (count >= 15)
+        out = writeLength(out, count - 15);
+    std::memcpy(out, literals, count);
+    return out + count;
+}
+
+static bool readLength(const std::uint8_t*& in, const std::uint8_t* end, std::size_t& length)
+{
+    std::uint8_t b;
+
+    do
+    {
+        if (in == end)
+            return false;
+        b = *in++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+std::size_t libnin64::lzCompress(const void* src, std::size_t size, void* dst)
+{
+    const std::uint8_t* in  = (const std::uint8_t*)src;
+    std::uint8_t*       out = (std::uint8_t*)dst;
+    std::uint32_t       table[1 << kHashBits]{};
+    std::size_t         ip{};
+    std::size_t         anchor{};
+    std::size_t         ref;
+    std::size_t         length;
+    std::uint32_t       seq;
+    std::uint32_t       h;
+
+    if (size > kTail)
+    {
+        while (ip < size - kTail)
+        {
+            seq      = read32(in + ip);
+            h        = hash(seq);
+            ref      = table[h];
+            table[h] = (std::uint32_t)ip;
+            if (ref >= ip || ip - ref > kMaxOffset || read32(in + ref) != seq)
+            {
+                /* Skip faster through data that does not compress */
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            length = kMinMatch;
+            while (ip + length < size - kLastLiterals && in[ref + length] == in[ip + length])
+                length++;
+
+            length -= kMinMatch;
+            out    = writeLiterals(out, in + anchor, ip - anchor, (std::uint8_t)((length < 15) ? length : 15));
+            *out++ = (std::uint8_t)(ip - ref);
+            *out++ = (std::uint8_t)((ip - ref) >> 8);
+            if (length >= 15)
+                out = writeLength(out, length - 15);
+
+            ip     += length + kMinMatch;
+            anchor  = ip;
+        }
+    }
+
+    out = writeLiterals(out, in + anchor, size - anchor, 0);
+    return out - (std::uint8_t*)dst;
+}
+
+bool libnin64::lzDecompress(const void* src, std::size_t size, void* dst, std::size_t dstSize)
+{
+    const std::uint8_t* in  = (const std::uint8_t*)src;
+    const std::uint8_t* end = in + size;
+    std::uint8_t*       out = (std::uint8_t*)dst;
+    std::size_t         op{};
+    std::size_t         count;
+    std::size_t         offset;
+    std::uint8_t        token;
+
+    while (in < end)
+    {
+        token = *in++;
+        count = token >> 4;
+        if (count == 15 && !readLength(in, end, count))
+            return false;
+        if (count > (std::size_t)(end - in) || count > dstSize - op)
+            return false;
+        std::memcpy(out + op, in, count);
+        in += count;
+        op += count;
+        if (in == end)
+            break;
+
+        if (end - in < 2)
+            return false;
+        offset = in[0] | (in[1] << 8);
+        in += 2;
+        count = token & 15;
+        if (count == 15 && !readLength(in, end, count))
+            return false;
+        count += kMinMatch;
+        if (!offset || offset > op || count > dstSize - op)
+            return false;
+
+        /* Matches may overlap what they produce */
+        if (offset == 1)
+            std::memset(out + op, out[op - 1], count);
+        else if (offset >= count)
+            std::memcpy(out + op, out + op - offset, count);
+        else
+        {
+            for (std::size_t i = 0; i < count; ++i)
+                out[op + i] = out[op + i - offset];
+        }
+        op += count;
+    }
+    return op == dstSize;
+}
@@ -0,0 +1,26 @@
+#ifndef INCLUDED_LZ_H
+#define INCLUDED_LZ_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace libnin64
+{
+
+/*
+ * Byte oriented LZ77 codec, in the spirit of LZ4: no entropy coding, a
+ * single pass with a small hash table, and a decoder that is little more
+ * than memcpy. It is tuned for state deltas, which are mostly zero runs.
+ */
+
+/* Largest compressed size of size bytes */
+constexpr std::size_t lzBound(std::size_t size) { return size + size / 255 + 16; }
+
+std::size_t lzCompress(const void* src, std::size_t size, void* dst);
+
+/* Fails on corrupt data, or when the output is not exactly dstSize bytes */
+bool lzDecompress(const void* src, std::size_t size, void* dst, std::size_t dstSize);
+
+} // namespace libnin64
+
+#endif
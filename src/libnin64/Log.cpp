@@ -0,0 +1,125 @@
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <libnin64/Log.h>
+
+using namespace libnin64;
+
+Log& Log::instance()
+{
+    static Log log;
+    return log;
+}
+
+Log::Log()
+: _slots{std::make_unique<Slot[]>(kSlotCount)}
+, _head{}
+, _tail{}
+, _dropped{}
+, _quit{}
+{
+    for (std::size_t i = 0; i < kSlotCount; ++i)
+        _slots[i].sequence.store(i, std::memory_order_relaxed);
+    _thread = std::thread{&Log::loop, this};
+}
+
+Log::~Log()
+{
+    _quit.store(true, std::memory_order_release);
+    _thread.join();
+}
+
+/*
+ * A slot is free for position pos when its sequence is pos, and holds a
+ * message once its sequence is pos + 1. The writer claims a position by
+ * bumping the head, as in a bounded MPMC queue with a single consumer.
+ */
+void Log::write(LogLevel level, const char* fmt, ...)
+{
+    std::size_t pos;
+    std::size_t sequence;
+    Slot*       slot;
+    va_list     args;
+    int         size;
+
+    pos = _head.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        slot     = &_slots[pos % kSlotCount];
+        sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence == pos)
+        {
+            if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if ((std::ptrdiff_t)(sequence - pos) < 0)
+        {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = _head.load(std::memory_order_relaxed);
+        }
+    }
+
+    va_start(args, fmt);
+    size = std::vsnprintf(slot->message, kMessageSize, fmt, args);
+    va_end(args);
+    slot->size = (size < 0) ? 0 : ((std::size_t)size < kMessageSize) ? (std::size_t)size : kMessageSize - 1;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    if (level >= LogLevel::Error)
+        flush();
+}
+
+/* Waits until everything logged so far has been written */
+void Log::flush()
+{
+    std::size_t head = _head.load(std::memory_order_acquire);
+
+    while (_tail.load(std::memory_order_acquire) < head)
+        std::this_thread::yield();
+}
+
+void Log::loop()
+{
+    for (;;)
+    {
+        bool quit = _quit.load(std::memory_order_acquire);
+
+        if (!drain())
+        {
+            if (quit)
+                return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+bool Log::drain()
+{
+    std::size_t tail = _tail.load(std::memory_order_relaxed);
+    std::size_t dropped;
+    Slot*       slot;
+    bool        drained{};
+
+    for (;;)
+    {
+        slot = &_slots[tail % kSlotCount];
+        if (slot->sequence.load(std::memory_order_acquire) != tail + 1)
+            break;
+
+        std::fwrite(slot->message, 1, slot->size, stderr);
+        slot->sequence.store(tail + kSlotCount, std::memory_order_release);
+        _tail.store(++tail, std::memory_order_release);
+        drained = true;
+    }
+
+    dropped = _dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped)
+        std::fprintf(stderr, "Log: %zu messages dropped\n", dropped);
+    if (drained || dropped)
+        std::fflush(stderr);
+    return drained;
+}
@@ -0,0 +1,112 @@
+#ifndef INCLUDED_LOG_H
+#define INCLUDED_LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <libnin64/NonCopyable.h>
+
+/* Lowest level compiled in, as a LogLevel value */
+#ifndef NIN64_LOG_LEVEL
+#define NIN64_LOG_LEVEL 2
+#endif
+
+/* Mask of the channels compiled in, one bit per LogChannel value */
+#ifndef NIN64_LOG_CHANNELS
+#define NIN64_LOG_CHANNELS 0xffffffff
+#endif
+
+#if defined(__GNUC__)
+#define NIN64_PRINTF(fmt, args) __attribute__((format(printf, fmt, args)))
+#else
+#define NIN64_PRINTF(fmt, args)
+#endif
+
+/*
+ * Logs a printf-style message. Messages below NIN64_LOG_LEVEL, or on a
+ * channel outside NIN64_LOG_CHANNELS, are compiled out along with their
+ * arguments.
+ */
+#define NIN64_LOG(channel, level, ...)                                                                       \
+    do                                                                                                       \
+    {                                                                                                        \
+        if constexpr (::libnin64::kLogEnabled<::libnin64::LogChannel::channel, ::libnin64::LogLevel::level>) \
+            ::libnin64::Log::instance().write(::libnin64::LogLevel::level, __VA_ARGS__);                     \
+    } while (0)
+
+namespace libnin64
+{
+
+enum class LogChannel : std::uint8_t
+{
+    Core,
+    CPU,
+    COP0,
+    RSP,
+    RDP,
+    MI,
+    PI,
+    SI,
+    VI,
+    AI,
+    Bus,
+};
+
+enum class LogLevel : std::uint8_t
+{
+    Trace,
+    Debug,
+    Info,
+    Warn,
+    Error,
+};
+
+template <LogChannel channel, LogLevel level>
+constexpr bool kLogEnabled = (int)level >= NIN64_LOG_LEVEL && ((NIN64_LOG_CHANNELS >> (int)channel) & 1);
+
+/*
+ * Asynchronous log sink.
+ *
+ * Messages are formatted by the caller into a bounded ring that any thread
+ * can push to without taking a lock, and written to stderr by a background
+ * thread. When the ring is full, messages are dropped and counted. Errors
+ * are flushed before write() returns, as they usually precede an exit.
+ */
+class Log : private NonCopyable
+{
+public:
+    static Log& instance();
+
+    void write(LogLevel level, const char* fmt, ...) NIN64_PRINTF(3, 4);
+    void flush();
+
+private:
+    static constexpr const std::size_t kSlotCount   = 4096;
+    static constexpr const std::size_t kMessageSize = 240;
+
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence;
+        std::size_t              size;
+        char                     message[kMessageSize];
+    };
+
+    Log();
+    ~Log();
+
+    void loop();
+    bool drain();
+
+    std::unique_ptr<Slot[]>  _slots;
+    std::atomic<std::size_t> _head;
+    std::atomic<std::size_t> _tail;
+    std::atomic<std::size_t> _dropped;
+    std::atomic<bool>        _quit;
+    std::thread              _thread;
+};
+
+} // namespace libnin64
+
+#endif
@@ -1,5 +1,7 @@
-#include <cstdio>
+#include <libnin64/Log.h>
 #include <libnin64/MIPSInterface.h>
+#include <libnin64/Savestate.h>
+#include <libnin64/Scheduler.h>
 
 #define MI_INIT_MODE_REG 0x04300000
 #define MI_VERSION_REG   0x04300004
@@ -8,8 +10,11 @@
 
 using namespace libnin64;
 
-MIPSInterface::MIPSInterface()
-: _interrupts{}
+MIPSInterface::MIPSInterface(Scheduler& scheduler)
+: _scheduler{scheduler}
+, _postedSet{}
+, _postedClear{}
+, _interrupts{}
 , _interruptsMask{}
 {
 }
@@ -30,18 +35,18 @@ std::uint32_t MIPSInterface::read(std::uint32_t reg)
     switch (reg)
     {
     case MI_INIT_MODE_REG:
-        std::printf("MI Read: MI_INIT_MODE_REG\n");
+        NIN64_LOG(MI, Trace, "MI Read: MI_INIT_MODE_REG\n");
         break;
     case MI_VERSION_REG:
-        std::printf("MI Read: MI_VERSION_REG\n");
+        NIN64_LOG(MI, Trace, "MI Read: MI_VERSION_REG\n");
         value = 0x01010101;
         break;
     case MI_INTR_REG:
-        std::printf("MI Read: MI_INTR_REG\n");
+        NIN64_LOG(MI, Trace, "MI Read: MI_INTR_REG\n");
         value = _interrupts;
         break;
     case MI_INTR_MASK_REG:
-        std::printf("MI Read: MI_INTR_MASK_REG\n");
+        NIN64_LOG(MI, Trace, "MI Read: MI_INTR_MASK_REG\n");
         value = _interruptsMask;
         break;
     }
@@ -54,19 +59,19 @@ void MIPSInterface::write(std::uint32_t reg, std::uint32_t value)
     switch (reg)
     {
     case MI_INIT_MODE_REG:
-        std::printf("MI Write: MI_INIT_MODE_REG 0x%08x\n", value);
+        NIN64_LOG(MI, Trace, "MI Write: MI_INIT_MODE_REG 0x%08x\n", value);
         if (value & (1 << 11)) clearInterrupt(MI_INTR_DP);
         break;
     case MI_VERSION_REG:
-        std::printf("MI Write: MI_VERSION_REG 0x%08x\n", value);
+        NIN64_LOG(MI, Trace, "MI Write: MI_VERSION_REG 0x%08x\n", value);
         /* No-op */
         break;
     case MI_INTR_REG:
-        std::printf("MI Write: MI_INTR_REG 0x%08x\n", value);
+        NIN64_LOG(MI, Trace, "MI Write: MI_INTR_REG 0x%08x\n", value);
         /* No-op */
         break;
     case MI_INTR_MASK_REG:
-        std::printf("MI Write: MI_INTR_MASK_REG 0x%08x\n", value);
+        NIN64_LOG(MI, Trace, "MI Write: MI_INTR_MASK_REG 0x%08x\n", value);
         // No handling of metastable input (https://en.wikibooks.org/wiki/Digital_Circuits/Latches#SR_latch)
         // SP (Clear/Set)
         if (value & (1 << 0)) _interruptsMask &= ~MI_INTR_SP;
@@ -85,6 +90,7 @@ void MIPSInterface::write(std::uint32_t reg, std::uint32_t value)
         // DP (Clear/Set)
         if (value & (1 << 10)) _interruptsMask &= ~MI_INTR_DP;
         if (value & (1 << 11)) _interruptsMask |= MI_INTR_DP;
+        _scheduler.yield();
         break;
     }
 }
@@ -96,11 +102,40 @@ bool MIPSInterface::checkInterrupt(std::uint8_t intr) const
 
 void MIPSInterface::setInterrupt(std::uint8_t intr)
 {
-    std::printf("MI Interrupt: 0x%02x\n", intr);
+    NIN64_LOG(MI, Trace, "MI Interrupt: 0x%02x\n", intr);
     _interrupts |= intr;
+    _scheduler.yield();
 }
 
 void MIPSInterface::clearInterrupt(std::uint8_t intr)
 {
     _interrupts &= ~intr;
 }
+
+void MIPSInterface::deliver()
+{
+    std::uint8_t intr;
+
+    if ((intr = _postedClear.exchange(0)))
+        clearInterrupt(intr);
+    if ((intr = _postedSet.exchange(0)))
+        setInterrupt(intr);
+}
+
+/* Posted interrupts must have been delivered */
+void MIPSInterface::save(SavestateWriter& writer) const
+{
+    writer.begin("MI  ");
+    writer.write(_interrupts);
+    writer.write(_interruptsMask);
+    writer.end();
+}
+
+void MIPSInterface::load(SavestateReader& reader)
+{
+    reader.open("MI  ");
+    reader.read(_interrupts);
+    reader.read(_interruptsMask);
+    _postedSet.store(0);
+    _postedClear.store(0);
+}
@@ -1,6 +1,7 @@
 #ifndef INCLUDED_MIPS_INTERFACE_H
 #define INCLUDED_MIPS_INTERFACE_H
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <libnin64/NonCopyable.h>
@@ -15,10 +16,13 @@
 namespace libnin64
 {
 
+class SavestateReader;
+class SavestateWriter;
+class Scheduler;
 class MIPSInterface : private NonCopyable
 {
 public:
-    MIPSInterface();
+    MIPSInterface(Scheduler& scheduler);
     ~MIPSInterface();
 
     std::uint8_t ip() const;
@@ -30,7 +34,20 @@ public:
     void setInterrupt(std::uint8_t intr);
     void clearInterrupt(std::uint8_t intr);
 
+    /* From coprocessor threads, applied by deliver() on the CPU thread */
+    void postInterrupt(std::uint8_t intr) { _postedSet.fetch_or(intr); }
+    void postClearInterrupt(std::uint8_t intr) { _postedClear.fetch_or(intr); }
+    void deliver();
+
+    void save(SavestateWriter& writer) const;
+    void load(SavestateReader& reader);
+
 private:
+    Scheduler& _scheduler;
+
+    std::atomic<std::uint8_t> _postedSet;
+    std::atomic<std::uint8_t> _postedClear;
+
     std::uint8_t _interrupts;
     std::uint8_t _interruptsMask;
 };
@@ -1,15 +1,147 @@
+#include <cstring>
 #include <libnin64/Memory.h>
+#include <libnin64/Savestate.h>
 
 using namespace libnin64;
 
 Memory::Memory()
-: ram{}
+: fastmem{}
+, ram{}
 , spDmem{}
 , spImem{}
 , pif{}
+, generation{}
+, _checkpoint{}
 {
+    std::uint8_t* sp{};
+
+    if (fastmem.valid())
+    {
+        ram = fastmem.commit(0x00000000, kRamSize);
+        sp  = fastmem.commit(0x04000000, 0x2000);
+    }
+    if (!ram || !sp)
+    {
+        _storage = std::make_unique<std::uint8_t[]>(kRamSize + 0x2000);
+        ram      = _storage.get();
+        sp       = ram + kRamSize;
+    }
+    spDmem = sp;
+    spImem = sp + 0x1000;
 }
 
 Memory::~Memory()
 {
 }
+
+void Memory::markWritten(std::uint32_t addr, std::uint32_t size)
+{
+    std::uint32_t first;
+    std::uint32_t last;
+
+    if (!size)
+        return;
+
+    first = offset(addr);
+    last  = first + size - 1;
+    if (addr < kRamSize && last >= kRamSize)
+        last = kRamSize - 1;
+    for (std::uint32_t i = first >> kLineShift; i <= (last >> kLineShift) && i < kLineCount; ++i)
+        generation[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Memory::save(SavestateWriter& writer) const
+{
+    writer.begin("MEM ");
+    writer.write(ram, kRamSize);
+    writer.write(spDmem, 0x1000);
+    writer.write(spImem, 0x1000);
+    writer.write(pif);
+    writer.end();
+}
+
+void Memory::saveDelta(SavestateWriter& writer) const
+{
+    std::uint32_t first;
+    std::uint32_t last;
+
+    writer.begin("MEMD");
+    writer.write(pif);
+    for (first = 0; first < kLineCount; first = last)
+    {
+        if (generation[first] == _checkpoint[first])
+        {
+            last = first + 1;
+            continue;
+        }
+
+        /* Runs stay on one side of the RDRAM/SP boundary */
+        last = first + 1;
+        while (last < kLineCount && last != kRamLines && generation[last] != _checkpoint[last])
+            last++;
+        writer.write(first);
+        writer.write(last - first);
+        writer.write(lineData(first), (last - first) << kLineShift);
+    }
+    writer.end();
+}
+
+/* Everything loaded changed under the block cache */
+void Memory::load(SavestateReader& reader)
+{
+    std::uint32_t first;
+    std::uint32_t count;
+
+    if (reader.sectionSize("MEMD") < 0)
+    {
+        reader.open("MEM ");
+        reader.read(ram, kRamSize);
+        reader.read(spDmem, 0x1000);
+        reader.read(spImem, 0x1000);
+        reader.read(pif);
+        markWritten(0x00000000, kRamSize);
+        markWritten(0x04000000, 0x2000);
+        return;
+    }
+
+    reader.open("MEMD");
+    reader.read(pif);
+    while (reader.ok() && reader.remaining())
+    {
+        first = reader.read<std::uint32_t>();
+        count = reader.read<std::uint32_t>();
+        if (!count || first >= kLineCount || count > kLineCount - first || (first < kRamLines && first + count > kRamLines))
+        {
+            reader.fail();
+            return;
+        }
+        reader.read(lineData(first), count << kLineShift);
+        for (std::uint32_t i = first; i < first + count; ++i)
+            generation[i].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/* Walks the runs of a delta without applying them */
+bool Memory::checkDelta(SavestateReader& reader) const
+{
+    std::uint32_t first;
+    std::uint32_t count;
+
+    reader.open("MEMD");
+    reader.skip(sizeof(pif));
+    while (reader.ok() && reader.remaining())
+    {
+        first = reader.read<std::uint32_t>();
+        count = reader.read<std::uint32_t>();
+        if (!count || first >= kLineCount || count > kLineCount - first || (first < kRamLines && first + count > kRamLines))
+            return false;
+        reader.skip(count << kLineShift);
+    }
+    return reader.ok();
+}
+
+void Memory::checkpoint()
+{
+    for (std::size_t i = 0; i < kLineCount; ++i)
+        _checkpoint[i] = generation[i].load(std::memory_order_relaxed);
+}
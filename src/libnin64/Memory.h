@@ -1,24 +1,73 @@
 #ifndef INCLUDED_MEMORY_H
 #define INCLUDED_MEMORY_H
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <libnin64/Fastmem.h>
 #include <libnin64/NonCopyable.h>
 
 namespace libnin64
 {
 
+class SavestateReader;
+class SavestateWriter;
 class Memory : private NonCopyable
 {
 public:
+    static constexpr const std::size_t   kRamSize   = 8 * 1024 * 1024;
+    static constexpr const unsigned      kLineShift = 8;
+    static constexpr const std::size_t   kLineCount = (kRamSize + 0x2000) >> kLineShift;
+    static constexpr const std::size_t   kLineSize  = std::size_t(1) << kLineShift;
+    static constexpr const std::uint32_t kRamLines  = kRamSize >> kLineShift;
+
     Memory();
     ~Memory();
 
-    std::uint8_t ram[8 * 1024 * 1024];
-    std::uint8_t spDmem[0x1000];
-    std::uint8_t spImem[0x1000];
-    std::uint8_t pif[0x40];
+    /* Flat offset of a physical address in RDRAM or SP memory */
+    static std::uint32_t offset(std::uint32_t addr) { return (addr < kRamSize) ? addr : std::uint32_t(kRamSize + (addr & 0x1fff)); }
+    static std::uint32_t line(std::uint32_t addr) { return offset(addr) >> kLineShift; }
+
+    /* Lines in RDRAM come first, then SP memory */
+    std::uint8_t* lineData(std::uint32_t line) const { return (line < kRamLines) ? ram + (line << kLineShift) : spDmem + ((line - kRamLines) << kLineShift); }
+
+    /*
+     * Every write to RDRAM or SP memory must go through one of these. The
+     * RSP and RDP workers write memory too, so the counts are atomic; only
+     * a change matters, not its ordering.
+     */
+    void markWritten(std::uint32_t addr) { generation[line(addr)].fetch_add(1, std::memory_order_relaxed); }
+    void markWritten(std::uint32_t addr, std::uint32_t size);
+
+    /*
+     * Save states. A delta only holds the lines written since the last
+     * checkpoint(), found by comparing write generations.
+     */
+    void save(SavestateWriter& writer) const;
+    void saveDelta(SavestateWriter& writer) const;
+    void load(SavestateReader& reader);
+    bool checkDelta(SavestateReader& reader) const;
+    void checkpoint();
+
+    /* RDRAM and SP memory live in the fastmem region when there is one */
+    Fastmem fastmem;
+
+    std::uint8_t* ram;
+    std::uint8_t* spDmem;
+    std::uint8_t* spImem;
+    std::uint8_t  pif[0x40];
+
+    std::atomic<std::uint32_t> generation[kLineCount];
+
+private:
+    std::unique_ptr<std::uint8_t[]> _storage;
+    std::uint32_t                   _checkpoint[kLineCount];
 };
 
+/* Generated code reads and bumps the generations as plain 32-bit words */
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) && std::atomic<std::uint32_t>::is_always_lock_free, "generations must be plain words");
+
 } // namespace libnin64
 
 #endif
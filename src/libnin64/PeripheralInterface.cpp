@@ -1,8 +1,11 @@
-#include <cstdio>
 #include <libnin64/Cart.h>
+#include <libnin64/Log.h>
 #include <libnin64/MIPSInterface.h>
 #include <libnin64/Memory.h>
 #include <libnin64/PeripheralInterface.h>
+#include <libnin64/Savestate.h>
+#include <libnin64/Scheduler.h>
+#include <libnin64/Timing.h>
 
 #define PI_DRAM_ADDR_REG    0x04600000
 #define PI_CART_ADDR_REG    0x04600004
@@ -20,12 +23,15 @@
 
 using namespace libnin64;
 
-PeripheralInterface::PeripheralInterface(MIPSInterface& mi, Memory& memory, Cart& cart)
+PeripheralInterface::PeripheralInterface(MIPSInterface& mi, Scheduler& scheduler, Memory& memory, Cart& cart)
 : _mi{mi}
+, _scheduler{scheduler}
 , _memory{memory}
 , _cart{cart}
 , _dramAddr{}
 , _cartAddr{}
+, _domains{}
+, _dmaBusy{}
 {
 }
 
@@ -40,45 +46,55 @@ std::uint32_t PeripheralInterface::read(std::uint32_t reg)
     switch (reg)
     {
     case PI_DRAM_ADDR_REG:
-        std::puts("READ :: PI_DRAM_ADDR_REG");
+        NIN64_LOG(PI, Trace, "READ :: PI_DRAM_ADDR_REG\n");
         value = _dramAddr;
         break;
     case PI_CART_ADDR_REG:
-        std::puts("READ :: PI_CART_ADDR_REG");
+        NIN64_LOG(PI, Trace, "READ :: PI_CART_ADDR_REG\n");
         value = _cartAddr;
         break;
     case PI_RD_LEN_REG:
-        std::puts("READ :: PI_RD_LEN_REG");
+        NIN64_LOG(PI, Trace, "READ :: PI_RD_LEN_REG\n");
         break;
     case PI_WR_LEN_REG:
-        std::puts("READ :: PI_WR_LEN_REG");
+        NIN64_LOG(PI, Trace, "READ :: PI_WR_LEN_REG\n");
         break;
     case PI_STATUS_REG:
-        std::puts("READ :: PI_STATUS_REG");
+        NIN64_LOG(PI, Trace, "READ :: PI_STATUS_REG\n");
+        if (_dmaBusy) value |= 0x01;
+        if (_mi.checkInterrupt(MI_INTR_PI)) value |= 0x08;
         break;
     case PI_BSD_DOM1_LAT_REG:
-        std::puts("READ :: PI_BSD_DOM1_LAT_REG");
+        NIN64_LOG(PI, Trace, "READ :: PI_BSD_DOM1_LAT_REG\n");
+        value = _domains[0].lat;
         break;
     case PI_BSD_DOM1_PWD_REG:
-        std::puts("READ :: PI_BSD_DOM1_PWD_REG");
+        NIN64_LOG(PI, Trace, "READ :: PI_BSD_DOM1_PWD_REG\n");
+        value = _domains[0].pwd;
         break;
     case PI_BSD_DOM1_PGS_REG:
-        std::puts("READ :: PI_BSD_DOM1_PGS_REG");
+        NIN64_LOG(PI, Trace, "READ :: PI_BSD_DOM1_PGS_REG\n");
+        value = _domains[0].pgs;
         break;
     case PI_BSD_DOM1_RLS_REG:
-        std::puts("READ :: PI_BSD_DOM1_RLS_REG");
+        NIN64_LOG(PI, Trace, "READ :: PI_BSD_DOM1_RLS_REG\n");
+        value = _domains[0].rls;
         break;
     case PI_BSD_DOM2_LAT_REG:
-        std::puts("READ :: PI_BSD_DOM2_LAT_REG");
+        NIN64_LOG(PI, Trace, "READ :: PI_BSD_DOM2_LAT_REG\n");
+        value = _domains[1].lat;
         break;
     case PI_BSD_DOM2_PWD_REG:
-        std::puts("READ :: PI_BSD_DOM2_PWD_REG");
+        NIN64_LOG(PI, Trace, "READ :: PI_BSD_DOM2_PWD_REG\n");
+        value = _domains[1].pwd;
         break;
     case PI_BSD_DOM2_PGS_REG:
-        std::puts("READ :: PI_BSD_DOM2_PGS_REG");
+        NIN64_LOG(PI, Trace, "READ :: PI_BSD_DOM2_PGS_REG\n");
+        value = _domains[1].pgs;
         break;
     case PI_BSD_DOM2_RLS_REG:
-        std::puts("READ :: PI_BSD_DOM2_RLS_REG");
+        NIN64_LOG(PI, Trace, "READ :: PI_BSD_DOM2_RLS_REG\n");
+        value = _domains[1].rls;
         break;
     default:
         break;
@@ -92,52 +108,109 @@ void PeripheralInterface::write(std::uint32_t reg, std::uint32_t value)
     switch (reg)
     {
     case PI_DRAM_ADDR_REG:
-        std::puts("WRITE :: PI_DRAM_ADDR_REG");
+        NIN64_LOG(PI, Trace, "WRITE :: PI_DRAM_ADDR_REG\n");
         _dramAddr = value & (0xffffff);
         break;
     case PI_CART_ADDR_REG:
-        std::puts("WRITE :: PI_CART_ADDR_REG");
+        NIN64_LOG(PI, Trace, "WRITE :: PI_CART_ADDR_REG\n");
         _cartAddr = value;
         break;
     case PI_RD_LEN_REG:
-        std::puts("WRITE :: PI_RD_LEN_REG");
-        _mi.setInterrupt(MI_INTR_PI);
+        NIN64_LOG(PI, Trace, "WRITE :: PI_RD_LEN_REG\n");
+        dmaStart((value & 0xffffff) + 1);
         break;
     case PI_WR_LEN_REG:
-        std::puts("WRITE :: PI_WR_LEN_REG");
-        std::printf("0x%08x 0x%08x 0x%08x\n", _dramAddr, _cartAddr, value);
+        NIN64_LOG(PI, Trace, "WRITE :: PI_WR_LEN_REG\n");
+        NIN64_LOG(PI, Trace, "0x%08x 0x%08x 0x%08x\n", _dramAddr, _cartAddr, value);
         _cart.read(_memory.ram + _dramAddr, _cartAddr & 0x0fffffff, (value & 0xffffff) + 1);
-        _mi.setInterrupt(MI_INTR_PI);
+        _memory.markWritten(_dramAddr, (value & 0xffffff) + 1);
+        dmaStart((value & 0xffffff) + 1);
         break;
     case PI_STATUS_REG:
-        std::puts("WRITE :: PI_STATUS_REG");
+        NIN64_LOG(PI, Trace, "WRITE :: PI_STATUS_REG\n");
         if (value & (1 << 1)) _mi.clearInterrupt(MI_INTR_PI);
         break;
     case PI_BSD_DOM1_LAT_REG:
-        std::puts("WRITE :: PI_BSD_DOM1_LAT_REG");
+        NIN64_LOG(PI, Trace, "WRITE :: PI_BSD_DOM1_LAT_REG\n");
+        _domains[0].lat = value & 0xff;
         break;
     case PI_BSD_DOM1_PWD_REG:
-        std::puts("WRITE :: PI_BSD_DOM1_PWD_REG");
+        NIN64_LOG(PI, Trace, "WRITE :: PI_BSD_DOM1_PWD_REG\n");
+        _domains[0].pwd = value & 0xff;
         break;
     case PI_BSD_DOM1_PGS_REG:
-        std::puts("WRITE :: PI_BSD_DOM1_PGS_REG");
+        NIN64_LOG(PI, Trace, "WRITE :: PI_BSD_DOM1_PGS_REG\n");
+        _domains[0].pgs = value & 0x0f;
         break;
     case PI_BSD_DOM1_RLS_REG:
-        std::puts("WRITE :: PI_BSD_DOM1_RLS_REG");
+        NIN64_LOG(PI, Trace, "WRITE :: PI_BSD_DOM1_RLS_REG\n");
+        _domains[0].rls = value & 0x03;
         break;
     case PI_BSD_DOM2_LAT_REG:
-        std::puts("WRITE :: PI_BSD_DOM2_LAT_REG");
+        NIN64_LOG(PI, Trace, "WRITE :: PI_BSD_DOM2_LAT_REG\n");
+        _domains[1].lat = value & 0xff;
         break;
     case PI_BSD_DOM2_PWD_REG:
-        std::puts("WRITE :: PI_BSD_DOM2_PWD_REG");
+        NIN64_LOG(PI, Trace, "WRITE :: PI_BSD_DOM2_PWD_REG\n");
+        _domains[1].pwd = value & 0xff;
         break;
     case PI_BSD_DOM2_PGS_REG:
-        std::puts("WRITE :: PI_BSD_DOM2_PGS_REG");
+        NIN64_LOG(PI, Trace, "WRITE :: PI_BSD_DOM2_PGS_REG\n");
+        _domains[1].pgs = value & 0x0f;
         break;
     case PI_BSD_DOM2_RLS_REG:
-        std::puts("WRITE :: PI_BSD_DOM2_RLS_REG");
+        NIN64_LOG(PI, Trace, "WRITE :: PI_BSD_DOM2_RLS_REG\n");
+        _domains[1].rls = value & 0x03;
         break;
     default:
         break;
     }
 }
+
+void PeripheralInterface::dmaComplete()
+{
+    _dmaBusy = false;
+    _mi.setInterrupt(MI_INTR_PI);
+}
+
+/* What the PIF sets up from the first word of the cart header before booting */
+void PeripheralInterface::init(std::uint32_t header)
+{
+    _domains[0].lat = header & 0xff;
+    _domains[0].pwd = (header >> 8) & 0xff;
+    _domains[0].pgs = (header >> 16) & 0x0f;
+    _domains[0].rls = (header >> 20) & 0x03;
+}
+
+void PeripheralInterface::dmaStart(std::uint32_t length)
+{
+    const Domain& domain = _domains[domain2(_cartAddr) ? 1 : 0];
+
+    _dmaBusy = true;
+    _scheduler.schedule(Event::PeripheralDma, Timing::peripheralDma(length, domain.lat, domain.pwd, domain.pgs, domain.rls));
+}
+
+/* The 64DD and SRAM windows, everything else on the cart bus is domain 1 */
+bool PeripheralInterface::domain2(std::uint32_t addr)
+{
+    return (addr >= 0x05000000 && addr < 0x06000000) || (addr >= 0x08000000 && addr < 0x10000000);
+}
+
+void PeripheralInterface::save(SavestateWriter& writer) const
+{
+    writer.begin("PI  ");
+    writer.write(_dramAddr);
+    writer.write(_cartAddr);
+    writer.write(_domains);
+    writer.write<bool>(_dmaBusy);
+    writer.end();
+}
+
+void PeripheralInterface::load(SavestateReader& reader)
+{
+    reader.open("PI  ");
+    reader.read(_dramAddr);
+    reader.read(_cartAddr);
+    reader.read(_domains);
+    _dmaBusy = reader.read<bool>();
+}
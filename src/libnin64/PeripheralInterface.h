@@ -11,22 +11,46 @@ namespace libnin64
 class Cart;
 class Memory;
 class MIPSInterface;
+class SavestateReader;
+class SavestateWriter;
+class Scheduler;
 class PeripheralInterface : private NonCopyable
 {
 public:
-    PeripheralInterface(MIPSInterface& mi, Memory& memory, Cart& cart);
+    PeripheralInterface(MIPSInterface& mi, Scheduler& scheduler, Memory& memory, Cart& cart);
     ~PeripheralInterface();
 
+    void          init(std::uint32_t header);
     std::uint32_t read(std::uint32_t reg);
     void          write(std::uint32_t reg, std::uint32_t value);
+    void          dmaComplete();
+
+    void save(SavestateWriter& writer) const;
+    void load(SavestateReader& reader);
 
 private:
+    /* Bus timings of a cart domain, from the PI_BSD_DOM registers */
+    struct Domain
+    {
+        std::uint8_t lat;
+        std::uint8_t pwd;
+        std::uint8_t pgs;
+        std::uint8_t rls;
+    };
+
+    static bool domain2(std::uint32_t addr);
+
+    void dmaStart(std::uint32_t length);
+
     MIPSInterface& _mi;
+    Scheduler&     _scheduler;
     Memory&        _memory;
     Cart&          _cart;
 
     std::uint32_t _dramAddr;
     std::uint32_t _cartAddr;
+    Domain        _domains[2];
+    bool          _dmaBusy : 1;
 };
 
 } // namespace libnin64
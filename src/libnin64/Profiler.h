@@ -0,0 +1,125 @@
+#ifndef INCLUDED_PROFILER_H
+#define INCLUDED_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <libnin64/NonCopyable.h>
+
+namespace libnin64
+{
+
+enum class Component : std::uint8_t
+{
+    CPU,
+    RSP,
+    RDP,
+    AI,
+    VI,
+    Count,
+};
+
+/*
+ * Wall time spent in each component, when enabled.
+ *
+ * Components time their own entry points with a Profiler::Scope. Scopes
+ * nest: a scope only counts the time not spent in the scopes it encloses,
+ * so the RDP list run from an RSP task is not counted twice. The CPU has no
+ * scope of its own, it gets whatever the others leave of State::run on the
+ * thread running it, which for a batch is any of the pool threads.
+ */
+class Profiler : private NonCopyable
+{
+public:
+    class Scope : private NonCopyable
+    {
+    public:
+        Scope(Profiler& profiler, Component component)
+        : _profiler{profiler.enabled() ? &profiler : nullptr}
+        , _component{component}
+        , _parent{}
+        , _children{}
+        {
+            if (!_profiler)
+                return;
+            _parent  = tCurrent;
+            tCurrent = this;
+            _start   = std::chrono::steady_clock::now();
+        }
+
+        ~Scope()
+        {
+            std::uint64_t elapsed;
+
+            if (!_profiler)
+                return;
+            elapsed  = Profiler::since(_start);
+            tCurrent = _parent;
+            if (_parent)
+                _parent->_children += elapsed;
+            _profiler->add(_component, elapsed - _children, tRunning == _profiler);
+        }
+
+    private:
+        Profiler*                             _profiler;
+        Component                             _component;
+        Scope*                                _parent;
+        std::uint64_t                         _children;
+        std::chrono::steady_clock::time_point _start;
+    };
+
+    Profiler()
+    : _time{}
+    , _inline{}
+    , _enabled{}
+    {
+    }
+
+    bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    void setEnabled(bool enabled) { _enabled.store(enabled, std::memory_order_release); }
+
+    std::uint64_t time(Component component) const { return _time[(int)component].load(std::memory_order_relaxed); }
+
+    /* Starts timing a slice of State::run, on whichever thread runs it */
+    std::chrono::steady_clock::time_point begin()
+    {
+        tRunning = this;
+        return std::chrono::steady_clock::now();
+    }
+
+    /* Ends the slice, charging what the scopes on this thread did not take to the CPU */
+    void run(std::chrono::steady_clock::time_point start)
+    {
+        std::uint64_t elapsed = since(start);
+        std::uint64_t other   = _inline.exchange(0, std::memory_order_relaxed);
+
+        tRunning = nullptr;
+        add(Component::CPU, (elapsed > other) ? elapsed - other : 0, false);
+    }
+
+    static std::uint64_t since(std::chrono::steady_clock::time_point start)
+    {
+        return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    void add(Component component, std::uint64_t time, bool running)
+    {
+        _time[(int)component].fetch_add(time, std::memory_order_relaxed);
+        if (running)
+            _inline.fetch_add(time, std::memory_order_relaxed);
+    }
+
+    inline static thread_local Scope*    tCurrent{};
+    inline static thread_local Profiler* tRunning{};
+
+    std::atomic<std::uint64_t> _time[(int)Component::Count];
+    std::atomic<std::uint64_t> _inline;
+    std::atomic<bool>          _enabled;
+};
+
+} // namespace libnin64
+
+#endif
@@ -1,91 +1,183 @@
-#include <cstdio>
+#include <algorithm>
 #include <cstdlib>
+#include <thread>
+#include <libnin64/Log.h>
 #include <libnin64/Memory.h>
 #include <libnin64/MipsInterface.h>
+#include <libnin64/Profiler.h>
 #include <libnin64/RDP.h>
+#include <libnin64/Savestate.h>
+#include <libnin64/Scheduler.h>
 #include <libnin64/Util.h>
 
-#define NOT_IMPLEMENTED()                                                                    \
-    do                                                                                       \
-    {                                                                                        \
-        std::printf("%s:%d: Unknown RDP Command: 0x%016llx\n", __FILE__, __LINE__, command); \
-        std::exit(1);                                                                        \
+#define NOT_IMPLEMENTED()                                                                              \
+    do                                                                                                 \
+    {                                                                                                  \
+        NIN64_LOG(RDP, Error, "%s:%d: Unknown RDP Command: 0x%016llx\n", __FILE__, __LINE__, command); \
+        std::exit(1);                                                                                  \
     } while (0)
 
+#define RDP_SYNC_CYCLES 1024
+
 using namespace libnin64;
 
-RDP::RDP(Memory& memory, MIPSInterface& mi)
+RDP::RDP(Memory& memory, MIPSInterface& mi, Scheduler& scheduler, Profiler& profiler)
 : _memory{memory}
 , _mi{mi}
-, _xbus{}
+, _scheduler{scheduler}
+, _profiler{profiler}
+, _rasterizer{memory}
+, _state{}
+, _texture{}
+, _tmem{std::make_shared<Tmem>()}
 , _cmdStart{}
 , _cmdEnd{}
 , _cmdCurrent{}
+, _xbus{}
 {
 }
 
 RDP::~RDP()
 {
+    if (_worker)
+        _worker->wait();
+}
+
+void RDP::setThreaded(bool threaded)
+{
+    if (threaded == !!_worker)
+        return;
+
+    if (threaded)
+    {
+        _worker = std::make_unique<Worker>();
+        _rasterizer.setThreads(std::thread::hardware_concurrency());
+    }
+    else
+    {
+        _worker->wait();
+        _worker.reset();
+        _rasterizer.setThreads(0);
+        _mi.deliver();
+    }
+}
+
+bool RDP::busy()
+{
+    return _worker && _worker->busy();
+}
+
+/* Checkpoint for command lists started by the CPU */
+void RDP::sync()
+{
+    bool busy;
+
+    if (!_worker)
+        return;
+    busy = _worker->busy();
+    _mi.deliver();
+    if (busy)
+        _scheduler.schedule(Event::RDP, RDP_SYNC_CYCLES);
+}
+
+/* Waits for the command list in flight, if any */
+void RDP::wait()
+{
+    if (!_worker)
+        return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _worker->wait();
 }
 
 std::uint32_t RDP::read(std::uint32_t reg)
+{
+    if (!_worker)
+        return regRead(reg);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _worker->wait();
+    return regRead(reg);
+}
+
+void RDP::write(std::uint32_t reg, std::uint32_t value)
+{
+    rspWrite(reg, value);
+    if (busy() && !_scheduler.pending(Event::RDP))
+        _scheduler.schedule(Event::RDP, RDP_SYNC_CYCLES);
+}
+
+void RDP::rspWrite(std::uint32_t reg, std::uint32_t value)
+{
+    if (!_worker)
+    {
+        regWrite(reg, value);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _worker->wait();
+    regWrite(reg, value);
+}
+
+std::uint32_t RDP::regRead(std::uint32_t reg)
 {
     std::uint32_t value{};
 
     switch (reg)
     {
     case DPC_START_REG:
-        std::printf("DP Read: DPC_START_REG\n");
+        NIN64_LOG(RDP, Trace, "DP Read: DPC_START_REG\n");
         value = _cmdStart;
         break;
     case DPC_END_REG:
-        std::printf("DP Read: DPC_END_REG\n");
+        NIN64_LOG(RDP, Trace, "DP Read: DPC_END_REG\n");
         value = _cmdEnd;
         break;
     case DPC_CURRENT_REG:
-        std::printf("DP Read: DPC_CURRENT_REG\n");
+        NIN64_LOG(RDP, Trace, "DP Read: DPC_CURRENT_REG\n");
         value = _cmdCurrent;
         break;
     case DPC_STATUS_REG:
-        std::printf("DP Read: DPC_STATUS_REG\n");
+        NIN64_LOG(RDP, Trace, "DP Read: DPC_STATUS_REG\n");
         if (_xbus)
             value |= 0x01;
         value |= 0x00000080;
         break;
     case DPC_CLOCK_REG:
-        std::printf("DP Read: DPC_CLOCK_REG\n");
+        NIN64_LOG(RDP, Error, "DP Read: DPC_CLOCK_REG\n");
         std::exit(1);
         break;
     case DPC_BUFBUSY_REG:
-        std::printf("DP Read: DPC_BUFBUSY_REG\n");
+        NIN64_LOG(RDP, Error, "DP Read: DPC_BUFBUSY_REG\n");
         std::exit(1);
         break;
     case DPC_PIPEBUSY_REG:
-        std::printf("DP Read: DPC_PIPEBUSY_REG\n");
+        NIN64_LOG(RDP, Error, "DP Read: DPC_PIPEBUSY_REG\n");
         std::exit(1);
         break;
     case DPC_TMEM_REG:
-        std::printf("DP Read: DPC_TMEM_REG\n");
+        NIN64_LOG(RDP, Error, "DP Read: DPC_TMEM_REG\n");
         std::exit(1);
         break;
     case DPS_TBIST_REG:
-        std::printf("DP Read: DPS_TBIST_REG\n");
+        NIN64_LOG(RDP, Error, "DP Read: DPS_TBIST_REG\n");
         std::exit(1);
         break;
     case DPS_TEST_MODE_REG:
-        std::printf("DP Read: DPS_TEST_MODE_REG\n");
+        NIN64_LOG(RDP, Error, "DP Read: DPS_TEST_MODE_REG\n");
         std::exit(1);
         break;
     case DPS_BUFTEST_ADDR_REG:
-        std::printf("DP Read: DPS_BUFTEST_ADDR_REG\n");
+        NIN64_LOG(RDP, Error, "DP Read: DPS_BUFTEST_ADDR_REG\n");
         std::exit(1);
         break;
     case DPS_BUFTEST_DATA_REG:
-        std::printf("DP Read: DPS_BUFTEST_DATA_REG\n");
+        NIN64_LOG(RDP, Error, "DP Read: DPS_BUFTEST_DATA_REG\n");
         std::exit(1);
         break;
     default:
-        std::printf("RDP Unknown reg\n");
+        NIN64_LOG(RDP, Error, "RDP Unknown reg\n");
         std::exit(1);
         break;
     }
@@ -93,177 +185,563 @@ std::uint32_t RDP::read(std::uint32_t reg)
     return value;
 }
 
-void RDP::write(std::uint32_t reg, std::uint32_t value)
+void RDP::regWrite(std::uint32_t reg, std::uint32_t value)
 {
     switch (reg)
     {
     case DPC_START_REG:
-        std::printf("DP Write DPC_START_REG: %08x\n", value);
+        NIN64_LOG(RDP, Trace, "DP Write DPC_START_REG: %08x\n", value);
         _cmdStart   = value & 0xffffff;
         _cmdCurrent = _cmdStart;
         break;
     case DPC_END_REG:
-        std::printf("DP Write DPC_END_REG: %08x\n", value);
+        NIN64_LOG(RDP, Trace, "DP Write DPC_END_REG: %08x\n", value);
         _cmdEnd = value & 0xffffff;
-        dma();
+        if (_worker)
+            _worker->submit([this] { dma(); });
+        else
+            dma();
         break;
     case DPC_CURRENT_REG:
-        std::printf("DP Write DPC_CURRENT_REG: %08x\n", value);
+        NIN64_LOG(RDP, Error, "DP Write DPC_CURRENT_REG: %08x\n", value);
         std::exit(1);
         break;
     case DPC_STATUS_REG:
-        std::printf("DP Write DPC_STATUS_REG: %08x\n", value);
+        NIN64_LOG(RDP, Trace, "DP Write DPC_STATUS_REG: %08x\n", value);
         if (value & 0x01) _xbus = false;
         if (value & 0x02) _xbus = true;
         break;
     case DPC_CLOCK_REG:
-        std::printf("DP Write DPC_CLOCK_REG: %08x\n", value);
+        NIN64_LOG(RDP, Error, "DP Write DPC_CLOCK_REG: %08x\n", value);
         std::exit(1);
         break;
     case DPC_BUFBUSY_REG:
-        std::printf("DP Write DPC_BUFBUSY_REG: %08x\n", value);
+        NIN64_LOG(RDP, Error, "DP Write DPC_BUFBUSY_REG: %08x\n", value);
         std::exit(1);
         break;
     case DPC_PIPEBUSY_REG:
-        std::printf("DP Write DPC_PIPEBUSY_REG: %08x\n", value);
+        NIN64_LOG(RDP, Error, "DP Write DPC_PIPEBUSY_REG: %08x\n", value);
         std::exit(1);
         break;
     case DPC_TMEM_REG:
-        std::printf("DP Write DPC_TMEM_REG: %08x\n", value);
+        NIN64_LOG(RDP, Error, "DP Write DPC_TMEM_REG: %08x\n", value);
         std::exit(1);
         break;
     case DPS_TBIST_REG:
-        std::printf("DP Write DPS_TBIST_REG: %08x\n", value);
+        NIN64_LOG(RDP, Error, "DP Write DPS_TBIST_REG: %08x\n", value);
         std::exit(1);
         break;
     case DPS_TEST_MODE_REG:
-        std::printf("DP Write DPS_TEST_MODE_REG: %08x\n", value);
+        NIN64_LOG(RDP, Error, "DP Write DPS_TEST_MODE_REG: %08x\n", value);
         std::exit(1);
         break;
     case DPS_BUFTEST_ADDR_REG:
-        std::printf("DP Write DPS_BUFTEST_ADDR_REG: %08x\n", value);
+        NIN64_LOG(RDP, Error, "DP Write DPS_BUFTEST_ADDR_REG: %08x\n", value);
         std::exit(1);
         break;
     case DPS_BUFTEST_DATA_REG:
-        std::printf("DP Write DPS_BUFTEST_DATA_REG: %08x\n", value);
+        NIN64_LOG(RDP, Error, "DP Write DPS_BUFTEST_DATA_REG: %08x\n", value);
         std::exit(1);
         break;
     default:
-        std::printf("RDP Unknown reg\n");
+        NIN64_LOG(RDP, Error, "RDP Unknown reg\n");
         std::exit(1);
         break;
     }
 }
 
+std::uint64_t RDP::fetch(std::uint32_t offset) const
+{
+    if (_xbus)
+        return swap64(*(const std::uint64_t*)(_memory.spDmem + (offset & 0xff8)));
+    return swap64(*(const std::uint64_t*)(_memory.ram + (offset & (Memory::kRamSize - 8))));
+}
+
+static std::uint32_t commandLength(std::uint8_t id)
+{
+    if (id >= 0x08 && id <= 0x0f)
+        return 4 + ((id & 4) ? 8 : 0) + ((id & 2) ? 8 : 0) + ((id & 1) ? 2 : 0);
+    if (id == 0x24 || id == 0x25)
+        return 2;
+    return 1;
+}
+
+static std::int32_t signExtend(std::uint64_t value, int bits)
+{
+    return (std::int32_t)((std::uint32_t)value << (32 - bits)) >> (32 - bits);
+}
+
+/* Attributes are split into integer and fractional halves, four per word */
+static std::int32_t fixedPoint(std::uint64_t ints, std::uint64_t fracs, int index)
+{
+    int shift = 48 - index * 16;
+
+    return (std::int32_t)((((ints >> shift) & 0xffff) << 16) | ((fracs >> shift) & 0xffff));
+}
+
+static RasterColor unpackColor(std::uint64_t w)
+{
+    return {(std::int32_t)((w >> 24) & 0xff), (std::int32_t)((w >> 16) & 0xff), (std::int32_t)((w >> 8) & 0xff), (std::int32_t)(w & 0xff)};
+}
+
+static RasterImage unpackImage(std::uint64_t w)
+{
+    RasterImage image;
+
+    image.format = (w >> 53) & 0x7;
+    image.size   = (w >> 51) & 0x3;
+    image.width  = ((w >> 32) & 0x3ff) + 1;
+    image.addr   = w & 0x3ffffff;
+    return image;
+}
+
+/* Commands that span several words are only run once they are complete */
 void RDP::dma()
 {
-    std::uint64_t command;
+    Profiler::Scope scope{_profiler, Component::RDP};
+    std::uint64_t   w[22];
+    std::uint32_t   length;
 
     while (_cmdCurrent < _cmdEnd)
     {
-        command = swap64(*(std::uint64_t*)(_memory.ram + _cmdCurrent));
-        _cmdCurrent += 8;
-
-        switch ((command >> 56) & 0x3f)
-        {
-        case 0x00: // No Op
-            NOT_IMPLEMENTED();
-            break;
-        case 0x08: // Non-ShadedTriangle
-        case 0x09:
-        case 0x0a:
-        case 0x0b:
-        case 0x0c:
-        case 0x0d:
-        case 0x0e:
-        case 0x0f:
-            NOT_IMPLEMENTED();
-            break;
-        case 0x25: // Texture Rectangle Flip
-            NOT_IMPLEMENTED();
-            break;
-        case 0x26: // Unknown
-            // TODO: Is this normal?
-            break;
-        case 0x27: // Sync Pipe
-            // TODO: Add me
+        w[0]   = fetch(_cmdCurrent);
+        length = commandLength((w[0] >> 56) & 0x3f);
+        if (_cmdCurrent + length * 8 > _cmdEnd)
             break;
-        case 0x28: // Sync Tile
-            // TODO: Add me
-            break;
-        case 0x29: // Sync Full
-            // TODO: Add me
+
+        for (std::uint32_t i = 1; i < length; ++i)
+            w[i] = fetch(_cmdCurrent + i * 8);
+        _cmdCurrent += length * 8;
+        execute(w);
+    }
+
+    _rasterizer.flush();
+    _rasterizer.wait();
+}
+
+void RDP::execute(const std::uint64_t* w)
+{
+    std::uint64_t command = w[0];
+
+    switch ((command >> 56) & 0x3f)
+    {
+    case 0x00: // No Op
+        break;
+    case 0x08: // Non-ShadedTriangle
+    case 0x09:
+    case 0x0a:
+    case 0x0b:
+    case 0x0c:
+    case 0x0d:
+    case 0x0e:
+    case 0x0f:
+        cmdTriangle(w, command & (4ull << 56), command & (2ull << 56), command & (1ull << 56));
+        break;
+    case 0x24: // Texture Rectangle
+        cmdRectangle(w, true, false);
+        break;
+    case 0x25: // Texture Rectangle Flip
+        cmdRectangle(w, true, true);
+        break;
+    case 0x26: // Sync Load
+    case 0x27: // Sync Pipe
+    case 0x28: // Sync Tile
+        break;
+    case 0x29: // Sync Full
+        _rasterizer.flush();
+        _rasterizer.wait();
+        if (_worker)
+            _mi.postInterrupt(MI_INTR_DP);
+        else
             _mi.setInterrupt(MI_INTR_DP);
-            break;
-        case 0x2a: // Set Key GB
-            NOT_IMPLEMENTED();
-            break;
-        case 0x2b: // Set Key R
-            NOT_IMPLEMENTED();
-            break;
-        case 0x2c: // Set Convert
-            NOT_IMPLEMENTED();
-            break;
-        case 0x2d: // Set Scissor
-            // TODO: Add me
-            break;
-        case 0x2e: // Set Prim Color
-            NOT_IMPLEMENTED();
-            break;
-        case 0x2f: // Set Other Modes
-            // TODO: Add me
-            break;
-        case 0x30: // Load Tlut
-            NOT_IMPLEMENTED();
-            break;
-        case 0x31: // Sync Load
-            NOT_IMPLEMENTED();
-            break;
-        case 0x32: // Set Tile Size
-            // TODO: Add me
-            break;
-        case 0x33: // Load Block
-            // TODO: Add me
-            break;
-        case 0x34: // Load Tile
-            NOT_IMPLEMENTED();
-            break;
-        case 0x35: // Set Tile
-            // TODO: Add me
-            break;
-        case 0x36: // Fill Rectangle
-            // TODO: Add me
-            break;
-        case 0x37: // Set Fill Color
-            // TODO: Add me
-            break;
-        case 0x38: // Set Fog Color
-            NOT_IMPLEMENTED();
-            break;
-        case 0x39: // Set Blend Color
-            NOT_IMPLEMENTED();
-            break;
-        case 0x3a: // Set Prim Color
-            NOT_IMPLEMENTED();
-            break;
-        case 0x3b: // Set Env Color
-            NOT_IMPLEMENTED();
-            break;
-        case 0x3c: // Set Combine Mode
-            // TODO: Add me
-            break;
-        case 0x3d: // Set Texture Image
-            // TODO: Add me
-            break;
-        case 0x3e: // Set Z Image
-            // TODO: Add me
-            break;
-        case 0x3f: // Set Color Image
-            // TODO: Add me
-            break;
-        default:
-            NOT_IMPLEMENTED();
-            break;
+        break;
+    case 0x2a: // Set Key GB
+        _state.keyCenter[1] = (command >> 24) & 0xff;
+        _state.keyScale[1]  = (command >> 16) & 0xff;
+        _state.keyCenter[2] = (command >> 8) & 0xff;
+        _state.keyScale[2]  = command & 0xff;
+        _snapshot.reset();
+        break;
+    case 0x2b: // Set Key R
+        _state.keyCenter[0] = (command >> 8) & 0xff;
+        _state.keyScale[0]  = command & 0xff;
+        _snapshot.reset();
+        break;
+    case 0x2c: // Set Convert
+        for (int i = 0; i < 6; ++i)
+            _state.convert[i] = signExtend(command >> (45 - i * 9), 9);
+        _snapshot.reset();
+        break;
+    case 0x2d: // Set Scissor
+        _state.scissor[0] = (command >> 44) & 0xfff;
+        _state.scissor[1] = (command >> 32) & 0xfff;
+        _state.scissor[2] = (command >> 12) & 0xfff;
+        _state.scissor[3] = command & 0xfff;
+        _snapshot.reset();
+        break;
+    case 0x2e: // Set Prim Depth
+        _state.primZ = (command >> 16) & 0xffff;
+        _snapshot.reset();
+        break;
+    case 0x2f: // Set Other Modes
+        _state.otherModes = command & 0x00ffffffffffffffull;
+        _snapshot.reset();
+        break;
+    case 0x30: // Load Tlut
+        cmdLoadTlut(command);
+        break;
+    case 0x31: // Unknown
+        NOT_IMPLEMENTED();
+        break;
+    case 0x32: // Set Tile Size
+    {
+        RasterTile& tile = _state.tiles[(command >> 24) & 7];
+
+        tile.sl = (command >> 44) & 0xfff;
+        tile.tl = (command >> 32) & 0xfff;
+        tile.sh = (command >> 12) & 0xfff;
+        tile.th = command & 0xfff;
+        _snapshot.reset();
+        break;
+    }
+    case 0x33: // Load Block
+        cmdLoadBlock(command);
+        break;
+    case 0x34: // Load Tile
+        cmdLoadTile(command);
+        break;
+    case 0x35: // Set Tile
+        cmdSetTile(command);
+        break;
+    case 0x36: // Fill Rectangle
+        cmdRectangle(w, false, false);
+        break;
+    case 0x37: // Set Fill Color
+        _state.fillColor = command & 0xffffffff;
+        _snapshot.reset();
+        break;
+    case 0x38: // Set Fog Color
+        _state.fog = unpackColor(command);
+        _snapshot.reset();
+        break;
+    case 0x39: // Set Blend Color
+        _state.blend = unpackColor(command);
+        _snapshot.reset();
+        break;
+    case 0x3a: // Set Prim Color
+        _state.prim        = unpackColor(command);
+        _state.primLodFrac = (command >> 32) & 0xff;
+        _snapshot.reset();
+        break;
+    case 0x3b: // Set Env Color
+        _state.env = unpackColor(command);
+        _snapshot.reset();
+        break;
+    case 0x3c: // Set Combine Mode
+        _state.combine = command & 0x00ffffffffffffffull;
+        _snapshot.reset();
+        break;
+    case 0x3d: // Set Texture Image
+        _texture = unpackImage(command);
+        break;
+    case 0x3e: // Set Z Image
+        _state.zAddr = command & 0x3ffffff;
+        _snapshot.reset();
+        break;
+    case 0x3f: // Set Color Image
+        _state.color = unpackImage(command);
+        _snapshot.reset();
+        break;
+    default:
+        NOT_IMPLEMENTED();
+        break;
+    }
+}
+
+void RDP::cmdTriangle(const std::uint64_t* w, bool shade, bool texture, bool depth)
+{
+    const RasterState& s = *snapshot();
+    const std::uint64_t* attr;
+    Primitive            p{};
+    std::int32_t         yl;
+
+    p.kind    = Primitive::Kind::Triangle;
+    p.shade   = shade;
+    p.texture = texture;
+    p.depth   = depth;
+    p.left    = (w[0] >> 55) & 1;
+    p.tile    = (w[0] >> 48) & 7;
+    yl        = signExtend(w[0] >> 32, 14);
+    p.ym      = signExtend(w[0] >> 16, 14);
+    p.yh      = signExtend(w[0], 14);
+    p.xl      = (std::int32_t)(w[1] >> 32);
+    p.dxldy   = (std::int32_t)w[1];
+    p.xh      = (std::int32_t)(w[2] >> 32);
+    p.dxhdy   = (std::int32_t)w[2];
+    p.xm      = (std::int32_t)(w[3] >> 32);
+    p.dxmdy   = (std::int32_t)w[3];
+    p.yBegin  = std::max((p.yh + 3) >> 2, s.scissor[1] >> 2);
+    p.yEnd    = std::min((yl + 3) >> 2, s.scissor[3] >> 2);
+
+    attr = w + 4;
+    if (shade)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            p.attr[Primitive::R + i] = fixedPoint(attr[0], attr[2], i);
+            p.dadx[Primitive::R + i] = fixedPoint(attr[1], attr[3], i);
+            p.dade[Primitive::R + i] = fixedPoint(attr[4], attr[6], i);
         }
+        attr += 8;
     }
+    if (texture)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            p.attr[Primitive::S + i] = fixedPoint(attr[0], attr[2], i);
+            p.dadx[Primitive::S + i] = fixedPoint(attr[1], attr[3], i);
+            p.dade[Primitive::S + i] = fixedPoint(attr[4], attr[6], i);
+        }
+        attr += 8;
+    }
+    if (depth)
+    {
+        p.attr[Primitive::Z] = (std::int32_t)(attr[0] >> 32);
+        p.dadx[Primitive::Z] = (std::int32_t)attr[0];
+        p.dade[Primitive::Z] = (std::int32_t)(attr[1] >> 32);
+    }
+
+    p.state = _snapshot;
+    _rasterizer.draw(std::move(p));
+}
+
+/* Fill and copy mode rectangles include their bottom right edge */
+void RDP::cmdRectangle(const std::uint64_t* w, bool texture, bool flip)
+{
+    const RasterState& s = *snapshot();
+    Primitive          p{};
+    std::int32_t       inclusive;
+    std::int32_t       dsdx;
+    std::int32_t       dtdy;
+
+    inclusive = (s.cycleType == CycleType::Fill || s.cycleType == CycleType::Copy) ? 1 : 0;
+    p.kind    = Primitive::Kind::Rectangle;
+    p.texture = texture;
+    p.flip    = flip;
+    p.tile    = (w[0] >> 24) & 7;
+    p.xh      = (std::int32_t)((w[0] >> 12) & 0xfff) >> 2;
+    p.yh      = (std::int32_t)(w[0] & 0xfff) >> 2;
+    p.x0      = std::max(p.xh, s.scissor[0] >> 2);
+    p.x1      = std::min((std::int32_t)((w[0] >> 44) & 0xfff) >> 2, (s.scissor[2] >> 2) - inclusive) + inclusive;
+    p.yBegin  = std::max(p.yh, s.scissor[1] >> 2);
+    p.yEnd    = std::min((std::int32_t)((w[0] >> 32) & 0xfff) >> 2, (s.scissor[3] >> 2) - inclusive) + inclusive;
+    if (p.x0 >= p.x1)
+        return;
+
+    if (texture)
+    {
+        /* S and T are s10.5, DsDx and DtDy s5.10 */
+        dsdx = (std::int32_t)(std::int16_t)(w[1] >> 16) * 2048;
+        dtdy = (std::int32_t)(std::int16_t)w[1] * 2048;
+        if (s.cycleType == CycleType::Copy)
+            dsdx /= 4;
+
+        p.attr[Primitive::S] = (std::int32_t)(std::int16_t)(w[1] >> 48) * 65536;
+        p.attr[Primitive::T] = (std::int32_t)(std::int16_t)(w[1] >> 32) * 65536;
+        if (flip)
+        {
+            p.dade[Primitive::S] = dsdx;
+            p.dadx[Primitive::T] = dtdy;
+        }
+        else
+        {
+            p.dadx[Primitive::S] = dsdx;
+            p.dade[Primitive::T] = dtdy;
+        }
+    }
+
+    p.state = _snapshot;
+    _rasterizer.draw(std::move(p));
+}
+
+/* TMEM is kept linear: rows are line * 8 bytes apart, twice that for 32 bit texels */
+void RDP::cmdLoadBlock(std::uint64_t w)
+{
+    const RasterTile& tile = _state.tiles[(w >> 24) & 7];
+    std::uint32_t     sl   = (w >> 44) & 0xfff;
+    std::uint32_t     tl   = (w >> 32) & 0xfff;
+    std::uint32_t     sh   = (w >> 12) & 0xfff;
+    std::uint32_t     src;
+    std::uint32_t     size;
+
+    src  = _texture.addr + ((tl * _texture.width + sl) << _texture.size >> 1);
+    size = std::max<std::uint32_t>(((sh - sl + 1) << _texture.size) >> 1, 1);
+    waitFor(src, size);
+
+    Tmem& dst = tmem();
+    for (std::uint32_t i = 0; i < size; ++i)
+        dst[(tile.tmem * 8 + i) & 0xfff] = _memory.ram[(src + i) & (Memory::kRamSize - 1)];
+}
+
+void RDP::cmdLoadTile(std::uint64_t w)
+{
+    RasterTile&   tile = _state.tiles[(w >> 24) & 7];
+    std::uint32_t stride;
+    std::uint32_t line;
+    std::uint32_t src;
+    std::uint32_t rows;
+    std::uint32_t size;
+
+    tile.sl = (w >> 44) & 0xfff;
+    tile.tl = (w >> 32) & 0xfff;
+    tile.sh = (w >> 12) & 0xfff;
+    tile.th = w & 0xfff;
+    _snapshot.reset();
+
+    stride = (_texture.width << _texture.size) >> 1;
+    line   = tile.line * ((tile.size == 3) ? 16 : 8);
+    src    = _texture.addr + (tile.tl >> 2) * stride + (((tile.sl >> 2) << _texture.size) >> 1);
+    rows   = (tile.th >> 2) - (tile.tl >> 2) + 1;
+    size   = std::max<std::uint32_t>(((((tile.sh >> 2) - (tile.sl >> 2) + 1) << _texture.size) >> 1), 1);
+    waitFor(src, rows * stride);
+
+    Tmem& dst = tmem();
+    for (std::uint32_t t = 0; t < rows; ++t)
+    {
+        for (std::uint32_t i = 0; i < size; ++i)
+            dst[(tile.tmem * 8 + t * line + i) & 0xfff] = _memory.ram[(src + t * stride + i) & (Memory::kRamSize - 1)];
+    }
+}
+
+/* Each 16 bit palette entry is repeated across a whole TMEM word */
+void RDP::cmdLoadTlut(std::uint64_t w)
+{
+    const RasterTile& tile = _state.tiles[(w >> 24) & 7];
+    std::uint32_t     sl   = ((w >> 44) & 0xfff) >> 2;
+    std::uint32_t     tl   = ((w >> 32) & 0xfff) >> 2;
+    std::uint32_t     sh   = ((w >> 12) & 0xfff) >> 2;
+    std::uint32_t     src;
+    std::uint32_t     count;
+
+    src   = _texture.addr + (tl * _texture.width + sl) * 2;
+    count = (sh >= sl) ? (sh - sl + 1) : 0;
+    waitFor(src, count * 2);
+
+    Tmem& dst = tmem();
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        for (std::uint32_t j = 0; j < 8; ++j)
+            dst[(tile.tmem * 8 + i * 8 + j) & 0xfff] = _memory.ram[(src + i * 2 + (j & 1)) & (Memory::kRamSize - 1)];
+    }
+}
+
+void RDP::cmdSetTile(std::uint64_t w)
+{
+    RasterTile& tile = _state.tiles[(w >> 24) & 7];
+
+    tile.format  = (w >> 53) & 0x7;
+    tile.size    = (w >> 51) & 0x3;
+    tile.line    = (w >> 41) & 0x1ff;
+    tile.tmem    = (w >> 32) & 0x1ff;
+    tile.palette = (w >> 20) & 0xf;
+    tile.clampT  = (w >> 19) & 1;
+    tile.mirrorT = (w >> 18) & 1;
+    tile.maskT   = (w >> 14) & 0xf;
+    tile.shiftT  = (w >> 10) & 0xf;
+    tile.clampS  = (w >> 9) & 1;
+    tile.mirrorS = (w >> 8) & 1;
+    tile.maskS   = (w >> 4) & 0xf;
+    tile.shiftS  = w & 0xf;
+    _snapshot.reset();
+}
+
+/*
+ * The state primitives are drawn with. It is shared by every primitive until
+ * the next state change.
+ */
+const std::shared_ptr<const RasterState>& RDP::snapshot()
+{
+    if (!_snapshot)
+    {
+        _state.tmem = _tmem;
+        _state.decode();
+        _snapshot = std::make_shared<const RasterState>(_state);
+        _state.tmem.reset();
+    }
+    return _snapshot;
+}
+
+/* TMEM is copied on write while queued primitives may still sample it */
+Tmem& RDP::tmem()
+{
+    _snapshot.reset();
+    if (_tmem.use_count() > 1)
+        _tmem = std::make_shared<Tmem>(*_tmem);
+    return *_tmem;
+}
+
+/* Loads from a range the rasterizer has yet to draw must see its output */
+void RDP::waitFor(std::uint32_t addr, std::uint32_t size)
+{
+    if (!_rasterizer.pending(addr, size))
+        return;
+    _rasterizer.flush();
+    _rasterizer.wait();
+}
+
+/* The RDP thread must be idle, see wait() */
+void RDP::save(SavestateWriter& writer) const
+{
+    writer.begin("RDP ");
+    writer.write(_cmdStart);
+    writer.write(_cmdEnd);
+    writer.write(_cmdCurrent);
+    writer.write<bool>(_xbus);
+    writer.write(_state.otherModes);
+    writer.write(_state.combine);
+    writer.write(_state.color);
+    writer.write(_state.zAddr);
+    writer.write(_state.scissor);
+    writer.write(_state.fillColor);
+    writer.write(_state.fog);
+    writer.write(_state.blend);
+    writer.write(_state.prim);
+    writer.write(_state.env);
+    writer.write(_state.primLodFrac);
+    writer.write(_state.primZ);
+    writer.write(_state.convert);
+    writer.write(_state.keyCenter);
+    writer.write(_state.keyScale);
+    writer.write(_state.tiles);
+    writer.write(_texture);
+    writer.write(*_tmem);
+    writer.end();
+}
+
+void RDP::load(SavestateReader& reader)
+{
+    reader.open("RDP ");
+    reader.read(_cmdStart);
+    reader.read(_cmdEnd);
+    reader.read(_cmdCurrent);
+    _xbus = reader.read<bool>();
+    reader.read(_state.otherModes);
+    reader.read(_state.combine);
+    reader.read(_state.color);
+    reader.read(_state.zAddr);
+    reader.read(_state.scissor);
+    reader.read(_state.fillColor);
+    reader.read(_state.fog);
+    reader.read(_state.blend);
+    reader.read(_state.prim);
+    reader.read(_state.env);
+    reader.read(_state.primLodFrac);
+    reader.read(_state.primZ);
+    reader.read(_state.convert);
+    reader.read(_state.keyCenter);
+    reader.read(_state.keyScale);
+    reader.read(_state.tiles);
+    reader.read(_texture);
+    reader.read(tmem());
+    _state.decode();
 }
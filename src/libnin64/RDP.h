@@ -3,7 +3,11 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <libnin64/NonCopyable.h>
+#include <libnin64/Rasterizer.h>
+#include <libnin64/Worker.h>
 
 #define DPC_START_REG        0x04100000
 #define DPC_END_REG          0x04100004
@@ -23,19 +27,60 @@ namespace libnin64
 
 class Memory;
 class MIPSInterface;
+class Profiler;
+class SavestateReader;
+class SavestateWriter;
+class Scheduler;
 class RDP : private NonCopyable
 {
 public:
-    RDP(Memory& memory, MIPSInterface& mi);
+    RDP(Memory& memory, MIPSInterface& mi, Scheduler& scheduler, Profiler& profiler);
     ~RDP();
 
+    void setThreaded(bool threaded);
+    bool busy();
+    void sync();
+    void wait();
+
+    /* write() is for the CPU, the RSP goes through rspWrite() */
     std::uint32_t read(std::uint32_t reg);
     void          write(std::uint32_t reg, std::uint32_t value);
+    void          rspWrite(std::uint32_t reg, std::uint32_t value);
     void          dma();
 
+    void save(SavestateWriter& writer) const;
+    void load(SavestateReader& reader);
+
 private:
+    std::uint32_t regRead(std::uint32_t reg);
+    void          regWrite(std::uint32_t reg, std::uint32_t value);
+    std::uint64_t fetch(std::uint32_t offset) const;
+    void          execute(const std::uint64_t* w);
+
+    void cmdTriangle(const std::uint64_t* w, bool shade, bool texture, bool depth);
+    void cmdRectangle(const std::uint64_t* w, bool texture, bool flip);
+    void cmdLoadBlock(std::uint64_t w);
+    void cmdLoadTile(std::uint64_t w);
+    void cmdLoadTlut(std::uint64_t w);
+    void cmdSetTile(std::uint64_t w);
+
+    const std::shared_ptr<const RasterState>& snapshot();
+    Tmem&                                     tmem();
+    void                                      waitFor(std::uint32_t addr, std::uint32_t size);
+
     Memory&        _memory;
     MIPSInterface& _mi;
+    Scheduler&     _scheduler;
+    Profiler&      _profiler;
+
+    std::unique_ptr<Worker> _worker;
+    std::mutex              _mutex;
+
+    Rasterizer                         _rasterizer;
+    RasterState                        _state;
+    RasterImage                        _texture;
+    std::shared_ptr<const RasterState> _snapshot;
+    std::shared_ptr<Tmem>              _tmem;
 
     std::uint32_t _cmdStart;
     std::uint32_t _cmdEnd;
@@ -1,4 +1,5 @@
 #include <libnin64/RDRAMInterface.h>
+#include <libnin64/Savestate.h>
 
 #define RI_MODE_REG         0x04700000
 #define RI_CONFIG_REG       0x04700004
@@ -79,3 +80,16 @@ void RDRAMInterface::write(std::uint32_t reg, std::uint32_t value)
         break;
     }
 }
+
+void RDRAMInterface::save(SavestateWriter& writer) const
+{
+    writer.begin("RI  ");
+    writer.write(_values);
+    writer.end();
+}
+
+void RDRAMInterface::load(SavestateReader& reader)
+{
+    reader.open("RI  ");
+    reader.read(_values);
+}
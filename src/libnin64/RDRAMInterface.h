@@ -7,6 +7,8 @@
 namespace libnin64
 {
 
+class SavestateReader;
+class SavestateWriter;
 class RDRAMInterface : private NonCopyable
 {
 public:
@@ -16,6 +18,9 @@ public:
     std::uint32_t read(std::uint32_t reg);
     void          write(std::uint32_t reg, std::uint32_t value);
 
+    void save(SavestateWriter& writer) const;
+    void load(SavestateReader& reader);
+
 private:
     std::uint32_t _values[5];
 };
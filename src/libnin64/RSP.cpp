@@ -1,16 +1,18 @@
-#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <libnin64/Log.h>
 #include <libnin64/MIPSInterface.h>
 #include <libnin64/Memory.h>
+#include <libnin64/Profiler.h>
 #include <libnin64/RDP.h>
 #include <libnin64/RSP.h>
+#include <libnin64/RSPVector.h>
+#include <libnin64/Savestate.h>
+#include <libnin64/Scheduler.h>
 #include <libnin64/Util.h>
 
 // http://ultra64.ca/files/documentation/silicon-graphics/SGI_Nintendo_64_RSP_Programmers_Guide.pdf
 
-bool gDebug = false;
-
 #define SP_MEM_ADDR_REG  0x04040000
 #define SP_DRAM_ADDR_REG 0x04040004
 #define SP_RD_LEN_REG    0x04040008
@@ -22,6 +24,17 @@ bool gDebug = false;
 #define SP_PC_REG        0x04080000
 #define SP_IBIST_REG     0x04080004
 
+/* The RSP runs in slices of CPU cycles, at 3/4 of the CPU clock */
+#define RSP_SLICE_CYCLES 256
+#define RSP_SLICE_TICKS  (RSP_SLICE_CYCLES * 3 / 4)
+
+/* Threaded mode: how often the CPU checks on the RSP, and how far it may get ahead */
+#define RSP_SYNC_CYCLES   1024
+#define RSP_MAX_LAG_TICKS 16384
+
+/* Tasks run natively still take some time before they signal completion */
+#define RSP_HLE_CYCLES 4096
+
 #define RS          ((std::uint8_t)((op >> 21) & 0x1f))
 #define BASE        RS
 #define E           ((std::uint8_t)((op >> 21) & 0xf))
@@ -39,413 +52,233 @@ bool gDebug = false;
 #define FUNC        ((std::uint16_t)(op & ((1 << 6) - 1)))
 #define JUMP_TARGET ((std::uint32_t)op & 0x3ffffff)
 
-#define NOT_IMPLEMENTED()                                                                                      \
-    {                                                                                                          \
-        std::printf("%s:%d PC: 0x%04x Not implemented: OP:%02o RS:%02o RT:%02o RD:%02o %02o %02o FUNC:%02x\n", \
-                    __FILE__,                                                                                  \
-                    __LINE__,                                                                                  \
-                    _pc,                                                                                       \
-                    (op >> 26),                                                                                \
-                    ((op >> 21) & 0x1f),                                                                       \
-                    ((op >> 16) & 0x1f),                                                                       \
-                    ((op >> 11) & 0x1f),                                                                       \
-                    ((op >> 06) & 0x1f),                                                                       \
-                    ((op >> 00) & 0x3f),                                                                       \
-                    FUNC);                                                                                     \
-        std::exit(1);                                                                                          \
+#define NOT_IMPLEMENTED()                                                                                                \
+    {                                                                                                                    \
+        NIN64_LOG(RSP, Error, "%s:%d PC: 0x%04x Not implemented: OP:%02o RS:%02o RT:%02o RD:%02o %02o %02o FUNC:%02x\n", \
+                  __FILE__,                                                                                              \
+                  __LINE__,                                                                                              \
+                  _pc,                                                                                                   \
+                  (op >> 26),                                                                                            \
+                  ((op >> 21) & 0x1f),                                                                                   \
+                  ((op >> 16) & 0x1f),                                                                                   \
+                  ((op >> 11) & 0x1f),                                                                                   \
+                  ((op >> 06) & 0x1f),                                                                                   \
+                  ((op >> 00) & 0x3f),                                                                                   \
+                  FUNC);                                                                                                 \
+        std::exit(1);                                                                                                    \
     }
 
 using namespace libnin64;
 
-static __m128i vSelect(__m128i v, std::uint8_t e)
-{
-    __m128i tmp;
-
-    switch (e & 0b1111)
-    {
-    case 0b0000: // Whole vector (01234567)
-        tmp = v;
-        break;
-    case 0b0001: // Undefined
-        tmp = _mm_setzero_si128();
-        break;
-    case 0b0010: // 00224466
-        tmp = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 2, 0, 0));
-        tmp = _mm_shufflehi_epi16(tmp, _MM_SHUFFLE(2, 2, 0, 0));
-        break;
-    case 0b0011: // 11335577
-        tmp = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 1, 1));
-        tmp = _mm_shufflehi_epi16(tmp, _MM_SHUFFLE(3, 3, 1, 1));
-        break;
-    case 0b0100: // 00004444
-        tmp = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 0, 0, 0));
-        tmp = _mm_shufflehi_epi16(tmp, _MM_SHUFFLE(0, 0, 0, 0));
-        break;
-    case 0b0101: // 11115555
-        tmp = _mm_shufflelo_epi16(v, _MM_SHUFFLE(1, 1, 1, 1));
-        tmp = _mm_shufflehi_epi16(tmp, _MM_SHUFFLE(1, 1, 1, 1));
-        break;
-    case 0b0110: // 22226666
-        tmp = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 2, 2, 2));
-        tmp = _mm_shufflehi_epi16(tmp, _MM_SHUFFLE(2, 2, 2, 2));
-        break;
-    case 0b0111: // 33337777
-        tmp = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
-        tmp = _mm_shufflehi_epi16(tmp, _MM_SHUFFLE(3, 3, 3, 3));
-        break;
-    case 0b1000: // 00000000
-        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 0));
-        break;
-    case 0b1001: // 11111111
-        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 1));
-        break;
-    case 0b1010: // 22222222
-        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 2));
-        break;
-    case 0b1011: // 33333333
-        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 3));
-        break;
-    case 0b1100: // 44444444
-        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 4));
-        break;
-    case 0b1101: // 55555555
-        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 5));
-        break;
-    case 0b1110: // 66666666
-        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 6));
-        break;
-    case 0b1111: // 77777777
-        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 7));
-        break;
-    }
-
-    return tmp;
-}
-
-static const __m128i kVector0           = _mm_set1_epi16((short)0x0000);
-static const __m128i kVector1           = _mm_set1_epi16((short)0xffff);
-static const __m128i kVectorHi          = _mm_set1_epi16((short)0x8000);
-static const __m128i kVectorLo          = _mm_set1_epi16((short)0x0001);
-static const __m128i kVectorSignedMin   = _mm_set1_epi16((short)0x8000);
-static const __m128i kVectorSignedMax   = _mm_set1_epi16((short)0x7fff);
-static const __m128i kVectorUnsignedMin = _mm_set1_epi16((short)0x0000);
-static const __m128i kVectorUnsignedMax = _mm_set1_epi16((short)0xffff);
-
-/*
- * Return:
- *   0xFFFF if the highest bit is set
- *   0x0000 otherwise
- */
-static __m128i vSext(__m128i value)
-{
-    return _mm_cmpeq_epi16(_mm_and_si128(value, kVectorHi), kVectorHi);
-}
-
-static __m128i vMultiplex(__m128i mask, __m128i a, __m128i b)
-{
-    return _mm_or_si128(_mm_and_si128(a, mask), _mm_andnot_si128(b, mask));
-}
-
-static __m128i vClampSigned3(__m128i lo, __m128i hi, __m128i value)
+RSP::RSP(Memory& memory, MIPSInterface& mi, Scheduler& scheduler, RDP& rdp, Profiler& profiler)
+: _memory{memory}
+, _mi{mi}
+, _scheduler{scheduler}
+, _rdp{rdp}
+, _profiler{profiler}
+, _halt{true}
+, _broke{}
+, _signal{}
+, _semaphore{}
+, _interruptOnBreak{}
+, _hleDone{}
+, _spAddr{}
+, _dramAddr{}
+, _regs{}
+, _vregs{}
+, _acc{_mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()}
+, _pc{0}
+, _pcNext{4}
+, _vcc{}
+, _vco{}
+, _vce{}
+, _vu{RSPVectorUnit::get(RSPVectorBackend::SSE2)}
+, _audio{memory}
+, _audioHLE{}
+, _stop{}
+, _progress{}
+, _resumed{}
 {
-    __m128i signExtMask;
-    __m128i positive;
-    __m128i clampValue;
-
-    signExtMask = _mm_cmpeq_epi16(hi, vSext(lo));
-    positive    = _mm_cmpeq_epi16(_mm_and_si128(hi, kVectorHi), _mm_setzero_si128());
-    clampValue  = vMultiplex(positive, kVectorSignedMax, kVectorSignedMin);
-    return vMultiplex(signExtMask, value, clampValue);
 }
 
-static __m128i vClampSigned(__m128i lo, __m128i hi)
+RSP::~RSP()
 {
-    return vClampSigned3(lo, hi, lo);
+    pause();
 }
 
-/* TODO: Make sure we clamp correctly */
-static __m128i vClampUnsigned(__m128i lo, __m128i hi)
+void RSP::init(const CICInfo& cic, TvType tvType)
 {
-    __m128i signExtMask;
-    __m128i positive;
-    __m128i clampValue;
-
-    signExtMask = _mm_cmpeq_epi16(hi, vSext(lo));
-    positive    = _mm_cmpeq_epi16(_mm_and_si128(hi, kVectorHi), _mm_setzero_si128());
-    clampValue  = vMultiplex(positive, kVectorUnsignedMax, kVectorUnsignedMin);
-    return vMultiplex(signExtMask, lo, clampValue);
+    switch (cic.cic)
+    {
+    case CIC::NUS_6105:
+        *(std::uint32_t*)(_memory.spImem + 0x00) = swap32(0x3c0dbfc0);
+        *(std::uint32_t*)(_memory.spImem + 0x04) = swap32((tvType == TvType::PAL) ? 0xbda807fc : 0x8da807fc);
+        *(std::uint32_t*)(_memory.spImem + 0x08) = swap32(0x25ad07c0);
+        *(std::uint32_t*)(_memory.spImem + 0x0c) = swap32(0x31080080);
+        *(std::uint32_t*)(_memory.spImem + 0x10) = swap32(0x5500fffc);
+        *(std::uint32_t*)(_memory.spImem + 0x14) = swap32(0x3c0dbfc0);
+        *(std::uint32_t*)(_memory.spImem + 0x18) = swap32(0x8da80024);
+        *(std::uint32_t*)(_memory.spImem + 0x1c) = swap32(0x3c0bb000);
+        _memory.markWritten(0x04001000, 0x20);
+        break;
+    default:
+        break;
+    }
 }
 
-static __m128i vAdd(__m128i a, __m128i b, __m128i* carryOut)
+void RSP::setVectorBackend(RSPVectorBackend backend)
 {
-
-    __m128i tmp;
-
-    tmp       = _mm_add_epi16(a, b);
-    *carryOut = _mm_and_si128(_mm_cmpgt_epi16(_mm_xor_si128(a, kVectorHi), _mm_xor_si128(tmp, kVectorHi)), kVectorLo);
-    return tmp;
+    _vu = RSPVectorUnit::get(backend);
 }
 
-static __m128i vAddCarry(__m128i a, __m128i b, __m128i* carryInOut)
+/*
+ * Audio HLE is not bit exact with the microcode, RESAMPLE in particular, so
+ * it is only used when asked for.
+ */
+void RSP::setAudioHLE(bool enabled)
 {
-
-    __m128i tmp;
-
-    tmp         = _mm_add_epi16(a, _mm_add_epi16(b, *carryInOut));
-    *carryInOut = _mm_and_si128(_mm_cmpgt_epi16(_mm_xor_si128(a, kVectorHi), _mm_xor_si128(tmp, kVectorHi)), kVectorLo);
-    return tmp;
+    _audioHLE = enabled;
 }
 
-static std::uint8_t vExtract(__m128i v)
+void RSP::setThreaded(bool threaded)
 {
-    std::uint16_t raw[8];
-    std::uint8_t  tmp{};
+    if (threaded == !!_worker)
+        return;
 
-    _mm_store_si128((__m128i*)raw, v);
-    for (int i = 0; i < 8; ++i)
+    if (threaded)
     {
-        if (raw[i] & 1)
-            tmp |= (1 << i);
+        _worker = std::make_unique<Worker>();
+        resume();
     }
-    return tmp;
-}
-
-static __m128i vUnextract(std::uint8_t v)
-{
-    std::uint16_t raw[8];
-
-    for (int i = 0; i < 8; ++i)
+    else
     {
-        raw[i] = (v & (1 << i)) ? 0xffff : 0x0000;
+        pause();
+        _worker.reset();
+        if (!_halt && !_scheduler.pending(Event::RSP))
+            _scheduler.schedule(Event::RSP, RSP_SLICE_CYCLES);
     }
-
-    return _mm_load_si128((__m128i*)raw);
 }
 
-/* TODO: Implement low correctly */
-template <bool low>
-static __m128i vClip(__m128i vs, __m128i vt, __m128i* acc, std::uint16_t* vcc, std::uint16_t* vco, std::uint8_t* vce)
+void RSP::run()
 {
-    __m128i vtNeg;
-    __m128i min;
-    __m128i max;
-    __m128i value;
-    __m128i ge;
-    __m128i le;
-    __m128i neq;
-    __m128i sign;
-    __m128i ce;
-
-    vtNeg = _mm_mullo_epi16(vt, kVector1);
-    min   = _mm_min_epi16(vt, vtNeg);
-    max   = _mm_max_epi16(vt, vtNeg);
-
-    value = vs;
-    value = _mm_min_epi16(_mm_max_epi16(value, min), max);
-    ge    = _mm_cmpeq_epi16(value, max);
-    le    = _mm_cmpeq_epi16(value, min);
-
-    if (!low)
-    {
-        neq  = _mm_xor_si128(_mm_or_si128(_mm_cmpeq_epi16(vs, vt), _mm_cmpeq_epi16(vs, vtNeg)), kVector1);
-        sign = _mm_cmpgt_epi16(_mm_setzero_si128(), _mm_xor_si128(vs, vt));
-        ce   = _mm_cmpeq_epi16(_mm_add_epi16(vs, vt), kVector1);
-    }
+    Profiler::Scope scope{_profiler, Component::RSP};
+    std::uint64_t   expected;
+    bool            busy;
 
-    acc[0] = value;
-    acc[1] = vSext(value);
-    acc[2] = acc[1];
-
-    if (!low)
+    if (_hleDone)
     {
-        *vcc = (((std::uint16_t)vExtract(ge)) << 8) | vExtract(le);
-        *vco = (((std::uint16_t)vExtract(neq)) << 8) | vExtract(sign);
-        *vce = vExtract(ce);
+        _hleDone = false;
+        _halt    = true;
+        _broke   = true;
+        if (_interruptOnBreak)
+            _mi.setInterrupt(MI_INTR_SP);
     }
-    else
+
+    if (_worker)
     {
-        *vcc = 0;
-        *vco = 0;
-        *vce = 0;
+        /* Checkpoint: don't let the CPU run too far ahead of the RSP thread */
+        expected = (_scheduler.now() - _resumed) * 3 / 4;
+        while ((busy = _worker->busy()) && _progress.load(std::memory_order_relaxed) + RSP_MAX_LAG_TICKS < expected)
+            std::this_thread::yield();
+
+        busy = busy || _rdp.busy();
+        _mi.deliver();
+        if (busy)
+            _scheduler.schedule(Event::RSP, RSP_SYNC_CYCLES);
+        return;
     }
 
-    return value;
+    tick(RSP_SLICE_TICKS);
+    if (!_halt)
+        _scheduler.schedule(Event::RSP, RSP_SLICE_CYCLES);
 }
 
-/* This function computes fractional products.
- * Example:
- * -1.0 * -1.0
- * => 0x8000 * 0x8000
- * => 0x40000000
- * => Sign bit: 0
- * => Shift Left 1: 0x80000000
- * => Insert in Acc with sign extension: 0x000080000000
- * => Clamp starting at b31: 0x7fff
- * => Result: ~1.0
- *
- * -0.5 * 0.25
- * => 0xc000 * 0x2000
- * => 0xf8000000
- * => Sign bit: 1
- * => Shift left 1: 0xf0000000
- * => Insert in Acc with sign extension: 0xfffff0000000
- * => Clamp starting at b31: 0xf000
- * => Result: -0.125
- */
-template <bool accumulate, bool unsignedClamp>
-static __m128i vMultiplyFraction(__m128i a, __m128i b, __m128i* acc)
+void RSP::tick(std::size_t count)
 {
-    __m128i hi;
-    __m128i lo;
-    __m128i sign;
-    __m128i carry;
-
-    /* Multiply */
-    hi = _mm_mulhi_epi16(a, b);
-    lo = _mm_mullo_epi16(a, b);
-
-    /* Extract sign */
-    sign = _mm_cmpgt_epi16(_mm_setzero_si128(), hi);
-
-    /* Shift left one bit */
-    hi = _mm_or_si128(_mm_slli_epi16(hi, 1), _mm_srli_epi16(lo, 15));
-    lo = _mm_slli_epi16(lo, 1);
-
-    if (!accumulate)
-    {
-        /* Add 32768 */
-        lo = vAdd(lo, kVectorHi, &carry);
-        hi = vAddCarry(a, b, &carry);
-
-        /* Load the accumulator */
-        acc[0] = lo;
-        acc[1] = hi;
-        acc[2] = sign;
-    }
-    else
-    {
-        /* Accumulate */
-        acc[0] = vAdd(acc[0], lo, &carry);
-        acc[1] = vAddCarry(acc[1], hi, &carry);
-        acc[2] = _mm_adds_epi16(acc[2], carry);
-    }
-
-    /* Clamp */
-    if (unsignedClamp)
+    while (count-- && !_halt)
     {
-        return vClampUnsigned(acc[1], acc[2]);
-    }
-    else
-    {
-        return vClampSigned(acc[1], acc[2]);
+        tick();
     }
 }
 
-/* TODO: Handle sign better */
-template <bool accumulate, int slot, int resultSlot>
-static __m128i vMultiplyMixed(__m128i a, __m128i b, __m128i* acc)
+std::uint32_t RSP::read(std::uint32_t reg)
 {
-    __m128i hi;
-    __m128i lo;
-    __m128i prod[3];
-    __m128i carry;
+    std::uint32_t value;
 
-    /* Multiply */
-    hi = _mm_mulhi_epi16(a, b);
-    lo = _mm_mullo_epi16(a, b);
+    if (!_worker)
+        return regRead(reg);
 
-    /* Load in prod */
-    switch (slot)
-    {
-    case 0:
-        prod[0] = hi;
-        prod[1] = vSext(hi);
-        prod[2] = prod[1];
-        break;
-    case 1:
-        prod[0] = lo;
-        prod[1] = hi;
-        prod[2] = vSext(hi);
-        break;
-    case 2:
-        prod[0] = _mm_setzero_si128();
-        prod[1] = lo;
-        prod[2] = hi;
-        break;
-    }
+    pause();
+    value = regRead(reg);
+    resume();
+    return value;
+}
 
-    if (!accumulate)
-    {
-        /* Store in acc */
-        acc[0] = prod[0];
-        acc[1] = prod[1];
-        acc[2] = prod[2];
-    }
-    else
+void RSP::write(std::uint32_t reg, std::uint32_t value)
+{
+    if (!_worker)
     {
-        /* Accumulate */
-        /* TODO: Add acc saturation */
-        acc[0] = vAdd(acc[0], prod[0], &carry);
-        acc[1] = vAddCarry(acc[1], prod[1], &carry);
-        acc[2] = vAddCarry(acc[2], prod[2], &carry);
+        regWrite(reg, value);
+        return;
     }
 
-    return vClampSigned3(acc[1], acc[2], acc[resultSlot]);
+    pause();
+    regWrite(reg, value);
+    resume();
 }
 
-RSP::RSP(Memory& memory, MIPSInterface& mi, RDP& rdp)
-: _memory{memory}
-, _mi{mi}
-, _rdp{rdp}
-, _halt{true}
-, _broke{}
-, _signal{}
-, _semaphore{}
-, _interruptOnBreak{}
-, _spAddr{}
-, _dramAddr{}
-, _regs{}
-, _vregs{}
-, _acc{_mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()}
-, _pc{0}
-, _pcNext{4}
-, _vcc{}
-, _vco{}
-, _vce{}
+/* Stop the RSP thread where it is, so its state can be accessed */
+void RSP::pause()
 {
+    if (!_worker)
+        return;
+    _stop.store(true);
+    _worker->wait();
+    _stop.store(false);
+    _mi.deliver();
 }
 
-RSP::~RSP()
+void RSP::resume()
 {
+    if (!_worker || _halt)
+        return;
+
+    _resumed = _scheduler.now();
+    _progress.store(0);
+    _worker->submit([this] { runThreaded(); });
+    if (!_scheduler.pending(Event::RSP))
+        _scheduler.schedule(Event::RSP, RSP_SYNC_CYCLES);
 }
 
-void RSP::init(CIC cic)
+void RSP::runThreaded()
 {
-    switch (cic)
+    Profiler::Scope scope{_profiler, Component::RSP};
+    std::uint64_t   ticks{};
+
+    while (!_halt && !_stop.load(std::memory_order_relaxed))
     {
-    case CIC::NUS_6105:
-        *(std::uint32_t*)(_memory.spImem + 0x00) = swap32(0x3c0dbfc0);
-        *(std::uint32_t*)(_memory.spImem + 0x04) = swap32(0x8da807fc);
-        *(std::uint32_t*)(_memory.spImem + 0x08) = swap32(0x25ad07c0);
-        *(std::uint32_t*)(_memory.spImem + 0x0c) = swap32(0x31080080);
-        *(std::uint32_t*)(_memory.spImem + 0x10) = swap32(0x5500fffc);
-        *(std::uint32_t*)(_memory.spImem + 0x14) = swap32(0x3c0dbfc0);
-        *(std::uint32_t*)(_memory.spImem + 0x18) = swap32(0x8da80024);
-        *(std::uint32_t*)(_memory.spImem + 0x1c) = swap32(0x3c0bb000);
-        break;
-    default:
-        break;
+        tick();
+        if ((++ticks & 0x3f) == 0)
+            _progress.store(ticks, std::memory_order_relaxed);
     }
+    _progress.store(ticks, std::memory_order_relaxed);
 }
 
-void RSP::tick(std::size_t count)
+/* Interrupts raised from the RSP thread are delivered at the next checkpoint */
+void RSP::raiseInterrupt()
 {
-    if (_halt) return;
+    if (_worker)
+        _mi.postInterrupt(MI_INTR_SP);
+    else
+        _mi.setInterrupt(MI_INTR_SP);
+}
 
-    while (count--)
-    {
-        tick();
-    }
+void RSP::lowerInterrupt()
+{
+    if (_worker)
+        _mi.postClearInterrupt(MI_INTR_SP);
+    else
+        _mi.clearInterrupt(MI_INTR_SP);
 }
 
 void RSP::tick()
@@ -471,21 +304,6 @@ void RSP::tick()
 
     op = swap(*(std::uint32_t*)(_memory.spImem + (_pc & 0xfff)));
 
-    if (gDebug)
-    {
-        std::printf("%s:%d PC: 0x%04x Debug: OP:%02o RS:%02o RT:%02o RD:%02o %02o %02o FUNC:%02x\n",
-                    __FILE__,
-                    __LINE__,
-                    _pc,
-                    (op >> 26),
-                    ((op >> 21) & 0x1f),
-                    ((op >> 16) & 0x1f),
-                    ((op >> 11) & 0x1f),
-                    ((op >> 06) & 0x1f),
-                    ((op >> 00) & 0x3f),
-                    FUNC);
-    }
-
     _pc     = _pcNext;
     _pcNext = _pcNext + 4;
 
@@ -520,11 +338,11 @@ void RSP::tick()
             _regs[RD].u32 = (_pc + 4) & 0xfff;
             break;
         case 015: // BREAK (Halt the RSP)
-            std::printf("RSP BREAK\n");
+            NIN64_LOG(RSP, Trace, "RSP BREAK\n");
             _halt  = true;
             _broke = true;
             if (_interruptOnBreak)
-                _mi.setInterrupt(MI_INTR_SP);
+                raiseInterrupt();
             break;
         case 040: // ADD (Add)
         case 041: // ADDU (Add Unsigned)
@@ -711,10 +529,10 @@ void RSP::tick()
             switch (FUNC)
             {
             case 0b000000: // VMULF (Vector Multiply of Signed Fractions)
-                _vregs[VD].i = vMultiplyFraction<false, false>(vSelect(_vregs[VT].i, E), _vregs[VS].i, _acc);
+                _vregs[VD].i = _vu->vmulf(_vregs[VS].i, _vregs[VT].i, E, _acc);
                 break;
             case 0b000001: // VMULU
-                _vregs[VD].i = vMultiplyFraction<false, true>(vSelect(_vregs[VT].i, E), _vregs[VS].i, _acc);
+                _vregs[VD].i = _vu->vmulu(_vregs[VS].i, _vregs[VT].i, E, _acc);
                 break;
             case 0b000010: // VRNDP
                 NOT_IMPLEMENTED();
@@ -723,22 +541,22 @@ void RSP::tick()
                 NOT_IMPLEMENTED();
                 break;
             case 0b000100: // VMUDL
-                _vregs[VD].i = vMultiplyMixed<false, 0, 0>(vSelect(_vregs[VT].i, E), _vregs[VS].i, _acc);
+                _vregs[VD].i = _vu->vmudl(_vregs[VS].i, _vregs[VT].i, E, _acc);
                 break;
             case 0b000101: // VMUDM
-                _vregs[VD].i = vMultiplyMixed<false, 1, 1>(vSelect(_vregs[VT].i, E), _vregs[VS].i, _acc);
+                _vregs[VD].i = _vu->vmudm(_vregs[VS].i, _vregs[VT].i, E, _acc);
                 break;
             case 0b000110: // VMUDN
-                _vregs[VD].i = vMultiplyMixed<false, 1, 0>(vSelect(_vregs[VT].i, E), _vregs[VS].i, _acc);
+                _vregs[VD].i = _vu->vmudn(_vregs[VS].i, _vregs[VT].i, E, _acc);
                 break;
             case 0b000111: // VMUDH
-                _vregs[VD].i = vMultiplyMixed<false, 2, 1>(vSelect(_vregs[VT].i, E), _vregs[VS].i, _acc);
+                _vregs[VD].i = _vu->vmudh(_vregs[VS].i, _vregs[VT].i, E, _acc);
                 break;
             case 0b001000: // VMACF
-                _vregs[VD].i = vMultiplyFraction<true, false>(vSelect(_vregs[VT].i, E), _vregs[VS].i, _acc);
+                _vregs[VD].i = _vu->vmacf(_vregs[VS].i, _vregs[VT].i, E, _acc);
                 break;
             case 0b001001: // VMACU
-                _vregs[VD].i = vMultiplyFraction<true, true>(vSelect(_vregs[VT].i, E), _vregs[VS].i, _acc);
+                _vregs[VD].i = _vu->vmacu(_vregs[VS].i, _vregs[VT].i, E, _acc);
                 break;
             case 0b001010: // VRNDN
                 NOT_IMPLEMENTED();
@@ -747,20 +565,20 @@ void RSP::tick()
                 NOT_IMPLEMENTED();
                 break;
             case 0b001100: // VMADL
-                _vregs[VD].i = vMultiplyMixed<true, 0, 0>(vSelect(_vregs[VT].i, E), _vregs[VS].i, _acc);
+                _vregs[VD].i = _vu->vmadl(_vregs[VS].i, _vregs[VT].i, E, _acc);
                 break;
             case 0b001101: // VMADM
-                _vregs[VD].i = vMultiplyMixed<true, 1, 1>(vSelect(_vregs[VT].i, E), _vregs[VS].i, _acc);
+                _vregs[VD].i = _vu->vmadm(_vregs[VS].i, _vregs[VT].i, E, _acc);
                 break;
             case 0b001110: // VMADN
-                _vregs[VD].i = vMultiplyMixed<true, 1, 0>(vSelect(_vregs[VT].i, E), _vregs[VS].i, _acc);
+                _vregs[VD].i = _vu->vmadn(_vregs[VS].i, _vregs[VT].i, E, _acc);
                 break;
             case 0b001111: // VMADH
-                _vregs[VD].i = vMultiplyMixed<true, 2, 1>(vSelect(_vregs[VT].i, E), _vregs[VS].i, _acc);
+                _vregs[VD].i = _vu->vmadh(_vregs[VS].i, _vregs[VT].i, E, _acc);
                 break;
             case 0b010000: // VADD
                 /* TODO: Add carry */
-                _acc[0] = _mm_add_epi16(vSelect(_vregs[VT].i, E), _vregs[VS].i);
+                _acc[0] = _mm_add_epi16(_vu->select(_vregs[VT].i, E), _vregs[VS].i);
                 _acc[1] = vSext(_acc[0]);
                 _acc[2] = _acc[1];
                 _vco    = 0;
@@ -793,10 +611,10 @@ void RSP::tick()
                 NOT_IMPLEMENTED();
                 break;
             case 0b100100: // VCL
-                _vregs[VD].i = vClip<true>(_vregs[VS].i, vSelect(_vregs[VT].i, E), _acc, &_vcc, &_vco, &_vce);
+                _vregs[VD].i = _vu->vcl(_vregs[VS].i, _vregs[VT].i, E, _acc, &_vcc, &_vco, &_vce);
                 break;
             case 0b100101: // VCH
-                _vregs[VD].i = vClip<false>(_vregs[VS].i, vSelect(_vregs[VT].i, E), _acc, &_vcc, &_vco, &_vce);
+                _vregs[VD].i = _vu->vch(_vregs[VS].i, _vregs[VT].i, E, _acc, &_vcc, &_vco, &_vce);
                 break;
             case 0b100110: // VCR
                 NOT_IMPLEMENTED();
@@ -981,98 +799,104 @@ void RSP::tick()
     _regs[0].u32 = 0;
 }
 
-std::uint32_t RSP::read(std::uint32_t reg)
+std::uint32_t RSP::regRead(std::uint32_t reg)
 {
     std::uint32_t value{};
 
     switch (reg)
     {
     case SP_MEM_ADDR_REG:
-        std::printf("SP Read: SP_MEM_ADDR_REG");
         value = _spAddr;
+        NIN64_LOG(RSP, Trace, "SP Read: SP_MEM_ADDR_REG: 0x%08x\n", value);
         break;
     case SP_DRAM_ADDR_REG:
-        std::printf("SP Read: SP_DRAM_ADDR_REG");
         value = _dramAddr;
+        NIN64_LOG(RSP, Trace, "SP Read: SP_DRAM_ADDR_REG: 0x%08x\n", value);
         break;
     case SP_RD_LEN_REG:
-        std::printf("SP Read: SP_RD_LEN_REG");
-        std::puts("READ::SP_RD_LEN_REG NOT IMPLEMENTED");
+        NIN64_LOG(RSP, Error, "READ::SP_RD_LEN_REG NOT IMPLEMENTED\n");
         exit(42);
         break;
     case SP_WR_LEN_REG:
-        std::printf("SP Read: SP_WR_LEN_REG");
-        std::puts("READ::SP_WR_LEN_REG NOT IMPLEMENTED");
+        NIN64_LOG(RSP, Error, "READ::SP_WR_LEN_REG NOT IMPLEMENTED\n");
         exit(42);
         break;
     case SP_STATUS_REG:
-        std::printf("SP Read: SP_STATUS_REG");
         if (_halt) value |= 0x00000001;
         if (_broke) value |= 0x00000002;
         if (_interruptOnBreak) value |= 0x00000040;
         value |= ((std::uint32_t)_signal << 7);
+        NIN64_LOG(RSP, Trace, "SP Read: SP_STATUS_REG: 0x%08x\n", value);
         break;
     case SP_DMA_FULL_REG:
-        std::printf("SP Read: SP_DMA_FULL_REG");
+        NIN64_LOG(RSP, Trace, "SP Read: SP_DMA_FULL_REG: 0x%08x\n", value);
         break;
     case SP_DMA_BUSY_REG:
-        std::printf("SP Read: SP_DMA_BUSY_REG");
+        NIN64_LOG(RSP, Trace, "SP Read: SP_DMA_BUSY_REG: 0x%08x\n", value);
         break;
     case SP_SEMAPHORE_REG:
-        std::printf("SP Read: SP_SEMAPHORE_REG");
         if (_semaphore) value |= 0x01;
         _semaphore = true;
+        NIN64_LOG(RSP, Trace, "SP Read: SP_SEMAPHORE_REG: 0x%08x\n", value);
         break;
     case SP_PC_REG:
-        std::printf("SP Read: SP_PC_REG");
         value = _pc | 0x1000;
+        NIN64_LOG(RSP, Trace, "SP Read: SP_PC_REG: 0x%08x\n", value);
         break;
     case SP_IBIST_REG:
-        std::printf("SP Read: SP_IBIST_REG");
-        std::puts("READ::SP_IBIST_REG NOT IMPLEMENTED");
+        NIN64_LOG(RSP, Error, "READ::SP_IBIST_REG NOT IMPLEMENTED\n");
         exit(42);
         break;
     default:
-        std::printf("TOO BAD\n");
+        NIN64_LOG(RSP, Warn, "SP Read: unknown register 0x%08x\n", reg);
         break;
     }
 
-    std::printf(": 0x%08x\n", value);
-
     return value;
 }
 
-void RSP::write(std::uint32_t reg, std::uint32_t value)
+void RSP::regWrite(std::uint32_t reg, std::uint32_t value)
 {
+    Profiler::Scope scope{_profiler, Component::RSP};
+
     switch (reg)
     {
     case SP_MEM_ADDR_REG:
-        std::printf("SP Write: SP_MEM_ADDR_REG: 0x%08x\n", value);
+        NIN64_LOG(RSP, Trace, "SP Write: SP_MEM_ADDR_REG: 0x%08x\n", value);
         _spAddr = value & 0x1fff;
         break;
     case SP_DRAM_ADDR_REG:
-        std::printf("SP Write: SP_DRAM_ADDR_REG: 0x%08x\n", value);
+        NIN64_LOG(RSP, Trace, "SP Write: SP_DRAM_ADDR_REG: 0x%08x\n", value);
         _dramAddr = value & 0xffffff;
         break;
     case SP_RD_LEN_REG:
-        std::printf("SP Write: SP_RD_LEN_REG: 0x%08x\n", value);
+        NIN64_LOG(RSP, Trace, "SP Write: SP_RD_LEN_REG: 0x%08x\n", value);
         dmaRead((value & 0xfff) + 1, ((value >> 12) & 0xff) + 1, value >> 20);
         break;
     case SP_WR_LEN_REG:
-        std::printf("SP Write: SP_WR_LEN_REG: 0x%08x\n", value);
+        NIN64_LOG(RSP, Trace, "SP Write: SP_WR_LEN_REG: 0x%08x\n", value);
         dmaWrite((value & 0xfff) + 1, ((value >> 12) & 0xff) + 1, value >> 20);
         break;
     case SP_STATUS_REG:
-        std::printf("SP Write: SP_STATUS_REG: 0x%08x\n", value);
-        if (value & 0x00000001)
+        NIN64_LOG(RSP, Trace, "SP Write: SP_STATUS_REG: 0x%08x\n", value);
+        if ((value & 0x00000001) && _audioHLE && _audio.run())
+        {
+            /* The task is done already, the RSP stays halted until it reports it */
+            _hleDone = true;
+            if (!_scheduler.pending(Event::RSP))
+                _scheduler.schedule(Event::RSP, RSP_HLE_CYCLES);
+        }
+        else if (value & 0x00000001)
         {
             _halt = false;
-            std::printf("RSP START!!!\n");
+            if (!_worker && !_scheduler.pending(Event::RSP))
+                _scheduler.schedule(Event::RSP, RSP_SLICE_CYCLES);
+            NIN64_LOG(RSP, Trace, "RSP START!!!\n");
         }
         if (value & 0x00000002) _halt = true;
         if (value & 0x00000004) _broke = false;
-        if (value & 0x00000008) _mi.clearInterrupt(MI_INTR_SP);
-        if (value & 0x00000010) _mi.setInterrupt(MI_INTR_SP);
+        if (value & 0x00000008) lowerInterrupt();
+        if (value & 0x00000010) raiseInterrupt();
         if (value & 0x00000080) _interruptOnBreak = false;
         if (value & 0x00000100) _interruptOnBreak = true;
         if (value & 0x00000200) _signal &= ~(0x01);
@@ -1093,27 +917,24 @@ void RSP::write(std::uint32_t reg, std::uint32_t value)
         if (value & 0x01000000) _signal |= 0x80;
         break;
     case SP_DMA_FULL_REG:
-        std::printf("SP Write: SP_DMA_FULL_REG: 0x%08x\n", value);
-        std::puts("WRITE::SP_DMA_FULL_REG NOT IMPLEMENTED");
+        NIN64_LOG(RSP, Error, "WRITE::SP_DMA_FULL_REG NOT IMPLEMENTED\n");
         exit(42);
         break;
     case SP_DMA_BUSY_REG:
-        std::printf("SP Write: SP_DMA_BUSY_REG: 0x%08x\n", value);
-        std::puts("WRITE::SP_DMA_BUSY_REG NOT IMPLEMENTED");
+        NIN64_LOG(RSP, Error, "WRITE::SP_DMA_BUSY_REG NOT IMPLEMENTED\n");
         exit(42);
         break;
     case SP_SEMAPHORE_REG:
-        std::printf("SP Write: SP_SEMAPHORE_REG: 0x%08x\n", value);
+        NIN64_LOG(RSP, Trace, "SP Write: SP_SEMAPHORE_REG: 0x%08x\n", value);
         _semaphore = false;
         break;
     case SP_PC_REG:
-        std::printf("SP Write: SP_PC_REG: 0x%08x\n", value);
+        NIN64_LOG(RSP, Trace, "SP Write: SP_PC_REG: 0x%08x\n", value);
         _pc     = (value & 0xfff);
         _pcNext = (_pc + 4) & 0xfff;
         break;
     case SP_IBIST_REG:
-        std::printf("SP Write: SP_IBIST_REG: 0x%08x\n", value);
-        std::puts("WRITE::SP_IBIST_REG NOT IMPLEMENTED");
+        NIN64_LOG(RSP, Error, "WRITE::SP_IBIST_REG NOT IMPLEMENTED\n");
         exit(42);
         break;
     default:
@@ -1126,7 +947,7 @@ void RSP::dmaRead(std::uint16_t length, std::uint16_t count, std::uint16_t skip)
     std::uint8_t* src;
     std::uint8_t* dst;
 
-    std::printf("SP DMA (Read)!  SPADDR:0x%04x ADDR:0x%08x L:0x%04x C:0x%04x S:0x%04x\n", _spAddr, _dramAddr, length, count, skip);
+    NIN64_LOG(RSP, Trace, "SP DMA (Read)!  SPADDR:0x%04x ADDR:0x%08x L:0x%04x C:0x%04x S:0x%04x\n", _spAddr, _dramAddr, length, count, skip);
 
     src = _memory.ram + _dramAddr;
 
@@ -1146,6 +967,7 @@ void RSP::dmaRead(std::uint16_t length, std::uint16_t count, std::uint16_t skip)
             std::memcpy(dst + i * length, src + i * (length + skip), length);
         }
     }
+    _memory.markWritten(0x04000000 | (_spAddr & 0x1fff), length * count);
 }
 
 void RSP::dmaWrite(std::uint16_t length, std::uint16_t count, std::uint16_t skip)
@@ -1153,7 +975,7 @@ void RSP::dmaWrite(std::uint16_t length, std::uint16_t count, std::uint16_t skip
     std::uint8_t* src;
     std::uint8_t* dst;
 
-    std::printf("SP DMA (Write)! SPADDR:0x%04x ADDR:0x%08x L:0x%04x C:0x%04x S:0x%04x\n", _spAddr, _dramAddr, length, count, skip);
+    NIN64_LOG(RSP, Trace, "SP DMA (Write)! SPADDR:0x%04x ADDR:0x%08x L:0x%04x C:0x%04x S:0x%04x\n", _spAddr, _dramAddr, length, count, skip);
 
     dst = _memory.ram + _dramAddr;
 
@@ -1173,6 +995,7 @@ void RSP::dmaWrite(std::uint16_t length, std::uint16_t count, std::uint16_t skip
             std::memcpy(dst + i * length, src + i * (length + skip), length);
         }
     }
+    _memory.markWritten(_dramAddr, length * count);
 }
 
 template <typename T> T RSP::dRead(std::uint16_t addr)
@@ -1187,39 +1010,40 @@ template <typename T> void RSP::dWrite(std::uint16_t addr, T value)
     addr &= 0xfff;
 
     *(T*)(_memory.spDmem + addr) = swap(value);
+    _memory.markWritten(0x04000000 | addr);
 }
 
 std::uint32_t RSP::cop0Read(std::uint8_t reg)
 {
     std::uint32_t value{};
 
-    std::printf("RSP COP0 READ\n");
+    NIN64_LOG(RSP, Trace, "RSP COP0 READ\n");
 
     switch (reg)
     {
     case 0:
-        value = read(SP_MEM_ADDR_REG);
+        value = regRead(SP_MEM_ADDR_REG);
         break;
     case 1:
-        value = read(SP_DRAM_ADDR_REG);
+        value = regRead(SP_DRAM_ADDR_REG);
         break;
     case 2:
-        value = read(SP_RD_LEN_REG);
+        value = regRead(SP_RD_LEN_REG);
         break;
     case 3:
-        value = read(SP_WR_LEN_REG);
+        value = regRead(SP_WR_LEN_REG);
         break;
     case 4:
-        value = read(SP_STATUS_REG);
+        value = regRead(SP_STATUS_REG);
         break;
     case 5:
-        value = read(SP_DMA_FULL_REG);
+        value = regRead(SP_DMA_FULL_REG);
         break;
     case 6:
-        value = read(SP_DMA_BUSY_REG);
+        value = regRead(SP_DMA_BUSY_REG);
         break;
     case 7:
-        value = read(SP_SEMAPHORE_REG);
+        value = regRead(SP_SEMAPHORE_REG);
         break;
     case 8:
         value = _rdp.read(DPC_START_REG);
@@ -1232,7 +1056,6 @@ std::uint32_t RSP::cop0Read(std::uint8_t reg)
         break;
     case 11:
         value = _rdp.read(DPC_STATUS_REG);
-        //gDebug = true;
         break;
     case 12:
         value = _rdp.read(DPC_CLOCK_REG);
@@ -1253,57 +1076,103 @@ std::uint32_t RSP::cop0Read(std::uint8_t reg)
 
 void RSP::cop0Write(std::uint8_t reg, std::uint32_t value)
 {
-    std::printf("RSP COP0 WRITE\n");
+    NIN64_LOG(RSP, Trace, "RSP COP0 WRITE\n");
 
     switch (reg)
     {
     case 0:
-        write(SP_MEM_ADDR_REG, value);
+        regWrite(SP_MEM_ADDR_REG, value);
         break;
     case 1:
-        write(SP_DRAM_ADDR_REG, value);
+        regWrite(SP_DRAM_ADDR_REG, value);
         break;
     case 2:
-        write(SP_RD_LEN_REG, value);
+        regWrite(SP_RD_LEN_REG, value);
         break;
     case 3:
-        write(SP_WR_LEN_REG, value);
+        regWrite(SP_WR_LEN_REG, value);
         break;
     case 4:
-        write(SP_STATUS_REG, value);
+        regWrite(SP_STATUS_REG, value);
         break;
     case 5:
-        write(SP_DMA_FULL_REG, value);
+        regWrite(SP_DMA_FULL_REG, value);
         break;
     case 6:
-        write(SP_DMA_BUSY_REG, value);
+        regWrite(SP_DMA_BUSY_REG, value);
         break;
     case 7:
-        write(SP_SEMAPHORE_REG, value);
+        regWrite(SP_SEMAPHORE_REG, value);
         break;
     case 8:
-        _rdp.write(DPC_START_REG, value);
+        _rdp.rspWrite(DPC_START_REG, value);
         break;
     case 9:
-        _rdp.write(DPC_END_REG, value);
+        _rdp.rspWrite(DPC_END_REG, value);
         break;
     case 10:
-        _rdp.write(DPC_CURRENT_REG, value);
+        _rdp.rspWrite(DPC_CURRENT_REG, value);
         break;
     case 11:
-        _rdp.write(DPC_STATUS_REG, value);
+        _rdp.rspWrite(DPC_STATUS_REG, value);
         break;
     case 12:
-        _rdp.write(DPC_CLOCK_REG, value);
+        _rdp.rspWrite(DPC_CLOCK_REG, value);
         break;
     case 13:
-        _rdp.write(DPC_BUFBUSY_REG, value);
+        _rdp.rspWrite(DPC_BUFBUSY_REG, value);
         break;
     case 14:
-        _rdp.write(DPC_PIPEBUSY_REG, value);
+        _rdp.rspWrite(DPC_PIPEBUSY_REG, value);
         break;
     case 15:
-        _rdp.write(DPC_TMEM_REG, value);
+        _rdp.rspWrite(DPC_TMEM_REG, value);
         break;
     }
 }
+
+/* The RSP thread must be paused */
+void RSP::save(SavestateWriter& writer) const
+{
+    writer.begin("RSP ");
+    writer.write<bool>(_halt);
+    writer.write<bool>(_broke);
+    writer.write<bool>(_semaphore);
+    writer.write<bool>(_interruptOnBreak);
+    writer.write<bool>(_hleDone);
+    writer.write(_signal);
+    writer.write(_spAddr);
+    writer.write(_dramAddr);
+    writer.write(_regs);
+    writer.write(_vregs);
+    writer.write(_acc);
+    writer.write(_pc);
+    writer.write(_pcNext);
+    writer.write(_vcc);
+    writer.write(_vco);
+    writer.write(_vce);
+    _audio.save(writer);
+    writer.end();
+}
+
+void RSP::load(SavestateReader& reader)
+{
+    reader.open("RSP ");
+    _halt             = reader.read<bool>();
+    _broke            = reader.read<bool>();
+    _semaphore        = reader.read<bool>();
+    _interruptOnBreak = reader.read<bool>();
+    _hleDone          = reader.read<bool>();
+    reader.read(_signal);
+    reader.read(_spAddr);
+    reader.read(_dramAddr);
+    reader.read(_regs);
+    reader.read(_vregs);
+    reader.read(_acc);
+    reader.read(_pc);
+    reader.read(_pcNext);
+    reader.read(_vcc);
+    reader.read(_vco);
+    reader.read(_vce);
+    _audio.load(reader);
+}
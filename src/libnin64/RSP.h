@@ -1,16 +1,15 @@
 #ifndef INCLUDED_RSP_H
 #define INCLUDED_RSP_H
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <libnin64/AudioHLE.h>
 #include <libnin64/CIC.h>
 #include <libnin64/NonCopyable.h>
-
-#if defined(_MSC_VER)
-#include <intrin.h>
-#else
-#include <x86intrin.h>
-#endif
+#include <libnin64/RSPVector.h>
+#include <libnin64/Worker.h>
 
 namespace libnin64
 {
@@ -18,19 +17,33 @@ namespace libnin64
 class Memory;
 class MIPSInterface;
 class RDP;
+class Profiler;
+class SavestateReader;
+class SavestateWriter;
+class Scheduler;
 class RSP : private NonCopyable
 {
 public:
-    RSP(Memory& memory, MIPSInterface& mi, RDP& rdp);
+    RSP(Memory& memory, MIPSInterface& mi, Scheduler& scheduler, RDP& rdp, Profiler& profiler);
     ~RSP();
 
-    void init(CIC cic);
+    void init(const CICInfo& cic, TvType tvType);
+    void setVectorBackend(RSPVectorBackend backend);
+    void setAudioHLE(bool enabled);
+    void setThreaded(bool threaded);
+    void run();
     void tick(std::size_t count);
     void tick();
 
     std::uint32_t read(std::uint32_t reg);
     void          write(std::uint32_t reg, std::uint32_t value);
 
+    void pause();
+    void resume();
+
+    void save(SavestateWriter& writer) const;
+    void load(SavestateReader& reader);
+
 private:
     union Reg
     {
@@ -47,6 +60,13 @@ private:
         __m128i i;
     };
 
+    std::uint32_t regRead(std::uint32_t reg);
+    void          regWrite(std::uint32_t reg, std::uint32_t value);
+
+    void runThreaded();
+    void raiseInterrupt();
+    void lowerInterrupt();
+
     void dmaRead(std::uint16_t length, std::uint16_t count, std::uint16_t skip);
     void dmaWrite(std::uint16_t length, std::uint16_t count, std::uint16_t skip);
 
@@ -68,12 +88,15 @@ private:
 
     Memory&        _memory;
     MIPSInterface& _mi;
+    Scheduler&     _scheduler;
     RDP&           _rdp;
+    Profiler&      _profiler;
 
     bool          _halt : 1;
     bool          _broke : 1;
     bool          _semaphore : 1;
     bool          _interruptOnBreak : 1;
+    bool          _hleDone : 1;
     std::uint8_t  _signal;
     std::uint16_t _spAddr;
     std::uint32_t _dramAddr;
@@ -85,6 +108,15 @@ private:
     std::uint16_t _vcc;
     std::uint16_t _vco;
     std::uint8_t  _vce;
+
+    const RSPVectorUnit* _vu;
+    AudioHLE             _audio;
+    bool                 _audioHLE;
+
+    std::unique_ptr<Worker>    _worker;
+    std::atomic<bool>          _stop;
+    std::atomic<std::uint64_t> _progress;
+    std::uint64_t              _resumed;
 };
 
 } // namespace libnin64
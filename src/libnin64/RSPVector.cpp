@@ -0,0 +1,260 @@
+#include <libnin64/CPUFeatures.h>
+#include <libnin64/RSPVector.h>
+
+using namespace libnin64;
+
+static __m128i vSelect(__m128i v, std::uint8_t e)
+{
+    __m128i tmp;
+
+    switch (e & 0b1111)
+    {
+    case 0b0000: // Whole vector (01234567)
+        tmp = v;
+        break;
+    case 0b0001: // Undefined
+        tmp = _mm_setzero_si128();
+        break;
+    case 0b0010: // 00224466
+        tmp = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 2, 0, 0));
+        tmp = _mm_shufflehi_epi16(tmp, _MM_SHUFFLE(2, 2, 0, 0));
+        break;
+    case 0b0011: // 11335577
+        tmp = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 1, 1));
+        tmp = _mm_shufflehi_epi16(tmp, _MM_SHUFFLE(3, 3, 1, 1));
+        break;
+    case 0b0100: // 00004444
+        tmp = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 0, 0, 0));
+        tmp = _mm_shufflehi_epi16(tmp, _MM_SHUFFLE(0, 0, 0, 0));
+        break;
+    case 0b0101: // 11115555
+        tmp = _mm_shufflelo_epi16(v, _MM_SHUFFLE(1, 1, 1, 1));
+        tmp = _mm_shufflehi_epi16(tmp, _MM_SHUFFLE(1, 1, 1, 1));
+        break;
+    case 0b0110: // 22226666
+        tmp = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 2, 2, 2));
+        tmp = _mm_shufflehi_epi16(tmp, _MM_SHUFFLE(2, 2, 2, 2));
+        break;
+    case 0b0111: // 33337777
+        tmp = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+        tmp = _mm_shufflehi_epi16(tmp, _MM_SHUFFLE(3, 3, 3, 3));
+        break;
+    case 0b1000: // 00000000
+        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 0));
+        break;
+    case 0b1001: // 11111111
+        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 1));
+        break;
+    case 0b1010: // 22222222
+        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 2));
+        break;
+    case 0b1011: // 33333333
+        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 3));
+        break;
+    case 0b1100: // 44444444
+        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 4));
+        break;
+    case 0b1101: // 55555555
+        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 5));
+        break;
+    case 0b1110: // 66666666
+        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 6));
+        break;
+    case 0b1111: // 77777777
+        tmp = _mm_set1_epi16(_mm_extract_epi16(v, 7));
+        break;
+    }
+
+    return tmp;
+}
+
+/* Unsigned compare, as SSE2 only has a signed one */
+static __m128i vCarry(__m128i before, __m128i after)
+{
+    return _mm_cmpgt_epi16(_mm_xor_si128(before, vSignBit()), _mm_xor_si128(after, vSignBit()));
+}
+
+/*
+ * Adds a 48-bit product to the accumulator, with the carries kept as
+ * 0xffff/0x0000 masks.
+ */
+static void vAccumulate(__m128i* acc, __m128i lo, __m128i mid, __m128i hi)
+{
+    __m128i sum;
+    __m128i carry;
+    __m128i carry2;
+
+    sum    = _mm_add_epi16(acc[0], lo);
+    carry  = vCarry(acc[0], sum);
+    acc[0] = sum;
+
+    sum    = _mm_add_epi16(acc[1], mid);
+    carry2 = vCarry(acc[1], sum);
+    acc[1] = _mm_sub_epi16(sum, carry);
+    carry  = _mm_or_si128(carry2, _mm_and_si128(carry, _mm_cmpeq_epi16(sum, vOnes())));
+
+    acc[2] = _mm_sub_epi16(_mm_add_epi16(acc[2], hi), carry);
+}
+
+/* This function computes fractional products.
+ * Example:
+ * -1.0 * -1.0
+ * => 0x8000 * 0x8000
+ * => 0x40000000
+ * => Sign bit: 0
+ * => Shift Left 1: 0x80000000
+ * => Insert in Acc with sign extension: 0x000080000000
+ * => Clamp starting at b31: 0x7fff
+ * => Result: ~1.0
+ *
+ * -0.5 * 0.25
+ * => 0xc000 * 0x2000
+ * => 0xf8000000
+ * => Sign bit: 1
+ * => Shift left 1: 0xf0000000
+ * => Insert in Acc with sign extension: 0xfffff0000000
+ * => Clamp starting at b31: 0xf000
+ * => Result: -0.125
+ *
+ * The non-accumulating forms round by starting from 0x8000.
+ */
+template <bool accumulate, bool unsignedClamp>
+static __m128i vMultiplyFraction(__m128i vs, __m128i vt, std::uint8_t e, __m128i* acc)
+{
+    __m128i a;
+    __m128i hi;
+    __m128i lo;
+    __m128i sign;
+
+    /* Multiply */
+    a  = vSelect(vt, e);
+    hi = _mm_mulhi_epi16(a, vs);
+    lo = _mm_mullo_epi16(a, vs);
+
+    /* Extract sign */
+    sign = vSext(hi);
+
+    /* Shift left one bit */
+    hi = _mm_or_si128(_mm_slli_epi16(hi, 1), _mm_srli_epi16(lo, 15));
+    lo = _mm_slli_epi16(lo, 1);
+
+    if (!accumulate)
+    {
+        acc[0] = vSignBit();
+        acc[1] = _mm_setzero_si128();
+        acc[2] = _mm_setzero_si128();
+    }
+    vAccumulate(acc, lo, hi, sign);
+
+    /* Clamp */
+    if (unsignedClamp)
+    {
+        return vClampUnsigned(acc[1], acc[2]);
+    }
+    else
+    {
+        return vClampSigned(acc[1], acc[2]);
+    }
+}
+
+/* TODO: Handle sign better */
+template <bool accumulate, int slot, int resultSlot>
+static __m128i vMultiplyMixed(__m128i vs, __m128i vt, std::uint8_t e, __m128i* acc)
+{
+    __m128i a;
+    __m128i hi;
+    __m128i lo;
+    __m128i prod[3];
+
+    /* Multiply */
+    a  = vSelect(vt, e);
+    hi = _mm_mulhi_epi16(a, vs);
+    lo = _mm_mullo_epi16(a, vs);
+
+    /* Load in prod */
+    switch (slot)
+    {
+    case 0:
+        prod[0] = hi;
+        prod[1] = vSext(hi);
+        prod[2] = prod[1];
+        break;
+    case 1:
+        prod[0] = lo;
+        prod[1] = hi;
+        prod[2] = vSext(hi);
+        break;
+    case 2:
+        prod[0] = _mm_setzero_si128();
+        prod[1] = lo;
+        prod[2] = hi;
+        break;
+    }
+
+    if (!accumulate)
+    {
+        /* Store in acc */
+        acc[0] = prod[0];
+        acc[1] = prod[1];
+        acc[2] = prod[2];
+    }
+    else
+    {
+        /* Accumulate */
+        /* TODO: Add acc saturation */
+        vAccumulate(acc, prod[0], prod[1], prod[2]);
+    }
+
+    return vClampSigned3(acc[1], acc[2], acc[resultSlot]);
+}
+
+template <bool low>
+static __m128i vClipSelect(__m128i vs, __m128i vt, std::uint8_t e, __m128i* acc, std::uint16_t* vcc, std::uint16_t* vco, std::uint8_t* vce)
+{
+    return vClip<low>(vs, vSelect(vt, e), acc, vcc, vco, vce);
+}
+
+__m128i libnin64::vmulfSSE2(__m128i vs, __m128i vt, std::uint8_t e, __m128i* acc)
+{
+    return vMultiplyFraction<false, false>(vs, vt, e, acc);
+}
+
+__m128i libnin64::vmuluSSE2(__m128i vs, __m128i vt, std::uint8_t e, __m128i* acc)
+{
+    return vMultiplyFraction<false, true>(vs, vt, e, acc);
+}
+
+const RSPVectorUnit libnin64::kRSPVectorSSE2 = {
+    "sse2",
+    &vSelect,
+    &vMultiplyFraction<false, false>,
+    &vMultiplyFraction<false, true>,
+    &vMultiplyMixed<false, 0, 0>,
+    &vMultiplyMixed<false, 1, 1>,
+    &vMultiplyMixed<false, 1, 0>,
+    &vMultiplyMixed<false, 2, 1>,
+    &vMultiplyFraction<true, false>,
+    &vMultiplyFraction<true, true>,
+    &vMultiplyMixed<true, 0, 0>,
+    &vMultiplyMixed<true, 1, 1>,
+    &vMultiplyMixed<true, 1, 0>,
+    &vMultiplyMixed<true, 2, 1>,
+    &vClipSelect<true>,
+    &vClipSelect<false>,
+};
+
+RSPVectorBackend RSPVectorUnit::detect()
+{
+    return CPUFeatures::host().avx2 ? RSPVectorBackend::AVX2 : RSPVectorBackend::SSE2;
+}
+
+const RSPVectorUnit* RSPVectorUnit::get(RSPVectorBackend backend)
+{
+    switch (backend)
+    {
+    case RSPVectorBackend::AVX2:
+        return &kRSPVectorAVX2;
+    default:
+        return &kRSPVectorSSE2;
+    }
+}
@@ -0,0 +1,178 @@
+#ifndef INCLUDED_RSP_VECTOR_H
+#define INCLUDED_RSP_VECTOR_H
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+namespace libnin64
+{
+
+enum class RSPVectorBackend : std::uint8_t
+{
+    SSE2,
+    AVX2,
+};
+
+/*
+ * Kernels for the RSP vector unit.
+ *
+ * Each backend lives in its own translation unit, built for its instruction
+ * set, and is picked at runtime from what the host supports. Every kernel
+ * takes the raw vt and the element field, so that element selection can be
+ * fused with the operation.
+ */
+struct RSPVectorUnit
+{
+    using Multiply = __m128i (*)(__m128i vs, __m128i vt, std::uint8_t e, __m128i* acc);
+    using Clip     = __m128i (*)(__m128i vs, __m128i vt, std::uint8_t e, __m128i* acc, std::uint16_t* vcc, std::uint16_t* vco, std::uint8_t* vce);
+    using Select   = __m128i (*)(__m128i v, std::uint8_t e);
+
+    static RSPVectorBackend     detect();
+    static const RSPVectorUnit* get(RSPVectorBackend backend);
+
+    const char* name;
+    Select      select;
+    Multiply    vmulf;
+    Multiply    vmulu;
+    Multiply    vmudl;
+    Multiply    vmudm;
+    Multiply    vmudn;
+    Multiply    vmudh;
+    Multiply    vmacf;
+    Multiply    vmacu;
+    Multiply    vmadl;
+    Multiply    vmadm;
+    Multiply    vmadn;
+    Multiply    vmadh;
+    Clip        vcl;
+    Clip        vch;
+};
+
+extern const RSPVectorUnit kRSPVectorSSE2;
+extern const RSPVectorUnit kRSPVectorAVX2;
+
+/* The SSE2 VMULF and VMULU, which the AVX2 backend uses as they beat its own */
+__m128i vmulfSSE2(__m128i vs, __m128i vt, std::uint8_t e, __m128i* acc);
+__m128i vmuluSSE2(__m128i vs, __m128i vt, std::uint8_t e, __m128i* acc);
+
+/*
+ * Helpers shared by the backends.
+ *
+ * These are static on purpose: the AVX2 backend is compiled with AVX2
+ * enabled, and an inline function with external linkage could end up
+ * using its copy on hosts without AVX2. For the same reason there are no
+ * vector constants with dynamic initialization.
+ */
+static inline __m128i vSignBit() { return _mm_set1_epi16((short)0x8000); }
+static inline __m128i vOnes() { return _mm_set1_epi16((short)0xffff); }
+
+/*
+ * Return:
+ *   0xFFFF if the highest bit is set
+ *   0x0000 otherwise
+ */
+static inline __m128i vSext(__m128i value)
+{
+    return _mm_srai_epi16(value, 15);
+}
+
+static inline __m128i vMultiplex(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(a, mask), _mm_andnot_si128(mask, b));
+}
+
+static inline __m128i vClampSigned3(__m128i lo, __m128i hi, __m128i value)
+{
+    __m128i signExtMask;
+    __m128i clampValue;
+
+    signExtMask = _mm_cmpeq_epi16(hi, vSext(lo));
+    clampValue  = _mm_xor_si128(vSext(hi), _mm_set1_epi16(0x7fff));
+    return vMultiplex(signExtMask, value, clampValue);
+}
+
+static inline __m128i vClampSigned(__m128i lo, __m128i hi)
+{
+    return vClampSigned3(lo, hi, lo);
+}
+
+/* TODO: Make sure we clamp correctly */
+static inline __m128i vClampUnsigned(__m128i lo, __m128i hi)
+{
+    __m128i signExtMask;
+    __m128i clampValue;
+
+    signExtMask = _mm_cmpeq_epi16(hi, vSext(lo));
+    clampValue  = _mm_xor_si128(vSext(hi), vOnes());
+    return vMultiplex(signExtMask, lo, clampValue);
+}
+
+/* One bit per lane, from bit 0 of each lane */
+static inline std::uint8_t vExtract(__m128i v)
+{
+    return (std::uint8_t)_mm_movemask_epi8(_mm_packs_epi16(_mm_slli_epi16(v, 15), _mm_setzero_si128()));
+}
+
+static inline __m128i vUnextract(std::uint8_t v)
+{
+    __m128i bits;
+
+    bits = _mm_set_epi16(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    return _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16(v), bits), bits);
+}
+
+/* TODO: Implement low correctly */
+template <bool low>
+static inline __m128i vClip(__m128i vs, __m128i vt, __m128i* acc, std::uint16_t* vcc, std::uint16_t* vco, std::uint8_t* vce)
+{
+    __m128i vtNeg;
+    __m128i min;
+    __m128i max;
+    __m128i value;
+    __m128i ge;
+    __m128i le;
+    __m128i neq;
+    __m128i sign;
+    __m128i ce;
+
+    vtNeg = _mm_sub_epi16(_mm_setzero_si128(), vt);
+    min   = _mm_min_epi16(vt, vtNeg);
+    max   = _mm_max_epi16(vt, vtNeg);
+
+    value = vs;
+    value = _mm_min_epi16(_mm_max_epi16(value, min), max);
+    ge    = _mm_cmpeq_epi16(value, max);
+    le    = _mm_cmpeq_epi16(value, min);
+
+    acc[0] = value;
+    acc[1] = vSext(value);
+    acc[2] = acc[1];
+
+    if (!low)
+    {
+        neq  = _mm_xor_si128(_mm_or_si128(_mm_cmpeq_epi16(vs, vt), _mm_cmpeq_epi16(vs, vtNeg)), vOnes());
+        sign = _mm_cmpgt_epi16(_mm_setzero_si128(), _mm_xor_si128(vs, vt));
+        ce   = _mm_cmpeq_epi16(_mm_add_epi16(vs, vt), vOnes());
+
+        *vcc = (((std::uint16_t)vExtract(ge)) << 8) | vExtract(le);
+        *vco = (((std::uint16_t)vExtract(neq)) << 8) | vExtract(sign);
+        *vce = vExtract(ce);
+    }
+    else
+    {
+        *vcc = 0;
+        *vco = 0;
+        *vce = 0;
+    }
+
+    return value;
+}
+
+} // namespace libnin64
+
+#endif
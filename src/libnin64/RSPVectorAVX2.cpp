@@ -0,0 +1,182 @@
+#include <libnin64/RSPVector.h>
+
+/*
+ * AVX2 backend.
+ *
+ * Element selection is a single pshufb from a table. The multiplies work on
+ * the low 32 bits of the accumulator as one 32-bit lane per element, so the
+ * product is added in one step and only the carry into the high slice has
+ * to be extracted, instead of chaining two 16-bit carries.
+ *
+ * Everything stays in 128-bit registers: a vector register only has eight
+ * elements, and moving halves across 256-bit lanes costs more than it saves.
+ */
+
+using namespace libnin64;
+
+alignas(16) static const std::uint8_t kSelect[16][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13},
+    {2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15},
+    {0, 1, 0, 1, 0, 1, 0, 1, 8, 9, 8, 9, 8, 9, 8, 9},
+    {2, 3, 2, 3, 2, 3, 2, 3, 10, 11, 10, 11, 10, 11, 10, 11},
+    {4, 5, 4, 5, 4, 5, 4, 5, 12, 13, 12, 13, 12, 13, 12, 13},
+    {6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15},
+    {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1},
+    {2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3, 2, 3},
+    {4, 5, 4, 5, 4, 5, 4, 5, 4, 5, 4, 5, 4, 5, 4, 5},
+    {6, 7, 6, 7, 6, 7, 6, 7, 6, 7, 6, 7, 6, 7, 6, 7},
+    {8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 8, 9, 8, 9},
+    {10, 11, 10, 11, 10, 11, 10, 11, 10, 11, 10, 11, 10, 11, 10, 11},
+    {12, 13, 12, 13, 12, 13, 12, 13, 12, 13, 12, 13, 12, 13, 12, 13},
+    {14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15},
+};
+
+static __m128i vSelect(__m128i v, std::uint8_t e)
+{
+    return _mm_shuffle_epi8(v, _mm_load_si128((const __m128i*)kSelect[e & 0xf]));
+}
+
+/*
+ * Adds a 32-bit product, given as elements 0-3 and 4-7, to the low 32 bits
+ * of the accumulator, and carries into the high slice.
+ */
+static void vAccumulate(__m128i* acc, __m128i prodLo, __m128i prodHi, __m128i top)
+{
+    __m128i bias;
+    __m128i lo;
+    __m128i hi;
+    __m128i sumLo;
+    __m128i sumHi;
+    __m128i carry;
+
+    bias  = _mm_set1_epi32((int)0x80000000);
+    lo    = _mm_unpacklo_epi16(acc[0], acc[1]);
+    hi    = _mm_unpackhi_epi16(acc[0], acc[1]);
+    sumLo = _mm_add_epi32(lo, prodLo);
+    sumHi = _mm_add_epi32(hi, prodHi);
+    carry = _mm_packs_epi32(_mm_cmpgt_epi32(_mm_xor_si128(lo, bias), _mm_xor_si128(sumLo, bias)),
+                            _mm_cmpgt_epi32(_mm_xor_si128(hi, bias), _mm_xor_si128(sumHi, bias)));
+
+    acc[0] = _mm_packus_epi32(_mm_blend_epi16(sumLo, _mm_setzero_si128(), 0xaa), _mm_blend_epi16(sumHi, _mm_setzero_si128(), 0xaa));
+    acc[1] = _mm_packus_epi32(_mm_srli_epi32(sumLo, 16), _mm_srli_epi32(sumHi, 16));
+    acc[2] = _mm_sub_epi16(_mm_add_epi16(acc[2], top), carry);
+}
+
+template <bool accumulate, bool unsignedClamp>
+static __m128i vMultiplyFraction(__m128i vs, __m128i vt, std::uint8_t e, __m128i* acc)
+{
+    __m128i a;
+    __m128i hi;
+    __m128i lo;
+    __m128i prodLo;
+    __m128i prodHi;
+
+    a      = vSelect(vt, e);
+    hi     = _mm_mulhi_epi16(a, vs);
+    lo     = _mm_mullo_epi16(a, vs);
+    prodLo = _mm_slli_epi32(_mm_unpacklo_epi16(lo, hi), 1);
+    prodHi = _mm_slli_epi32(_mm_unpackhi_epi16(lo, hi), 1);
+
+    if (!accumulate)
+    {
+        acc[0] = vSignBit();
+        acc[1] = _mm_setzero_si128();
+        acc[2] = _mm_setzero_si128();
+    }
+    vAccumulate(acc, prodLo, prodHi, vSext(hi));
+
+    if (unsignedClamp)
+    {
+        return vClampUnsigned(acc[1], acc[2]);
+    }
+    else
+    {
+        return vClampSigned(acc[1], acc[2]);
+    }
+}
+
+template <bool accumulate, int slot, int resultSlot>
+static __m128i vMultiplyMixed(__m128i vs, __m128i vt, std::uint8_t e, __m128i* acc)
+{
+    __m128i a;
+    __m128i hi;
+    __m128i lo;
+    __m128i prodLo;
+    __m128i prodHi;
+
+    a  = vSelect(vt, e);
+    hi = _mm_mulhi_epi16(a, vs);
+    lo = _mm_mullo_epi16(a, vs);
+
+    if (!accumulate)
+    {
+        switch (slot)
+        {
+        case 0:
+            acc[0] = hi;
+            acc[1] = vSext(hi);
+            acc[2] = acc[1];
+            break;
+        case 1:
+            acc[0] = lo;
+            acc[1] = hi;
+            acc[2] = vSext(hi);
+            break;
+        case 2:
+            acc[0] = _mm_setzero_si128();
+            acc[1] = lo;
+            acc[2] = hi;
+            break;
+        }
+    }
+    else
+    {
+        switch (slot)
+        {
+        case 0:
+            prodLo = _mm_unpacklo_epi16(hi, vSext(hi));
+            prodHi = _mm_unpackhi_epi16(hi, vSext(hi));
+            vAccumulate(acc, prodLo, prodHi, vSext(hi));
+            break;
+        case 1:
+            prodLo = _mm_unpacklo_epi16(lo, hi);
+            prodHi = _mm_unpackhi_epi16(lo, hi);
+            vAccumulate(acc, prodLo, prodHi, vSext(hi));
+            break;
+        case 2:
+            prodLo = _mm_unpacklo_epi16(_mm_setzero_si128(), lo);
+            prodHi = _mm_unpackhi_epi16(_mm_setzero_si128(), lo);
+            vAccumulate(acc, prodLo, prodHi, hi);
+            break;
+        }
+    }
+
+    return vClampSigned3(acc[1], acc[2], acc[resultSlot]);
+}
+
+template <bool low>
+static __m128i vClipSelect(__m128i vs, __m128i vt, std::uint8_t e, __m128i* acc, std::uint16_t* vcc, std::uint16_t* vco, std::uint8_t* vce)
+{
+    return vClip<low>(vs, vSelect(vt, e), acc, vcc, vco, vce);
+}
+
+const RSPVectorUnit libnin64::kRSPVectorAVX2 = {
+    "avx2",
+    &vSelect,
+    &vmulfSSE2,
+    &vmuluSSE2,
+    &vMultiplyMixed<false, 0, 0>,
+    &vMultiplyMixed<false, 1, 1>,
+    &vMultiplyMixed<false, 1, 0>,
+    &vMultiplyMixed<false, 2, 1>,
+    &vMultiplyFraction<true, false>,
+    &vMultiplyFraction<true, true>,
+    &vMultiplyMixed<true, 0, 0>,
+    &vMultiplyMixed<true, 1, 1>,
+    &vMultiplyMixed<true, 1, 0>,
+    &vMultiplyMixed<true, 2, 1>,
+    &vClipSelect<true>,
+    &vClipSelect<false>,
+};
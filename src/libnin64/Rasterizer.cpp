@@ -0,0 +1,643 @@
+#include <algorithm>
+#include <libnin64/Memory.h>
+#include <libnin64/Rasterizer.h>
+
+/* Bands are this many scanlines high, and dealt to the workers in turn */
+#define BAND_SHIFT 3
+
+/* A full batch is handed to the workers without waiting for a sync */
+#define BATCH_SIZE 1024
+
+using namespace libnin64;
+
+static std::int32_t clamp8(std::int32_t value)
+{
+    return std::min(std::max(value, 0), 255);
+}
+
+static std::int32_t expand5(std::uint32_t value)
+{
+    value &= 0x1f;
+    return (std::int32_t)((value << 3) | (value >> 2));
+}
+
+static std::uint32_t bytesPerPixel(std::uint8_t size)
+{
+    return (size == 3) ? 4 : (size == 2) ? 2 : 1;
+}
+
+void RasterState::decode()
+{
+    cycleType    = (CycleType)((otherModes >> 52) & 3);
+    perspective  = (otherModes >> 51) & 1;
+    tlut         = (otherModes >> 47) & 1;
+    tlutIA       = (otherModes >> 46) & 1;
+    forceBlend   = (otherModes >> 14) & 1;
+    zDecal       = ((otherModes >> 10) & 3) == 3;
+    zUpdate      = (otherModes >> 5) & 1;
+    zCompare     = (otherModes >> 4) & 1;
+    zPrim        = (otherModes >> 2) & 1;
+    alphaCompare = otherModes & 1;
+
+    for (int c = 0; c < 2; ++c)
+    {
+        blender[c][0] = (otherModes >> (30 - c * 2)) & 3;
+        blender[c][1] = (otherModes >> (26 - c * 2)) & 3;
+        blender[c][2] = (otherModes >> (22 - c * 2)) & 3;
+        blender[c][3] = (otherModes >> (18 - c * 2)) & 3;
+    }
+
+    rgb[0][0]   = (combine >> 52) & 0xf;
+    rgb[0][1]   = (combine >> 28) & 0xf;
+    rgb[0][2]   = (combine >> 47) & 0x1f;
+    rgb[0][3]   = (combine >> 15) & 0x7;
+    rgb[1][0]   = (combine >> 37) & 0xf;
+    rgb[1][1]   = (combine >> 24) & 0xf;
+    rgb[1][2]   = (combine >> 32) & 0x1f;
+    rgb[1][3]   = (combine >> 6) & 0x7;
+    alpha[0][0] = (combine >> 44) & 0x7;
+    alpha[0][1] = (combine >> 12) & 0x7;
+    alpha[0][2] = (combine >> 41) & 0x7;
+    alpha[0][3] = (combine >> 9) & 0x7;
+    alpha[1][0] = (combine >> 21) & 0x7;
+    alpha[1][1] = (combine >> 3) & 0x7;
+    alpha[1][2] = (combine >> 18) & 0x7;
+    alpha[1][3] = (combine >> 0) & 0x7;
+}
+
+namespace
+{
+
+struct CombineInputs
+{
+    RasterColor combined;
+    RasterColor tex0;
+    RasterColor tex1;
+    RasterColor shade;
+    RasterColor one;
+    RasterColor zero;
+    RasterColor keyCenter;
+    RasterColor keyScale;
+    RasterColor k4;
+};
+
+const RasterColor& rgbInput(const RasterState& s, const CombineInputs& in, std::uint8_t sel)
+{
+    switch (sel)
+    {
+    case 0:
+        return in.combined;
+    case 1:
+        return in.tex0;
+    case 2:
+        return in.tex1;
+    case 3:
+        return s.prim;
+    case 4:
+        return in.shade;
+    case 5:
+        return s.env;
+    default:
+        return in.zero;
+    }
+}
+
+std::int32_t alphaInput(const RasterState& s, const CombineInputs& in, std::uint8_t sel)
+{
+    switch (sel)
+    {
+    case 0:
+        return in.combined.a;
+    case 1:
+        return in.tex0.a;
+    case 2:
+        return in.tex1.a;
+    case 3:
+        return s.prim.a;
+    case 4:
+        return in.shade.a;
+    case 5:
+        return s.env.a;
+    case 6:
+        return 255;
+    default:
+        return 0;
+    }
+}
+
+/* (A - B) * C + D, with C = 255 standing for 1.0 */
+std::int32_t lerp(std::int32_t a, std::int32_t b, std::int32_t c, std::int32_t d)
+{
+    return clamp8((((a - b) * (c + (c >> 7))) >> 8) + d);
+}
+
+RasterColor combine(const RasterState& s, const CombineInputs& in, int cycle)
+{
+    const std::uint8_t* rgb   = s.rgb[cycle];
+    const std::uint8_t* alpha = s.alpha[cycle];
+    const RasterColor*  a;
+    const RasterColor*  b;
+    const RasterColor*  d;
+    RasterColor         c;
+    RasterColor         out;
+
+    a = (rgb[0] == 6) ? &in.one : (rgb[0] == 7) ? &in.zero : &rgbInput(s, in, rgb[0]);
+    b = (rgb[1] == 6) ? &in.keyCenter : (rgb[1] == 7) ? &in.k4 : &rgbInput(s, in, rgb[1]);
+    d = (rgb[3] == 6) ? &in.one : &rgbInput(s, in, rgb[3]);
+
+    switch (rgb[2])
+    {
+    case 6:
+        c = in.keyScale;
+        break;
+    case 7:
+    case 8:
+    case 9:
+    case 10:
+    case 11:
+    case 12:
+        c.r = c.g = c.b = alphaInput(s, in, rgb[2] - 7);
+        break;
+    case 14:
+        c.r = c.g = c.b = s.primLodFrac;
+        break;
+    case 15:
+        c.r = c.g = c.b = s.convert[5];
+        break;
+    default:
+        c = (rgb[2] < 6) ? rgbInput(s, in, rgb[2]) : in.zero;
+        break;
+    }
+
+    out.r = lerp(a->r, b->r, c.r, d->r);
+    out.g = lerp(a->g, b->g, c.g, d->g);
+    out.b = lerp(a->b, b->b, c.b, d->b);
+    out.a = lerp(alphaInput(s, in, alpha[0]),
+                 alphaInput(s, in, alpha[1]),
+                 (alpha[2] == 0) ? 0 : (alpha[2] == 6) ? s.primLodFrac : alphaInput(s, in, alpha[2]),
+                 alphaInput(s, in, alpha[3]));
+    return out;
+}
+
+} // namespace
+
+Rasterizer::Rasterizer(Memory& memory)
+: _memory{memory}
+{
+}
+
+Rasterizer::~Rasterizer()
+{
+    wait();
+}
+
+void Rasterizer::setThreads(std::size_t count)
+{
+    flush();
+    wait();
+
+    _workers.clear();
+    for (std::size_t i = 0; i < count; ++i)
+        _workers.push_back(std::make_unique<Worker>());
+}
+
+void Rasterizer::draw(Primitive&& primitive)
+{
+    const RasterState& s = *primitive.state;
+    std::uint32_t      stride;
+    std::uint32_t      rows;
+
+    if (primitive.yBegin >= primitive.yEnd)
+        return;
+
+    stride = s.color.width * bytesPerPixel(s.color.size);
+    rows   = (std::uint32_t)(primitive.yEnd - primitive.yBegin);
+    _queuedRanges.push_back({s.color.addr + primitive.yBegin * stride, rows * stride});
+    if (s.zUpdate && s.cycleType != CycleType::Fill && s.cycleType != CycleType::Copy)
+        _queuedRanges.push_back({s.zAddr + primitive.yBegin * s.color.width * 2, rows * s.color.width * 2});
+
+    _queued.push_back(std::move(primitive));
+    if (_queued.size() >= BATCH_SIZE)
+        flush();
+}
+
+void Rasterizer::flush()
+{
+    if (_queued.empty())
+        return;
+
+    wait();
+    std::swap(_queued, _drawing);
+    std::swap(_queuedRanges, _drawingRanges);
+
+    if (_workers.empty())
+    {
+        drawBatch(_drawing, 0, 1);
+        return;
+    }
+
+    for (std::size_t i = 0; i < _workers.size(); ++i)
+        _workers[i]->submit([this, i] { drawBatch(_drawing, i, _workers.size()); });
+}
+
+void Rasterizer::wait()
+{
+    for (auto& worker : _workers)
+        worker->wait();
+
+    for (const Range& range : _drawingRanges)
+    {
+        if (range.addr < Memory::kRamSize)
+            _memory.markWritten(range.addr, std::min<std::uint32_t>(range.size, Memory::kRamSize - range.addr));
+    }
+    _drawingRanges.clear();
+    _drawing.clear();
+}
+
+/* Whether queued or in-flight primitives may write to this range of RDRAM */
+bool Rasterizer::pending(std::uint32_t addr, std::uint32_t size) const
+{
+    for (const auto* ranges : {&_queuedRanges, &_drawingRanges})
+    {
+        for (const Range& range : *ranges)
+        {
+            if (addr < range.addr + range.size && range.addr < addr + size)
+                return true;
+        }
+    }
+    return false;
+}
+
+void Rasterizer::drawBatch(const std::vector<Primitive>& batch, std::size_t band, std::size_t bandCount)
+{
+    for (const Primitive& p : batch)
+    {
+        for (std::int32_t y = p.yBegin; y < p.yEnd; ++y)
+        {
+            if (((std::size_t)(y >> BAND_SHIFT) % bandCount) != band)
+                continue;
+
+            if (p.kind == Primitive::Kind::Triangle)
+                drawTriangle(p, y);
+            else
+                drawRectangle(p, y);
+        }
+    }
+}
+
+/*
+ * Walks the edges down to scanline y. The major edge and the upper minor
+ * edge start at the scanline of YH, the lower minor edge at YM.
+ */
+void Rasterizer::drawTriangle(const Primitive& p, std::int32_t y)
+{
+    const RasterState& s = *p.state;
+    std::int32_t       attr[Primitive::Count];
+    std::int32_t       dy;
+    std::int64_t       major;
+    std::int64_t       minor;
+    std::int64_t       left;
+    std::int64_t       right;
+    std::int32_t       x0;
+    std::int32_t       x1;
+
+    dy    = y - (p.yh >> 2);
+    major = p.xh + (std::int64_t)p.dxhdy * dy;
+    if (y * 4 < p.ym)
+        minor = p.xm + (std::int64_t)p.dxmdy * dy;
+    else
+        minor = p.xl + (((std::int64_t)p.dxldy * (y * 4 - p.ym)) >> 2);
+
+    left  = p.left ? major : minor;
+    right = p.left ? minor : major;
+    x0    = (std::int32_t)((left + 0xffff) >> 16);
+    x1    = (std::int32_t)((right + 0xffff) >> 16);
+    x0    = std::max<std::int32_t>(x0, s.scissor[0] >> 2);
+    x1    = std::min<std::int32_t>(x1, s.scissor[2] >> 2);
+    if (x0 >= x1)
+        return;
+
+    for (int i = 0; i < Primitive::Count; ++i)
+        attr[i] = (std::int32_t)(p.attr[i] + (std::int64_t)p.dade[i] * dy + (((std::int64_t)p.dadx[i] * (((std::int64_t)x0 << 16) - major)) >> 16));
+    drawSpan(p, y, x0, x1, attr);
+}
+
+void Rasterizer::drawRectangle(const Primitive& p, std::int32_t y)
+{
+    std::int32_t attr[Primitive::Count];
+
+    for (int i = 0; i < Primitive::Count; ++i)
+        attr[i] = p.attr[i] + p.dade[i] * (y - p.yh) + p.dadx[i] * (p.x0 - p.xh);
+    drawSpan(p, y, p.x0, p.x1, attr);
+}
+
+void Rasterizer::drawSpan(const Primitive& p, std::int32_t y, std::int32_t x0, std::int32_t x1, std::int32_t* attr)
+{
+    const RasterState& s = *p.state;
+    std::uint32_t      bpp;
+    std::uint32_t      row;
+    std::uint32_t      zRow;
+    CombineInputs      in{};
+    RasterColor        pixel;
+    bool               memory;
+    int                cycles;
+
+    if (s.cycleType == CycleType::Fill)
+    {
+        fillSpan(s, y, x0, x1);
+        return;
+    }
+
+    bpp    = bytesPerPixel(s.color.size);
+    row    = s.color.addr + (std::uint32_t)y * s.color.width * bpp;
+    zRow   = s.zAddr + (std::uint32_t)y * s.color.width * 2;
+    cycles = (s.cycleType == CycleType::Two) ? 2 : 1;
+    memory = false;
+    for (int c = 0; c < cycles; ++c)
+        memory = memory || s.blender[c][0] == 1 || s.blender[c][2] == 1 || s.blender[c][3] == 1;
+
+    in.one       = {255, 255, 255, 255};
+    in.keyCenter = {s.keyCenter[0], s.keyCenter[1], s.keyCenter[2], 0};
+    in.keyScale  = {s.keyScale[0], s.keyScale[1], s.keyScale[2], 0};
+    in.k4        = {s.convert[4], s.convert[4], s.convert[4], 0};
+
+    for (std::int32_t x = x0; x < x1; ++x, std::transform(attr, attr + Primitive::Count, p.dadx, attr, [](std::int32_t a, std::int32_t d) { return a + d; }))
+    {
+        std::uint32_t depth{};
+        std::uint32_t zAddr{};
+
+        if (p.texture)
+        {
+            bool perspective = s.perspective && p.kind == Primitive::Kind::Triangle;
+
+            in.tex0 = sample(s, p.tile, attr[Primitive::S], attr[Primitive::T], attr[Primitive::W], perspective);
+            in.tex1 = (cycles == 2) ? sample(s, (p.tile + 1) & 7, attr[Primitive::S], attr[Primitive::T], attr[Primitive::W], perspective) : in.tex0;
+        }
+
+        if (s.cycleType == CycleType::Copy)
+        {
+            if (s.alphaCompare && in.tex0.a == 0)
+                continue;
+            writeColor(s, row + x * bpp, in.tex0);
+            continue;
+        }
+
+        if (p.shade)
+        {
+            in.shade.r = clamp8(attr[Primitive::R] >> 16);
+            in.shade.g = clamp8(attr[Primitive::G] >> 16);
+            in.shade.b = clamp8(attr[Primitive::B] >> 16);
+            in.shade.a = clamp8(attr[Primitive::A] >> 16);
+        }
+
+        /* One cycle mode runs the second cycle of the combiner only */
+        in.combined = in.zero;
+        for (int c = 2 - cycles; c < 2; ++c)
+            in.combined = combine(s, in, c);
+        pixel = in.combined;
+
+        if (s.alphaCompare && pixel.a < s.blend.a)
+            continue;
+
+        if (s.zCompare || s.zUpdate)
+        {
+            std::int32_t z = s.zPrim ? (s.primZ << 16) : p.depth ? attr[Primitive::Z] : 0;
+            std::uint32_t stored;
+
+            depth = (std::uint32_t)std::min(std::max(z >> 15, 0), 0xffff);
+            zAddr = (zRow + x * 2) & (Memory::kRamSize - 2);
+            if (s.zCompare)
+            {
+                stored = (_memory.ram[zAddr] << 8) | _memory.ram[zAddr + 1];
+                if (s.zDecal ? depth > stored : depth >= stored)
+                    continue;
+            }
+        }
+
+        /* Blender: (P * A + M * B) / (A + B) */
+        {
+            RasterColor mem = memory ? readColor(s, row + x * bpp) : RasterColor{};
+            std::int32_t shadeAlpha = in.shade.a;
+
+            for (int c = 0; c < cycles; ++c)
+            {
+                const std::uint8_t* mode = s.blender[c];
+                const RasterColor*  sel[4] = {&pixel, &mem, &s.blend, &s.fog};
+                const RasterColor&  pIn    = *sel[mode[0]];
+                const RasterColor&  mIn    = *sel[mode[2]];
+                std::int32_t        a;
+                std::int32_t        b;
+
+                if (c == cycles - 1 && !s.forceBlend)
+                {
+                    pixel = {pIn.r, pIn.g, pIn.b, pixel.a};
+                    break;
+                }
+
+                a = (mode[1] == 0) ? pixel.a : (mode[1] == 1) ? s.fog.a : (mode[1] == 2) ? shadeAlpha : 0;
+                b = (mode[3] == 0) ? 255 - a : (mode[3] == 1) ? mem.a : (mode[3] == 2) ? 255 : 0;
+                if (a + b == 0)
+                    pixel = {pIn.r, pIn.g, pIn.b, pixel.a};
+                else
+                    pixel = {(pIn.r * a + mIn.r * b) / (a + b), (pIn.g * a + mIn.g * b) / (a + b), (pIn.b * a + mIn.b * b) / (a + b), pixel.a};
+            }
+        }
+
+        writeColor(s, row + x * bpp, pixel);
+        if (s.zUpdate)
+        {
+            _memory.ram[zAddr + 0] = (std::uint8_t)(depth >> 8);
+            _memory.ram[zAddr + 1] = (std::uint8_t)depth;
+        }
+    }
+}
+
+void Rasterizer::fillSpan(const RasterState& s, std::int32_t y, std::int32_t x0, std::int32_t x1)
+{
+    std::uint32_t bpp = bytesPerPixel(s.color.size);
+    std::uint32_t row = s.color.addr + (std::uint32_t)y * s.color.width * bpp;
+
+    for (std::int32_t x = x0; x < x1; ++x)
+    {
+        std::uint32_t addr = (row + x * bpp) & (Memory::kRamSize - 1);
+        std::uint32_t shift;
+
+        switch (bpp)
+        {
+        case 4:
+            addr &= ~3u;
+            for (int i = 0; i < 4; ++i)
+                _memory.ram[addr + i] = (std::uint8_t)(s.fillColor >> (24 - i * 8));
+            break;
+        case 2:
+            addr &= ~1u;
+            shift                 = (x & 1) ? 0 : 16;
+            _memory.ram[addr + 0] = (std::uint8_t)(s.fillColor >> (shift + 8));
+            _memory.ram[addr + 1] = (std::uint8_t)(s.fillColor >> shift);
+            break;
+        default:
+            _memory.ram[addr] = (std::uint8_t)(s.fillColor >> (24 - (x & 3) * 8));
+            break;
+        }
+    }
+}
+
+/* Point sampling, with the tile's shift, clamp, mirror and mask */
+RasterColor Rasterizer::sample(const RasterState& s, std::uint8_t index, std::int32_t sc, std::int32_t tc, std::int32_t wc, bool perspective) const
+{
+    const RasterTile& tile = s.tiles[index];
+    std::int32_t      coord[2];
+
+    if (perspective)
+    {
+        std::int64_t w = std::max(wc, 1);
+
+        coord[0] = (std::int32_t)std::min<std::int64_t>(std::max<std::int64_t>(((std::int64_t)sc << 15) / w, -0x10000), 0xffff);
+        coord[1] = (std::int32_t)std::min<std::int64_t>(std::max<std::int64_t>(((std::int64_t)tc << 15) / w, -0x10000), 0xffff);
+    }
+    else
+    {
+        coord[0] = sc >> 16;
+        coord[1] = tc >> 16;
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        std::uint8_t  shift  = i ? tile.shiftT : tile.shiftS;
+        std::uint8_t  mask   = i ? tile.maskT : tile.maskS;
+        bool          clamp  = i ? tile.clampT : tile.clampS;
+        bool          mirror = i ? tile.mirrorT : tile.mirrorS;
+        std::int32_t  lo     = i ? tile.tl : tile.sl;
+        std::int32_t  hi     = i ? tile.th : tile.sh;
+        std::int32_t& c      = coord[i];
+
+        if (shift < 11)
+            c >>= shift;
+        else
+            c <<= (16 - shift);
+        c = (c - (lo << 3)) >> 5;
+
+        if (clamp || mask == 0)
+            c = std::min(std::max(c, 0), (hi - lo) >> 2);
+        if (mask)
+        {
+            if (mirror && (c & (1 << mask)))
+                c = ~c;
+            c &= (1 << mask) - 1;
+        }
+    }
+
+    return texel(s, tile, coord[0], coord[1]);
+}
+
+RasterColor Rasterizer::texel(const RasterState& s, const RasterTile& tile, std::int32_t si, std::int32_t ti) const
+{
+    const Tmem&   tmem = *s.tmem;
+    std::uint32_t base;
+    std::uint32_t v;
+    std::int32_t  i;
+
+    base = tile.tmem * 8 + ti * tile.line * ((tile.size == 3) ? 16 : 8);
+    switch (tile.size)
+    {
+    case 0:
+        v = tmem[(base + (si >> 1)) & 0xfff];
+        v = (si & 1) ? (v & 0xf) : (v >> 4);
+        break;
+    case 1:
+        v = tmem[(base + si) & 0xfff];
+        break;
+    case 2:
+        base = (base + si * 2) & 0xffe;
+        v    = (tmem[base] << 8) | tmem[base + 1];
+        break;
+    default:
+        base = (base + si * 4) & 0xffc;
+        v    = ((std::uint32_t)tmem[base] << 24) | (tmem[base + 1] << 16) | (tmem[base + 2] << 8) | tmem[base + 3];
+        break;
+    }
+
+    /* Color indexed, or any 4/8 bit texture when the TLUT is on */
+    if (tile.size < 2 && (s.tlut || tile.format == 2))
+    {
+        std::uint32_t index = (tile.size == 0) ? ((tile.palette << 4) | v) : v;
+        std::uint32_t entry = (0x800 + index * 8) & 0xffe;
+
+        v = (tmem[entry] << 8) | tmem[entry + 1];
+        if (s.tlutIA)
+            return {(std::int32_t)(v >> 8), (std::int32_t)(v >> 8), (std::int32_t)(v >> 8), (std::int32_t)(v & 0xff)};
+        return {expand5(v >> 11), expand5(v >> 6), expand5(v >> 1), (v & 1) ? 255 : 0};
+    }
+
+    switch (tile.format)
+    {
+    case 0: // RGBA
+        if (tile.size == 3)
+            return {(std::int32_t)(v >> 24), (std::int32_t)((v >> 16) & 0xff), (std::int32_t)((v >> 8) & 0xff), (std::int32_t)(v & 0xff)};
+        return {expand5(v >> 11), expand5(v >> 6), expand5(v >> 1), (v & 1) ? 255 : 0};
+    case 3: // IA
+        switch (tile.size)
+        {
+        case 0:
+            i = (std::int32_t)(((v >> 1) * 255) / 7);
+            return {i, i, i, (v & 1) ? 255 : 0};
+        case 1:
+            i = (std::int32_t)((v >> 4) * 17);
+            return {i, i, i, (std::int32_t)((v & 0xf) * 17)};
+        default:
+            i = (std::int32_t)((v >> 8) & 0xff);
+            return {i, i, i, (std::int32_t)(v & 0xff)};
+        }
+    case 4: // I
+        i = (tile.size == 0) ? (std::int32_t)(v * 17) : (std::int32_t)(v & 0xff);
+        return {i, i, i, i};
+    default:
+        return {0, 0, 0, 0};
+    }
+}
+
+RasterColor Rasterizer::readColor(const RasterState& s, std::uint32_t offset) const
+{
+    std::uint32_t addr = offset & (Memory::kRamSize - 1);
+    std::uint32_t v;
+
+    switch (s.color.size)
+    {
+    case 3:
+        addr &= ~3u;
+        return {_memory.ram[addr], _memory.ram[addr + 1], _memory.ram[addr + 2], _memory.ram[addr + 3]};
+    case 2:
+        addr &= ~1u;
+        v = (_memory.ram[addr] << 8) | _memory.ram[addr + 1];
+        return {expand5(v >> 11), expand5(v >> 6), expand5(v >> 1), (v & 1) ? 255 : 0};
+    default:
+        v = _memory.ram[addr];
+        return {(std::int32_t)v, (std::int32_t)v, (std::int32_t)v, 255};
+    }
+}
+
+void Rasterizer::writeColor(const RasterState& s, std::uint32_t offset, const RasterColor& color)
+{
+    std::uint32_t addr = offset & (Memory::kRamSize - 1);
+    std::uint32_t v;
+
+    switch (s.color.size)
+    {
+    case 3:
+        addr &= ~3u;
+        _memory.ram[addr + 0] = (std::uint8_t)color.r;
+        _memory.ram[addr + 1] = (std::uint8_t)color.g;
+        _memory.ram[addr + 2] = (std::uint8_t)color.b;
+        _memory.ram[addr + 3] = (std::uint8_t)color.a;
+        break;
+    case 2:
+        addr &= ~1u;
+        v                     = ((color.r >> 3) << 11) | ((color.g >> 3) << 6) | ((color.b >> 3) << 1) | 1;
+        _memory.ram[addr + 0] = (std::uint8_t)(v >> 8);
+        _memory.ram[addr + 1] = (std::uint8_t)v;
+        break;
+    default:
+        _memory.ram[addr] = (std::uint8_t)color.r;
+        break;
+    }
+}
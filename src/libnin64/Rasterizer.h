@@ -0,0 +1,212 @@
+#ifndef INCLUDED_RASTERIZER_H
+#define INCLUDED_RASTERIZER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <libnin64/NonCopyable.h>
+#include <libnin64/Worker.h>
+
+namespace libnin64
+{
+
+class Memory;
+
+using Tmem = std::array<std::uint8_t, 0x1000>;
+
+enum class CycleType : std::uint8_t
+{
+    One,
+    Two,
+    Copy,
+    Fill,
+};
+
+struct RasterColor
+{
+    std::int32_t r;
+    std::int32_t g;
+    std::int32_t b;
+    std::int32_t a;
+};
+
+struct RasterTile
+{
+    std::uint8_t  format;
+    std::uint8_t  size;
+    std::uint8_t  palette;
+    std::uint16_t line;
+    std::uint16_t tmem;
+    bool          clampS;
+    bool          mirrorS;
+    bool          clampT;
+    bool          mirrorT;
+    std::uint8_t  maskS;
+    std::uint8_t  maskT;
+    std::uint8_t  shiftS;
+    std::uint8_t  shiftT;
+    std::uint16_t sl;
+    std::uint16_t tl;
+    std::uint16_t sh;
+    std::uint16_t th;
+};
+
+struct RasterImage
+{
+    std::uint8_t  format;
+    std::uint8_t  size;
+    std::uint16_t width;
+    std::uint32_t addr;
+};
+
+/*
+ * Everything a primitive needs to be drawn. Primitives keep a reference to
+ * the state they were submitted with, so the command stream can move on
+ * while they are still being rasterized.
+ */
+struct RasterState
+{
+    void decode();
+
+    std::uint64_t otherModes;
+    std::uint64_t combine;
+    RasterImage   color;
+    std::uint32_t zAddr;
+    std::uint16_t scissor[4];
+    std::uint32_t fillColor;
+    RasterColor   fog;
+    RasterColor   blend;
+    RasterColor   prim;
+    RasterColor   env;
+    std::uint8_t  primLodFrac;
+    std::uint16_t primZ;
+    std::int32_t  convert[6];
+    std::int32_t  keyCenter[3];
+    std::int32_t  keyScale[3];
+    RasterTile    tiles[8];
+
+    std::shared_ptr<const Tmem> tmem;
+
+    /* Decoded from otherModes and combine */
+    CycleType    cycleType;
+    bool         perspective;
+    bool         tlut;
+    bool         tlutIA;
+    bool         forceBlend;
+    bool         zCompare;
+    bool         zUpdate;
+    bool         zDecal;
+    bool         zPrim;
+    bool         alphaCompare;
+    std::uint8_t blender[2][4];
+    std::uint8_t rgb[2][4];
+    std::uint8_t alpha[2][4];
+};
+
+struct Primitive
+{
+    enum class Kind : std::uint8_t
+    {
+        Triangle,
+        Rectangle,
+    };
+
+    enum Attr
+    {
+        R,
+        G,
+        B,
+        A,
+        S,
+        T,
+        W,
+        Z,
+        Count,
+    };
+
+    Kind         kind;
+    bool         shade;
+    bool         texture;
+    bool         depth;
+    bool         flip;
+    bool         left;
+    std::uint8_t tile;
+
+    /* Scanlines covered, after scissoring */
+    std::int32_t yBegin;
+    std::int32_t yEnd;
+
+    /* Triangle edges, in s15.16 x and s11.2 y */
+    std::int32_t yh;
+    std::int32_t ym;
+    std::int32_t xh;
+    std::int32_t xm;
+    std::int32_t xl;
+    std::int32_t dxhdy;
+    std::int32_t dxmdy;
+    std::int32_t dxldy;
+
+    /* Rectangle bounds, in pixels, end exclusive */
+    std::int32_t x0;
+    std::int32_t x1;
+
+    /* Attributes at the start, and their derivatives */
+    std::int32_t attr[Count];
+    std::int32_t dadx[Count];
+    std::int32_t dade[Count];
+
+    std::shared_ptr<const RasterState> state;
+};
+
+/*
+ * Software rasterizer for the RDP.
+ *
+ * Primitives are queued in batches. A batch is drawn by a set of worker
+ * threads, each owning an interleaved set of horizontal bands of the screen,
+ * so that every pixel still sees the primitives in submission order. The
+ * next batch is queued while the previous one is being drawn.
+ */
+class Rasterizer : private NonCopyable
+{
+public:
+    Rasterizer(Memory& memory);
+    ~Rasterizer();
+
+    void setThreads(std::size_t count);
+    void draw(Primitive&& primitive);
+    void flush();
+    void wait();
+    bool pending(std::uint32_t addr, std::uint32_t size) const;
+
+private:
+    struct Range
+    {
+        std::uint32_t addr;
+        std::uint32_t size;
+    };
+
+    void drawBatch(const std::vector<Primitive>& batch, std::size_t band, std::size_t bandCount);
+    void drawTriangle(const Primitive& p, std::int32_t y);
+    void drawRectangle(const Primitive& p, std::int32_t y);
+    void drawSpan(const Primitive& p, std::int32_t y, std::int32_t x0, std::int32_t x1, std::int32_t* attr);
+    void fillSpan(const RasterState& s, std::int32_t y, std::int32_t x0, std::int32_t x1);
+
+    RasterColor sample(const RasterState& s, std::uint8_t tile, std::int32_t sc, std::int32_t tc, std::int32_t wc, bool perspective) const;
+    RasterColor texel(const RasterState& s, const RasterTile& tile, std::int32_t si, std::int32_t ti) const;
+    RasterColor readColor(const RasterState& s, std::uint32_t offset) const;
+    void        writeColor(const RasterState& s, std::uint32_t offset, const RasterColor& color);
+
+    Memory& _memory;
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<Primitive>               _queued;
+    std::vector<Primitive>               _drawing;
+    std::vector<Range>                   _queuedRanges;
+    std::vector<Range>                   _drawingRanges;
+};
+
+} // namespace libnin64
+
+#endif
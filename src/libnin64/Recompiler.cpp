@@ -0,0 +1,1250 @@
+#include <atomic>
+#include <cstring>
+#include <libnin64/CPU.h>
+#include <libnin64/Memory.h>
+#include <libnin64/Recompiler.h>
+#include <libnin64/Scheduler.h>
+#include <libnin64/Timing.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <csignal>
+#include <sys/mman.h>
+#include <ucontext.h>
+#endif
+
+#define CODE_BUFFER_SIZE (32 * 1024 * 1024)
+#define MAX_BLOCK_CODE   (32 * 1024)
+#define MAX_RECOMPILERS  1024
+
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RSP 4
+#define RBP 5
+#define RSI 6
+#define RDI 7
+#define R12 12
+#define R13 13
+#define R14 14
+
+#define REX_W 0x08
+
+#define CC_AE 0x3
+#define CC_E  0x4
+#define CC_NE 0x5
+#define CC_L  0xc
+#define CC_GE 0xd
+#define CC_LE 0xe
+#define CC_G  0xf
+
+#if defined(_WIN32)
+#define ARG0 RCX
+#define ARG1 RDX
+#else
+#define ARG0 RDI
+#define ARG1 RSI
+#endif
+
+#define RS   (instr.rs)
+#define RT   (instr.rt)
+#define RD   (instr.rd)
+#define SA   (instr.sa)
+#define IMM  (instr.imm)
+#define SIMM ((std::int16_t)instr.imm)
+
+using namespace libnin64;
+
+/*
+ * Recompilers with fastmem code, looked up by the fault handler, and their
+ * code buffers. A recompiler is only touched once the fault is known to be
+ * in its buffer: it is then running on the faulting thread, so it cannot be
+ * going away. The buffer is published last and withdrawn first.
+ */
+static std::atomic<Recompiler*>          gFaultTargets[MAX_RECOMPILERS];
+static std::atomic<const std::uint8_t*> gFaultBuffers[MAX_RECOMPILERS];
+
+#if defined(_WIN32)
+static LONG CALLBACK faultHandler(PEXCEPTION_POINTERS info)
+{
+    std::uint64_t rip;
+
+    if (info->ExceptionRecord->ExceptionCode != EXCEPTION_ACCESS_VIOLATION)
+        return EXCEPTION_CONTINUE_SEARCH;
+    rip = info->ContextRecord->Rip;
+    if (!Recompiler::handleFault(rip))
+        return EXCEPTION_CONTINUE_SEARCH;
+    info->ContextRecord->Rip = rip;
+    return EXCEPTION_CONTINUE_EXECUTION;
+}
+
+static void installFaultHandler()
+{
+    AddVectoredExceptionHandler(1, &faultHandler);
+}
+#else
+static struct sigaction gOldSegv;
+static struct sigaction gOldBus;
+
+static void faultHandler(int sig, siginfo_t* info, void* ctx)
+{
+    ucontext_t*       uc;
+    struct sigaction* old;
+    std::uint64_t     rip;
+
+    uc = (ucontext_t*)ctx;
+#if defined(__APPLE__)
+    rip = uc->uc_mcontext->__ss.__rip;
+#else
+    rip = (std::uint64_t)uc->uc_mcontext.gregs[REG_RIP];
+#endif
+    if (Recompiler::handleFault(rip))
+    {
+#if defined(__APPLE__)
+        uc->uc_mcontext->__ss.__rip = rip;
+#else
+        uc->uc_mcontext.gregs[REG_RIP] = (greg_t)rip;
+#endif
+        return;
+    }
+
+    /* Not ours, hand it to whoever was there before */
+    old = (sig == SIGSEGV) ? &gOldSegv : &gOldBus;
+    if (old->sa_flags & SA_SIGINFO)
+        old->sa_sigaction(sig, info, ctx);
+    else if (old->sa_handler == SIG_DFL || old->sa_handler == SIG_IGN)
+        sigaction(sig, old, nullptr);
+    else
+        old->sa_handler(sig);
+}
+
+static void installFaultHandler()
+{
+    struct sigaction action{};
+
+    action.sa_sigaction = &faultHandler;
+    action.sa_flags     = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, &gOldSegv);
+    sigaction(SIGBUS, &action, &gOldBus);
+}
+#endif
+
+static bool registerFaultTarget(Recompiler* recompiler, const std::uint8_t* buffer)
+{
+    static bool installed = (installFaultHandler(), true);
+
+    (void)installed;
+    for (std::size_t i = 0; i < MAX_RECOMPILERS; ++i)
+    {
+        Recompiler* expected = nullptr;
+        if (gFaultTargets[i].compare_exchange_strong(expected, recompiler))
+        {
+            gFaultBuffers[i].store(buffer);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void unregisterFaultTarget(Recompiler* recompiler)
+{
+    for (std::size_t i = 0; i < MAX_RECOMPILERS; ++i)
+    {
+        if (gFaultTargets[i].load() != recompiler)
+            continue;
+        gFaultBuffers[i].store(nullptr);
+        gFaultTargets[i].store(nullptr);
+    }
+}
+
+static bool fitsInt32(std::uint64_t value)
+{
+    return (std::uint64_t)(std::int64_t)(std::int32_t)value == value;
+}
+
+/* Loads and stores, whose handlers may raise a TLB exception, and COP1 arithmetic and CTC1, which may trap */
+static bool canFault(std::uint32_t op)
+{
+    if ((op >> 26) == 021)
+        return (op & (1 << 25)) || ((op >> 21) & 0x1f) == 006;
+    return (op >> 26) >= 040 || (op >> 26) == 032 || (op >> 26) == 033;
+}
+
+/* Static destination of a branch or jump, if it has one */
+static bool branchTarget(std::uint32_t op, std::uint64_t addr, std::uint64_t& target)
+{
+    switch (op >> 26)
+    {
+    case 000: // SPECIAL (JR, JALR)
+        return false;
+    case 002: // J
+    case 003: // JAL
+        target = ((std::uint64_t)(op & 0x3ffffff) << 2) | ((addr + 4) & 0xfffffffff0000000ull);
+        return true;
+    default:
+        target = addr + 4 + ((std::int64_t)(std::int16_t)op << 2);
+        return true;
+    }
+}
+
+Recompiler::Recompiler(CPU& cpu, Scheduler& scheduler, Memory& memory)
+: _cpu{cpu}
+, _scheduler{scheduler}
+, _memory{memory}
+, _fastmem{}
+, _buffer{}
+, _code{}
+, _ptr{}
+, _exit{}
+, _enter{}
+, _epoch{}
+{
+    _pcDisp           = disp(&_cpu._pc);
+    _pcNextDisp       = disp(&_cpu._pcNext);
+    _instrPcDisp      = disp(&_cpu._instrPc);
+    _instrDelayDisp   = disp(&_cpu._instrDelay);
+    _branchDelayDisp  = disp(&_cpu._branchDelay);
+    _instructionsDisp = disp(&_cpu._instructions);
+    _loDisp           = disp(&_cpu._lo);
+    _hiDisp           = disp(&_cpu._hi);
+    _limitDisp        = (std::int32_t)((const std::uint8_t*)_scheduler.limitAddr() - (const std::uint8_t*)_scheduler.nowAddr());
+
+    if (!supported())
+        return;
+
+#if defined(_WIN32)
+    _buffer = (std::uint8_t*)VirtualAlloc(nullptr, CODE_BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+    _buffer = (std::uint8_t*)mmap(nullptr, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (_buffer == MAP_FAILED)
+        _buffer = nullptr;
+#endif
+    if (!_buffer)
+        return;
+    _ptr = _buffer;
+
+    if (_memory.fastmem.valid() && registerFaultTarget(this, _buffer))
+        _fastmem = _memory.fastmem.base();
+
+    /*
+     * Entry trampoline: save the callee-saved registers, keep the CPU in rbx,
+     * the scheduler clock in r12 and the memory generations in r13, then
+     * jump to the block. Generated code leaves through _exit with the link
+     * site to patch (or null) in rax.
+     */
+    _enter = (Entry)_ptr;
+    emit8(0x53);       // push rbx
+    emit8(0x55);       // push rbp
+    emit8(0x41);       // push r12
+    emit8(0x54);
+    emit8(0x41);       // push r13
+    emit8(0x55);
+    emit8(0x41);       // push r14
+    emit8(0x56);
+    emit8(0x41);       // push r15
+    emit8(0x57);
+#if defined(_WIN32)
+    emit8(0x57);       // push rdi
+    emit8(0x56);       // push rsi
+    emit8(0x48);       // sub rsp, 40 (alignment + shadow space)
+    emit8(0x83);
+    emit8(0xec);
+    emit8(40);
+    emit8(0x48);       // mov rbx, rcx
+    emit8(0x89);
+    emit8(0xcb);
+    emit8(0x4d);       // mov r12, r8
+    emit8(0x89);
+    emit8(0xc4);
+    emit8(0x4d);       // mov r13, r9
+    emit8(0x89);
+    emit8(0xcd);
+    emit8(0x49);       // mov r14, imm64
+    emit8(0xbe);
+    emit64((std::uint64_t)_fastmem);
+    emit8(0xff);       // jmp rdx
+    emit8(0xe2);
+#else
+    emit8(0x48);       // sub rsp, 8 (alignment)
+    emit8(0x83);
+    emit8(0xec);
+    emit8(8);
+    emit8(0x48);       // mov rbx, rdi
+    emit8(0x89);
+    emit8(0xfb);
+    emit8(0x49);       // mov r12, rdx
+    emit8(0x89);
+    emit8(0xd4);
+    emit8(0x49);       // mov r13, rcx
+    emit8(0x89);
+    emit8(0xcd);
+    emit8(0x49);       // mov r14, imm64
+    emit8(0xbe);
+    emit64((std::uint64_t)_fastmem);
+    emit8(0xff);       // jmp rsi
+    emit8(0xe6);
+#endif
+
+    _exit = _ptr;
+#if defined(_WIN32)
+    emit8(0x48);       // add rsp, 40
+    emit8(0x83);
+    emit8(0xc4);
+    emit8(40);
+    emit8(0x5e);       // pop rsi
+    emit8(0x5f);       // pop rdi
+#else
+    emit8(0x48);       // add rsp, 8
+    emit8(0x83);
+    emit8(0xc4);
+    emit8(8);
+#endif
+    emit8(0x41);       // pop r15
+    emit8(0x5f);
+    emit8(0x41);       // pop r14
+    emit8(0x5e);
+    emit8(0x41);       // pop r13
+    emit8(0x5d);
+    emit8(0x41);       // pop r12
+    emit8(0x5c);
+    emit8(0x5d);       // pop rbp
+    emit8(0x5b);       // pop rbx
+    emit8(0xc3);       // ret
+
+    _code = _ptr;
+}
+
+Recompiler::~Recompiler()
+{
+    if (_fastmem)
+        unregisterFaultTarget(this);
+    if (!_buffer)
+        return;
+#if defined(_WIN32)
+    VirtualFree(_buffer, 0, MEM_RELEASE);
+#else
+    munmap(_buffer, CODE_BUFFER_SIZE);
+#endif
+}
+
+bool Recompiler::supported()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    return true;
+#else
+    return false;
+#endif
+}
+
+/* Called from the fault handler, moves faulting fastmem loads to their slow path */
+bool Recompiler::handleFault(std::uint64_t& rip)
+{
+    const std::uint8_t* buffer;
+
+    for (std::size_t i = 0; i < MAX_RECOMPILERS; ++i)
+    {
+        buffer = gFaultBuffers[i].load();
+        if (buffer && rip >= (std::uint64_t)buffer && rip < (std::uint64_t)buffer + CODE_BUFFER_SIZE)
+            return gFaultTargets[i].load()->redirect(rip);
+    }
+    return false;
+}
+
+void Recompiler::run(Block* block, std::uint64_t until)
+{
+    const std::uint8_t* target;
+    std::uint8_t*       site;
+    std::uint32_t       addr;
+    std::uint32_t       epoch;
+
+    if (!enterable(_cpu._pc) || _cpu._pcNext != _cpu._pc + 4 || _cpu._branchDelay)
+    {
+        _cpu.execute(*block);
+        return;
+    }
+
+    _scheduler.setLimit(until);
+    target = code(*block);
+    for (;;)
+    {
+        site = _enter(&_cpu, target, _scheduler.nowAddr(), (const std::uint32_t*)_memory.generation);
+        if (!site)
+            return;
+
+        /* The block wants to chain to its successor, which is now in _pc */
+        if (!enterable(_cpu._pc))
+            return;
+        addr  = (std::uint32_t)_cpu._pc & 0x1fffffff;
+        block = _cpu._blocks.find(addr);
+        if (!block)
+        {
+            if (!BlockCache::cacheable(addr))
+                return;
+            block = _cpu.compile(addr);
+        }
+
+        epoch  = _epoch;
+        target = code(*block);
+        if (epoch == _epoch)
+            link(site, target, _cpu._pc);
+    }
+}
+
+/* Only the unmapped segments, where the virtual to physical mapping is fixed */
+bool Recompiler::enterable(std::uint64_t pc) const
+{
+    return (pc & 0xffffffffc0000000ull) == 0xffffffff80000000ull;
+}
+
+const std::uint8_t* Recompiler::code(Block& block)
+{
+    const std::uint8_t* code;
+
+    if (block.code && block.codeEpoch == _epoch && block.codePc == _cpu._pc)
+        return (const std::uint8_t*)block.code;
+
+    code            = compile(block, _cpu._pc);
+    block.code      = code;
+    block.codeEpoch = _epoch;
+    block.codePc    = _cpu._pc;
+
+    /* Blocks already chained to this address now go to the new code */
+    auto it = _links.find(_cpu._pc);
+    if (it != _links.end())
+    {
+        for (std::uint8_t* site : it->second)
+            patch(site, code);
+    }
+    return code;
+}
+
+void Recompiler::link(std::uint8_t* site, const std::uint8_t* target, std::uint64_t pc)
+{
+    patch(site, target);
+    _links[pc].push_back(site);
+}
+
+void Recompiler::patch(std::uint8_t* rel, const std::uint8_t* target)
+{
+    std::int32_t value;
+
+    value = (std::int32_t)(target - (rel + 4));
+    std::memcpy(rel, &value, 4);
+}
+
+void Recompiler::flush()
+{
+    _ptr = _code;
+    _epoch++;
+    _links.clear();
+    _faults.clear();
+}
+
+bool Recompiler::redirect(std::uint64_t& rip)
+{
+    std::uint8_t* site;
+
+    site = (std::uint8_t*)rip;
+    if (site < _buffer || site >= _buffer + CODE_BUFFER_SIZE)
+        return false;
+    auto it = _faults.find(site);
+    if (it == _faults.end())
+        return false;
+
+    /* Only MMIO faults, so the site goes straight to the slow path from now on */
+    site[0] = 0xe9;
+    patch(site + 1, it->second);
+    rip = (std::uint64_t)it->second;
+    _faults.erase(it);
+    return true;
+}
+
+const std::uint8_t* Recompiler::compile(const Block& block, std::uint64_t pc)
+{
+    const std::uint8_t* start;
+    std::uint64_t       addr;
+    std::uint64_t       target;
+    Pending             pending;
+    std::uint32_t       last;
+    bool                delaySlot;
+
+    if (_ptr + MAX_BLOCK_CODE > _buffer + CODE_BUFFER_SIZE)
+        flush();
+    start = _ptr;
+    _plains.clear();
+    _slows.clear();
+
+    /* Bail out if the code was overwritten since the block was decoded */
+    emitMem(0, 0x81, 7, R13, (std::int32_t)(block.lines[0] * 4));
+    emit32(block.generation[0]);
+    _plains.push_back(emitJumpIf(CC_NE));
+    if (block.lines[1] != block.lines[0])
+    {
+        emitMem(0, 0x81, 7, R13, (std::int32_t)(block.lines[1] * 4));
+        emit32(block.generation[1]);
+        _plains.push_back(emitJumpIf(CC_NE));
+    }
+
+    pending   = {};
+    delaySlot = false;
+    last      = block.size - 1;
+    for (std::uint32_t i = 0; i < block.size; ++i)
+    {
+        const Instr& instr = block.instrs[i];
+
+        addr = pc + i * 4;
+        if (delaySlot)
+        {
+            /* Delay slot: _pcNext holds wherever the branch decided to go */
+            emitLoad(RAX, _pcNextDisp);
+            emitStore(_pcDisp, RAX);
+            emit8(0x48); // add rax, 4
+            emit8(0x83);
+            emit8(0xc0);
+            emit8(0x04);
+            emitStore(_pcNextDisp, RAX);
+            if (canFault(instr.op))
+            {
+                emitMem(0, 0x8a, RAX, RBX, _branchDelayDisp); // mov al, [branchDelay]
+                emitMem(0, 0x88, RAX, RBX, _instrDelayDisp);  // mov [instrDelay], al
+            }
+            emitMem(0, 0xc6, 0, RBX, _branchDelayDisp);
+            emit8(0);
+        }
+
+        if (emitInline(instr) || emitAccess(instr, addr, delaySlot, pending))
+        {
+            pending.add(instr);
+        }
+        else if (!delaySlot && emitBranch(instr, addr, pending))
+        {
+        }
+        else
+        {
+            emitCycles(pending);
+            pending = {};
+            pending.add(instr);
+            if (!delaySlot)
+            {
+                emitStoreImm(_pcDisp, addr + 4);
+                emitStoreImm(_pcNextDisp, addr + 8);
+            }
+            if (canFault(instr.op))
+                emitFaultPc(addr, delaySlot);
+            emitCall(instr);
+
+            /* Leave if the access raised an exception, the delay slot ends the block anyway */
+            if (!delaySlot && canFault(instr.op))
+            {
+                emitCycles(pending);
+                pending = {};
+                emitComparePc(addr + 4);
+                _plains.push_back(emitJumpIf(CC_NE));
+            }
+
+            /* Branch likely handlers skip the delay slot when not taken */
+            if (!delaySlot && CPU::blockEnd(instr.op) == 1)
+            {
+                std::uint8_t* cont;
+
+                emitCycles(pending);
+                pending = {};
+                emitComparePc(addr + 4);
+                cont = emitJumpIf(CC_E);
+                emitComparePc(addr + 8);
+                _plains.push_back(emitJumpIf(CC_NE));
+                emitLink(addr + 8, false);
+                bind(cont);
+            }
+        }
+
+        if (delaySlot)
+            break;
+        delaySlot = (CPU::blockEnd(instr.op) == 1);
+    }
+    emitCycles(pending);
+
+    addr = pc + last * 4;
+    if (last > 0 && CPU::blockEnd(block.instrs[last - 1].op) == 1)
+    {
+        /* Ended with a delay slot */
+        if (branchTarget(block.instrs[last - 1].op, addr - 4, target))
+        {
+            /* Idle loops go back to the CPU loop, which skips them ahead */
+            if (!block.idle)
+                emitLink(target, true);
+            emitLink(addr + 4, true);
+        }
+    }
+    else if (!CPU::blockEnd(block.instrs[last].op))
+    {
+        /* Ran into the size or page limit */
+        emitStoreImm(_pcDisp, addr + 4);
+        emitStoreImm(_pcNextDisp, addr + 8);
+        emitLink(addr + 4, false);
+    }
+    emitPlainExit();
+
+    for (const SlowPath& slow : _slows)
+        emitSlowPath(slow);
+
+    return start;
+}
+
+bool Recompiler::emitInline(const Instr& instr)
+{
+    std::uint8_t  op;
+    std::uint8_t  dst;
+    std::uint32_t imm;
+
+    switch (instr.op >> 26)
+    {
+    case 000: // SPECIAL
+        switch (instr.op & 0x3f)
+        {
+        case 000: // SLL
+        case 002: // SRL
+        case 003: // SRA
+            if (!RD) return true;
+            emitMem(0, 0x8b, RAX, RBX, reg(RT)); // mov eax, [rt]
+            emit8(0xc1);
+            emit8((instr.op & 0x3f) == 000 ? 0xe0 : ((instr.op & 0x3f) == 002 ? 0xe8 : 0xf8));
+            emit8(SA);
+            break;
+        case 004: // SLLV
+        case 006: // SRLV
+        case 007: // SRAV
+            if (!RD) return true;
+            emitMem(0, 0x8b, RCX, RBX, reg(RS)); // mov ecx, [rs]
+            emitMem(0, 0x8b, RAX, RBX, reg(RT)); // mov eax, [rt]
+            emit8(0xd3);
+            emit8((instr.op & 0x3f) == 004 ? 0xe0 : ((instr.op & 0x3f) == 006 ? 0xe8 : 0xf8));
+            break;
+        case 020: // MFHI
+        case 022: // MFLO
+            if (!RD) return true;
+            emitLoad(RAX, (instr.op & 0x3f) == 020 ? _hiDisp : _loDisp);
+            emitStore(reg(RD), RAX);
+            return true;
+        case 021: // MTHI
+        case 023: // MTLO
+            emitLoad(RAX, reg(RS));
+            emitStore((instr.op & 0x3f) == 021 ? _hiDisp : _loDisp, RAX);
+            return true;
+        case 040: // ADD
+        case 041: // ADDU
+        case 042: // SUB
+        case 043: // SUBU
+            if (!RD) return true;
+            emitLoad(RAX, reg(RS));
+            emitMem(REX_W, (instr.op & 2) ? 0x2b : 0x03, RAX, RBX, reg(RT));
+            break;
+        case 044: // AND
+        case 045: // OR
+        case 046: // XOR
+        case 047: // NOR
+            if (!RD) return true;
+            op = (instr.op & 0x3f) == 044 ? 0x23 : ((instr.op & 0x3f) == 046 ? 0x33 : 0x0b);
+            emitLoad(RAX, reg(RS));
+            emitMem(REX_W, op, RAX, RBX, reg(RT));
+            if ((instr.op & 0x3f) == 047)
+            {
+                emit8(0x48); // not rax
+                emit8(0xf7);
+                emit8(0xd0);
+            }
+            emitStore(reg(RD), RAX);
+            return true;
+        case 052: // SLT
+        case 053: // SLTU
+            if (!RD) return true;
+            emitLoad(RAX, reg(RS));
+            emitMem(REX_W, 0x3b, RAX, RBX, reg(RT)); // cmp rax, [rt]
+            emit8(0x0f);
+            emit8((instr.op & 0x3f) == 052 ? 0x9c : 0x92); // setl / setb al
+            emit8(0xc0);
+            emit8(0x0f); // movzx eax, al
+            emit8(0xb6);
+            emit8(0xc0);
+            emitStore(reg(RD), RAX);
+            return true;
+        case 054: // DADD
+        case 055: // DADDU
+        case 056: // DSUB
+        case 057: // DSUBU
+            if (!RD) return true;
+            emitLoad(RAX, reg(RS));
+            emitMem(REX_W, (instr.op & 2) ? 0x2b : 0x03, RAX, RBX, reg(RT));
+            emitStore(reg(RD), RAX);
+            return true;
+        case 070: // DSLL
+        case 072: // DSRL
+        case 073: // DSRA
+        case 074: // DSLL32
+        case 076: // DSRL32
+        case 077: // DSRA32
+            if (!RD) return true;
+            emitLoad(RAX, reg(RT));
+            emit8(0x48);
+            emit8(0xc1);
+            emit8(((instr.op & 3) == 0) ? 0xe0 : (((instr.op & 3) == 2) ? 0xe8 : 0xf8));
+            emit8(SA + ((instr.op & 4) ? 32 : 0));
+            emitStore(reg(RD), RAX);
+            return true;
+        default:
+            return false;
+        }
+        /* 32-bit result, sign extended */
+        emit8(0x48); // movsxd rax, eax
+        emit8(0x63);
+        emit8(0xc0);
+        emitStore(reg(RD), RAX);
+        return true;
+    case 010: // ADDI
+    case 011: // ADDIU
+        if (!RT) return true;
+        emitMem(0, 0x8b, RAX, RBX, reg(RS)); // mov eax, [rs]
+        emit8(0x05);                         // add eax, imm32
+        emit32((std::uint32_t)(std::int32_t)SIMM);
+        emit8(0x48); // movsxd rax, eax
+        emit8(0x63);
+        emit8(0xc0);
+        emitStore(reg(RT), RAX);
+        return true;
+    case 012: // SLTI
+    case 013: // SLTIU
+        if (!RT) return true;
+        emitMem(REX_W, 0x81, 7, RBX, reg(RS)); // cmp qword [rs], simm32
+        emit32((std::uint32_t)(std::int32_t)SIMM);
+        emit8(0x0f);
+        emit8((instr.op >> 26) == 012 ? 0x9c : 0x92); // setl / setb al
+        emit8(0xc0);
+        emit8(0x0f); // movzx eax, al
+        emit8(0xb6);
+        emit8(0xc0);
+        emitStore(reg(RT), RAX);
+        return true;
+    case 014: // ANDI
+    case 015: // ORI
+    case 016: // XORI
+        if (!RT) return true;
+        dst = (instr.op >> 26) == 014 ? 0x25 : ((instr.op >> 26) == 015 ? 0x0d : 0x35);
+        imm = IMM;
+        emitLoad(RAX, reg(RS));
+        emit8(0x48); // and/or/xor rax, imm32
+        emit8(dst);
+        emit32(imm);
+        emitStore(reg(RT), RAX);
+        return true;
+    case 017: // LUI
+        if (!RT) return true;
+        emitStoreImm(reg(RT), (std::uint64_t)(std::int64_t)(std::int32_t)((std::uint32_t)IMM << 16));
+        return true;
+    case 030: // DADDI
+    case 031: // DADDIU
+        if (!RT) return true;
+        emitLoad(RAX, reg(RS));
+        emit8(0x48); // add rax, simm32
+        emit8(0x05);
+        emit32((std::uint32_t)(std::int32_t)SIMM);
+        emitStore(reg(RT), RAX);
+        return true;
+    }
+
+    return false;
+}
+
+bool Recompiler::emitBranch(const Instr& instr, std::uint64_t addr, Pending& pending)
+{
+    std::uint64_t target{};
+    std::uint8_t* rel;
+    bool          likely;
+    int           cc;
+
+    switch (instr.op >> 26)
+    {
+    case 001: // REGIMM
+        switch (RT)
+        {
+        case 000: // BLTZ
+        case 002: // BLTZL
+            cc = CC_L;
+            break;
+        case 001: // BGEZ
+        case 003: // BGEZL
+            cc = CC_GE;
+            break;
+        default:
+            return false;
+        }
+        likely = !!(RT & 2);
+        emitMem(REX_W, 0x83, 7, RBX, reg(RS)); // cmp qword [rs], 0
+        emit8(0);
+        break;
+    case 002: // J
+    case 003: // JAL
+        branchTarget(instr.op, addr, target);
+        emitStoreImm(_pcDisp, addr + 4);
+        emitStoreImm(_pcNextDisp, target);
+        emitMem(0, 0xc6, 0, RBX, _branchDelayDisp);
+        emit8(1);
+        if ((instr.op >> 26) == 003)
+            emitStoreImm(reg(31), addr + 8);
+        pending.add(instr);
+        return true;
+    case 004: // BEQ
+    case 005: // BNE
+    case 024: // BEQL
+    case 025: // BNEL
+        cc     = (instr.op & (1 << 26)) ? CC_NE : CC_E;
+        likely = !!(instr.op & (020 << 26));
+        emitLoad(RAX, reg(RS));
+        emitMem(REX_W, 0x3b, RAX, RBX, reg(RT)); // cmp rax, [rt]
+        break;
+    case 006: // BLEZ
+    case 007: // BGTZ
+    case 026: // BLEZL
+    case 027: // BGTZL
+        cc     = (instr.op & (1 << 26)) ? CC_G : CC_LE;
+        likely = !!(instr.op & (020 << 26));
+        emitMem(REX_W, 0x83, 7, RBX, reg(RS)); // cmp qword [rs], 0
+        emit8(0);
+        break;
+    default:
+        return false;
+    }
+
+    branchTarget(instr.op, addr, target);
+    pending.add(instr);
+    if (!likely)
+    {
+        emitStoreImm(_pcDisp, addr + 4);
+        emitStoreImm(_pcNextDisp, addr + 8);
+        rel = emitJumpIf(cc ^ 1);
+        emitStoreImm(_pcNextDisp, target);
+        emitMem(0, 0xc6, 0, RBX, _branchDelayDisp);
+        emit8(1);
+        bind(rel);
+    }
+    else
+    {
+        emitStoreImm(_pcDisp, addr + 4);
+        rel = emitJumpIf(cc);
+
+        /* Not taken: the delay slot is skipped */
+        emitStoreImm(_pcDisp, addr + 8);
+        emitStoreImm(_pcNextDisp, addr + 12);
+        emitCycles(pending);
+        emitLink(addr + 8, false);
+
+        bind(rel);
+        emitStoreImm(_pcNextDisp, target);
+        emitMem(0, 0xc6, 0, RBX, _branchDelayDisp);
+        emit8(1);
+    }
+    return true;
+}
+
+/*
+ * Loads and stores through the fastmem mirror. The address is computed the
+ * way the interpreter does. Only KSEG0 and KSEG1 map straight onto the
+ * mirror, KSEG0 alone when uncached accesses stall. The TLB mapped segments
+ * take the slow path, as do stores outside RDRAM so that SP memory and MMIO
+ * writes keep their side effects.
+ */
+bool Recompiler::emitAccess(const Instr& instr, std::uint64_t addr, bool delaySlot, const Pending& pending)
+{
+    SlowPath     slow;
+    std::uint8_t op;
+    bool         store;
+
+    if (!_fastmem)
+        return false;
+
+    op = (std::uint8_t)(instr.op >> 26);
+    switch (op)
+    {
+    case 040: // LB
+    case 041: // LH
+    case 043: // LW
+    case 044: // LBU
+    case 045: // LHU
+    case 047: // LWU
+    case 067: // LD
+        if (!RT) return false;
+        store = false;
+        break;
+    case 050: // SB
+    case 051: // SH
+    case 053: // SW
+    case 077: // SD
+        store = true;
+        break;
+    default:
+        return false;
+    }
+
+    slow.instr     = &instr;
+    slow.addr      = addr;
+    slow.pending   = pending;
+    slow.delaySlot = delaySlot;
+    slow.fault     = nullptr;
+
+    emitMem(0, 0x8b, RAX, RBX, reg(RS)); // mov eax, [rs]
+    if (SIMM)
+    {
+        emit8(0x05); // add eax, imm32
+        emit32((std::uint32_t)(std::int32_t)SIMM);
+    }
+    emit8(0x8d); // lea ecx, [rax + 0x80000000]
+    emit8(0x88);
+    emit32(0x80000000);
+    emit8(0x81); // cmp ecx, 0x40000000, or 0x20000000 to leave out KSEG1
+    emit8(0xf9);
+    emit32((Timing::kUncachedLoad || Timing::kUncachedStore) ? 0x20000000 : 0x40000000);
+    slow.jumps.push_back(emitJumpIf(CC_AE));
+    emit8(0x25); // and eax, 0x1fffffff
+    emit32(0x1fffffff);
+
+    if (store)
+    {
+        emit8(0x3d); // cmp eax, imm32
+        emit32((std::uint32_t)Memory::kRamSize);
+        slow.jumps.push_back(emitJumpIf(CC_AE));
+
+        emitLoad(RDX, reg(RT));
+        switch (op)
+        {
+        case 050: // mov [r14 + rax], dl
+            emit8(0x41);
+            emit8(0x88);
+            break;
+        case 051: // rol dx, 8; mov [r14 + rax], dx
+            emit8(0x66);
+            emit8(0xc1);
+            emit8(0xc2);
+            emit8(0x08);
+            emit8(0x66);
+            emit8(0x41);
+            emit8(0x89);
+            break;
+        case 053: // bswap edx; mov [r14 + rax], edx
+            emit8(0x0f);
+            emit8(0xca);
+            emit8(0x41);
+            emit8(0x89);
+            break;
+        case 077: // bswap rdx; mov [r14 + rax], rdx
+            emit8(0x48);
+            emit8(0x0f);
+            emit8(0xca);
+            emit8(0x49);
+            emit8(0x89);
+            break;
+        }
+        emit8(0x54);
+        emit8(0x06);
+        emit8(0x00);
+
+        /* Bump the write generation of the line */
+        emit8(0x89); // mov ecx, eax
+        emit8(0xc1);
+        emit8(0xc1); // shr ecx, kLineShift
+        emit8(0xe9);
+        emit8(Memory::kLineShift);
+        emit8(0xf0); // lock inc dword [r13 + rcx * 4]
+        emit8(0x41);
+        emit8(0xff);
+        emit8(0x44);
+        emit8(0x8d);
+        emit8(0x00);
+    }
+    else
+    {
+        /* The faulting instruction is at least 5 bytes, enough for a jump */
+        slow.fault = _ptr;
+        switch (op)
+        {
+        case 040: // movsx rcx, byte [r14 + rax]
+            emit8(0x49);
+            emit8(0x0f);
+            emit8(0xbe);
+            break;
+        case 044: // movzx ecx, byte [r14 + rax]
+            emit8(0x41);
+            emit8(0x0f);
+            emit8(0xb6);
+            break;
+        case 041: // movzx ecx, word [r14 + rax]
+        case 045:
+            emit8(0x41);
+            emit8(0x0f);
+            emit8(0xb7);
+            break;
+        case 043: // mov ecx, [r14 + rax]
+        case 047:
+            emit8(0x41);
+            emit8(0x8b);
+            break;
+        case 067: // mov rcx, [r14 + rax]
+            emit8(0x49);
+            emit8(0x8b);
+            break;
+        }
+        emit8(0x4c);
+        emit8(0x06);
+        emit8(0x00);
+
+        switch (op)
+        {
+        case 041: // rol cx, 8; movsx rcx, cx
+            emit8(0x66);
+            emit8(0xc1);
+            emit8(0xc1);
+            emit8(0x08);
+            emit8(0x48);
+            emit8(0x0f);
+            emit8(0xbf);
+            emit8(0xc9);
+            break;
+        case 045: // rol cx, 8; movzx ecx, cx
+            emit8(0x66);
+            emit8(0xc1);
+            emit8(0xc1);
+            emit8(0x08);
+            emit8(0x0f);
+            emit8(0xb7);
+            emit8(0xc9);
+            break;
+        case 043: // bswap ecx; movsxd rcx, ecx
+            emit8(0x0f);
+            emit8(0xc9);
+            emit8(0x48);
+            emit8(0x63);
+            emit8(0xc9);
+            break;
+        case 047: // bswap ecx
+            emit8(0x0f);
+            emit8(0xc9);
+            break;
+        case 067: // bswap rcx
+            emit8(0x48);
+            emit8(0x0f);
+            emit8(0xc9);
+            break;
+        }
+        emitStore(reg(RT), RCX);
+    }
+
+    slow.resume = _ptr;
+    _slows.push_back(std::move(slow));
+    return true;
+}
+
+/* Run the access through the interpreter handler, with the clock where it would be */
+void Recompiler::emitSlowPath(const SlowPath& slow)
+{
+    std::uint8_t* exception{};
+
+    for (std::uint8_t* jump : slow.jumps)
+        bind(jump);
+    if (slow.fault)
+        _faults[slow.fault] = _ptr;
+
+    emitCycles(slow.pending);
+    if (!slow.delaySlot)
+    {
+        emitStoreImm(_pcDisp, slow.addr + 4);
+        emitStoreImm(_pcNextDisp, slow.addr + 8);
+    }
+    emitFaultPc(slow.addr, slow.delaySlot);
+    emitCall(*slow.instr);
+    if (!slow.delaySlot)
+    {
+        emitComparePc(slow.addr + 4);
+        exception = emitJumpIf(CC_NE);
+    }
+    emitCycles({-slow.pending.cycles, -slow.pending.instrs});
+    patch(emitJump(), slow.resume);
+
+    /* The access raised an exception: count it and go back to the CPU loop */
+    if (exception)
+    {
+        bind(exception);
+        emitCycles({slow.instr->cycles, 1});
+        emit8(0x31); // xor eax, eax
+        emit8(0xc0);
+        patch(emitJump(), _exit);
+    }
+}
+
+/* Where an exception raised by the handler returns to. Delay slots copied _branchDelay already */
+void Recompiler::emitFaultPc(std::uint64_t addr, bool delaySlot)
+{
+    emitStoreImm(_instrPcDisp, addr);
+    if (!delaySlot)
+    {
+        emitMem(0, 0xc6, 0, RBX, _instrDelayDisp); // mov byte [instrDelay], 0
+        emit8(0);
+    }
+}
+
+void Recompiler::emitCall(const Instr& instr)
+{
+    emit8(0x48); // mov arg0, rbx
+    emit8(0x89);
+    emit8(0xd8 | ARG0);
+    emit8(0x48); // mov arg1, imm64
+    emit8(0xb8 | ARG1);
+    emit64((std::uint64_t)&instr);
+    emit8(0x48); // mov rax, imm64
+    emit8(0xb8);
+    emit64((std::uint64_t)instr.handler);
+    emit8(0xff); // call rax
+    emit8(0xd0);
+    emitStoreImm(reg(0), 0);
+}
+
+void Recompiler::emitCycles(const Pending& pending)
+{
+    if (!pending.instrs)
+        return;
+    emitMem(REX_W, 0x81, 0, R12, 0); // add qword [now], imm32
+    emit32((std::uint32_t)pending.cycles);
+    emitMem(REX_W, 0x81, 0, RBX, _instructionsDisp); // add qword [instructions], imm32
+    emit32((std::uint32_t)pending.instrs);
+}
+
+/* Chain to the block at pc, if the scheduler limit has not been reached */
+void Recompiler::emitLink(std::uint64_t pc, bool check)
+{
+    std::uint8_t* skip{};
+    std::uint8_t* site;
+
+    if (check)
+    {
+        emitComparePc(pc);
+        skip = emitJumpIf(CC_NE);
+    }
+    emitMem(REX_W, 0x8b, RAX, R12, 0);          // mov rax, [now]
+    emitMem(REX_W, 0x3b, RAX, R12, _limitDisp); // cmp rax, [limit]
+    _plains.push_back(emitJumpIf(CC_AE));
+
+    /* Until linked, the jump falls through to a stub reporting its own address */
+    site = emitJump();
+    emit8(0x48); // mov rax, imm64
+    emit8(0xb8);
+    emit64((std::uint64_t)site);
+    patch(emitJump(), _exit);
+
+    if (skip)
+        bind(skip);
+}
+
+void Recompiler::emitPlainExit()
+{
+    for (std::uint8_t* p : _plains)
+        bind(p);
+    emit8(0x31); // xor eax, eax
+    emit8(0xc0);
+    patch(emitJump(), _exit);
+}
+
+void Recompiler::emit32(std::uint32_t value)
+{
+    std::memcpy(_ptr, &value, 4);
+    _ptr += 4;
+}
+
+void Recompiler::emit64(std::uint64_t value)
+{
+    std::memcpy(_ptr, &value, 8);
+    _ptr += 8;
+}
+
+/* op reg, [base + disp32] */
+void Recompiler::emitMem(std::uint8_t rex, std::uint8_t op, int reg, int base, std::int32_t disp)
+{
+    if (reg & 8)
+        rex |= 0x04;
+    if (base & 8)
+        rex |= 0x01;
+    if (rex)
+        emit8(0x40 | rex);
+    emit8(op);
+    emit8(0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP)
+        emit8(0x24);
+    emit32((std::uint32_t)disp);
+}
+
+void Recompiler::emitLoad(int reg, std::int32_t disp)
+{
+    emitMem(REX_W, 0x8b, reg, RBX, disp);
+}
+
+void Recompiler::emitStore(std::int32_t disp, int reg)
+{
+    emitMem(REX_W, 0x89, reg, RBX, disp);
+}
+
+void Recompiler::emitStoreImm(std::int32_t disp, std::uint64_t value)
+{
+    if (fitsInt32(value))
+    {
+        emitMem(REX_W, 0xc7, 0, RBX, disp);
+        emit32((std::uint32_t)value);
+    }
+    else
+    {
+        emit8(0x48); // mov rax, imm64
+        emit8(0xb8);
+        emit64(value);
+        emitStore(disp, RAX);
+    }
+}
+
+void Recompiler::emitComparePc(std::uint64_t value)
+{
+    if (fitsInt32(value))
+    {
+        emitMem(REX_W, 0x81, 7, RBX, _pcDisp);
+        emit32((std::uint32_t)value);
+    }
+    else
+    {
+        emit8(0x48); // mov rax, imm64
+        emit8(0xb8);
+        emit64(value);
+        emitMem(REX_W, 0x39, RAX, RBX, _pcDisp);
+    }
+}
+
+std::uint8_t* Recompiler::emitJump()
+{
+    emit8(0xe9);
+    emit32(0);
+    return _ptr - 4;
+}
+
+std::uint8_t* Recompiler::emitJumpIf(int cc)
+{
+    emit8(0x0f);
+    emit8(0x80 | cc);
+    emit32(0);
+    return _ptr - 4;
+}
+
+/* Point a rel32 at the current position */
+void Recompiler::bind(std::uint8_t* rel)
+{
+    patch(rel, _ptr);
+}
+
+std::int32_t Recompiler::reg(int index) const
+{
+    return disp(&_cpu._regs[index]);
+}
@@ -0,0 +1,138 @@
+#ifndef INCLUDED_RECOMPILER_H
+#define INCLUDED_RECOMPILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <libnin64/BlockCache.h>
+#include <libnin64/NonCopyable.h>
+
+namespace libnin64
+{
+
+class CPU;
+class Memory;
+class Scheduler;
+
+/*
+ * x86-64 recompiler for the VR4300.
+ *
+ * Translates the blocks of the cached interpreter. Simple ALU ops and
+ * branches become host code, everything else calls the interpreter handler
+ * for the instruction, so both backends produce the same results. Blocks
+ * chain to their successors directly while the scheduler limit allows it.
+ *
+ * With fastmem, loads and stores to KSEG0 and KSEG1 access the host mirror
+ * of the physical address space directly. Loads that hit an unmapped page
+ * fault, and the fault handler sends them to an out-of-line call to the
+ * interpreter handler, which also serves TLB mapped addresses. Blocks are
+ * left as soon as a handler raised an exception.
+ *
+ * The clock is kept in step with the interpreter: every instruction adds its
+ * Timing cycles, and the stalls of uncached accesses are left to the
+ * handlers, so with cycle timing KSEG1 always takes the slow path.
+ */
+class Recompiler : private NonCopyable
+{
+public:
+    Recompiler(CPU& cpu, Scheduler& scheduler, Memory& memory);
+    ~Recompiler();
+
+    static bool supported();
+    static bool handleFault(std::uint64_t& rip);
+
+    bool valid() const { return _buffer != nullptr; }
+    void run(Block* block, std::uint64_t until);
+
+private:
+    /* Clock and instruction count the code emitted so far has yet to add */
+    struct Pending
+    {
+        std::int32_t cycles;
+        std::int32_t instrs;
+
+        void add(const Instr& instr)
+        {
+            cycles += instr.cycles;
+            instrs++;
+        }
+    };
+
+    struct SlowPath
+    {
+        const Instr*               instr;
+        std::uint64_t              addr;
+        Pending                    pending;
+        bool                       delaySlot;
+        std::uint8_t*              fault;
+        std::uint8_t*              resume;
+        std::vector<std::uint8_t*> jumps;
+    };
+
+    using Entry = std::uint8_t* (*)(CPU* cpu, const std::uint8_t* code, const std::uint64_t* now, const std::uint32_t* generation);
+
+    bool                enterable(std::uint64_t pc) const;
+    const std::uint8_t* code(Block& block);
+    const std::uint8_t* compile(const Block& block, std::uint64_t pc);
+    void                link(std::uint8_t* site, const std::uint8_t* target, std::uint64_t pc);
+    void                patch(std::uint8_t* rel, const std::uint8_t* target);
+    void                flush();
+    bool                redirect(std::uint64_t& rip);
+
+    bool emitInline(const Instr& instr);
+    bool emitBranch(const Instr& instr, std::uint64_t addr, Pending& pending);
+    bool emitAccess(const Instr& instr, std::uint64_t addr, bool delaySlot, const Pending& pending);
+    void emitSlowPath(const SlowPath& slow);
+    void emitFaultPc(std::uint64_t addr, bool delaySlot);
+    void emitCall(const Instr& instr);
+    void emitCycles(const Pending& pending);
+    void emitLink(std::uint64_t pc, bool check);
+    void emitPlainExit();
+
+    void          emit8(std::uint8_t value) { *_ptr++ = value; }
+    void          emit32(std::uint32_t value);
+    void          emit64(std::uint64_t value);
+    void          emitMem(std::uint8_t rex, std::uint8_t op, int reg, int base, std::int32_t disp);
+    void          emitLoad(int reg, std::int32_t disp);
+    void          emitStore(std::int32_t disp, int reg);
+    void          emitStoreImm(std::int32_t disp, std::uint64_t value);
+    void          emitComparePc(std::uint64_t value);
+    std::uint8_t* emitJump();
+    std::uint8_t* emitJumpIf(int cc);
+    void          bind(std::uint8_t* rel);
+
+    std::int32_t disp(const void* field) const { return (std::int32_t)((const std::uint8_t*)field - (const std::uint8_t*)&_cpu); }
+    std::int32_t reg(int index) const;
+
+    CPU&       _cpu;
+    Scheduler& _scheduler;
+    Memory&    _memory;
+
+    std::uint8_t* _fastmem;
+    std::uint8_t* _buffer;
+    std::uint8_t* _code;
+    std::uint8_t* _ptr;
+    std::uint8_t* _exit;
+    Entry         _enter;
+    std::uint32_t _epoch;
+
+    std::int32_t _pcDisp;
+    std::int32_t _pcNextDisp;
+    std::int32_t _instrPcDisp;
+    std::int32_t _instrDelayDisp;
+    std::int32_t _branchDelayDisp;
+    std::int32_t _instructionsDisp;
+    std::int32_t _loDisp;
+    std::int32_t _hiDisp;
+    std::int32_t _limitDisp;
+
+    std::vector<std::uint8_t*>                                  _plains;
+    std::vector<SlowPath>                                       _slows;
+    std::unordered_map<std::uint64_t, std::vector<std::uint8_t*>> _links;
+    std::unordered_map<const std::uint8_t*, std::uint8_t*>        _faults;
+};
+
+} // namespace libnin64
+
+#endif
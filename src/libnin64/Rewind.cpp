@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <libnin64/LZ.h>
+#include <libnin64/Memory.h>
+#include <libnin64/Rewind.h>
+
+using namespace libnin64;
+
+static constexpr const std::size_t kShadowSize = Memory::kLineCount * Memory::kLineSize + sizeof(Memory::pif);
+
+/* out = old ^ cur, then old = cur */
+static void diff(std::uint8_t* out, std::uint8_t* old, const std::uint8_t* cur, std::size_t size)
+{
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        out[i] = old[i] ^ cur[i];
+        old[i] = cur[i];
+    }
+}
+
+static void apply(std::uint8_t* dst, const std::uint8_t* delta, std::size_t size)
+{
+    for (std::size_t i = 0; i < size; ++i)
+        dst[i] ^= delta[i];
+}
+
+Rewind::Rewind(Memory& memory, std::size_t machineSize, std::size_t budget)
+: _memory{memory}
+, _machineSize{machineSize}
+, _shadow{std::make_unique<std::uint8_t[]>(kShadowSize)}
+, _machine{std::make_unique<std::uint8_t[]>(machineSize)}
+, _scratch{std::make_unique<std::uint8_t[]>(machineSize)}
+, _raw{std::make_unique<std::uint8_t[]>(rawSize(machineSize))}
+, _packed{std::make_unique<std::uint8_t[]>(lzBound(rawSize(machineSize)))}
+, _generation{std::make_unique<std::uint32_t[]>(Memory::kLineCount)}
+, _stale{std::make_unique<std::uint8_t[]>(Memory::kLineCount)}
+, _valid{}
+, _ringSize{budget - overhead(machineSize)}
+, _head{}
+, _used{}
+{
+    _ring = std::make_unique<std::uint8_t[]>(_ringSize);
+}
+
+Rewind::~Rewind()
+{
+}
+
+std::size_t Rewind::overhead(std::size_t machineSize)
+{
+    return kShadowSize + machineSize * 2 + rawSize(machineSize) + lzBound(rawSize(machineSize)) + Memory::kLineCount * (sizeof(std::uint32_t) + 1);
+}
+
+/* Line count, then index and contents of each line, then PIF RAM and the machine */
+std::size_t Rewind::rawSize(std::size_t machineSize)
+{
+    return 4 + Memory::kLineCount * (4 + Memory::kLineSize) + sizeof(Memory::pif) + machineSize;
+}
+
+void Rewind::push()
+{
+    std::uint8_t* out;
+    std::uint32_t count{};
+
+    if (!_valid)
+    {
+        for (std::uint32_t line = 0; line < Memory::kLineCount; ++line)
+            std::memcpy(_shadow.get() + line * Memory::kLineSize, _memory.lineData(line), Memory::kLineSize);
+        std::memcpy(_shadow.get() + kShadowSize - sizeof(Memory::pif), _memory.pif, sizeof(Memory::pif));
+        std::swap(_machine, _scratch);
+        sync();
+        _valid = true;
+        return;
+    }
+
+    out = _raw.get() + 4;
+    for (std::uint32_t line = 0; line < Memory::kLineCount; ++line)
+    {
+        if (!dirty(line))
+            continue;
+        std::memcpy(out, &line, 4);
+        diff(out + 4, _shadow.get() + line * Memory::kLineSize, _memory.lineData(line), Memory::kLineSize);
+        out += 4 + Memory::kLineSize;
+        count++;
+    }
+    std::memcpy(_raw.get(), &count, 4);
+    diff(out, _shadow.get() + kShadowSize - sizeof(Memory::pif), _memory.pif, sizeof(Memory::pif));
+    out += sizeof(Memory::pif);
+    diff(out, _machine.get(), _scratch.get(), _machineSize);
+    out += _machineSize;
+    sync();
+
+    store(lzCompress(_raw.get(), out - _raw.get(), _packed.get()), out - _raw.get());
+}
+
+const std::uint8_t* Rewind::step(bool skip)
+{
+    if (!_valid)
+        return nullptr;
+
+    if (skip && !_records.empty())
+        pop();
+
+    for (std::uint32_t line = 0; line < Memory::kLineCount; ++line)
+    {
+        if (!dirty(line))
+            continue;
+        std::memcpy(_memory.lineData(line), _shadow.get() + line * Memory::kLineSize, Memory::kLineSize);
+        _memory.generation[line].fetch_add(1, std::memory_order_relaxed);
+    }
+    std::memcpy(_memory.pif, _shadow.get() + kShadowSize - sizeof(Memory::pif), sizeof(Memory::pif));
+    std::memcpy(_scratch.get(), _machine.get(), _machineSize);
+    sync();
+
+    if (!_records.empty())
+        pop();
+    return _scratch.get();
+}
+
+/* Lines where memory and the shadow may differ */
+bool Rewind::dirty(std::uint32_t line) const
+{
+    return _memory.generation[line] != _generation[line] || _stale[line];
+}
+
+void Rewind::sync()
+{
+    for (std::uint32_t line = 0; line < Memory::kLineCount; ++line)
+        _generation[line] = _memory.generation[line].load(std::memory_order_relaxed);
+    std::memset(_stale.get(), 0, Memory::kLineCount);
+}
+
+void Rewind::store(std::size_t size, std::size_t rawSize)
+{
+    std::size_t first;
+
+    /* Too big to keep, and the history cannot have a hole */
+    if (size > _ringSize)
+    {
+        _records.clear();
+        _head = 0;
+        _used = 0;
+        return;
+    }
+
+    while (_ringSize - _used < size)
+    {
+        _used -= _records.front().size;
+        _records.pop_front();
+    }
+
+    first = std::min(size, _ringSize - _head);
+    std::memcpy(_ring.get() + _head, _packed.get(), first);
+    std::memcpy(_ring.get(), _packed.get() + first, size - first);
+    _records.push_back({_head, size, rawSize});
+    _head  = (_head + size) % _ringSize;
+    _used += size;
+}
+
+/* Turns the newest frame into the one before it */
+void Rewind::pop()
+{
+    Record              record = _records.back();
+    const std::uint8_t* packed = _ring.get() + record.offset;
+    const std::uint8_t* in;
+    std::size_t         first;
+    std::uint32_t       count;
+    std::uint32_t       line;
+
+    _records.pop_back();
+    _head  = record.offset;
+    _used -= record.size;
+
+    if (record.offset + record.size > _ringSize)
+    {
+        first = _ringSize - record.offset;
+        std::memcpy(_packed.get(), packed, first);
+        std::memcpy(_packed.get() + first, _ring.get(), record.size - first);
+        packed = _packed.get();
+    }
+    if (!lzDecompress(packed, record.size, _raw.get(), record.rawSize))
+    {
+        _records.clear();
+        _head = 0;
+        _used = 0;
+        return;
+    }
+
+    in = _raw.get();
+    std::memcpy(&count, in, 4);
+    in += 4;
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        std::memcpy(&line, in, 4);
+        apply(_shadow.get() + line * Memory::kLineSize, in + 4, Memory::kLineSize);
+        _stale[line] = 1;
+        in += 4 + Memory::kLineSize;
+    }
+    apply(_shadow.get() + kShadowSize - sizeof(Memory::pif), in, sizeof(Memory::pif));
+    in += sizeof(Memory::pif);
+    apply(_machine.get(), in, _machineSize);
+}
@@ -0,0 +1,90 @@
+#ifndef INCLUDED_REWIND_H
+#define INCLUDED_REWIND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <libnin64/NonCopyable.h>
+
+namespace libnin64
+{
+
+class Memory;
+
+/*
+ * History of past frames, for rewinding.
+ *
+ * The newest frame is kept whole: a shadow copy of memory, and the rest of
+ * the machine as a save state without memory. Every older frame is a record
+ * of what changed on the way to the frame after it, XORed so the same
+ * record works both ways: the memory lines written since (found through
+ * their write generations), PIF RAM and the machine state. Records are LZ
+ * compressed into a ring, the oldest being dropped when it is full.
+ *
+ * All buffers are allocated upfront from the budget, so pushing a frame
+ * costs a scan of the line generations plus work in proportion to the
+ * memory written during the frame.
+ */
+class Rewind : private NonCopyable
+{
+public:
+    Rewind(Memory& memory, std::size_t machineSize, std::size_t budget);
+    ~Rewind();
+
+    /* Part of the budget that does not go to the ring */
+    static std::size_t overhead(std::size_t machineSize);
+
+    std::size_t budget() const { return _ringSize + overhead(_machineSize); }
+
+    std::size_t frames() const { return _valid ? _records.size() + 1 : 0; }
+
+    /* The machine state, without memory, is saved to machine() before push() */
+    std::uint8_t* machine() { return _scratch.get(); }
+    std::size_t   machineSize() const { return _machineSize; }
+    void          push();
+
+    /*
+     * Restores memory to the newest frame and returns its machine state,
+     * dropping it from the history unless it is the only one left. Skip the
+     * newest frame when the machine has not moved since it was pushed.
+     */
+    const std::uint8_t* step(bool skip);
+
+private:
+    struct Record
+    {
+        std::size_t offset;
+        std::size_t size;
+        std::size_t rawSize;
+    };
+
+    static std::size_t rawSize(std::size_t machineSize);
+
+    bool dirty(std::uint32_t line) const;
+    void sync();
+    void store(std::size_t size, std::size_t rawSize);
+    void pop();
+
+    Memory& _memory;
+
+    std::size_t                      _machineSize;
+    std::unique_ptr<std::uint8_t[]>  _shadow;
+    std::unique_ptr<std::uint8_t[]>  _machine;
+    std::unique_ptr<std::uint8_t[]>  _scratch;
+    std::unique_ptr<std::uint8_t[]>  _raw;
+    std::unique_ptr<std::uint8_t[]>  _packed;
+    std::unique_ptr<std::uint32_t[]> _generation;
+    std::unique_ptr<std::uint8_t[]>  _stale;
+    bool                             _valid;
+
+    std::unique_ptr<std::uint8_t[]> _ring;
+    std::size_t                     _ringSize;
+    std::size_t                     _head;
+    std::size_t                     _used;
+    std::deque<Record>              _records;
+};
+
+} // namespace libnin64
+
+#endif
@@ -0,0 +1,212 @@
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <libnin64/ByteOrder.h>
+#include <libnin64/Rom.h>
+#include <libnin64/Util.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace libnin64;
+
+/* Images in use, by size and hash of the file as is */
+static std::mutex                                                             gRomsMutex;
+static std::map<std::pair<std::uint32_t, std::uint64_t>, std::weak_ptr<const Rom>> gRoms;
+
+Rom::Rom()
+: _data{}
+, _size{}
+, _fingerprint{}
+, _view{}
+, _fd{-1}
+{
+}
+
+Rom::~Rom()
+{
+#if defined(_WIN32)
+    if (_data && _view)
+        UnmapViewOfFile(_data);
+    else if (_data)
+        VirtualFree(_data, 0, MEM_RELEASE);
+#else
+    if (_data)
+        munmap(_data, _size);
+    if (_fd >= 0)
+        close(_fd);
+#endif
+}
+
+Nin64Err Rom::open(const char* path, std::shared_ptr<const Rom>& dst)
+{
+    std::shared_ptr<Rom> rom{new Rom};
+    std::uint32_t        magic;
+    std::uint64_t        key;
+    ByteOrder            order;
+
+    dst.reset();
+
+    /* Map the file */
+#if defined(_WIN32)
+    HANDLE        file;
+    HANDLE        mapping;
+    LARGE_INTEGER size;
+    void*         data;
+
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return NIN64_ERROR_IO;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return NIN64_ERROR_IO;
+    }
+    if (size.QuadPart < 0x1000 || size.QuadPart > 0xffffffff)
+    {
+        CloseHandle(file);
+        return NIN64_ERROR_BADROM;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping)
+        return NIN64_ERROR_IO;
+    rom->_data = (std::uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!rom->_data)
+        return NIN64_ERROR_IO;
+    rom->_size = (std::uint32_t)size.QuadPart;
+#else
+    struct stat st;
+    void*       data;
+
+    rom->_fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (rom->_fd < 0 || fstat(rom->_fd, &st))
+        return NIN64_ERROR_IO;
+    if (st.st_size < 0x1000 || st.st_size > 0xffffffff)
+        return NIN64_ERROR_BADROM;
+    data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, rom->_fd, 0);
+    if (data == MAP_FAILED)
+        return NIN64_ERROR_IO;
+    rom->_data = (std::uint8_t*)data;
+    rom->_size = (std::uint32_t)st.st_size;
+#endif
+    rom->_view = true;
+
+    /* Detect the correct endianess */
+    std::memcpy(&magic, rom->_data, 4);
+    switch (magic & 0xff)
+    {
+    case 0x80:
+        /* Big-Endian ROM */
+        order = ByteOrder::Big;
+        break;
+    case 0x37:
+        /* Little-Endian ROM */
+        order = ByteOrder::Swap16;
+        break;
+    case 0x40:
+        /* Middle-Endian ROM */
+        order = ByteOrder::Swap32;
+        break;
+    case 0x12:
+        /* Alternative Middle-Endian ROM - very rare */
+        order = ByteOrder::SwapHalves;
+        break;
+    default:
+        return NIN64_ERROR_BADROM;
+    }
+
+    /* Check the fixed up magic */
+    swapByteOrder(&magic, &magic, 4, order);
+    if (magic != 0x40123780)
+        return NIN64_ERROR_BADROM;
+
+    /* Share the image if another cart has it loaded */
+    key = xxh64(rom->_data, rom->_size);
+    {
+        std::lock_guard<std::mutex> lock(gRomsMutex);
+        auto it = gRoms.find({rom->_size, key});
+        if (it != gRoms.end() && (dst = it->second.lock()))
+            return NIN64_OK;
+    }
+
+    /* Convert to big endian, into memory backed by a file where possible */
+    if (order != ByteOrder::Big)
+    {
+        std::uint8_t* file = rom->_data;
+#if defined(_WIN32)
+        DWORD old;
+
+        data = VirtualAlloc(nullptr, rom->_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (!data)
+            return NIN64_ERROR_OUTOFMEMORY;
+        swapByteOrder(data, file, rom->_size, order);
+        VirtualProtect(data, rom->_size, PAGE_READONLY, &old);
+        UnmapViewOfFile(file);
+#else
+        int fd{-1};
+
+#if defined(__linux__)
+        fd = memfd_create("nin64-rom", MFD_CLOEXEC);
+        if (fd >= 0 && ftruncate(fd, rom->_size))
+        {
+            close(fd);
+            fd = -1;
+        }
+#endif
+        if (fd >= 0)
+            data = mmap(nullptr, rom->_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        else
+            data = mmap(nullptr, rom->_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED)
+        {
+            if (fd >= 0)
+                close(fd);
+            return NIN64_ERROR_OUTOFMEMORY;
+        }
+        swapByteOrder(data, file, rom->_size, order);
+        mprotect(data, rom->_size, PROT_READ);
+        munmap(file, rom->_size);
+        close(rom->_fd);
+        rom->_fd = fd;
+#endif
+        rom->_data = (std::uint8_t*)data;
+        rom->_view = false;
+    }
+    rom->_fingerprint = (order == ByteOrder::Big) ? key : xxh64(rom->_data, rom->_size);
+
+    /* Another cart may have loaded the same image in the meantime */
+    {
+        std::lock_guard<std::mutex> lock(gRomsMutex);
+        auto& entry = gRoms[{rom->_size, key}];
+        if (!(dst = entry.lock()))
+        {
+            dst   = rom;
+            entry = rom;
+        }
+        for (auto it = gRoms.begin(); it != gRoms.end();)
+            it = it->second.expired() ? gRoms.erase(it) : std::next(it);
+    }
+    return NIN64_OK;
+}
+
+bool Rom::map(std::uint8_t* addr, std::size_t size) const
+{
+#if defined(_WIN32)
+    (void)addr;
+    (void)size;
+    return false;
+#else
+    if (_fd < 0)
+        return false;
+    return mmap(addr, size, PROT_READ, MAP_SHARED | MAP_FIXED, _fd, 0) != MAP_FAILED;
+#endif
+}
@@ -0,0 +1,50 @@
+#ifndef INCLUDED_ROM_H
+#define INCLUDED_ROM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <libnin64/NonCopyable.h>
+#include <nin64/nin64.h>
+
+namespace libnin64
+{
+
+/*
+ * An immutable, big endian ROM image, shared by every cart of the process
+ * loaded from the same contents.
+ *
+ * A big endian file is mapped read-only as is, so the image costs no copy
+ * and its pages come from the page cache. Any other byte order is converted
+ * once into memory of its own. Where the host allows it, both are backed by
+ * a file that can be mapped again at another address, still without a copy.
+ */
+class Rom : private NonCopyable
+{
+public:
+    ~Rom();
+
+    static Nin64Err open(const char* path, std::shared_ptr<const Rom>& dst);
+
+    const std::uint8_t* data() const { return _data; }
+    std::uint32_t       size() const { return _size; }
+
+    /* xxHash64 of the big endian image, the same for any byte order of the file */
+    std::uint64_t fingerprint() const { return _fingerprint; }
+
+    /* Maps size bytes of the image at a page aligned addr, read-only, replacing what was there */
+    bool map(std::uint8_t* addr, std::size_t size) const;
+
+private:
+    Rom();
+
+    std::uint8_t* _data;
+    std::uint32_t _size;
+    std::uint64_t _fingerprint;
+    bool          _view;
+    int           _fd;
+};
+
+} // namespace libnin64
+
+#endif
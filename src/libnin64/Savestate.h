@@ -0,0 +1,221 @@
+#ifndef INCLUDED_SAVESTATE_H
+#define INCLUDED_SAVESTATE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <libnin64/NonCopyable.h>
+
+namespace libnin64
+{
+
+/*
+ * Save state format.
+ *
+ * A header (magic, version) followed by sections, each a four character
+ * tag, a 32-bit payload size and the payload. Values are stored raw, in
+ * host byte order. Sections are looked up by tag, so their order does not
+ * matter; bump the version whenever the layout of a payload changes.
+ */
+constexpr const std::uint32_t kSavestateMagic   = 0x5334364e; // "N64S"
+constexpr const std::uint32_t kSavestateVersion = 7;
+
+inline std::uint32_t savestateTag(const char* tag)
+{
+    std::uint32_t value;
+
+    std::memcpy(&value, tag, 4);
+    return value;
+}
+
+struct SavestateSection
+{
+    const char*   tag;
+    std::uint32_t size;
+};
+
+class SavestateWriter : private NonCopyable
+{
+public:
+    /* Without a buffer, only measures; sections, if given, gets the layout */
+    SavestateWriter(void* buffer, std::size_t capacity, std::vector<SavestateSection>* sections = nullptr)
+    : _buffer{(std::uint8_t*)buffer}
+    , _capacity{capacity}
+    , _size{}
+    , _section{}
+    , _sections{sections}
+    , _tag{}
+    {
+        write(kSavestateMagic);
+        write(kSavestateVersion);
+    }
+
+    std::size_t size() const { return _size; }
+    bool        ok() const { return !_buffer || _size <= _capacity; }
+
+    void begin(const char* tag)
+    {
+        write(savestateTag(tag));
+        _tag     = tag;
+        _section = _size;
+        write(std::uint32_t{});
+    }
+
+    void end()
+    {
+        std::uint32_t size = (std::uint32_t)(_size - _section - 4);
+
+        if (_buffer && _section + 4 <= _capacity)
+            std::memcpy(_buffer + _section, &size, 4);
+        if (_sections)
+            _sections->push_back({_tag, size});
+    }
+
+    template <typename T> void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "save states hold raw values");
+        write(&value, sizeof(T));
+    }
+
+    void write(const void* data, std::size_t size)
+    {
+        if (_buffer && _size + size <= _capacity)
+            std::memcpy(_buffer + _size, data, size);
+        _size += size;
+    }
+
+private:
+    std::uint8_t*                  _buffer;
+    std::size_t                    _capacity;
+    std::size_t                    _size;
+    std::size_t                    _section;
+    std::vector<SavestateSection>* _sections;
+    const char*                    _tag;
+};
+
+class SavestateReader : private NonCopyable
+{
+public:
+    SavestateReader(const void* buffer, std::size_t size)
+    : _buffer{(const std::uint8_t*)buffer}
+    , _size{size}
+    , _cursor{}
+    , _end{}
+    , _error{}
+    {
+        std::size_t   pos;
+        std::uint32_t header[2];
+
+        _end   = std::min<std::size_t>(8, size);
+        _error = read<std::uint32_t>() != kSavestateMagic || read<std::uint32_t>() != kSavestateVersion;
+
+        /* Sections must cover the rest of the buffer exactly */
+        for (pos = 8; pos + 8 <= _size; pos += 8 + header[1])
+        {
+            std::memcpy(header, _buffer + pos, 8);
+            if (header[1] > _size - pos - 8)
+                break;
+        }
+        if (pos != _size)
+            _error = true;
+    }
+
+    bool        ok() const { return !_error; }
+    void        fail() { _error = true; }
+    std::size_t remaining() const { return _end - _cursor; }
+
+    /* Payload size of a section, or -1 if there is none */
+    std::ptrdiff_t sectionSize(const char* tag) const
+    {
+        std::size_t   pos;
+        std::uint32_t size;
+
+        if (!find(tag, pos, size))
+            return -1;
+        return size;
+    }
+
+    bool open(const char* tag)
+    {
+        std::size_t   pos;
+        std::uint32_t size;
+
+        if (!find(tag, pos, size))
+        {
+            _error = true;
+            return false;
+        }
+        _cursor = pos;
+        _end    = pos + size;
+        return true;
+    }
+
+    template <typename T> T read()
+    {
+        T value{};
+
+        read(value);
+        return value;
+    }
+
+    template <typename T> void read(T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "save states hold raw values");
+        read(&value, sizeof(T));
+    }
+
+    void read(void* data, std::size_t size)
+    {
+        if (_cursor + size > _end)
+        {
+            _error = true;
+            return;
+        }
+        std::memcpy(data, _buffer + _cursor, size);
+        _cursor += size;
+    }
+
+    void skip(std::size_t size)
+    {
+        if (size > _end - _cursor)
+        {
+            _error = true;
+            return;
+        }
+        _cursor += size;
+    }
+
+private:
+    bool find(const char* tag, std::size_t& payload, std::uint32_t& payloadSize) const
+    {
+        std::uint32_t wanted = savestateTag(tag);
+        std::uint32_t header[2];
+
+        for (std::size_t pos = 8; pos + 8 <= _size; pos += 8 + header[1])
+        {
+            std::memcpy(header, _buffer + pos, 8);
+            if (header[1] > _size - pos - 8)
+                break;
+            if (header[0] == wanted)
+            {
+                payload     = pos + 8;
+                payloadSize = header[1];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const std::uint8_t* _buffer;
+    std::size_t         _size;
+    std::size_t         _cursor;
+    std::size_t         _end;
+    bool                _error;
+};
+
+} // namespace libnin64
+
+#endif
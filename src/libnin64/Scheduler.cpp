@@ -0,0 +1,186 @@
+#include <libnin64/Savestate.h>
+#include <libnin64/Scheduler.h>
+
+using namespace libnin64;
+
+Scheduler::Scheduler()
+: _now{}
+, _limit{}
+, _time{}
+, _heap{}
+, _size{}
+{
+    for (std::size_t i = 0; i < kEventCount; ++i)
+        _slot[i] = -1;
+}
+
+Scheduler::~Scheduler()
+{
+}
+
+void Scheduler::scheduleAt(Event event, std::uint64_t time)
+{
+    std::size_t id = (std::size_t)event;
+    int         slot;
+
+    if (time < _limit)
+        _limit = time;
+
+    if (_slot[id] < 0)
+    {
+        slot        = _size++;
+        _heap[slot] = event;
+        _slot[id]   = (std::int8_t)slot;
+        _time[id]   = time;
+        siftUp(slot);
+        return;
+    }
+
+    slot = _slot[id];
+    if (time < _time[id])
+    {
+        _time[id] = time;
+        siftUp(slot);
+    }
+    else
+    {
+        _time[id] = time;
+        siftDown(slot);
+    }
+}
+
+void Scheduler::cancel(Event event)
+{
+    std::size_t id = (std::size_t)event;
+    int         slot;
+    int         last;
+
+    slot = _slot[id];
+    if (slot < 0)
+        return;
+
+    last = --_size;
+    if (slot != last)
+    {
+        swapSlots(slot, last);
+        siftDown(slot);
+        siftUp(slot);
+    }
+    _slot[id] = -1;
+}
+
+bool Scheduler::pop(Event& event)
+{
+    if (!_size || _time[(std::size_t)_heap[0]] > _now)
+        return false;
+
+    event = _heap[0];
+    cancel(event);
+    return true;
+}
+
+void Scheduler::setLimit(std::uint64_t until)
+{
+    _limit = deadline();
+    if (until < _limit)
+        _limit = until;
+}
+
+void Scheduler::swapSlots(int a, int b)
+{
+    Event tmp;
+
+    tmp      = _heap[a];
+    _heap[a] = _heap[b];
+    _heap[b] = tmp;
+
+    _slot[(std::size_t)_heap[a]] = (std::int8_t)a;
+    _slot[(std::size_t)_heap[b]] = (std::int8_t)b;
+}
+
+void Scheduler::siftUp(int slot)
+{
+    int parent;
+
+    while (slot > 0)
+    {
+        parent = (slot - 1) / 2;
+        if (_time[(std::size_t)_heap[parent]] <= _time[(std::size_t)_heap[slot]])
+            break;
+        swapSlots(slot, parent);
+        slot = parent;
+    }
+}
+
+void Scheduler::siftDown(int slot)
+{
+    int child;
+
+    for (;;)
+    {
+        child = slot * 2 + 1;
+        if (child >= _size)
+            break;
+        if (child + 1 < _size && _time[(std::size_t)_heap[child + 1]] < _time[(std::size_t)_heap[child]])
+            child++;
+        if (_time[(std::size_t)_heap[slot]] <= _time[(std::size_t)_heap[child]])
+            break;
+        swapSlots(slot, child);
+        slot = child;
+    }
+}
+
+void Scheduler::save(SavestateWriter& writer) const
+{
+    writer.begin("SCHD");
+    writer.write(_now);
+    writer.write(_time);
+    writer.write(_slot);
+    writer.write(_heap);
+    writer.write(_size);
+    writer.end();
+}
+
+/* The limit belongs to the CPU loop that was running, make it come back */
+void Scheduler::load(SavestateReader& reader)
+{
+    reader.open("SCHD");
+    reader.read(_now);
+    reader.read(_time);
+    reader.read(_slot);
+    reader.read(_heap);
+    reader.read(_size);
+    _limit = 0;
+}
+
+/* The heap and slots index each other, they must agree before being loaded */
+bool Scheduler::check(SavestateReader& reader) const
+{
+    std::int8_t  slot[kEventCount];
+    Event        heap[kEventCount];
+    std::uint8_t size;
+    std::size_t  used;
+
+    reader.open("SCHD");
+    reader.skip(sizeof(_now) + sizeof(_time));
+    reader.read(slot);
+    reader.read(heap);
+    reader.read(size);
+    if (!reader.ok() || size > kEventCount)
+        return false;
+
+    used = 0;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        if ((std::size_t)heap[i] >= kEventCount || slot[(std::size_t)heap[i]] != (std::int8_t)i)
+            return false;
+    }
+    for (std::size_t i = 0; i < kEventCount; ++i)
+    {
+        if (slot[i] >= 0)
+            used++;
+        else if (slot[i] != -1)
+            return false;
+    }
+    return used == size;
+}
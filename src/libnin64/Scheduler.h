@@ -0,0 +1,83 @@
+#ifndef INCLUDED_SCHEDULER_H
+#define INCLUDED_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <libnin64/NonCopyable.h>
+
+namespace libnin64
+{
+
+enum class Event : std::uint8_t
+{
+    VideoScanline = 0,
+    AudioDrain,
+    Timer,
+    PeripheralDma,
+    SerialDma,
+    RSP,
+    RDP,
+    Max
+};
+
+class SavestateReader;
+class SavestateWriter;
+
+/*
+ * Global timeline, in CPU cycles.
+ *
+ * Every event kind has at most one pending occurrence, kept in a small
+ * indexed min-heap so that (re)scheduling an event replaces its deadline.
+ *
+ * The limit is how far the CPU may run without going back to the main loop.
+ * It follows any event scheduled earlier than itself, and yield() drops it
+ * when something happens that the main loop must look at (an interrupt).
+ */
+class Scheduler : private NonCopyable
+{
+public:
+    static constexpr const std::uint64_t kNever = ~std::uint64_t(0);
+
+    Scheduler();
+    ~Scheduler();
+
+    std::uint64_t now() const { return _now; }
+    std::uint64_t deadline() const { return _size ? _time[(std::size_t)_heap[0]] : kNever; }
+    std::uint64_t when(Event event) const { return _time[(std::size_t)event]; }
+    bool          pending(Event event) const { return _slot[(std::size_t)event] >= 0; }
+    std::uint64_t limit() const { return _limit; }
+
+    /* For generated code, which reads both through one base register */
+    const std::uint64_t* nowAddr() const { return &_now; }
+    const std::uint64_t* limitAddr() const { return &_limit; }
+
+    void advance(std::uint64_t cycles) { _now += cycles; }
+    void schedule(Event event, std::uint64_t delay) { scheduleAt(event, _now + delay); }
+    void scheduleAt(Event event, std::uint64_t time);
+    void cancel(Event event);
+    bool pop(Event& event);
+    void setLimit(std::uint64_t until);
+    void yield() { _limit = 0; }
+
+    void save(SavestateWriter& writer) const;
+    void load(SavestateReader& reader);
+    bool check(SavestateReader& reader) const;
+
+private:
+    static constexpr const std::size_t kEventCount = (std::size_t)Event::Max;
+
+    void swapSlots(int a, int b);
+    void siftUp(int slot);
+    void siftDown(int slot);
+
+    std::uint64_t _now;
+    std::uint64_t _limit;
+    std::uint64_t _time[kEventCount];
+    std::int8_t   _slot[kEventCount];
+    Event         _heap[kEventCount];
+    std::uint8_t  _size;
+};
+
+} // namespace libnin64
+
+#endif
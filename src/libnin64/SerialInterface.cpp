@@ -1,8 +1,11 @@
-#include <cstdio>
 #include <cstring>
+#include <libnin64/Log.h>
 #include <libnin64/MIPSInterface.h>
 #include <libnin64/Memory.h>
+#include <libnin64/Savestate.h>
+#include <libnin64/Scheduler.h>
 #include <libnin64/SerialInterface.h>
+#include <libnin64/Timing.h>
 
 #define SI_DRAM_ADDR_REG      0x04800000
 #define SI_PIF_ADDR_RD64B_REG 0x04800004
@@ -11,10 +14,12 @@
 
 using namespace libnin64;
 
-SerialInterface::SerialInterface(MIPSInterface& mi, Memory& memory)
+SerialInterface::SerialInterface(MIPSInterface& mi, Scheduler& scheduler, Memory& memory)
 : _mi{mi}
+, _scheduler{scheduler}
 , _memory{memory}
 , _addr{}
+, _dmaBusy{}
 {
 }
 
@@ -29,21 +34,22 @@ std::uint32_t SerialInterface::read(std::uint32_t reg)
     switch (reg)
     {
     case SI_DRAM_ADDR_REG:
-        std::printf("SI Read: SI_DRAM_ADDR_REG\n");
+        NIN64_LOG(SI, Trace, "SI Read: SI_DRAM_ADDR_REG\n");
 
         value = _addr;
         break;
     case SI_PIF_ADDR_RD64B_REG:
-        std::printf("SI Read: SI_PIF_ADDR_RD64B_REG\n");
+        NIN64_LOG(SI, Trace, "SI Read: SI_PIF_ADDR_RD64B_REG\n");
 
         break;
     case SI_PIF_ADDR_WR64B_REG:
-        std::printf("SI Read: SI_PIF_ADDR_WR64B_REG\n");
+        NIN64_LOG(SI, Trace, "SI Read: SI_PIF_ADDR_WR64B_REG\n");
 
         break;
     case SI_STATUS_REG:
-        std::printf("SI Read: SI_STATUS_REG\n");
+        NIN64_LOG(SI, Trace, "SI Read: SI_STATUS_REG\n");
 
+        if (_dmaBusy) value |= (1 << 0);
         if (_mi.checkInterrupt(MI_INTR_SI)) value |= (1 << 12);
         break;
     default:
@@ -58,22 +64,22 @@ void SerialInterface::write(std::uint32_t reg, std::uint32_t value)
     switch (reg)
     {
     case SI_DRAM_ADDR_REG:
-        std::printf("SI Write: SI_DRAM_ADDR_REG: 0x%08x\n", value);
+        NIN64_LOG(SI, Trace, "SI Write: SI_DRAM_ADDR_REG: 0x%08x\n", value);
 
         _addr = value & 0x00ffffff;
         break;
     case SI_PIF_ADDR_RD64B_REG:
-        std::printf("SI Write: SI_PIF_ADDR_RD64B_REG: 0x%08x\n", value);
+        NIN64_LOG(SI, Trace, "SI Write: SI_PIF_ADDR_RD64B_REG: 0x%08x\n", value);
 
         dmaRead();
         break;
     case SI_PIF_ADDR_WR64B_REG:
-        std::printf("SI Write: SI_PIF_ADDR_WR64B_REG: 0x%08x\n", value);
+        NIN64_LOG(SI, Trace, "SI Write: SI_PIF_ADDR_WR64B_REG: 0x%08x\n", value);
 
         dmaWrite();
         break;
     case SI_STATUS_REG:
-        std::printf("SI Write: SI_STATUS_REG: 0x%08x\n", value);
+        NIN64_LOG(SI, Trace, "SI Write: SI_STATUS_REG: 0x%08x\n", value);
 
         _mi.clearInterrupt(MI_INTR_SI);
         break;
@@ -86,18 +92,18 @@ void SerialInterface::pifUpdate()
 {
     if (_memory.pif[63] != 1)
         return;
-    std::printf("PIF Command!\n");
+    NIN64_LOG(SI, Trace, "PIF Command!\n");
     for (int i = 0; i < 8; ++i)
     {
-        std::printf("  %02x%02x%02x%02x - %02x%02x%02x%02x\n",
-                    _memory.pif[i * 8 + 0],
-                    _memory.pif[i * 8 + 1],
-                    _memory.pif[i * 8 + 2],
-                    _memory.pif[i * 8 + 3],
-                    _memory.pif[i * 8 + 4],
-                    _memory.pif[i * 8 + 5],
-                    _memory.pif[i * 8 + 6],
-                    _memory.pif[i * 8 + 7]);
+        NIN64_LOG(SI, Trace, "  %02x%02x%02x%02x - %02x%02x%02x%02x\n",
+                  _memory.pif[i * 8 + 0],
+                  _memory.pif[i * 8 + 1],
+                  _memory.pif[i * 8 + 2],
+                  _memory.pif[i * 8 + 3],
+                  _memory.pif[i * 8 + 4],
+                  _memory.pif[i * 8 + 5],
+                  _memory.pif[i * 8 + 6],
+                  _memory.pif[i * 8 + 7]);
     }
 
     for (int i = 0; i < 16; ++i)
@@ -125,30 +131,54 @@ void SerialInterface::pifUpdate()
     }
     _memory.pif[63] = 0;
 
-    std::printf("\nResult:\n");
+    NIN64_LOG(SI, Trace, "\nResult:\n");
     for (int i = 0; i < 8; ++i)
     {
-        std::printf("  %02x%02x%02x%02x - %02x%02x%02x%02x\n",
-                    _memory.pif[i * 8 + 0],
-                    _memory.pif[i * 8 + 1],
-                    _memory.pif[i * 8 + 2],
-                    _memory.pif[i * 8 + 3],
-                    _memory.pif[i * 8 + 4],
-                    _memory.pif[i * 8 + 5],
-                    _memory.pif[i * 8 + 6],
-                    _memory.pif[i * 8 + 7]);
+        NIN64_LOG(SI, Trace, "  %02x%02x%02x%02x - %02x%02x%02x%02x\n",
+                  _memory.pif[i * 8 + 0],
+                  _memory.pif[i * 8 + 1],
+                  _memory.pif[i * 8 + 2],
+                  _memory.pif[i * 8 + 3],
+                  _memory.pif[i * 8 + 4],
+                  _memory.pif[i * 8 + 5],
+                  _memory.pif[i * 8 + 6],
+                  _memory.pif[i * 8 + 7]);
     }
 }
 
+void SerialInterface::dmaComplete()
+{
+    _dmaBusy = false;
+    _mi.setInterrupt(MI_INTR_SI);
+}
+
 void SerialInterface::dmaRead()
 {
     std::memcpy(_memory.ram + _addr, _memory.pif, 64);
-    _mi.setInterrupt(MI_INTR_SI);
+    _memory.markWritten(_addr, 64);
+    _dmaBusy = true;
+    _scheduler.schedule(Event::SerialDma, Timing::kSerialDma);
 }
 
 void SerialInterface::dmaWrite()
 {
     std::memcpy(_memory.pif, _memory.ram + _addr, 64);
     pifUpdate();
-    _mi.setInterrupt(MI_INTR_SI);
+    _dmaBusy = true;
+    _scheduler.schedule(Event::SerialDma, Timing::kSerialDma);
+}
+
+void SerialInterface::save(SavestateWriter& writer) const
+{
+    writer.begin("SI  ");
+    writer.write(_addr);
+    writer.write<bool>(_dmaBusy);
+    writer.end();
+}
+
+void SerialInterface::load(SavestateReader& reader)
+{
+    reader.open("SI  ");
+    reader.read(_addr);
+    _dmaBusy = reader.read<bool>();
 }
@@ -10,24 +10,33 @@ namespace libnin64
 
 class MIPSInterface;
 class Memory;
+class SavestateReader;
+class SavestateWriter;
+class Scheduler;
 class SerialInterface : private NonCopyable
 {
 public:
-    SerialInterface(MIPSInterface& mi, Memory& memory);
+    SerialInterface(MIPSInterface& mi, Scheduler& scheduler, Memory& memory);
     ~SerialInterface();
 
     std::uint32_t read(std::uint32_t reg);
     void          write(std::uint32_t reg, std::uint32_t value);
     void          pifUpdate();
+    void          dmaComplete();
+
+    void save(SavestateWriter& writer) const;
+    void load(SavestateReader& reader);
 
 private:
     void dmaRead();
     void dmaWrite();
 
     MIPSInterface& _mi;
+    Scheduler&     _scheduler;
     Memory&        _memory;
 
     std::uint32_t _addr;
+    bool          _dmaBusy : 1;
 };
 
 } // namespace libnin64
@@ -1,22 +1,31 @@
-#include <cstdio>
+#include <libnin64/Log.h>
+#include <libnin64/Savestate.h>
 #include <libnin64/State.h>
+#include <libnin64/Util.h>
 
 using namespace libnin64;
 
 State::State()
-: cart{}
+: profiler{}
+, scheduler{}
+, cart{}
 , memory{}
-, mi{}
-, pi{mi, memory, cart}
-, si{mi, memory}
-, vi{mi}
-, ai{mi, memory}
+, mi{scheduler}
+, pi{mi, scheduler, memory, cart}
+, si{mi, scheduler, memory}
+, vi{mi, scheduler, profiler}
+, ai{mi, scheduler, memory, profiler}
 , ri{}
-, rdp{memory, mi}
-, rsp{memory, mi, rdp}
+, rdp{memory, mi, scheduler, profiler}
+, rsp{memory, mi, scheduler, rdp, profiler}
 , bus{memory, cart, mi, pi, si, vi, ai, ri, rsp, rdp}
-, cpu{bus, mi}
+, cpu{bus, memory, mi, scheduler}
+, _ids{std::random_device{}()}
+, _checkpoint{}
+, _clean{}
+, _pushed{}
 {
+    rsp.setVectorBackend(RSPVectorUnit::detect());
 }
 
 State::~State()
@@ -25,37 +34,337 @@ State::~State()
 
 Nin64Err State::loadRom(const char* path)
 {
-    Nin64Err    err;
-    const char* cicName;
+    Nin64Err err;
 
     if ((err = cart.load(path)))
     {
         return err;
     }
+    bus.mapCart();
     cart.read(memory.spDmem, 0, 0x1000);
-    switch (cart.cic())
+    NIN64_LOG(Core, Info, "CIC: %s %s\n", cart.cic().name, cart.tvType() == TvType::PAL ? "PAL" : "NTSC");
+    cpu.init(cart.cic(), cart.tvType());
+    pi.init(swap(*(const std::uint32_t*)memory.spDmem));
+    rsp.init(cart.cic(), cart.tvType());
+    return NIN64_OK;
+}
+
+/*
+ * Runs the RSP and the RDP on their own threads. They sync with the CPU at
+ * register accesses and at checkpoint events, so results are no longer
+ * deterministic; the default is to run everything on the caller's thread.
+ */
+void State::setThreaded(bool threaded)
+{
+    if (threaded)
+    {
+        rdp.setThreaded(true);
+        rsp.setThreaded(true);
+    }
+    else
     {
-    case CIC::NUS_6101:
-        cicName = "6101";
+        rsp.setThreaded(false);
+        rdp.setThreaded(false);
+    }
+}
+
+/*
+ * Emulating the CPU caches adds them to the state, so states only load with
+ * the setting they were made with. The rewind history starts over.
+ */
+Nin64Err State::setCacheEmulation(bool enabled)
+{
+    if (enabled == cpu.cacheEmulation())
+        return NIN64_OK;
+
+    cpu.setCacheEmulation(enabled);
+    _checkpoint = 0;
+    if (_rewind)
+        return setRewindBudget(_rewind->budget());
+    return NIN64_OK;
+}
+
+void State::run(std::uint64_t cycles)
+{
+    std::chrono::steady_clock::time_point start;
+    std::uint64_t                         target;
+    Event                                 event;
+    bool                                  profiling;
+
+    profiling = profiler.enabled();
+    if (profiling)
+        start = profiler.begin();
+    target = scheduler.now() + cycles;
+    _clean  = false;
+    _pushed = false;
+    for (;;)
+    {
+        while (scheduler.pop(event))
+            dispatch(event);
+        if (scheduler.now() >= target)
+            break;
+        cpu.run(target);
+    }
+    if (profiling)
+        profiler.run(start);
+}
+
+void State::stats(Nin64Stats* stats) const
+{
+    stats->cycles       = scheduler.now();
+    stats->instructions = cpu.instructions();
+    stats->cpuTime      = profiler.time(Component::CPU);
+    stats->rspTime      = profiler.time(Component::RSP);
+    stats->rdpTime      = profiler.time(Component::RDP);
+    stats->aiTime       = profiler.time(Component::AI);
+    stats->viTime       = profiler.time(Component::VI);
+}
+
+std::size_t State::saveSize() const
+{
+    SavestateWriter writer{nullptr, 0};
+
+    write(writer, 0, SaveMemory::Full);
+    return writer.size();
+}
+
+/*
+ * Snapshots the whole machine into a caller provided buffer, at least
+ * saveSize() bytes long. RDRAM and SP memory are copied as they are.
+ */
+Nin64Err State::save(void* buffer, std::size_t size)
+{
+    std::uint64_t id = _ids() | 1;
+
+    if (size < saveSize())
+        return NIN64_ERROR_OUTOFMEMORY;
+
+    SavestateWriter writer{buffer, size};
+
+    quiesce();
+    write(writer, id, SaveMemory::Full);
+    memory.checkpoint();
+    rsp.resume();
+    _checkpoint = id;
+    _clean      = true;
+    return NIN64_OK;
+}
+
+/*
+ * Like save(), but only keeps the memory lines written since the last state
+ * saved or loaded, the checkpoint. Restoring it takes loading the states it
+ * builds on first, in order. The size is not known in advance: when the
+ * buffer is too small, the size needed is returned and nothing changes.
+ */
+Nin64Err State::saveDelta(void* buffer, std::size_t size, std::size_t* written)
+{
+    std::uint64_t id = _ids() | 1;
+
+    if (!_checkpoint)
+    {
+        *written = saveSize();
+        return save(buffer, size);
+    }
+
+    SavestateWriter writer{buffer, size};
+
+    quiesce();
+    write(writer, id, SaveMemory::Delta);
+    *written = writer.size();
+    if (writer.ok())
+    {
+        memory.checkpoint();
+        _checkpoint = id;
+        _clean      = true;
+    }
+    rsp.resume();
+    return writer.ok() ? NIN64_OK : NIN64_ERROR_OUTOFMEMORY;
+}
+
+/*
+ * Restores a snapshot made by save() in place, nothing gets reallocated.
+ * A delta only applies to the state it was made from, with nothing run in
+ * between. The cart is not part of the state, it must be the one it was
+ * made with.
+ */
+Nin64Err State::load(const void* buffer, std::size_t size)
+{
+    SavestateReader reader{buffer, size};
+    std::uint64_t   id{};
+    std::uint64_t   base{};
+
+    if (!reader.ok() || !reader.open("CKPT"))
+        return NIN64_ERROR_BADSTATE;
+    reader.read(id);
+    reader.read(base);
+    if (!reader.ok())
+        return NIN64_ERROR_BADSTATE;
+    if (base ? (base != _checkpoint || !_clean) : size != saveSize())
+        return NIN64_ERROR_BADSTATE;
+    if (!check(reader, base != 0))
+        return NIN64_ERROR_BADSTATE;
+
+    quiesce();
+    read(reader, true);
+    memory.checkpoint();
+    rsp.resume();
+    _checkpoint = reader.ok() ? id : 0;
+    _clean      = reader.ok();
+    return reader.ok() ? NIN64_OK : NIN64_ERROR_BADSTATE;
+}
+
+/*
+ * Rewinding keeps up to budget bytes of history, allocated here. It is off
+ * with a budget of 0; any other budget must at least fit the newest frame.
+ */
+Nin64Err State::setRewindBudget(std::size_t budget)
+{
+    SavestateWriter writer{nullptr, 0};
+
+    _rewind.reset();
+    if (!budget)
+        return NIN64_OK;
+
+    write(writer, 0, SaveMemory::None);
+    if (budget <= Rewind::overhead(writer.size()))
+        return NIN64_ERROR_OUTOFMEMORY;
+    _rewind = std::make_unique<Rewind>(memory, writer.size(), budget);
+    return NIN64_OK;
+}
+
+/* Adds the current frame to the history */
+Nin64Err State::rewindPush()
+{
+    if (!_rewind)
+        return NIN64_ERROR_UNSUPPORTED;
+
+    SavestateWriter writer{_rewind->machine(), _rewind->machineSize()};
+
+    quiesce();
+    write(writer, 0, SaveMemory::None);
+    _rewind->push();
+    rsp.resume();
+    _pushed = true;
+    return NIN64_OK;
+}
+
+/* Goes back one frame in the history, staying on the oldest once there */
+Nin64Err State::rewindStep()
+{
+    const std::uint8_t* machine;
+
+    if (!_rewind)
+        return NIN64_ERROR_UNSUPPORTED;
+    if (!_rewind->frames())
+        return NIN64_ERROR_EMPTY;
+
+    quiesce();
+    machine = _rewind->step(_pushed);
+
+    SavestateReader reader{machine, _rewind->machineSize()};
+
+    read(reader, false);
+    rsp.resume();
+    _clean  = false;
+    _pushed = false;
+    return NIN64_OK;
+}
+
+/* Brings the coprocessor threads to a stop, the RSP must be resumed after */
+void State::quiesce()
+{
+    rsp.pause();
+    rdp.wait();
+    mi.deliver();
+}
+
+void State::write(SavestateWriter& writer, std::uint64_t id, SaveMemory mode) const
+{
+    writer.begin("CKPT");
+    writer.write(id);
+    writer.write((mode == SaveMemory::Delta) ? _checkpoint : 0);
+    writer.end();
+    scheduler.save(writer);
+    if (mode == SaveMemory::Full)
+        memory.save(writer);
+    else if (mode == SaveMemory::Delta)
+        memory.saveDelta(writer);
+    mi.save(writer);
+    pi.save(writer);
+    si.save(writer);
+    vi.save(writer);
+    ai.save(writer);
+    ri.save(writer);
+    rdp.save(writer);
+    rsp.save(writer);
+    cpu.save(writer);
+}
+
+void State::read(SavestateReader& reader, bool withMemory)
+{
+    scheduler.load(reader);
+    if (withMemory)
+        memory.load(reader);
+    mi.load(reader);
+    pi.load(reader);
+    si.load(reader);
+    vi.load(reader);
+    ai.load(reader);
+    ri.load(reader);
+    rdp.load(reader);
+    rsp.load(reader);
+    cpu.load(reader);
+}
+
+/*
+ * Nothing is applied until every section read back is known good: present,
+ * with the size this machine writes, a consistent event heap, and for a
+ * delta, well formed runs.
+ */
+bool State::check(SavestateReader& reader, bool delta) const
+{
+    std::vector<SavestateSection> layout;
+    SavestateWriter               writer{nullptr, 0, &layout};
+
+    write(writer, 0, delta ? SaveMemory::None : SaveMemory::Full);
+    for (const SavestateSection& section : layout)
+    {
+        if (reader.sectionSize(section.tag) != section.size)
+            return false;
+    }
+    if (!scheduler.check(reader))
+        return false;
+    if (delta)
+        return memory.checkDelta(reader);
+    return reader.sectionSize("MEMD") < 0;
+}
+
+void State::dispatch(Event event)
+{
+    switch (event)
+    {
+    case Event::VideoScanline:
+        vi.scanline();
+        break;
+    case Event::AudioDrain:
+        ai.drain();
         break;
-    case CIC::NUS_6102:
-        cicName = "6102";
+    case Event::Timer:
+        cpu.timer();
         break;
-    case CIC::NUS_6103:
-        cicName = "6103";
+    case Event::PeripheralDma:
+        pi.dmaComplete();
         break;
-    case CIC::NUS_6105:
-        cicName = "6105";
+    case Event::SerialDma:
+        si.dmaComplete();
         break;
-    case CIC::NUS_6106:
-        cicName = "6106";
+    case Event::RSP:
+        rsp.run();
+        break;
+    case Event::RDP:
+        rdp.sync();
         break;
     default:
-        cicName = "Unknown";
         break;
     }
-    std::printf("CIC: %s\n", cicName);
-    cpu.init(cart.cic());
-    rsp.init(cart.cic());
-    return NIN64_OK;
 }
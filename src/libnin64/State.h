@@ -1,6 +1,8 @@
 #ifndef INCLUDED_STATE_H
 #define INCLUDED_STATE_H
 
+#include <memory>
+#include <random>
 #include <libnin64/AudioInterface.h>
 #include <libnin64/Bus.h>
 #include <libnin64/CPU.h>
@@ -9,23 +11,45 @@
 #include <libnin64/Memory.h>
 #include <libnin64/NonCopyable.h>
 #include <libnin64/PeripheralInterface.h>
+#include <libnin64/Profiler.h>
 #include <libnin64/RDP.h>
 #include <libnin64/RDRAMInterface.h>
 #include <libnin64/RSP.h>
+#include <libnin64/Rewind.h>
+#include <libnin64/Scheduler.h>
 #include <libnin64/SerialInterface.h>
 #include <libnin64/VideoInterface.h>
 
 namespace libnin64
 {
 
+class SavestateReader;
+class SavestateWriter;
 class State : private NonCopyable
 {
 public:
+    static constexpr const std::uint64_t kCyclesPerFrame = 93750000 / 60;
+
     State();
     ~State();
 
     Nin64Err loadRom(const char* path);
+    void     run(std::uint64_t cycles);
+    void     setThreaded(bool threaded);
+    Nin64Err setCacheEmulation(bool enabled);
+    void     stats(Nin64Stats* stats) const;
+
+    std::size_t saveSize() const;
+    Nin64Err    save(void* buffer, std::size_t size);
+    Nin64Err    saveDelta(void* buffer, std::size_t size, std::size_t* written);
+    Nin64Err    load(const void* buffer, std::size_t size);
+
+    Nin64Err setRewindBudget(std::size_t budget);
+    Nin64Err rewindPush();
+    Nin64Err rewindStep();
 
+    Profiler            profiler;
+    Scheduler           scheduler;
     Cart                cart;
     Memory              memory;
     MIPSInterface       mi;
@@ -38,6 +62,26 @@ public:
     RSP                 rsp;
     Bus                 bus;
     CPU                 cpu;
+
+private:
+    enum class SaveMemory
+    {
+        Full,
+        Delta,
+        None,
+    };
+
+    void dispatch(Event event);
+    void quiesce();
+    void write(SavestateWriter& writer, std::uint64_t id, SaveMemory mode) const;
+    void read(SavestateReader& reader, bool withMemory);
+    bool check(SavestateReader& reader, bool delta) const;
+
+    std::mt19937_64         _ids;
+    std::uint64_t           _checkpoint;
+    bool                    _clean;
+    std::unique_ptr<Rewind> _rewind;
+    bool                    _pushed;
 };
 
 } // namespace libnin64
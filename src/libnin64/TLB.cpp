@@ -0,0 +1,152 @@
+#include <libnin64/TLB.h>
+
+using namespace libnin64;
+
+static constexpr const std::uint32_t kPageCount = std::uint32_t(1) << (32 - TLB::kPageShift);
+
+/* Pages of the unmapped segments, KSEG0 and KSEG1 */
+static bool unmapped(std::uint32_t page)
+{
+    return page >= (0x80000000 >> TLB::kPageShift) && page < (0xc0000000 >> TLB::kPageShift);
+}
+
+static bool global(const TLB::Entry& entry)
+{
+    return entry.entryLo0 & entry.entryLo1 & 1;
+}
+
+/* Pages in each half of the entry, the even one mapped by EntryLo0 and the odd one by EntryLo1 */
+static std::uint32_t halfPages(const TLB::Entry& entry)
+{
+    return (entry.pageMask >> 13) + 1;
+}
+
+static std::uint32_t firstPage(const TLB::Entry& entry)
+{
+    return (entry.entryHi & ~(entry.pageMask | 0x1fff)) >> TLB::kPageShift;
+}
+
+static bool overlap(const TLB::Entry& a, const TLB::Entry& b)
+{
+    return firstPage(a) < firstPage(b) + halfPages(b) * 2 && firstPage(b) < firstPage(a) + halfPages(a) * 2;
+}
+
+TLB::TLB()
+: _pages{std::make_unique<std::uint32_t[]>(kPageCount)}
+, _entries{}
+, _asid{}
+{
+    for (std::uint32_t page = 0x80000000 >> kPageShift; page < (0xc0000000 >> kPageShift); ++page)
+        _pages[page] = ((page << kPageShift) & 0x1fffffff) | kReadable | kWritable | ((page < (0xa0000000 >> kPageShift)) ? kCached : 0);
+}
+
+TLB::~TLB()
+{
+}
+
+void TLB::write(std::size_t index, const Entry& entry)
+{
+    Entry old;
+
+    old             = _entries[index];
+    _entries[index] = entry;
+    if (active(old))
+    {
+        fill(old, true);
+        refill(old);
+    }
+    if (active(entry))
+        fill(entry, false);
+}
+
+void TLB::setAsid(std::uint8_t asid)
+{
+    if (asid == _asid)
+        return;
+
+    for (const Entry& entry : _entries)
+    {
+        if (active(entry) && !global(entry))
+            fill(entry, true);
+    }
+    _asid = asid;
+    for (const Entry& entry : _entries)
+    {
+        if (active(entry))
+            fill(entry, false);
+    }
+}
+
+int TLB::probe(std::uint32_t entryHi) const
+{
+    std::uint32_t mask;
+
+    for (std::size_t i = 0; i < kEntryCount; ++i)
+    {
+        const Entry& entry = _entries[i];
+
+        mask = ~(entry.pageMask | 0x1fff);
+        if ((entry.entryHi & mask) == (entryHi & mask) && (global(entry) || (entry.entryHi & 0xff) == (entryHi & 0xff)))
+            return (int)i;
+    }
+    return -1;
+}
+
+void TLB::load(const Entry* entries, std::uint8_t asid)
+{
+    for (const Entry& entry : _entries)
+    {
+        if (active(entry))
+            fill(entry, true);
+    }
+    for (std::size_t i = 0; i < kEntryCount; ++i)
+        _entries[i] = entries[i];
+    _asid = asid;
+    for (const Entry& entry : _entries)
+    {
+        if (active(entry))
+            fill(entry, false);
+    }
+}
+
+bool TLB::active(const Entry& entry) const
+{
+    return global(entry) || (entry.entryHi & 0xff) == _asid;
+}
+
+void TLB::fill(const Entry& entry, bool clear)
+{
+    std::uint32_t count;
+    std::uint32_t first;
+    std::uint32_t lo;
+    std::uint32_t pfn;
+    std::uint32_t page;
+
+    count = halfPages(entry);
+    first = firstPage(entry);
+    for (std::uint32_t half = 0; half < 2; ++half)
+    {
+        lo  = half ? entry.entryLo1 : entry.entryLo0;
+        pfn = ((lo >> 6) & 0xfffff) & ~(count - 1);
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            page = first + half * count + i;
+            if (unmapped(page))
+                continue;
+            if (clear || !(lo & 0x2))
+                _pages[page] = 0;
+            else
+                _pages[page] = (((pfn + i) << kPageShift) & 0x1fffffff) | kReadable | ((lo & 0x4) ? kWritable : 0) | (((lo >> 3) & 7) != 2 ? kCached : 0);
+        }
+    }
+}
+
+/* Entries the given one may have been hiding, once its pages are gone */
+void TLB::refill(const Entry& entry)
+{
+    for (const Entry& other : _entries)
+    {
+        if (active(other) && overlap(entry, other))
+            fill(other, false);
+    }
+}
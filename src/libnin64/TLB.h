@@ -0,0 +1,66 @@
+#ifndef INCLUDED_TLB_H
+#define INCLUDED_TLB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <libnin64/NonCopyable.h>
+
+namespace libnin64
+{
+
+/*
+ * VR4300 joint TLB, in 32-bit mode.
+ *
+ * Besides the 32 entries, the whole virtual address space is mirrored in an
+ * array of 4KiB pages holding the physical page, what it may be used for
+ * and whether it is cached, so translating an address is a single lookup.
+ * KSEG0 and KSEG1 are filled once, the mapped segments are updated whenever
+ * an entry or the current ASID changes. A page without the needed access bit is either
+ * unmapped or invalid, and the CPU sorts it out on the slow path.
+ */
+class TLB : private NonCopyable
+{
+public:
+    static constexpr const std::size_t   kEntryCount = 32;
+    static constexpr const unsigned      kPageShift  = 12;
+    static constexpr const std::uint32_t kReadable   = 0x1;
+    static constexpr const std::uint32_t kWritable   = 0x2;
+    static constexpr const std::uint32_t kCached     = 0x4;
+
+    struct Entry
+    {
+        std::uint32_t pageMask;
+        std::uint32_t entryHi;
+        std::uint32_t entryLo0;
+        std::uint32_t entryLo1;
+    };
+
+    TLB();
+    ~TLB();
+
+    std::uint32_t lookup(std::uint32_t addr) const { return _pages[addr >> kPageShift]; }
+
+    const Entry& entry(std::size_t index) const { return _entries[index]; }
+    void         write(std::size_t index, const Entry& entry);
+    void         setAsid(std::uint8_t asid);
+
+    /* Index of the entry matching the VPN2 and ASID of entryHi, or -1 */
+    int probe(std::uint32_t entryHi) const;
+
+    /* Replaces every entry at once, as when loading a save state */
+    void load(const Entry* entries, std::uint8_t asid);
+
+private:
+    bool active(const Entry& entry) const;
+    void fill(const Entry& entry, bool clear);
+    void refill(const Entry& entry);
+
+    std::unique_ptr<std::uint32_t[]> _pages;
+    Entry                            _entries[kEntryCount];
+    std::uint8_t                     _asid;
+};
+
+} // namespace libnin64
+
+#endif
@@ -0,0 +1,79 @@
+#include <libnin64/Timing.h>
+
+using namespace libnin64;
+
+/* SPECIAL, by function: the multiplies and divides hold the pipeline until HI and LO are ready */
+static constexpr const std::uint8_t kSpecialCycles[64] = {
+    1, 1, 1, 1, 1, 1, 1, 1,      // 000
+    1, 1, 1, 1, 1, 1, 1, 1,      // 010
+    1, 1, 1, 1, 1, 1, 1, 1,      // 020
+    5, 5, 37, 37, 8, 8, 69, 69,  // 030 MULT MULTU DIV DIVU DMULT DMULTU DDIV DDIVU
+    1, 1, 1, 1, 1, 1, 1, 1,      // 040
+    1, 1, 1, 1, 1, 1, 1, 1,      // 050
+    1, 1, 1, 1, 1, 1, 1, 1,      // 060
+    1, 1, 1, 1, 1, 1, 1, 1,      // 070
+};
+
+/* COP1 single precision, by function */
+static constexpr const std::uint8_t kSingleCycles[64] = {
+    3, 3, 5, 29, 29, 1, 1, 1,    // 000 ADD SUB MUL DIV SQRT ABS MOV NEG
+    5, 5, 5, 5, 5, 5, 5, 5,      // 010 ROUND TRUNC CEIL FLOOR
+    1, 1, 1, 1, 1, 1, 1, 1,      // 020
+    1, 1, 1, 1, 1, 1, 1, 1,      // 030
+    1, 1, 1, 1, 5, 5, 1, 1,      // 040 CVT.S CVT.D - - CVT.W CVT.L
+    1, 1, 1, 1, 1, 1, 1, 1,      // 050
+    1, 1, 1, 1, 1, 1, 1, 1,      // 060 C.cond
+    1, 1, 1, 1, 1, 1, 1, 1,      // 070
+};
+
+/* COP1 double precision, by function */
+static constexpr const std::uint8_t kDoubleCycles[64] = {
+    3, 3, 8, 58, 58, 1, 1, 1,    // 000 ADD SUB MUL DIV SQRT ABS MOV NEG
+    5, 5, 5, 5, 5, 5, 5, 5,      // 010 ROUND TRUNC CEIL FLOOR
+    1, 1, 1, 1, 1, 1, 1, 1,      // 020
+    1, 1, 1, 1, 1, 1, 1, 1,      // 030
+    2, 1, 1, 1, 5, 5, 1, 1,      // 040 CVT.S CVT.D - - CVT.W CVT.L
+    1, 1, 1, 1, 1, 1, 1, 1,      // 050
+    1, 1, 1, 1, 1, 1, 1, 1,      // 060 C.cond
+    1, 1, 1, 1, 1, 1, 1, 1,      // 070
+};
+
+std::uint8_t Timing::instrCycles(std::uint32_t op)
+{
+    if (!kAccurate)
+        return 1;
+
+    switch (op >> 26)
+    {
+    case 000: // SPECIAL
+        return kSpecialCycles[op & 0x3f];
+    case 021: // COP1
+        switch ((op >> 21) & 0x1f)
+        {
+        case 020: // S
+            return kSingleCycles[op & 0x3f];
+        case 021: // D
+            return kDoubleCycles[op & 0x3f];
+        case 024: // W
+        case 025: // L
+            return ((op & 0x3f) == 040 || (op & 0x3f) == 041) ? 5 : 1;
+        }
+        break;
+    }
+    return 1;
+}
+
+std::uint64_t Timing::peripheralDma(std::uint32_t length, std::uint8_t lat, std::uint8_t pwd, std::uint8_t pgs, std::uint8_t rls)
+{
+    std::uint64_t pages;
+    std::uint64_t cycles;
+
+    if (!kAccurate)
+        return (std::uint64_t(length) * 63) / 25;
+
+    pages  = (length + (std::uint32_t(4) << pgs) - 1) >> (pgs + 2);
+    cycles = pages * (lat + 1) + ((length + 1) / 2) * (std::uint64_t(pwd + 1) + (rls + 1));
+
+    /* The RCP runs at two thirds of the CPU clock */
+    return cycles * 3 / 2;
+}
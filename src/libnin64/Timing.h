@@ -0,0 +1,56 @@
+#ifndef INCLUDED_TIMING_H
+#define INCLUDED_TIMING_H
+
+#include <cstdint>
+
+#if !defined(NIN64_CYCLE_TIMING)
+#define NIN64_CYCLE_TIMING 1
+#endif
+
+namespace libnin64
+{
+
+/*
+ * How long things take, in CPU cycles, picked at build time.
+ *
+ * With NIN64_CYCLE_TIMING on, instructions take their VR4300 latency and
+ * accesses that leave the CPU pay for the trip: uncached loads wait for the
+ * bus, uncached stores for the write buffer, and with cache emulation a miss
+ * waits for the line. DMA lengths follow the bus timings. With it off, every
+ * instruction takes a cycle and memory is free.
+ */
+struct Timing
+{
+#if NIN64_CYCLE_TIMING
+    static constexpr const bool          kAccurate      = true;
+    static constexpr const std::uint32_t kUncachedLoad  = 40;
+    static constexpr const std::uint32_t kUncachedStore = 10;
+    static constexpr const std::uint32_t kICacheMiss    = 48;
+    static constexpr const std::uint32_t kDCacheMiss    = 40;
+    static constexpr const std::uint32_t kWriteBack     = 32;
+#else
+    static constexpr const bool          kAccurate      = false;
+    static constexpr const std::uint32_t kUncachedLoad  = 0;
+    static constexpr const std::uint32_t kUncachedStore = 0;
+    static constexpr const std::uint32_t kICacheMiss    = 0;
+    static constexpr const std::uint32_t kDCacheMiss    = 0;
+    static constexpr const std::uint32_t kWriteBack     = 0;
+#endif
+
+    /* SI DMA to or from PIF RAM, 64 bytes over the serial bus */
+    static constexpr const std::uint32_t kSerialDma = 2304;
+
+    /* Cycles an instruction takes when nothing stalls it */
+    static std::uint8_t instrCycles(std::uint32_t op);
+
+    /*
+     * PI DMA of length bytes on a domain with the given bus timings, the
+     * BSD_DOM registers: a latency per page of 2^(pgs+2) bytes, then a pulse
+     * and a release per halfword, in RCP cycles.
+     */
+    static std::uint64_t peripheralDma(std::uint32_t length, std::uint8_t lat, std::uint8_t pwd, std::uint8_t pgs, std::uint8_t rls);
+};
+
+} // namespace libnin64
+
+#endif
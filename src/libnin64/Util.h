@@ -38,6 +38,10 @@ inline static void umul128(std::uint64_t a, std::uint64_t b, std::uint64_t* lo,
 }
 
 std::uint32_t crc32(const void* data, std::size_t length);
+std::uint64_t xxh64(const void* data, std::size_t length);
+
+/* Kernel behind crc32 on hosts with PCLMULQDQ */
+std::uint32_t crc32PCLMUL(std::uint32_t crc, const void* data, std::size_t length);
 
 inline static constexpr std::uint8_t swap(std::uint8_t v)
 {
@@ -1,5 +1,8 @@
-#include <cstdio>
+#include <libnin64/Log.h>
 #include <libnin64/MIPSInterface.h>
+#include <libnin64/Profiler.h>
+#include <libnin64/Savestate.h>
+#include <libnin64/Scheduler.h>
 #include <libnin64/VideoInterface.h>
 
 #define VI_STATUS_REG  0x04400000
@@ -17,15 +20,19 @@
 #define VI_X_SCALE_REG 0x04400030
 #define VI_Y_SCALE_REG 0x04400034
 
+#define CYCLES_PER_SCANLINE (93750000 / 30 / 525)
+
 using namespace libnin64;
 
-VideoInterface::VideoInterface(MIPSInterface& mi)
+VideoInterface::VideoInterface(MIPSInterface& mi, Scheduler& scheduler, Profiler& profiler)
 : _mi{mi}
+, _scheduler{scheduler}
+, _profiler{profiler}
 , _sync{}
-, _acc{}
 , _scanline{}
 , _scanlineSync{}
 {
+    _scheduler.schedule(Event::VideoScanline, CYCLES_PER_SCANLINE);
 }
 
 VideoInterface::~VideoInterface()
@@ -36,7 +43,7 @@ void VideoInterface::setVBlank()
 {
     if (_sync)
     {
-        std::printf("VI set!\n");
+        NIN64_LOG(VI, Trace, "VI set!\n");
         _mi.setInterrupt(MI_INTR_VI);
     }
 }
@@ -48,49 +55,49 @@ std::uint32_t VideoInterface::read(std::uint32_t reg)
     switch (reg)
     {
     case VI_STATUS_REG:
-        std::printf("VI Read: VI_STATUS_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_STATUS_REG\n");
         break;
     case VI_ORIGIN_REG:
-        std::printf("VI Read: VI_ORIGIN_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_ORIGIN_REG\n");
         value = _origin;
         break;
     case VI_WIDTH_REG:
-        std::printf("VI Read: VI_WIDTH_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_WIDTH_REG\n");
         break;
     case VI_INTR_REG:
-        std::printf("VI Read: VI_INTR_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_INTR_REG\n");
         value = _scanlineSync;
         break;
     case VI_CURRENT_REG:
-        //std::printf("VI Read: VI_CURRENT_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_CURRENT_REG\n");
         value = _scanline;
         break;
     case VI_BURST_REG:
-        std::printf("VI Read: VI_BURST_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_BURST_REG\n");
         break;
     case VI_V_SYNC_REG:
-        std::printf("VI Read: VI_V_SYNC_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_V_SYNC_REG\n");
         break;
     case VI_H_SYNC_REG:
-        std::printf("VI Read: VI_H_SYNC_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_H_SYNC_REG\n");
         break;
     case VI_LEAP_REG:
-        std::printf("VI Read: VI_LEAP_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_LEAP_REG\n");
         break;
     case VI_H_START_REG:
-        std::printf("VI Read: VI_H_START_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_H_START_REG\n");
         break;
     case VI_V_START_REG:
-        std::printf("VI Read: VI_V_START_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_V_START_REG\n");
         break;
     case VI_V_BURST_REG:
-        std::printf("VI Read: VI_V_BURST_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_V_BURST_REG\n");
         break;
     case VI_X_SCALE_REG:
-        std::printf("VI Read: VI_X_SCALE_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_X_SCALE_REG\n");
         break;
     case VI_Y_SCALE_REG:
-        std::printf("VI Read: VI_Y_SCALE_REG\n");
+        NIN64_LOG(VI, Trace, "VI Read: VI_Y_SCALE_REG\n");
         break;
     default:
         break;
@@ -105,68 +112,83 @@ void VideoInterface::write(std::uint32_t reg, std::uint32_t value)
     {
     case VI_STATUS_REG:
         _sync = !!(value & 0x03);
-        std::printf("VI Write: VI_STATUS_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI Write: VI_STATUS_REG: 0x%08x\n", value);
         break;
     case VI_ORIGIN_REG:
-        std::printf("VI Write: VI_ORIGIN_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI Write: VI_ORIGIN_REG: 0x%08x\n", value);
         _origin = value & 0xffffff;
         break;
     case VI_WIDTH_REG:
-        std::printf("VI Write: VI_WIDTH_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI Write: VI_WIDTH_REG: 0x%08x\n", value);
         break;
     case VI_INTR_REG:
-        std::printf("VI Write: VI_INTR_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI Write: VI_INTR_REG: 0x%08x\n", value);
         _scanlineSync = value;
         break;
     case VI_CURRENT_REG:
         _mi.clearInterrupt(MI_INTR_VI);
-        std::printf("VI Write: VI_CURRENT_REG: 0x%08x\n", value);
-        std::printf("VI clear!\n");
+        NIN64_LOG(VI, Trace, "VI Write: VI_CURRENT_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI clear!\n");
         break;
     case VI_BURST_REG:
-        std::printf("VI Write: VI_BURST_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI Write: VI_BURST_REG: 0x%08x\n", value);
         break;
     case VI_V_SYNC_REG:
-        std::printf("VI Write: VI_V_SYNC_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI Write: VI_V_SYNC_REG: 0x%08x\n", value);
         break;
     case VI_H_SYNC_REG:
-        std::printf("VI Write: VI_H_SYNC_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI Write: VI_H_SYNC_REG: 0x%08x\n", value);
         break;
     case VI_LEAP_REG:
-        std::printf("VI Write: VI_LEAP_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI Write: VI_LEAP_REG: 0x%08x\n", value);
         break;
     case VI_H_START_REG:
-        std::printf("VI Write: VI_H_START_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI Write: VI_H_START_REG: 0x%08x\n", value);
         break;
     case VI_V_START_REG:
-        std::printf("VI Write: VI_V_START_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI Write: VI_V_START_REG: 0x%08x\n", value);
         break;
     case VI_V_BURST_REG:
-        std::printf("VI Write: VI_V_BURST_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI Write: VI_V_BURST_REG: 0x%08x\n", value);
         break;
     case VI_X_SCALE_REG:
-        std::printf("VI Write: VI_X_SCALE_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI Write: VI_X_SCALE_REG: 0x%08x\n", value);
         break;
     case VI_Y_SCALE_REG:
-        std::printf("VI Write: VI_Y_SCALE_REG: 0x%08x\n", value);
+        NIN64_LOG(VI, Trace, "VI Write: VI_Y_SCALE_REG: 0x%08x\n", value);
         break;
     default:
         break;
     }
 }
 
-void VideoInterface::tick(std::size_t count)
+void VideoInterface::scanline()
 {
-    static constexpr const std::size_t kScanlineSync = 93750000 / 30 / 525;
+    Profiler::Scope scope{_profiler, Component::VI};
 
-    _acc += count;
-    while (_acc >= kScanlineSync)
-    {
-        _acc -= kScanlineSync;
-        _scanline++;
-        if (_scanline == 525)
-            _scanline = 0;
-        if (_scanline == _scanlineSync)
-            _mi.setInterrupt(MI_INTR_VI);
-    }
+    _scanline++;
+    if (_scanline == 525)
+        _scanline = 0;
+    if (_scanline == _scanlineSync)
+        _mi.setInterrupt(MI_INTR_VI);
+    _scheduler.scheduleAt(Event::VideoScanline, _scheduler.when(Event::VideoScanline) + CYCLES_PER_SCANLINE);
+}
+
+void VideoInterface::save(SavestateWriter& writer) const
+{
+    writer.begin("VI  ");
+    writer.write<bool>(_sync);
+    writer.write(_origin);
+    writer.write(_scanline);
+    writer.write(_scanlineSync);
+    writer.end();
+}
+
+void VideoInterface::load(SavestateReader& reader)
+{
+    reader.open("VI  ");
+    _sync = reader.read<bool>();
+    reader.read(_origin);
+    reader.read(_scanline);
+    reader.read(_scanlineSync);
 }
@@ -9,25 +9,33 @@ namespace libnin64
 {
 
 class MIPSInterface;
+class Profiler;
+class SavestateReader;
+class SavestateWriter;
+class Scheduler;
 class VideoInterface : private NonCopyable
 {
 public:
-    VideoInterface(MIPSInterface& mi);
+    VideoInterface(MIPSInterface& mi, Scheduler& scheduler, Profiler& profiler);
     ~VideoInterface();
 
     void          setVBlank();
     std::uint32_t read(std::uint32_t reg);
     void          write(std::uint32_t reg, std::uint32_t value);
-    void          tick(std::size_t count);
+    void          scanline();
+
+    void save(SavestateWriter& writer) const;
+    void load(SavestateReader& reader);
 
 private:
     MIPSInterface& _mi;
+    Scheduler&     _scheduler;
+    Profiler&      _profiler;
 
     bool          _sync : 1;
     std::uint32_t _origin;
     std::uint16_t _scanline;
     std::uint16_t _scanlineSync;
-    std::size_t   _acc;
 };
 
 } // namespace libnin64
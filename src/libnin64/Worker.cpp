@@ -0,0 +1,64 @@
+#include <libnin64/Worker.h>
+
+using namespace libnin64;
+
+Worker::Worker()
+: _busy{}
+, _quit{}
+, _thread{&Worker::loop, this}
+{
+}
+
+Worker::~Worker()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _wake.notify_one();
+    _thread.join();
+}
+
+bool Worker::busy()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _busy;
+}
+
+void Worker::submit(std::function<void()> job)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _done.wait(lock, [this] { return !_busy; });
+    _job  = std::move(job);
+    _busy = true;
+    lock.unlock();
+    _wake.notify_one();
+}
+
+void Worker::wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _done.wait(lock, [this] { return !_busy; });
+}
+
+void Worker::loop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    for (;;)
+    {
+        _wake.wait(lock, [this] { return _busy || _quit; });
+        if (_quit)
+            return;
+
+        lock.unlock();
+        _job();
+        lock.lock();
+
+        _job  = nullptr;
+        _busy = false;
+        _done.notify_all();
+    }
+}
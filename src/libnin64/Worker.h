@@ -0,0 +1,42 @@
+#ifndef INCLUDED_WORKER_H
+#define INCLUDED_WORKER_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <libnin64/NonCopyable.h>
+
+namespace libnin64
+{
+
+/*
+ * A thread running one job at a time, for the coprocessors.
+ *
+ * Whoever submits work owns the data it touches until wait() returns.
+ */
+class Worker : private NonCopyable
+{
+public:
+    Worker();
+    ~Worker();
+
+    bool busy();
+    void submit(std::function<void()> job);
+    void wait();
+
+private:
+    void loop();
+
+    std::mutex              _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    std::function<void()>   _job;
+    bool                    _busy;
+    bool                    _quit;
+    std::thread             _thread;
+};
+
+} // namespace libnin64
+
+#endif
@@ -0,0 +1,77 @@
+#include <cstring>
+#include <libnin64/Util.h>
+
+/*
+ * xxHash64, seeded with 0. Four independent lanes of one multiply per
+ * 8 bytes, which runs close to memory bandwidth on large inputs.
+ */
+
+using namespace libnin64;
+
+inline static std::uint64_t rotl(std::uint64_t v, int shift)
+{
+    return (v << shift) | (v >> (64 - shift));
+}
+
+std::uint64_t libnin64::xxh64(const void* src, std::size_t size)
+{
+    static constexpr const std::uint64_t kP1 = 0x9e3779b185ebca87ull;
+    static constexpr const std::uint64_t kP2 = 0xc2b2ae3d27d4eb4full;
+    static constexpr const std::uint64_t kP3 = 0x165667b19e3779f9ull;
+    static constexpr const std::uint64_t kP4 = 0x85ebca77c2b2ae63ull;
+    static constexpr const std::uint64_t kP5 = 0x27d4eb2f165667c5ull;
+
+    const std::uint8_t* data = (const std::uint8_t*)src;
+    const std::uint8_t* end  = data + size;
+    std::uint64_t       v1   = kP1 + kP2;
+    std::uint64_t       v2   = kP2;
+    std::uint64_t       v3   = 0;
+    std::uint64_t       v4   = 0 - kP1;
+    std::uint64_t       h;
+    std::uint32_t       w;
+
+    auto round = [](std::uint64_t acc, const std::uint8_t* input) {
+        std::uint64_t value;
+
+        std::memcpy(&value, input, 8);
+        return rotl(acc + value * kP2, 31) * kP1;
+    };
+    auto merge = [](std::uint64_t acc, std::uint64_t lane) { return (acc ^ (rotl(lane * kP2, 31) * kP1)) * kP1 + kP4; };
+
+    if (size >= 32)
+    {
+        for (; end - data >= 32; data += 32)
+        {
+            v1 = round(v1, data);
+            v2 = round(v2, data + 8);
+            v3 = round(v3, data + 16);
+            v4 = round(v4, data + 24);
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge(h, v1);
+        h = merge(h, v2);
+        h = merge(h, v3);
+        h = merge(h, v4);
+    }
+    else
+        h = kP5;
+
+    h += size;
+    for (; end - data >= 8; data += 8)
+        h = rotl(h ^ round(0, data), 27) * kP1 + kP4;
+    if (end - data >= 4)
+    {
+        std::memcpy(&w, data, 4);
+        h = rotl(h ^ (w * kP1), 23) * kP2 + kP3;
+        data += 4;
+    }
+    for (; data < end; ++data)
+        h = rotl(h ^ (*data * kP5), 11) * kP1;
+
+    h ^= h >> 33;
+    h *= kP2;
+    h ^= h >> 29;
+    h *= kP3;
+    h ^= h >> 32;
+    return h;
+}